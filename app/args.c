@@ -9,9 +9,13 @@
 
 #include "thirdparty/parsarg/parsarg.h"
 
-static bool readpe_args_parse_by_parsarg_(readpe_args_t* args, parsarg_t* pa) {
+#include "./output.h"
+
+static bool readpe_args_parse_by_parsarg_(
+    readpe_args_t* args, parsarg_t* pa, FILE* err) {
   assert(args != NULL);
   assert(pa   != NULL);
+  assert(err  != NULL);
 
   *args = (typeof(*args)) {0};
 
@@ -27,7 +31,7 @@ static bool readpe_args_parse_by_parsarg_(readpe_args_t* args, parsarg_t* pa) {
 #     define bool_(name, arg_name) do {  \
         if (!ok && streq_(arg_name)) {  \
           if (v != NULL) {  \
-            fprintf(stderr, "option '%s' cannot take values\n", arg_name);  \
+            fprintf(err, "option '%s' cannot take values\n", arg_name);  \
             return false;  \
           }  \
           args->name = true;  \
@@ -35,41 +39,136 @@ static bool readpe_args_parse_by_parsarg_(readpe_args_t* args, parsarg_t* pa) {
         }  \
       } while (0)
 
+#     define size_(name, arg_name) do {  \
+        if (!ok && streq_(arg_name)) {  \
+          char* end;  \
+          if (v == NULL || (args->name = strtoul(v, &end, 0), *end != 0)) {  \
+            fprintf(err, "option '%s' requires a number\n", arg_name);  \
+            return false;  \
+          }  \
+          ok = true;  \
+        }  \
+      } while (0)
+
+#     define str_(name, arg_name) do {  \
+        if (!ok && streq_(arg_name)) {  \
+          if (v == NULL) {  \
+            fprintf(err, "option '%s' requires a value\n", arg_name);  \
+            return false;  \
+          }  \
+          args->name = v;  \
+          ok = true;  \
+        }  \
+      } while (0)
+
       bool_(help, "help");
       bool_(all,  "all");
 
+      bool_(stdin_list,     "stdin");
+      bool_(null_separated, "null");
+      bool_(unordered,      "unordered");
+      size_(jobs,           "jobs");
+      str_(cache,           "cache");
+      bool_(read_ahead,     "read-ahead");
+      str_(serve,           "serve");
+      str_(connect,         "connect");
+      size_(keep,           "keep");
+
+      if (!ok && streq_("format")) {
+        if (v == NULL || !readpe_output_parse_format(v, &args->format)) {
+          fprintf(err,
+              "option 'format' requires text, json, ndjson or record\n");
+          return false;
+        }
+        ok = true;
+      }
+
       bool_(dos_header, "dos-header");
       bool_(dos_stub,   "dos-stub");
       bool_(nt_header,  "nt-header");
 
+      bool_(authenticode, "authenticode");
+
       bool_(section_table, "section-table");
+      bool_(section_stats, "section-stats");
       bool_(export_table,  "export-table");
+      str_(find_export,    "find-export");
       bool_(import_table,  "import-table");
       bool_(relocation_table,  "relocation-table");
+      bool_(relocation_density, "relocation-density");
+      bool_(hashes,             "hashes");
+      bool_(strings,            "strings");
+      size_(min_length,         "min-length");
+      bool_(skip_names,         "skip-names");
+      str_(signatures,          "signatures");
+      bool_(scan_image,         "scan-image");
+      bool_(fingerprints,       "fingerprints");
+
+      bool_(exports, "exports");
+      bool_(prefix,  "prefix");
 
+#     undef str_
+#     undef size_
 #     undef bool_
 #     undef streq_
 
       if (!ok) {
-        fprintf(stderr, "unknown option: %.*s\n", (int) nlen, n);
+        fprintf(err, "unknown option: %.*s\n", (int) nlen, n);
         return false;
       }
     } else {
-
-      if (args->input != NULL) {
-        fprintf(stderr, "cannot take two input files\n");
+      const char** inputs = realloc(
+          args->inputs, (args->inputs_length+1)*sizeof(*inputs));
+      if (inputs == NULL) {
+        fprintf(err, "failed to allocate memory for input files\n");
         return false;
       }
-      args->input = v;
+      args->inputs = inputs;
+      args->inputs[args->inputs_length++] = v;
     }
   }
 
   return true;
 }
 
+/* takes "index build <index>", "index query <index>" or "resolve" off the
+ * inputs */
+static void readpe_args_take_subcommand_(readpe_args_t* args) {
+  assert(args != NULL);
+
+  const char* const* in = args->inputs;
+  const size_t       n  = args->inputs_length;
+
+  size_t taken;
+  if (n >= 1 && strcmp(in[0], "resolve") == 0) {
+    args->mode = READPE_ARGS_MODE_RESOLVE;
+    taken = 1;
+  } else if (n >= 2 && strcmp(in[0], "index") == 0 &&
+      strcmp(in[1], "build") == 0) {
+    args->mode = READPE_ARGS_MODE_INDEX_BUILD;
+    taken = 2;
+  } else if (n >= 2 && strcmp(in[0], "index") == 0 &&
+      strcmp(in[1], "query") == 0) {
+    args->mode = READPE_ARGS_MODE_INDEX_QUERY;
+    taken = 2;
+  } else {
+    return;
+  }
+  if (args->mode != READPE_ARGS_MODE_RESOLVE && n > taken) {
+    args->index = in[taken++];
+  }
+
+  args->inputs_length -= taken;
+  memmove(args->inputs, args->inputs + taken,
+      args->inputs_length*sizeof(*args->inputs));
+}
+
 static void readpe_args_normalize_(readpe_args_t* args) {
   assert(args != NULL);
 
+  readpe_args_take_subcommand_(args);
+  if (args->serve != NULL) args->mode = READPE_ARGS_MODE_SERVE;
+
   args->dos_header |= args->all;
   args->dos_stub   |= args->all;
   args->nt_header  |= args->all;
@@ -78,37 +177,171 @@ static void readpe_args_normalize_(readpe_args_t* args) {
   args->export_table     |= args->all;
   args->import_table     |= args->all;
   args->relocation_table |= args->all;
+
+  if (args->fingerprints) {
+    args->dos_header   = false;
+    args->dos_stub     = false;
+    args->nt_header    = false;
+    args->authenticode = false;
+
+    args->section_table      = false;
+    args->section_stats      = false;
+    args->export_table       = false;
+    args->find_export        = NULL;
+    args->import_table       = false;
+    args->relocation_table   = false;
+    args->relocation_density = false;
+    args->hashes             = false;
+    args->strings            = false;
+    args->signatures         = NULL;
+  }
+
+  args->batch = args->inputs_length != 1 || args->stdin_list;
 }
 
-static bool readpe_args_validate_(const readpe_args_t* args) {
+static bool readpe_args_validate_(const readpe_args_t* args, FILE* err) {
   assert(args != NULL);
+  assert(err  != NULL);
 
-  return
-      (args->help || args->input != NULL);
+  if (args->help) return true;
+
+  switch (args->mode) {
+  case READPE_ARGS_MODE_INSPECT:
+  case READPE_ARGS_MODE_RESOLVE:
+    break;
+  case READPE_ARGS_MODE_INDEX_BUILD:
+    return args->index != NULL &&
+        (args->inputs_length > 0 || args->stdin_list);
+  case READPE_ARGS_MODE_SERVE:
+    if (args->inputs_length > 0 || args->stdin_list) {
+      fprintf(err, "the server takes files from requests only\n");
+      return false;
+    }
+    return true;
+  case READPE_ARGS_MODE_INDEX_QUERY:
+    if (args->format == READPE_OUTPUT_FORMAT_RECORD) {
+      fprintf(err, "queries cannot be written as records\n");
+      return false;
+    }
+    return args->index != NULL && args->inputs_length > 0;
+  }
+  return args->inputs_length > 0 || args->stdin_list;
 }
 
 void readpe_args_print_help(void) {
-  printf("usage: readpe <exe file> [options]\n");
+  printf("usage: readpe <exe file or directory>... [options]\n");
+  printf("       readpe index build <index file> <exe file or directory>..."
+      " [batch options]\n");
+  printf("       readpe index query <index file> <symbol>... [options]\n");
+  printf("       readpe resolve <exe file or directory>... [options]\n");
   printf("  options:\n");
   printf("    --all\n");
   printf("    --dos-header\n");
   printf("    --dos-stub\n");
   printf("    --nt-header\n");
+  printf("    --authenticode : Authenticode digests and the checksum\n");
   printf("    --section-table\n");
+  printf("    --section-stats : entropy and byte histograms of sections\n");
   printf("    --export-table\n");
+  printf("    --find-export=<name or @ordinal>\n");
+  printf("    --import-table\n");
   printf("    --relocation-table\n");
+  printf("    --relocation-density\n");
+  printf("    --hashes     : MD5, SHA-1 and SHA-256 of the file and sections\n");
+  printf("    --strings    : ASCII and UTF-16LE strings in sections\n");
+  printf("    --min-length=<n> : of strings (default: 4)\n");
+  printf("    --skip-names : omit strings of import and export names\n");
+  printf("    --signatures=<file> : match byte signatures in the file\n");
+  printf("    --scan-image : match signatures in the image laid out on RVAs\n");
+  printf("    --fingerprints : imphash, export and Rich header hashes only\n");
+  printf("    --format=<text|json|ndjson|record>\n");
+  printf("  batch options:\n");
+  printf("    --stdin      : "
+      "read a newline-separated list of files from stdin\n");
+  printf("    --null       : the list from stdin is NUL-separated\n");
+  printf("    --jobs=<n>   : number of worker threads (default: processors)\n");
+  printf("    --unordered  : output results as each file finishes\n");
+  printf("    --cache=<dir> : reuse results of files seen before\n");
+  printf("    --read-ahead : read many files at once through io_uring\n");
+  printf("  server options:\n");
+  printf("    --serve=<socket> : inspect files requested through the socket\n");
+  printf("    --keep=<n>   : number of parsed files kept (default: 64)\n");
+  printf("    --connect=<socket> : ask the server, or run here if none\n");
+  printf("  query options:\n");
+  printf("    --exports    : find files exporting the symbols\n");
+  printf("    --prefix     : find symbols beginning with the given ones\n");
 }
 
-bool readpe_args_parse(readpe_args_t* args, int argc, const char* const* argv) {
+bool readpe_args_parse(
+    readpe_args_t* args, int argc, const char* const* argv, FILE* err) {
   assert(args != NULL);
+  assert(err  != NULL);
 
   parsarg_t pa;
   parsarg_initialize(&pa, argc-1, (char**) argv+1);
 
-  const bool ret = readpe_args_parse_by_parsarg_(args, &pa);
+  const bool ret = readpe_args_parse_by_parsarg_(args, &pa, err);
   parsarg_deinitialize(&pa);
-  if (!ret) return false;
+  if (!ret) {
+    readpe_args_deinitialize(args);
+    return false;
+  }
 
   readpe_args_normalize_(args);
-  return readpe_args_validate_(args);
+  if (!readpe_args_validate_(args, err)) {
+    readpe_args_deinitialize(args);
+    return false;
+  }
+  return true;
+}
+
+void readpe_args_hash(const readpe_args_t* args, readpe_hash_state_t* st) {
+  assert(args != NULL);
+  assert(st   != NULL);
+
+# define hash_(v) do {  \
+    const typeof(v) v_ = (v);  \
+    readpe_hash_update(st, &v_, sizeof(v_));  \
+  } while (0)
+# define hash_str_(v) do {  \
+    const char* s_ = (v);  \
+    hash_(s_ != NULL);  \
+    if (s_ != NULL) readpe_hash_update(st, s_, strlen(s_) + 1);  \
+  } while (0)
+
+  hash_(args->format);
+  hash_(args->batch);
+
+  hash_(args->dos_header);
+  hash_(args->dos_stub);
+  hash_(args->nt_header);
+  hash_(args->authenticode);
+
+  hash_(args->section_table);
+  hash_(args->section_stats);
+  hash_(args->export_table);
+  hash_str_(args->find_export);
+  hash_(args->import_table);
+  hash_(args->relocation_table);
+  hash_(args->relocation_density);
+  hash_(args->hashes);
+  hash_(args->strings);
+  hash_(args->min_length);
+  hash_(args->skip_names);
+  hash_(args->signatures != NULL);
+  hash_(args->scan_image);
+  hash_(args->fingerprints);
+
+  /* timestamps are printed in local time */
+  hash_str_(getenv("TZ"));
+
+# undef hash_str_
+# undef hash_
+}
+
+void readpe_args_deinitialize(readpe_args_t* args) {
+  if (args == NULL) return;
+
+  free(args->inputs);
+  *args = (typeof(*args)) {0};
 }
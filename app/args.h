@@ -1,9 +1,40 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "lib/hash.h"
+
+#include "./output.h"
+
+typedef enum readpe_args_mode_t {
+  READPE_ARGS_MODE_INSPECT,
+  READPE_ARGS_MODE_INDEX_BUILD,  /* readpe index build <index> <inputs>... */
+  READPE_ARGS_MODE_INDEX_QUERY,  /* readpe index query <index> <symbols>... */
+  READPE_ARGS_MODE_RESOLVE,      /* readpe resolve <inputs>... */
+  READPE_ARGS_MODE_SERVE,        /* readpe --serve=<socket> */
+} readpe_args_mode_t;
 
 typedef struct readpe_args_t {
-  const char* input;
+  readpe_args_mode_t mode;
+  const char*        index;  /* NULLABLE, path to a symbol index */
+
+  const char** inputs;
+  size_t       inputs_length;
+
+  bool   stdin_list;
+  bool   null_separated;
+  bool   unordered;
+  size_t jobs;  /* 0 means the number of processors */
+  const char* cache;  /* NULLABLE, directory of cached results */
+  bool read_ahead;    /* reads files through io_uring ahead of workers */
+
+  const char* serve;    /* NULLABLE, socket to listen on */
+  const char* connect;  /* NULLABLE, socket of a server to request */
+  size_t      keep;     /* parsed files kept by the server, 0 means 64 */
+
+  readpe_output_format_t format;
 
   bool help;
   bool all;
@@ -11,11 +42,27 @@ typedef struct readpe_args_t {
   bool dos_header;
   bool dos_stub;
   bool nt_header;
+  bool authenticode;
 
   bool section_table;
+  bool section_stats;
   bool export_table;
+  const char* find_export;  /* NULLABLE */
   bool import_table;
   bool relocation_table;
+  bool relocation_density;
+  bool hashes;
+  bool strings;
+  size_t min_length;  /* of strings, 0 means 4 */
+  bool skip_names;    /* drops strings which are import or export names */
+  const char* signatures;  /* NULLABLE, path to a signature file */
+  bool scan_image;         /* scans signatures over the image, not the file */
+  bool fingerprints;  /* computes only fingerprints and skips the others */
+
+  bool exports;  /* queries exports instead of imports */
+  bool prefix;   /* queries symbols beginning with the inputs */
+
+  bool batch;  /* inputs may expand to more than one file */
 } readpe_args_t;
 
 void
@@ -27,5 +74,19 @@ bool
 readpe_args_parse(
     readpe_args_t*     args,
     int                argc,
-    const char* const* argv
+    const char* const* argv,
+    FILE*              err
+);
+
+void
+readpe_args_hash(
+    const readpe_args_t* args,
+    readpe_hash_state_t* st
+);
+    /* Feeds options which change the result of a file. Contents of the
+     * signature file are not included. */
+
+void
+readpe_args_deinitialize(
+    readpe_args_t* args
 );
@@ -0,0 +1,505 @@
+#include "./batch.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/context.h"
+
+#include "./output.h"
+#include "./output_buffer.h"
+#include "./read_ahead.h"
+
+/* Files taken ahead of the flush per worker in ordered mode, which bounds
+ * results kept waiting for a slow file before them. */
+#define READPE_BATCH_WINDOW 16
+
+/* Bytes of a result kept by a worker, beyond which the worker waits for
+ * its turn and writes the rest straight to dst. */
+#define READPE_BATCH_SPILL_LIMIT (1024*1024)
+
+/* Bytes of finished results kept waiting in ordered mode, beyond which
+ * workers take no files but the next to be written. */
+#define READPE_BATCH_HELD_LIMIT (64*1024*1024)
+
+typedef struct readpe_batch_item_t {
+  char*  buf;
+  size_t len;
+  bool   done;
+  bool   success;
+} readpe_batch_item_t;
+
+typedef struct readpe_batch_state_t {
+  const readpe_batch_t* batch;
+
+  readpe_batch_job_t   job;
+  void*                udata;
+  readpe_read_ahead_t* read_ahead;  /* NULLABLE */
+
+  bool  ordered;
+  FILE* dst;
+  FILE* err;
+
+  readpe_output_format_t format;
+  const char*            separator;
+  bool                   written;  /* some result is already in dst */
+
+  pthread_mutex_t mtx;
+  pthread_cond_t  cond;
+  pthread_mutex_t dst_mtx;  /* of writes to dst in unordered mode */
+
+  size_t               next;
+  size_t               flushed;  /* number of items flushed in order */
+  size_t               window;
+  size_t               held;  /* bytes of done items not flushed yet */
+  readpe_batch_item_t* items;
+} readpe_batch_state_t;
+
+/* the item which a worker is doing, passed to the spill of its output */
+typedef struct readpe_batch_worker_t {
+  readpe_batch_state_t* st;
+  size_t                index;
+} readpe_batch_worker_t;
+
+static bool readpe_batch_push_(
+    readpe_batch_t* batch, char* path, FILE* err) {
+  assert(batch != NULL);
+  assert(path  != NULL);
+  assert(err   != NULL);
+
+  if (batch->paths_length >= batch->paths_reserved) {
+    const size_t n = batch->paths_reserved*2 + 16;
+
+    char** ptr = realloc(batch->paths, n*sizeof(*ptr));
+    if (ptr == NULL) {
+      fprintf(err, "failed to allocate memory for path list\n");
+      free(path);
+      return false;
+    }
+    batch->paths          = ptr;
+    batch->paths_reserved = n;
+  }
+  batch->paths[batch->paths_length++] = path;
+  return true;
+}
+
+static int readpe_batch_compare_names_(const void* a, const void* b) {
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static bool readpe_batch_add_directory_(
+    readpe_batch_t* batch, const char* path, FILE* err) {
+  assert(batch != NULL);
+  assert(path  != NULL);
+  assert(err   != NULL);
+
+  DIR* dir = opendir(path);
+  if (dir == NULL) {
+    fprintf(err, "opendir failed: %s\n", path);
+    return false;
+  }
+
+  /* entries are sorted to make the order of results reproducible */
+  char** names    = NULL;
+  size_t names_n  = 0;
+  size_t names_r  = 0;
+  bool   success  = false;
+
+  const struct dirent* ent;
+  while ((ent = readdir(dir)) != NULL) {
+    if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+      continue;
+    }
+    if (names_n >= names_r) {
+      names_r = names_r*2 + 16;
+
+      char** ptr = realloc(names, names_r*sizeof(*ptr));
+      if (ptr == NULL) goto FINALIZE;
+      names = ptr;
+    }
+    const size_t len = strlen(path) + 1 + strlen(ent->d_name) + 1;
+    names[names_n] = malloc(len);
+    if (names[names_n] == NULL) goto FINALIZE;
+    snprintf(names[names_n++], len, "%s/%s", path, ent->d_name);
+  }
+  qsort(names, names_n, sizeof(*names), readpe_batch_compare_names_);
+
+  for (size_t i = 0; i < names_n; ++i) {
+    struct stat st;
+    if (lstat(names[i], &st) != 0) continue;
+
+    if (S_ISDIR(st.st_mode)) {
+      /* symbolic links to directories are not followed to avoid loops */
+      if (!readpe_batch_add_directory_(batch, names[i], err)) goto FINALIZE;
+      continue;
+    }
+    if (S_ISLNK(st.st_mode) &&
+        (stat(names[i], &st) != 0 || S_ISDIR(st.st_mode))) {
+      continue;
+    }
+    if (!S_ISREG(st.st_mode)) continue;
+
+    char* dup = names[i];
+    names[i] = NULL;
+    if (!readpe_batch_push_(batch, dup, err)) goto FINALIZE;
+  }
+  success = true;
+
+FINALIZE:
+  if (!success) {
+    fprintf(err, "failed to list directory: %s\n", path);
+  }
+  for (size_t i = 0; i < names_n; ++i) free(names[i]);
+  free(names);
+  closedir(dir);
+  return success;
+}
+
+void readpe_batch_initialize(readpe_batch_t* batch) {
+  assert(batch != NULL);
+
+  *batch = (typeof(*batch)) {0};
+}
+
+void readpe_batch_deinitialize(readpe_batch_t* batch) {
+  if (batch == NULL) return;
+
+  for (size_t i = 0; i < batch->paths_length; ++i) free(batch->paths[i]);
+  free(batch->paths);
+  *batch = (typeof(*batch)) {0};
+}
+
+bool readpe_batch_add_path(
+    readpe_batch_t* batch, const char* path, FILE* err) {
+  assert(batch != NULL);
+  assert(path  != NULL);
+  assert(err   != NULL);
+
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+    return readpe_batch_add_directory_(batch, path, err);
+  }
+
+  /* the path is pushed even if it doesn't exist, to report the error in
+   * the order of inputs */
+  char* dup = strdup(path);
+  if (dup == NULL) {
+    fprintf(err, "failed to allocate memory for path list\n");
+    return false;
+  }
+  return readpe_batch_push_(batch, dup, err);
+}
+
+bool readpe_batch_add_list(
+    readpe_batch_t* batch, FILE* fp, char delim, FILE* err) {
+  assert(batch != NULL);
+  assert(fp    != NULL);
+  assert(err   != NULL);
+
+  char*  line = NULL;
+  size_t cap  = 0;
+
+  bool    success = true;
+  ssize_t len;
+  while ((len = getdelim(&line, &cap, delim, fp)) >= 0) {
+    if (len > 0 && line[len-1] == delim) line[--len] = 0;
+    if (len > 0 && delim == '\n' && line[len-1] == '\r') line[--len] = 0;
+    if (len == 0) continue;
+
+    if (!readpe_batch_add_path(batch, line, err)) {
+      success = false;
+      break;
+    }
+  }
+  free(line);
+  return success;
+}
+
+readpe_error_t readpe_batch_initialize_context(
+    const readpe_batch_file_t* file, readpe_context_t* ctx) {
+  assert(file != NULL);
+  assert(ctx  != NULL);
+
+  if (file->body != NULL) {
+    return readpe_context_initialize_from_memory(
+        ctx, file->body, file->length);
+  }
+  if (file->fd >= 0) return readpe_context_initialize_from_fd(ctx, file->fd);
+  return readpe_context_initialize(ctx, file->path);
+}
+
+static bool readpe_batch_do_job_(
+    const readpe_batch_t* batch,
+    size_t                index,
+    readpe_read_ahead_t*  ra,
+    readpe_batch_job_t    job,
+    void*                 udata,
+    readpe_output_t*      out) {
+  assert(batch != NULL);
+  assert(job   != NULL);
+  assert(out   != NULL);
+
+  readpe_batch_file_t file = { .path = batch->paths[index], .fd = -1, };
+
+  uint8_t* body = NULL;
+  if (ra != NULL) readpe_read_ahead_take(ra, index, &body, &file.length);
+  file.body = body;
+
+  const bool ret = job(udata, out, &file);
+  readpe_read_ahead_release(body, file.length);
+  return ret;
+}
+
+static void readpe_batch_flush_item_(
+    readpe_batch_state_t* st, readpe_batch_item_t* item) {
+  assert(st   != NULL);
+  assert(item != NULL);
+
+  if (item->len > 0) {
+    if (st->written && st->separator != NULL) {
+      fputs(st->separator, st->dst);
+    }
+    fwrite(item->buf, item->len, 1, st->dst);
+    st->written = true;
+  }
+  free(item->buf);
+  item->buf = NULL;
+}
+
+/* Lets the worker of a large result write it through dst, once all
+ * results before it are written in ordered mode, otherwise holding
+ * dst_mtx until the job returns. The buffer is flushed after this, so the
+ * separator is put before it. */
+static void readpe_batch_spill_(readpe_output_t* out) {
+  assert(out != NULL);
+
+  const readpe_batch_worker_t* w  = out->spill_udata;
+  readpe_batch_state_t*        st = w->st;
+
+  if (st->ordered) {
+    pthread_mutex_lock(&st->mtx);
+    while (st->flushed != w->index) pthread_cond_wait(&st->cond, &st->mtx);
+    pthread_mutex_unlock(&st->mtx);
+  } else {
+    pthread_mutex_lock(&st->dst_mtx);
+  }
+  if (st->written && st->separator != NULL) {
+    fputs(st->separator, st->dst);
+  }
+  st->written = true;
+
+  out->fp    = st->dst;
+  out->spill = NULL;
+}
+
+static void* readpe_batch_worker_main_(void* ptr) {
+  readpe_batch_state_t* st = ptr;
+
+  for (;;) {
+    /* the next file to be written is always taken, so that the flush never
+     * waits for a file no worker takes */
+    pthread_mutex_lock(&st->mtx);
+    while (st->ordered && st->next < st->batch->paths_length &&
+        st->next != st->flushed &&
+        (st->next >= st->flushed + st->window ||
+         st->held >= READPE_BATCH_HELD_LIMIT)) {
+      pthread_cond_wait(&st->cond, &st->mtx);
+    }
+    const size_t i = st->next++;
+    pthread_mutex_unlock(&st->mtx);
+
+    if (i >= st->batch->paths_length) break;
+
+    readpe_batch_item_t* item = &st->items[i];
+
+    /* the buffer is kept without flushing, and taken by the item unless
+     * it grows too large */
+    readpe_batch_worker_t w = { .st = st, .index = i, };
+
+    readpe_output_t out;
+    readpe_output_initialize(&out, NULL, st->format);
+    out.spill       = readpe_batch_spill_;
+    out.spill_udata = &w;
+    out.spill_limit = READPE_BATCH_SPILL_LIMIT;
+
+    item->success = readpe_batch_do_job_(
+        st->batch, i, st->read_ahead, st->job, st->udata, &out);
+    if (out.broken) {
+      fprintf(st->err, "failed to allocate memory for output buffer\n");
+      item->success = false;
+    }
+
+    if (out.fp != NULL) {
+      /* the result has been written through */
+      readpe_output_deinitialize(&out);
+      if (!st->ordered) pthread_mutex_unlock(&st->dst_mtx);
+    } else {
+      item->buf = out.buf;
+      item->len = out.length;
+      if (!st->ordered) {
+        pthread_mutex_lock(&st->dst_mtx);
+        readpe_batch_flush_item_(st, item);
+        pthread_mutex_unlock(&st->dst_mtx);
+      }
+    }
+
+    pthread_mutex_lock(&st->mtx);
+    if (st->ordered) st->held += item->len;
+    item->done = true;
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->mtx);
+  }
+  return NULL;
+}
+
+bool readpe_batch_run(
+    const readpe_batch_t*      batch,
+    size_t                     jobs,
+    bool                       ordered,
+    readpe_read_ahead_extent_t read_ahead,
+    FILE*                      dst,
+    FILE*                      err,
+    readpe_output_format_t     format,
+    const char*                separator,
+    readpe_batch_job_t         job,
+    void*                      udata) {
+  assert(batch != NULL);
+  assert(dst   != NULL);
+  assert(err   != NULL);
+  assert(job   != NULL);
+
+  if (jobs == 0) {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = n > 0? (size_t) n: 1;
+  }
+  if (jobs > batch->paths_length) jobs = batch->paths_length;
+
+  /* files are read as usual if io_uring is unavailable */
+  readpe_read_ahead_t* ra = NULL;
+  if (read_ahead != READPE_READ_AHEAD_NONE && batch->paths_length > 0 &&
+      !readpe_read_ahead_start(
+        &ra, batch->paths, batch->paths_length, read_ahead)) {
+    ra = NULL;
+  }
+
+  if (jobs <= 1) {
+    bool success = true;
+
+    /* the separator is taken back if the job writes nothing, as the
+     * threaded flush puts it only between results written */
+    bool written = false;
+
+    readpe_output_t out;
+    readpe_output_initialize(&out, dst, format);
+    for (size_t i = 0; i < batch->paths_length; ++i) {
+      size_t sep_len = 0;
+      if (written && separator != NULL) {
+        sep_len = strlen(separator);
+        readpe_output_put(&out, separator, sep_len);
+      }
+      const size_t flushed = out.flushed;
+      const size_t length  = out.length;
+
+      success =
+          readpe_batch_do_job_(batch, i, ra, job, udata, &out) && success;
+
+      if (out.flushed == flushed && out.length == length) {
+        assert(out.length == sep_len);
+        out.length = 0;
+      } else {
+        written = true;
+      }
+      readpe_output_flush(&out);
+    }
+    if (out.broken) {
+      fprintf(err, "failed to allocate memory for output buffer\n");
+      success = false;
+    }
+    readpe_output_deinitialize(&out);
+    readpe_read_ahead_stop(ra);
+    return success;
+  }
+
+  readpe_batch_state_t st = {
+    .batch      = batch,
+    .job        = job,
+    .udata      = udata,
+    .read_ahead = ra,
+    .ordered    = ordered,
+    .dst        = dst,
+    .err        = err,
+    .format     = format,
+    .separator  = separator,
+    .window     = jobs*READPE_BATCH_WINDOW,
+    .items      = calloc(batch->paths_length, sizeof(*st.items)),
+  };
+  pthread_t* threads = calloc(jobs, sizeof(*threads));
+  if (st.items == NULL || threads == NULL) {
+    fprintf(err, "failed to allocate memory for workers\n");
+    free(st.items);
+    free(threads);
+    readpe_read_ahead_stop(ra);
+    return false;
+  }
+  pthread_mutex_init(&st.mtx, NULL);
+  pthread_cond_init(&st.cond, NULL);
+  pthread_mutex_init(&st.dst_mtx, NULL);
+
+  size_t started = 0;
+  for (; started < jobs; ++started) {
+    if (pthread_create(&threads[started], NULL,
+          readpe_batch_worker_main_, &st) != 0) {
+      break;
+    }
+  }
+  if (started == 0) {
+    /* no worker could start, so the caller does the jobs by itself, and
+     * flushes each result as soon as it's done, which keeps the order */
+    st.ordered = false;
+    readpe_batch_worker_main_(&st);
+  }
+
+  if (st.ordered) {
+    for (size_t i = 0; i < batch->paths_length; ++i) {
+      readpe_batch_item_t* item = &st.items[i];
+
+      pthread_mutex_lock(&st.mtx);
+      while (!item->done) pthread_cond_wait(&st.cond, &st.mtx);
+      pthread_mutex_unlock(&st.mtx);
+
+      const size_t len = item->len;
+      readpe_batch_flush_item_(&st, item);
+
+      pthread_mutex_lock(&st.mtx);
+      st.flushed = i+1;
+      st.held   -= len;
+      pthread_cond_broadcast(&st.cond);
+      pthread_mutex_unlock(&st.mtx);
+    }
+  }
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  bool success = true;
+  for (size_t i = 0; i < batch->paths_length; ++i) {
+    success = success && st.items[i].success;
+  }
+
+  pthread_mutex_destroy(&st.dst_mtx);
+  pthread_cond_destroy(&st.cond);
+  pthread_mutex_destroy(&st.mtx);
+  free(threads);
+  free(st.items);
+  readpe_read_ahead_stop(ra);
+  return success;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lib/context.h"
+
+#include "./output.h"
+#include "./read_ahead.h"
+
+typedef struct readpe_batch_t {
+  char** paths;
+  size_t paths_length;
+  size_t paths_reserved;
+} readpe_batch_t;
+
+typedef struct readpe_batch_file_t {
+  const char*    path;
+  const uint8_t* body;  /* NULLABLE, the contents if read ahead */
+  size_t         length;
+  int            fd;  /* of the file opened by the job if not -1 */
+} readpe_batch_file_t;
+
+typedef bool (*readpe_batch_job_t)(
+    void*                      udata,
+    readpe_output_t*           out,
+    const readpe_batch_file_t* file
+);
+
+void
+readpe_batch_initialize(
+    readpe_batch_t* batch
+);
+
+void
+readpe_batch_deinitialize(
+    readpe_batch_t* batch
+);
+
+bool
+readpe_batch_add_path(
+    readpe_batch_t* batch,
+    const char*     path,
+    FILE*           err
+);
+    /* Directories are expanded recursively into regular files. */
+
+bool
+readpe_batch_add_list(
+    readpe_batch_t* batch,
+    FILE*           fp,
+    char            delim,
+    FILE*           err
+);
+
+readpe_error_t
+readpe_batch_initialize_context(
+    const readpe_batch_file_t* file,
+    readpe_context_t*          ctx
+);
+    /* Parses the contents read ahead if any, otherwise the file opened as
+     * fd or at the path. The context refers the contents, which are
+     * released after the job returns. */
+
+bool
+readpe_batch_run(
+    const readpe_batch_t*      batch,
+    size_t                     jobs,  /* 0 means the number of processors */
+    bool                       ordered,
+    readpe_read_ahead_extent_t read_ahead,
+    FILE*                      dst,
+    FILE*                      err,
+    readpe_output_format_t     format,
+    const char*                separator,  /* NULLABLE */
+    readpe_batch_job_t         job,
+    void*                      udata
+);
+    /* Returns false if any of jobs failed. Each job writes to its own
+     * buffer, which is flushed to dst in order of the paths if ordered,
+     * otherwise as soon as the job finishes. The separator is written
+     * between results of two jobs. Unless read_ahead is NONE, the parts of
+     * files which jobs touch are read through io_uring ahead of the jobs
+     * where available. */
@@ -0,0 +1,381 @@
+#include "./cache.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/hash.h"
+#include "lib/readpe.h"
+
+#define READPE_CACHE_VERSION 1
+
+#define READPE_CACHE_RESULT_MAGIC "RPECACHE"
+#define READPE_CACHE_INDEX_MAGIC  "RPEINDEX"
+
+/* The entry of a result, "r-<file digest>-<options digest>", is this header
+ * followed by the output between the beginning and the end of the file. It's
+ * mapped on a hit and copied to the output as it is. */
+typedef struct readpe_cache_result_t {
+  char     magic[8];
+  uint32_t version;
+  int32_t  status;  /* readpe_error_t */
+  uint64_t length;
+} readpe_cache_result_t;
+
+/* The entry of a file, "i-<dev>-<inode>", remembers the digest of the file
+ * while it looks unchanged. */
+typedef struct readpe_cache_index_t {
+  char     magic[8];
+  uint32_t version;
+  uint32_t reserved;
+
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  int64_t  mtime_sec;
+  int64_t  mtime_nsec;
+
+  uint8_t digest[32];
+} readpe_cache_index_t;
+
+static void readpe_cache_hex_(char* dst, const uint8_t* src, size_t len) {
+  static const char digits[] = "0123456789abcdef";
+  for (size_t i = 0; i < len; ++i) {
+    dst[i*2]   = digits[src[i] >> 4];
+    dst[i*2+1] = digits[src[i] & 0xF];
+  }
+  dst[len*2] = 0;
+}
+
+/* returns a path in the directory, which must be freed */
+static char* readpe_cache_path_(const readpe_cache_t* cache, const char* name) {
+  const size_t len = strlen(cache->dir) + 1 + strlen(name) + 1;
+
+  char* ret = malloc(len);
+  if (ret == NULL) return NULL;
+  snprintf(ret, len, "%s/%s", cache->dir, name);
+  return ret;
+}
+
+static char* readpe_cache_result_path_(
+    const readpe_cache_t* cache, const uint8_t digest[32]) {
+  char digest_hex[32*2+1], key_hex[8*2+1];
+  readpe_cache_hex_(digest_hex, digest, 32);
+  readpe_cache_hex_(key_hex, cache->key, 8);
+
+  char name[sizeof(digest_hex) + sizeof(key_hex) + 8];
+  snprintf(name, sizeof(name), "r-%s-%s", digest_hex, key_hex);
+  return readpe_cache_path_(cache, name);
+}
+
+static char* readpe_cache_index_path_(
+    const readpe_cache_t* cache, const struct stat* st) {
+  char name[64];
+  snprintf(name, sizeof(name), "i-%jx-%jx",
+      (uintmax_t) st->st_dev, (uintmax_t) st->st_ino);
+  return readpe_cache_path_(cache, name);
+}
+
+static bool readpe_cache_write_all_(int fd, const void* data, size_t len) {
+  const uint8_t* p = data;
+  while (len > 0) {
+    const ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p   += n;
+    len -= n;
+  }
+  return true;
+}
+
+/* Writes a file in the directory by renaming a temporary one, so readers
+ * never see a partial entry even if processes share the directory. */
+static bool readpe_cache_write_(
+    const readpe_cache_t* cache,
+    const char*           path,
+    const void*           head,
+    size_t                head_length,
+    const void*           body,  /* NULLABLE */
+    size_t                body_length) {
+  char* tmp = readpe_cache_path_(cache, "tmp-XXXXXX");
+  if (tmp == NULL) return false;
+
+  const int fd = mkstemp(tmp);
+  if (fd < 0) {
+    free(tmp);
+    return false;
+  }
+  bool ok =
+      readpe_cache_write_all_(fd, head, head_length) &&
+      readpe_cache_write_all_(fd, body, body_length);
+  ok = close(fd) == 0 && ok;
+  ok = ok && rename(tmp, path) == 0;
+  if (!ok) unlink(tmp);
+
+  free(tmp);
+  return ok;
+}
+
+static bool readpe_cache_read_index_(
+    const readpe_cache_t* cache, readpe_cache_entry_t* e) {
+  char* path = readpe_cache_index_path_(cache, &e->st);
+  if (path == NULL) return false;
+
+  const int fd = open(path, O_RDONLY);
+  free(path);
+  if (fd < 0) return false;
+
+  readpe_cache_index_t idx;
+  const bool ok = read(fd, &idx, sizeof(idx)) == sizeof(idx);
+  close(fd);
+  if (!ok) return false;
+
+  const struct stat* st = &e->st;
+  if (memcmp(idx.magic, READPE_CACHE_INDEX_MAGIC, sizeof(idx.magic)) != 0 ||
+      idx.version    != READPE_CACHE_VERSION ||
+      idx.dev        != (uint64_t) st->st_dev ||
+      idx.ino        != (uint64_t) st->st_ino ||
+      idx.size       != (uint64_t) st->st_size ||
+      idx.mtime_sec  != (int64_t) st->st_mtim.tv_sec ||
+      idx.mtime_nsec != (int64_t) st->st_mtim.tv_nsec) {
+    return false;
+  }
+  memcpy(e->digest, idx.digest, sizeof(e->digest));
+  return true;
+}
+
+static void readpe_cache_write_index_(
+    const readpe_cache_t* cache, const readpe_cache_entry_t* e) {
+  char* path = readpe_cache_index_path_(cache, &e->st);
+  if (path == NULL) return;
+
+  const struct stat* st = &e->st;
+
+  readpe_cache_index_t idx = {
+    .version    = READPE_CACHE_VERSION,
+    .dev        = st->st_dev,
+    .ino        = st->st_ino,
+    .size       = st->st_size,
+    .mtime_sec  = st->st_mtim.tv_sec,
+    .mtime_nsec = st->st_mtim.tv_nsec,
+  };
+  memcpy(idx.magic, READPE_CACHE_INDEX_MAGIC, sizeof(idx.magic));
+  memcpy(idx.digest, e->digest, sizeof(idx.digest));
+
+  readpe_cache_write_(cache, path, &idx, sizeof(idx), NULL, 0);
+  free(path);
+}
+
+static bool readpe_cache_map_result_(
+    const readpe_cache_t* cache, readpe_cache_entry_t* e) {
+  char* path = readpe_cache_result_path_(cache, e->digest);
+  if (path == NULL) return false;
+
+  const int fd = open(path, O_RDONLY);
+  free(path);
+  if (fd < 0) return false;
+
+  struct stat st;
+  void*       map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 &&
+      (uintmax_t) st.st_size >= sizeof(readpe_cache_result_t)) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) return false;
+
+  const readpe_cache_result_t* r = map;
+  if (memcmp(r->magic, READPE_CACHE_RESULT_MAGIC, sizeof(r->magic)) != 0 ||
+      r->version != READPE_CACHE_VERSION ||
+      r->length  != st.st_size - sizeof(*r)) {
+    munmap(map, st.st_size);
+    return false;
+  }
+  e->map        = map;
+  e->map_length = st.st_size;
+  e->body       = (const char*) (r + 1);
+  e->length     = r->length;
+  e->status     = r->status;
+  return true;
+}
+
+bool readpe_cache_initialize(
+    readpe_cache_t*            cache,
+    const char*                dir,
+    const readpe_hash_state_t* key,
+    FILE*                      err) {
+  assert(cache != NULL);
+  assert(dir   != NULL);
+  assert(key   != NULL);
+  assert(err   != NULL);
+
+  *cache = (readpe_cache_t) {0};
+
+  if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+    fprintf(err, "failed to create cache directory: %s\n", dir);
+    return false;
+  }
+  cache->dir = strdup(dir);
+  if (cache->dir == NULL) {
+    fprintf(err, "failed to allocate memory for cache\n");
+    return false;
+  }
+
+  /* entries of another version or build are never shared */
+  readpe_hash_state_t st = *key;
+  const uint32_t version = READPE_CACHE_VERSION;
+  readpe_hash_update(&st, &version, sizeof(version));
+  if (!readpe_cache_hash_file(&st, "/proc/self/exe")) {
+    fprintf(err, "failed to read the executable for cache\n");
+    readpe_cache_deinitialize(cache);
+    return false;
+  }
+
+  readpe_hash_t h;
+  readpe_hash_finalize(&st, &h);
+  memcpy(cache->key, h.sha256, sizeof(cache->key));
+  return true;
+}
+
+void readpe_cache_deinitialize(readpe_cache_t* cache) {
+  if (cache == NULL) return;
+
+  free(cache->dir);
+  *cache = (readpe_cache_t) {0};
+}
+
+/* reads from the beginning wherever the offset of fd is */
+static bool readpe_cache_hash_fd_(readpe_hash_state_t* st, int fd) {
+  off_t offset = 0;
+  for (;;) {
+    uint8_t buf[64*1024];
+    const ssize_t n = pread(fd, buf, sizeof(buf), offset);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return n == 0;
+    readpe_hash_update(st, buf, n);
+    offset += n;
+  }
+}
+
+static bool readpe_cache_same_stat_(
+    const struct stat* a, const struct stat* b) {
+  return
+      a->st_dev          == b->st_dev          &&
+      a->st_ino          == b->st_ino          &&
+      a->st_size         == b->st_size         &&
+      a->st_mtim.tv_sec  == b->st_mtim.tv_sec  &&
+      a->st_mtim.tv_nsec == b->st_mtim.tv_nsec &&
+      a->st_ctim.tv_sec  == b->st_ctim.tv_sec  &&
+      a->st_ctim.tv_nsec == b->st_ctim.tv_nsec;
+}
+
+bool readpe_cache_hash_file(readpe_hash_state_t* st, const char* path) {
+  assert(st   != NULL);
+  assert(path != NULL);
+
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  const bool ok = readpe_cache_hash_fd_(st, fd);
+  close(fd);
+  return ok;
+}
+
+bool readpe_cache_find(
+    const readpe_cache_t* cache, const char* path, readpe_cache_entry_t* e) {
+  assert(cache != NULL);
+  assert(path  != NULL);
+  assert(e     != NULL);
+
+  *e = (readpe_cache_entry_t) { .fd = -1, };
+
+  /* unchanged files are answered without opening them */
+  if (stat(path, &e->st) == 0 && S_ISREG(e->st.st_mode) &&
+      readpe_cache_read_index_(cache, e) &&
+      readpe_cache_map_result_(cache, e)) {
+    e->stat_valid     = true;
+    e->digest_valid   = true;
+    e->digest_indexed = true;
+    return true;
+  }
+
+  /* the file is hashed and parsed through the same fd, so a file replaced
+   * meanwhile cannot be stored under the digest of another */
+  e->fd = open(path, O_RDONLY);
+  if (e->fd < 0) return false;
+  if (fstat(e->fd, &e->st) != 0 || !S_ISREG(e->st.st_mode)) return false;
+  e->stat_valid = true;
+
+  if (readpe_cache_read_index_(cache, e)) {
+    e->digest_valid   = true;
+    e->digest_indexed = true;
+  } else {
+    readpe_hash_state_t st;
+    readpe_hash_initialize(&st, READPE_HASH_SHA256);
+    if (!readpe_cache_hash_fd_(&st, e->fd)) return false;
+
+    readpe_hash_t h;
+    readpe_hash_finalize(&st, &h);
+    memcpy(e->digest, h.sha256, sizeof(e->digest));
+    e->digest_valid = true;
+  }
+
+  if (!readpe_cache_map_result_(cache, e)) return false;
+
+  /* the same contents are found by another file or after modification */
+  if (!e->digest_indexed) {
+    readpe_cache_write_index_(cache, e);
+    e->digest_indexed = true;
+  }
+  return true;
+}
+
+void readpe_cache_store(
+    const readpe_cache_t*       cache,
+    const readpe_cache_entry_t* e,
+    const char*                 body,
+    size_t                      length,
+    readpe_error_t              status) {
+  assert(cache != NULL);
+  assert(e     != NULL);
+  assert(body  != NULL || length == 0);
+
+  if (!e->stat_valid || !e->digest_valid || e->fd < 0) return;
+
+  /* the file may be written in place while parsed */
+  struct stat st;
+  if (fstat(e->fd, &st) != 0 || !readpe_cache_same_stat_(&st, &e->st)) return;
+
+  char* path = readpe_cache_result_path_(cache, e->digest);
+  if (path == NULL) return;
+
+  readpe_cache_result_t r = {
+    .version = READPE_CACHE_VERSION,
+    .status  = status,
+    .length  = length,
+  };
+  memcpy(r.magic, READPE_CACHE_RESULT_MAGIC, sizeof(r.magic));
+
+  const bool ok = readpe_cache_write_(cache, path, &r, sizeof(r), body, length);
+  free(path);
+
+  if (ok && !e->digest_indexed) readpe_cache_write_index_(cache, e);
+}
+
+void readpe_cache_release(readpe_cache_entry_t* e) {
+  if (e == NULL) return;
+
+  if (e->map != NULL) munmap(e->map, e->map_length);
+  if (e->fd >= 0) close(e->fd);
+  *e = (readpe_cache_entry_t) { .fd = -1, };
+}
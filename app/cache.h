@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sys/stat.h>
+
+#include "lib/hash.h"
+#include "lib/readpe.h"
+
+/* A directory of results keyed by SHA-256 of file contents and of options
+ * which change them. Files are also indexed by (dev, inode, size, mtime), so
+ * unchanged files are found without reading them. */
+typedef struct readpe_cache_t {
+  char*   dir;
+  uint8_t key[32];  /* SHA-256 of the options */
+} readpe_cache_t;
+
+/* a result being looked up, and stored on a miss */
+typedef struct readpe_cache_entry_t {
+  bool        stat_valid;  /* the file could be stat'ed */
+  struct stat st;
+  int         fd;  /* of the file hashed on a miss, otherwise -1 */
+
+  bool    digest_valid;
+  bool    digest_indexed;  /* the file index already has the digest */
+  uint8_t digest[32];
+
+  /* of the result found, which is mapped */
+  void*          map;
+  size_t         map_length;
+  const char*    body;
+  size_t         length;
+  readpe_error_t status;
+} readpe_cache_entry_t;
+
+bool
+readpe_cache_initialize(
+    readpe_cache_t*            cache,
+    const char*                dir,
+    const readpe_hash_state_t* key,
+    FILE*                      err
+);
+    /* Creates the directory if missing. The key is consumed, and mixed with
+     * the digest of the running executable, so results of another build
+     * are never replayed. */
+
+void
+readpe_cache_deinitialize(
+    readpe_cache_t* cache
+);
+
+bool
+readpe_cache_hash_file(
+    readpe_hash_state_t* st,
+    const char*          path
+);
+
+bool
+readpe_cache_find(
+    const readpe_cache_t* cache,
+    const char*           path,
+    readpe_cache_entry_t* e
+);
+    /* Returns true if a result of the file is found. The entry must be
+     * released by readpe_cache_release whatever the result is. On a miss,
+     * the file hashed is left open as fd, which should be parsed instead of
+     * the path so the result matches the digest. */
+
+void
+readpe_cache_store(
+    const readpe_cache_t*       cache,
+    const readpe_cache_entry_t* e,
+    const char*                 body,
+    size_t                      length,
+    readpe_error_t              status
+);
+    /* Stores the result of the file missed by readpe_cache_find, unless the
+     * file has been modified since it was hashed. Failures are ignored, as
+     * the result is only not cached. */
+
+void
+readpe_cache_release(
+    readpe_cache_entry_t* e
+);
@@ -0,0 +1,197 @@
+#include "./context_lru.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lib/readpe.h"
+
+static bool readpe_context_lru_match_(
+    const readpe_context_lru_entry_t* e, const struct stat* st) {
+  assert(e  != NULL);
+  assert(st != NULL);
+
+  return
+      e->dev        == st->st_dev &&
+      e->ino        == st->st_ino &&
+      e->size       == st->st_size &&
+      e->mtime_sec  == (int64_t) st->st_mtim.tv_sec &&
+      e->mtime_nsec == st->st_mtim.tv_nsec;
+}
+
+static void readpe_context_lru_unlink_(
+    readpe_context_lru_t* lru, readpe_context_lru_entry_t* e) {
+  assert(lru != NULL);
+  assert(e   != NULL);
+
+  if (e->prev != NULL) e->prev->next = e->next; else lru->head = e->next;
+  if (e->next != NULL) e->next->prev = e->prev; else lru->tail = e->prev;
+  e->prev = NULL;
+  e->next = NULL;
+}
+
+static void readpe_context_lru_push_front_(
+    readpe_context_lru_t* lru, readpe_context_lru_entry_t* e) {
+  assert(lru != NULL);
+  assert(e   != NULL);
+
+  e->prev = NULL;
+  e->next = lru->head;
+  if (lru->head != NULL) lru->head->prev = e; else lru->tail = e;
+  lru->head = e;
+}
+
+static void readpe_context_lru_destroy_entry_(readpe_context_lru_entry_t* e) {
+  if (e == NULL) return;
+
+  readpe_context_destroy(e->ctx);
+  pthread_mutex_destroy(&e->mtx);
+  free(e);
+}
+
+/* must be called with lru->mtx locked */
+static readpe_context_lru_entry_t* readpe_context_lru_find_(
+    readpe_context_lru_t* lru, const struct stat* st) {
+  assert(lru != NULL);
+  assert(st  != NULL);
+
+  for (readpe_context_lru_entry_t* e = lru->head; e != NULL; e = e->next) {
+    if (readpe_context_lru_match_(e, st)) {
+      readpe_context_lru_unlink_(lru, e);
+      readpe_context_lru_push_front_(lru, e);
+      ++e->users;
+      return e;
+    }
+  }
+  return NULL;
+}
+
+/* must be called with lru->mtx locked, pinned entries are left over */
+static void readpe_context_lru_evict_(readpe_context_lru_t* lru) {
+  assert(lru != NULL);
+
+  readpe_context_lru_entry_t* e = lru->tail;
+  while (lru->length > lru->capacity && e != NULL) {
+    readpe_context_lru_entry_t* prev = e->prev;
+    if (e->users == 0) {
+      readpe_context_lru_unlink_(lru, e);
+      readpe_context_lru_destroy_entry_(e);
+      --lru->length;
+    }
+    e = prev;
+  }
+}
+
+void readpe_context_lru_initialize(
+    readpe_context_lru_t* lru, size_t capacity) {
+  assert(lru != NULL);
+
+  *lru = (typeof(*lru)) {
+    .capacity = capacity > 0? capacity: 64,
+  };
+  pthread_mutex_init(&lru->mtx, NULL);
+}
+
+void readpe_context_lru_deinitialize(readpe_context_lru_t* lru) {
+  if (lru == NULL) return;
+
+  readpe_context_lru_entry_t* e = lru->head;
+  while (e != NULL) {
+    readpe_context_lru_entry_t* next = e->next;
+    assert(e->users == 0);
+    readpe_context_lru_destroy_entry_(e);
+    e = next;
+  }
+  pthread_mutex_destroy(&lru->mtx);
+  *lru = (typeof(*lru)) {0};
+}
+
+readpe_error_t readpe_context_lru_acquire(
+    readpe_context_lru_t*        lru,
+    const char*                  path,
+    readpe_context_lru_entry_t** e) {
+  assert(lru  != NULL);
+  assert(path != NULL);
+  assert(e    != NULL);
+
+  *e = NULL;
+
+  /* the key is taken from the file opened, not from the path, so the
+   * context always matches what is parsed */
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return READPE_ERROR_OPEN;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return READPE_ERROR_READ;
+  }
+
+  pthread_mutex_lock(&lru->mtx);
+  *e = readpe_context_lru_find_(lru, &st);
+  pthread_mutex_unlock(&lru->mtx);
+
+  if (*e != NULL) {
+    close(fd);
+    pthread_mutex_lock(&(*e)->mtx);
+    return READPE_OK;
+  }
+
+  /* parsed without the lock, so the same file may be parsed by some
+   * threads at once, and only the first one is kept */
+  readpe_context_t* ctx;
+  const readpe_error_t err = readpe_context_create_from_fd(&ctx, fd);
+  close(fd);
+  if (err != READPE_OK) return err;
+
+  readpe_context_lru_entry_t* ne = malloc(sizeof(*ne));
+  if (ne == NULL) {
+    readpe_context_destroy(ctx);
+    return READPE_ERROR_NO_MEMORY;
+  }
+  *ne = (typeof(*ne)) {
+    .dev        = st.st_dev,
+    .ino        = st.st_ino,
+    .size       = st.st_size,
+    .mtime_sec  = st.st_mtim.tv_sec,
+    .mtime_nsec = st.st_mtim.tv_nsec,
+    .ctx        = ctx,
+    .users      = 1,
+  };
+  pthread_mutex_init(&ne->mtx, NULL);
+
+  pthread_mutex_lock(&lru->mtx);
+  *e = readpe_context_lru_find_(lru, &st);
+  if (*e == NULL) {
+    readpe_context_lru_push_front_(lru, ne);
+    ++lru->length;
+    readpe_context_lru_evict_(lru);
+    *e = ne;
+    ne = NULL;
+  }
+  pthread_mutex_unlock(&lru->mtx);
+
+  readpe_context_lru_destroy_entry_(ne);
+  pthread_mutex_lock(&(*e)->mtx);
+  return READPE_OK;
+}
+
+void readpe_context_lru_release(
+    readpe_context_lru_t* lru, readpe_context_lru_entry_t* e) {
+  assert(lru != NULL);
+
+  if (e == NULL) return;
+  pthread_mutex_unlock(&e->mtx);
+
+  pthread_mutex_lock(&lru->mtx);
+  assert(e->users > 0);
+  --e->users;
+  readpe_context_lru_evict_(lru);
+  pthread_mutex_unlock(&lru->mtx);
+}
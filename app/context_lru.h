@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "lib/readpe.h"
+
+/* Contexts parsed recently, keyed by (dev, inode, size, mtime) of the files,
+ * so results computed on demand are also kept across requests. A context is
+ * used by one thread at a time. */
+typedef struct readpe_context_lru_entry_t {
+  struct readpe_context_lru_entry_t* prev;  /* NULLABLE, more recent */
+  struct readpe_context_lru_entry_t* next;  /* NULLABLE, less recent */
+
+  dev_t    dev;
+  ino_t    ino;
+  off_t    size;
+  int64_t  mtime_sec;
+  long     mtime_nsec;
+
+  readpe_context_t* ctx;
+  size_t            users;  /* pinned while positive */
+  pthread_mutex_t   mtx;    /* held by the user of ctx */
+} readpe_context_lru_entry_t;
+
+typedef struct readpe_context_lru_t {
+  pthread_mutex_t mtx;
+
+  readpe_context_lru_entry_t* head;  /* NULLABLE, the most recent */
+  readpe_context_lru_entry_t* tail;  /* NULLABLE, the least recent */
+  size_t length;
+  size_t capacity;
+} readpe_context_lru_t;
+
+void
+readpe_context_lru_initialize(
+    readpe_context_lru_t* lru,
+    size_t                capacity  /* 0 means 64 */
+);
+
+void
+readpe_context_lru_deinitialize(
+    readpe_context_lru_t* lru
+);
+    /* No entry must be in use. */
+
+readpe_error_t
+readpe_context_lru_acquire(
+    readpe_context_lru_t*        lru,
+    const char*                  path,
+    readpe_context_lru_entry_t** e
+);
+    /* Finds the context of the file or parses it, and locks it for the
+     * caller until readpe_context_lru_release. Files failing to parse are
+     * not kept. */
+
+void
+readpe_context_lru_release(
+    readpe_context_lru_t*       lru,
+    readpe_context_lru_entry_t* e
+);
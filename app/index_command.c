@@ -0,0 +1,132 @@
+#include "./index_command.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lib/context.h"
+
+#include "./args.h"
+#include "./batch.h"
+#include "./output.h"
+#include "./output_buffer.h"
+
+static bool readpe_index_command_add_file_(
+    void* udata, readpe_output_t* out, const readpe_batch_file_t* file) {
+  readpe_index_builder_t* builder = udata;
+  assert(builder != NULL);
+  assert(out     != NULL);
+  assert(file    != NULL);
+
+  (void) out;
+
+  const char* path = file->path;
+
+  readpe_context_t ctx;
+  readpe_error_t   err = readpe_batch_initialize_context(file, &ctx);
+  if (err == READPE_OK) {
+    err = readpe_index_builder_add(builder, path, &ctx);
+    readpe_context_deinitialize(&ctx);
+  }
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s: %s\n", path, readpe_error_stringify(err));
+  }
+  return err == READPE_OK;
+}
+
+bool readpe_index_command_build(const readpe_args_t* args) {
+  assert(args        != NULL);
+  assert(args->index != NULL);
+
+  bool ret = false;
+
+  readpe_batch_t batch;
+  readpe_batch_initialize(&batch);
+
+  readpe_index_builder_t* builder = NULL;
+  readpe_error_t err = readpe_index_builder_create(&builder);
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s: %s\n", args->index, readpe_error_stringify(err));
+    goto FINALIZE;
+  }
+
+  for (size_t i = 0; i < args->inputs_length; ++i) {
+    if (!readpe_batch_add_path(&batch, args->inputs[i], stderr)) goto FINALIZE;
+  }
+  if (args->stdin_list) {
+    const char delim = args->null_separated? '\0': '\n';
+    if (!readpe_batch_add_list(&batch, stdin, delim, stderr)) goto FINALIZE;
+  }
+
+  /* the index is written even if some files are broken */
+  /* exports and imports lie in sections */
+  const readpe_read_ahead_extent_t read_ahead = args->read_ahead?
+      READPE_READ_AHEAD_SECTIONS: READPE_READ_AHEAD_NONE;
+  ret = readpe_batch_run(&batch, args->jobs, false, read_ahead,
+      stdout, stderr, READPE_OUTPUT_FORMAT_TEXT, NULL,
+      readpe_index_command_add_file_, builder);
+
+  err = readpe_index_builder_write(builder, args->index);
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s: %s\n", args->index, readpe_error_stringify(err));
+    ret = false;
+  }
+
+FINALIZE:
+  readpe_index_builder_destroy(builder);
+  readpe_batch_deinitialize(&batch);
+  return ret;
+}
+
+bool readpe_index_command_query(const readpe_args_t* args) {
+  assert(args        != NULL);
+  assert(args->index != NULL);
+
+  readpe_index_t* idx;
+  readpe_error_t  err = readpe_index_open(&idx, args->index);
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s: %s\n", args->index, readpe_error_stringify(err));
+    return false;
+  }
+
+  const readpe_index_kind_t kind =
+      args->exports? READPE_INDEX_EXPORT: READPE_INDEX_IMPORT;
+  const bool batch = args->inputs_length > 1;
+
+  readpe_output_t out;
+  readpe_output_initialize(&out, stdout, args->format);
+  readpe_output_begin_batch(&out, batch);
+
+  const char* sep = readpe_output_get_separator(args->format, batch);
+
+  bool ret = true;
+  for (size_t i = 0; i < args->inputs_length; ++i) {
+    const char* query = args->inputs[i];
+
+    size_t begin = 0, end = 0;
+    err = readpe_index_find(
+        idx, kind, query, strlen(query), args->prefix, &begin, &end);
+
+    if (i > 0 && sep != NULL) readpe_output_put(&out, sep, strlen(sep));
+    if (err == READPE_OK) {
+      err = readpe_output_index_query(&out, idx, query, begin, end, batch);
+    }
+    readpe_output_flush(&out);
+
+    if (err != READPE_OK) {
+      fprintf(stderr, "%s: %s\n", args->index, readpe_error_stringify(err));
+      ret = false;
+    } else if (begin == end) {
+      fprintf(stderr, "%s: not found\n", query);
+      ret = false;
+    }
+  }
+
+  readpe_output_end_batch(&out, batch);
+  readpe_output_deinitialize(&out);
+
+  readpe_index_close(idx);
+  return ret;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "./args.h"
+
+bool
+readpe_index_command_build(
+    const readpe_args_t* args
+);
+    /* Adds the symbols of every input to a new index at args->index. Files
+     * failing to parse are reported and left out. */
+
+bool
+readpe_index_command_query(
+    const readpe_args_t* args
+);
+    /* Prints the files importing (or exporting) each input. Returns false
+     * if any of them is not found. */
@@ -0,0 +1,294 @@
+#include "./inspect_command.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "lib/context.h"
+
+#include "./args.h"
+#include "./batch.h"
+#include "./cache.h"
+#include "./context_lru.h"
+#include "./output.h"
+#include "./output_buffer.h"
+
+typedef struct readpe_inspect_command_t {
+  const readpe_args_t*  args;
+  readpe_signatures_t*  signatures;  /* NULLABLE */
+  readpe_cache_t*       cache;       /* NULLABLE */
+  readpe_context_lru_t* contexts;    /* NULLABLE */
+  FILE*                 err;
+} readpe_inspect_command_t;
+
+static readpe_error_t readpe_inspect_command_print_context_(
+    const readpe_inspect_command_t* m,
+    readpe_output_t*                out,
+    readpe_context_t*               ctx) {
+  const readpe_args_t* args = m->args;
+
+  readpe_error_t err = READPE_OK;
+
+  if (args->fingerprints) {
+    err = readpe_context_compute_fingerprints(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_fingerprints(out, ctx);
+  }
+  if (args->dos_header) {
+    readpe_output_dos_header(out, ctx->dos_header);
+  }
+  if (args->dos_stub) {
+    readpe_output_dos_stub(out, ctx->dos_stub, ctx->dos_stub_length);
+  }
+  if (args->nt_header) {
+    readpe_output_nt_header(out, ctx->nt_header);
+  }
+  if (args->authenticode) {
+    err = readpe_context_compute_authenticode(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_authenticode(out, ctx);
+  }
+  if (args->section_table) {
+    readpe_output_section_table(
+        out, ctx->sections, ctx->nt_header->file.number_of_sections);
+  }
+  if (args->section_stats) {
+    /* files of a batch already run in parallel */
+    err = readpe_context_compute_section_stats(
+        ctx, args->batch? 1: args->jobs);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_section_stats(out, ctx);
+  }
+  if (args->export_table) {
+    err = readpe_context_find_export_table(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_export_table(out, ctx);
+  }
+  if (args->find_export != NULL) {
+    err = readpe_context_find_export_table(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_export_lookup(out, ctx, args->find_export);
+  }
+  if (args->import_table) {
+    err = readpe_context_find_import_table(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_import_table(out, ctx);
+  }
+  if (args->relocation_table) {
+    err = readpe_context_find_relocation_table(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_relocation_table(out, ctx);
+  }
+  if (args->relocation_density) {
+    err = readpe_context_build_relocation_index(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_relocation_density(out, ctx);
+  }
+  if (args->hashes) {
+    err = readpe_context_compute_hashes(ctx);
+    if (err != READPE_OK) goto FINALIZE;
+    readpe_output_hashes(out, ctx);
+  }
+  if (args->strings) {
+    const readpe_strings_options_t opts = {
+      .min_length = args->min_length,
+      .skip_names = args->skip_names,
+      .threads    = args->batch? 1: args->jobs,
+    };
+    err = readpe_output_strings(out, ctx, &opts);
+    if (err != READPE_OK) goto FINALIZE;
+  }
+  if (m->signatures != NULL) {
+    err = readpe_output_signatures(out, ctx, m->signatures,
+        args->scan_image? READPE_SIGNATURE_IMAGE: READPE_SIGNATURE_RAW);
+    if (err != READPE_OK) goto FINALIZE;
+  }
+
+FINALIZE:
+  return err;
+}
+
+/* Returns the parts of files which the outputs requested touch, which must
+ * follow readpe_inspect_command_print_context_, as parts not read ahead
+ * are left zero. */
+static readpe_read_ahead_extent_t readpe_inspect_command_extent_(
+    const readpe_inspect_command_t* m) {
+  const readpe_args_t* args = m->args;
+
+  if (args->authenticode || args->hashes ||
+      (m->signatures != NULL && !args->scan_image)) {
+    return READPE_READ_AHEAD_WHOLE;
+  }
+  if (args->fingerprints        ||
+      args->section_stats       ||
+      args->export_table        ||
+      args->find_export != NULL ||
+      args->import_table        ||
+      args->relocation_table    ||
+      args->relocation_density  ||
+      args->strings             ||
+      m->signatures != NULL) {
+    return READPE_READ_AHEAD_SECTIONS;
+  }
+  return READPE_READ_AHEAD_HEADERS;
+}
+
+static readpe_error_t readpe_inspect_command_print_file_(
+    const readpe_inspect_command_t* m,
+    readpe_output_t*                out,
+    const readpe_batch_file_t*      file) {
+  readpe_error_t err;
+  /* the file opened for the cache must be parsed as it is */
+  if (m->contexts != NULL && file->fd < 0) {
+    readpe_context_lru_entry_t* e;
+    err = readpe_context_lru_acquire(m->contexts, file->path, &e);
+    if (err != READPE_OK) return err;
+    err = readpe_inspect_command_print_context_(m, out, e->ctx);
+    readpe_context_lru_release(m->contexts, e);
+    return err;
+  }
+
+  readpe_context_t ctx;
+  err = readpe_batch_initialize_context(file, &ctx);
+  if (err != READPE_OK) return err;
+  err = readpe_inspect_command_print_context_(m, out, &ctx);
+  readpe_context_deinitialize(&ctx);
+  return err;
+}
+
+static bool readpe_inspect_command_job_(
+    void* udata, readpe_output_t* out, const readpe_batch_file_t* file) {
+  const readpe_inspect_command_t* m    = udata;
+  const readpe_args_t*            args = m->args;
+  assert(args != NULL);
+  assert(out  != NULL);
+  assert(file != NULL);
+
+  const char* path = file->path;
+
+  readpe_output_begin_file(out, path, args->batch);
+
+  readpe_error_t err;
+  if (m->cache == NULL) {
+    err = readpe_inspect_command_print_file_(m, out, file);
+  } else {
+    readpe_cache_entry_t e;
+    if (readpe_cache_find(m->cache, path, &e)) {
+      readpe_output_put(out, e.body, e.length);
+      err = e.status;
+    } else {
+      /* the result is kept in the buffer until stored */
+      FILE* fp = out->fp;
+      void (*spill)(readpe_output_t*) = out->spill;
+      out->fp    = NULL;
+      out->spill = NULL;
+
+      /* parses the contents hashed, not the file at the path now */
+      readpe_batch_file_t f = *file;
+      if (e.fd >= 0) f.fd = e.fd;
+
+      const size_t begin = out->length;
+      err = readpe_inspect_command_print_file_(m, out, &f);
+      if (!out->broken) {
+        readpe_cache_store(
+            m->cache, &e, out->buf + begin, out->length - begin, err);
+      }
+      out->fp    = fp;
+      out->spill = spill;
+    }
+    readpe_cache_release(&e);
+  }
+
+  if (err != READPE_OK) {
+    fprintf(m->err, "%s: %s\n", path, readpe_error_stringify(err));
+  }
+  readpe_output_end_file(out, err);
+  return err == READPE_OK;
+}
+
+bool readpe_inspect_command_run(
+    readpe_args_t*        args,
+    readpe_context_lru_t* contexts,
+    FILE*                 in,
+    FILE*                 out,
+    FILE*                 err) {
+  assert(args != NULL);
+  assert(in   != NULL);
+  assert(out  != NULL);
+  assert(err  != NULL);
+
+  bool ret = false;
+
+  readpe_inspect_command_t m = {
+    .args     = args,
+    .contexts = contexts,
+    .err      = err,
+  };
+  readpe_cache_t cache = {0};
+
+  readpe_batch_t batch;
+  readpe_batch_initialize(&batch);
+
+  /* compiled once and shared by all workers */
+  if (args->signatures != NULL) {
+    size_t line;
+    const readpe_error_t e =
+        readpe_signatures_load(&m.signatures, args->signatures, &line);
+    if (e != READPE_OK) {
+      if (e == READPE_ERROR_INVALID_SIGNATURE) {
+        fprintf(err, "%s:%zu: %s\n",
+            args->signatures, line, readpe_error_stringify(e));
+      } else {
+        fprintf(err, "%s: %s\n",
+            args->signatures, readpe_error_stringify(e));
+      }
+      goto FINALIZE;
+    }
+  }
+
+  for (size_t i = 0; i < args->inputs_length; ++i) {
+    if (!readpe_batch_add_path(&batch, args->inputs[i], err)) goto FINALIZE;
+  }
+  if (args->stdin_list) {
+    const char delim = args->null_separated? '\0': '\n';
+    if (!readpe_batch_add_list(&batch, in, delim, err)) goto FINALIZE;
+  }
+  args->batch = args->batch || batch.paths_length != 1;
+
+  /* the key depends on the batch mode, which changes JSON indentation */
+  if (args->cache != NULL) {
+    readpe_hash_state_t key;
+    readpe_hash_initialize(&key, READPE_HASH_SHA256);
+    readpe_args_hash(args, &key);
+    if (args->signatures != NULL &&
+        !readpe_cache_hash_file(&key, args->signatures)) {
+      fprintf(err, "%s: %s\n",
+          args->signatures, readpe_error_stringify(READPE_ERROR_READ));
+      goto FINALIZE;
+    }
+    if (!readpe_cache_initialize(&cache, args->cache, &key, err)) goto FINALIZE;
+    m.cache = &cache;
+  }
+
+  readpe_output_t o;
+  readpe_output_initialize(&o, out, args->format);
+  readpe_output_begin_batch(&o, args->batch);
+  readpe_output_flush(&o);
+
+  const char* sep = readpe_output_get_separator(args->format, args->batch);
+  /* files answered from the cache or kept by the server are not read */
+  const readpe_read_ahead_extent_t read_ahead =
+      args->read_ahead && m.cache == NULL && m.contexts == NULL?
+          readpe_inspect_command_extent_(&m): READPE_READ_AHEAD_NONE;
+  ret = readpe_batch_run(&batch, args->jobs, !args->unordered, read_ahead,
+      out, err, args->format, sep, readpe_inspect_command_job_, &m);
+
+  readpe_output_end_batch(&o, args->batch);
+  readpe_output_deinitialize(&o);
+
+FINALIZE:
+  readpe_cache_deinitialize(&cache);
+  readpe_signatures_destroy(m.signatures);
+  readpe_batch_deinitialize(&batch);
+  return ret;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "./args.h"
+#include "./context_lru.h"
+
+bool
+readpe_inspect_command_run(
+    readpe_args_t*        args,
+    readpe_context_lru_t* contexts,  /* NULLABLE */
+    FILE*                 in,
+    FILE*                 out,
+    FILE*                 err
+);
+    /* Prints what args asks for each input to out, and reports files
+     * failing to err. The list of --stdin is read from in. Contexts are
+     * parsed for each file unless the LRU is given. Returns false if any
+     * of the files failed. */
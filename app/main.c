@@ -1,54 +1,50 @@
-#include <assert.h>
-#include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-#include "pe.h"
-
 #include "./args.h"
-#include "./context.h"
-#include "./output.h"
+#include "./index_command.h"
+#include "./inspect_command.h"
+#include "./resolve_command.h"
+#include "./serve_command.h"
 
 int main(int argc, char** argv) {
   readpe_args_t args;
-  if (!readpe_args_parse(&args, argc, (const char**) argv)) {
+  if (!readpe_args_parse(&args, argc, (const char**) argv, stderr)) {
     fprintf(stderr, "failed to parse args\n");
     return EXIT_FAILURE;
   }
   if (args.help) {
     readpe_args_print_help();
+    readpe_args_deinitialize(&args);
     return EXIT_SUCCESS;
   }
 
-  readpe_context_t ctx;
-  if (!readpe_context_initialize(&ctx, args.input)) {
-    return EXIT_FAILURE;
-  }
+  bool success = false;
 
-  if (args.dos_header) {
-    readpe_output_dos_header(ctx.dos_header);
-  }
-  if (args.dos_stub) {
-    readpe_output_dos_stub(ctx.dos_stub, ctx.dos_stub_length);
-  }
-  if (args.nt_header) {
-    readpe_output_nt_header(ctx.nt_header);
-  }
-  if (args.section_table) {
-    readpe_output_section_table(ctx.sections, ctx.nt_header->file.number_of_sections);
-  }
-  if (args.export_table) {
-    readpe_output_export_table(
-        ctx.image, ctx.export_, ctx.export_section_length);
-  }
-  if (args.import_table) {
-    readpe_output_import_table(ctx.image, ctx.imports, ctx._64bit);
-  }
-  if (args.relocation_table) {
-    readpe_output_relocation_table(ctx.relocations, ctx.relocations_length);
+  switch (args.mode) {
+  case READPE_ARGS_MODE_INSPECT:
+    /* falls back to this process if no server is found */
+    if (args.connect == NULL || !readpe_serve_command_request(
+          args.connect, argc, (const char**) argv, &success)) {
+      success = readpe_inspect_command_run(
+          &args, NULL, stdin, stdout, stderr);
+    }
+    break;
+  case READPE_ARGS_MODE_INDEX_BUILD:
+    success = readpe_index_command_build(&args);
+    break;
+  case READPE_ARGS_MODE_INDEX_QUERY:
+    success = readpe_index_command_query(&args);
+    break;
+  case READPE_ARGS_MODE_RESOLVE:
+    success = readpe_resolve_command_run(&args);
+    break;
+  case READPE_ARGS_MODE_SERVE:
+    success = readpe_serve_command_run(&args);
+    break;
   }
 
-  readpe_context_deinitialize(&ctx);
-  return EXIT_SUCCESS;
+  readpe_args_deinitialize(&args);
+  return success? EXIT_SUCCESS: EXIT_FAILURE;
 }
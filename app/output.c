@@ -3,65 +3,165 @@
 #include <assert.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "pe.h"
 
-static size_t output_indent_ = 0;
+#include "./output_buffer.h"
+#include "./output_json.h"
+#include "./output_record.h"
+
+#define READPE_OUTPUT_BUFFER_SIZE (64*1024)
+
+/* hands the call to the printer of the structured format, if any */
+#define READPE_OUTPUT_DISPATCH_(json, record) do {  \
+  switch (out->format) {  \
+  case READPE_OUTPUT_FORMAT_TEXT:  \
+    break;  \
+  case READPE_OUTPUT_FORMAT_JSON:  \
+  case READPE_OUTPUT_FORMAT_NDJSON:  \
+    json;  \
+    return;  \
+  case READPE_OUTPUT_FORMAT_RECORD:  \
+    record;  \
+    return;  \
+  }  \
+} while (0)
 
 #define printfln(fmt, ...) do {  \
-  readpe_output_indent_();  \
-  printf(fmt"\n", __VA_ARGS__);  \
+  readpe_output_indent_(out);  \
+  readpe_output_printf(out, fmt"\n", __VA_ARGS__);  \
 } while (0)
 
-static inline void readpe_output_indent_(void) {
-  if (output_indent_ > 0) {
-    printf("%*c", (int) output_indent_*2, ' ');
-  }
+static inline void readpe_output_indent_(readpe_output_t* out) {
+  readpe_output_fill(out, ' ', out->indent*2);
 }
-static inline void readpe_output_begin_group_(const char* name) {
-  printf("\n");
+static inline void readpe_output_begin_group_(
+    readpe_output_t* out, const char* name) {
+  readpe_output_putc(out, '\n');
   printfln("---- %s", name);
-  ++output_indent_;
+  ++out->indent;
 }
-static inline void readpe_output_end_group_(void) {
-  assert(output_indent_ > 0);
+static inline void readpe_output_end_group_(readpe_output_t* out) {
+  assert(out->indent > 0);
 
-  --output_indent_;
+  --out->indent;
 }
 
-static void readpe_output_binary_(const uint8_t* body, size_t len) {
+static void readpe_output_binary_(
+    readpe_output_t* out, const uint8_t* body, size_t len) {
+  assert(out  != NULL);
   assert(body != NULL || len == 0);
 
   const uint8_t* itr = body;
   const uint8_t* end = body + len;
 
   for (size_t i = 0; itr < end; ++i) {
-    readpe_output_indent_();
-    printf("%06"PRIX64":", (uint64_t) i*16);
-
-    char str[16] = {0};
-    for (size_t j = 0; j < 16 && itr < end; ++j) {
-      if (j%2 == 0) printf(" ");
-      str[j] = *(itr++);
-      printf("%02"PRIX8, (uint8_t) str[j]);
-      if (!isprint(str[j])) str[j] = '.';
+    readpe_output_indent_(out);
+    readpe_output_put_hex(out, (uint64_t) i*16, 6);
+    readpe_output_putc(out, ':');
+
+    char   str[16];
+    size_t j = 0;
+    for (; j < 16 && itr < end; ++j) {
+      const uint8_t c = *(itr++);
+      if (j%2 == 0) readpe_output_putc(out, ' ');
+      readpe_output_put(out, &readpe_output_hex_table[c*2], 2);
+      str[j] = isprint(c)? (char) c: '.';
     }
-    printf("    %.16s\n", str);
+    readpe_output_put(out, "    ", 4);
+    readpe_output_put(out, str, j);
+    readpe_output_putc(out, '\n');
+  }
+}
+
+bool readpe_output_grow(readpe_output_t* out, size_t n) {
+  assert(out != NULL);
+
+  if (out->fp == NULL && out->spill != NULL &&
+      out->length + n > out->spill_limit) {
+    out->spill(out);
+  }
+  if (out->fp != NULL) {
+    readpe_output_flush(out);
+    if (n <= out->reserved) return true;
+  }
+
+  size_t cap = out->reserved*2 + READPE_OUTPUT_BUFFER_SIZE;
+  while (cap < out->length + n) cap *= 2;
+
+  char* ptr = realloc(out->buf, cap);
+  if (ptr == NULL) {
+    out->broken = true;
+    return false;
+  }
+  out->buf      = ptr;
+  out->reserved = cap;
+  return true;
+}
+
+void readpe_output_initialize(
+    readpe_output_t* out, FILE* fp, readpe_output_format_t format) {
+  assert(out != NULL);
+
+  *out = (readpe_output_t) { .fp = fp, .format = format, };
+}
+
+void readpe_output_deinitialize(readpe_output_t* out) {
+  assert(out != NULL);
+
+  readpe_output_flush(out);
+  free(out->buf);
+  *out = (readpe_output_t) {0};
+}
+
+void readpe_output_flush(readpe_output_t* out) {
+  assert(out != NULL);
+
+  if (out->fp == NULL || out->length == 0) return;
+  fwrite(out->buf, out->length, 1, out->fp);
+  out->flushed += out->length;
+  out->length   = 0;
+}
+
+void readpe_output_printf(readpe_output_t* out, const char* fmt, ...) {
+  assert(out != NULL);
+  assert(fmt != NULL);
+
+  if (!readpe_output_reserve(out, 1)) return;
+
+  va_list args;
+  va_start(args, fmt);
+  const size_t space = out->reserved - out->length;
+  const int    n     = vsnprintf(out->buf + out->length, space, fmt, args);
+  va_end(args);
+  if (n < 0) return;
+
+  if ((size_t) n >= space) {
+    if (!readpe_output_reserve(out, (size_t) n + 1)) return;
+    va_start(args, fmt);
+    vsnprintf(out->buf + out->length, (size_t) n + 1, fmt, args);
+    va_end(args);
   }
+  out->length += (size_t) n;
 }
 
-static const char* readpe_output_stringify_time_(uint32_t ts) {
-  static char result[64];
+static const char* readpe_output_stringify_time_(
+    char* buf, size_t len, uint32_t ts) {
+  assert(buf != NULL);
 
   const time_t t = (time_t) ts;
-  strftime(result, sizeof(result), "%Y/%m/%d %A %H:%M:%S", localtime(&t));
-  return result;
+
+  struct tm tm;
+  strftime(buf, len, "%Y/%m/%d %A %H:%M:%S", localtime_r(&t, &tm));
+  return buf;
 }
 
 static const char* readpe_output_stringify_image_signature_(
@@ -177,16 +277,20 @@ static const char* readpe_output_stringify_data_directory_entry_(size_t i) {
 }
 
 static void readpe_output_image_file_header_(
-    const pe_image_file_header_t* header) {
+    readpe_output_t* out, const pe_image_file_header_t* header) {
+  assert(out    != NULL);
   assert(header != NULL);
 
-  readpe_output_begin_group_("IMAGE FILE HEADER");
+  char time[64];
+
+  readpe_output_begin_group_(out, "IMAGE FILE HEADER");
 
   printfln("machine                : %s (0x%04"PRIX16")",
       readpe_output_stringify_machine_(header->machine), header->machine);
   printfln("number of sections     : %"PRIu16, header->number_of_sections);
   printfln("time date stamp        : %s",
-      readpe_output_stringify_time_(header->time_date_stamp));
+      readpe_output_stringify_time_(
+          time, sizeof(time), header->time_date_stamp));
   printfln("pointer to symbol table: 0x%08"PRIX32,
       header->pointer_to_symbol_table);
   printfln("number of symbols      : %"PRIu32, header->number_of_symbols);
@@ -231,11 +335,12 @@ static void readpe_output_image_file_header_(
 
 # undef p
 
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
 static void readpe_output_data_directories_(
-    const pe_image_data_directory_t* dirs, size_t len) {
+    readpe_output_t* out, const pe_image_data_directory_t* dirs, size_t len) {
+  assert(out  != NULL);
   assert(dirs != NULL || len == 0);
 
   printfln("data directories: %s", "");
@@ -250,238 +355,186 @@ static void readpe_output_data_directories_(
   }
 }
 
-static void readpe_output_optional_header32_(
-    const pe32_image_optional_header_t* header) {
-  assert(header != NULL);
-
-  readpe_output_begin_group_("OPTIONAL HEADER 32-bit");
-
-  printfln("magic                     : %s (0x%04"PRIX16")",
-      readpe_output_stringify_optional_magic_(header->magic), header->magic);
-  printfln("linker version            : %"PRIu8".%"PRIu8,
-      header->major_linker_version, header->minor_linker_version);
-  printfln("size of code              : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_code, header->size_of_code);
-  printfln("size of initialized data  : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_initialized_data, header->size_of_initialized_data);
-  printfln("size of uninitialized data: 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_uninitialized_data, header->size_of_uninitialized_data);
-  printfln("address of entrypoint     : 0x%08"PRIX32" RVA",
-      header->address_of_entrypoint);
-  printfln("base of code              : 0x%08"PRIX32" RVA",
-      header->base_of_code);
-  printfln("base of data              : 0x%08"PRIX32" RVA",
-      header->base_of_data);
-  printfln("image base                : 0x%08"PRIX32,
-      header->image_base);
-  printfln("section alignment         : 0x%08"PRIX32" = %"PRIu32,
-      header->section_alignment, header->section_alignment);
-  printfln("file alignment            : 0x%08"PRIX32" = %"PRIu32,
-      header->file_alignment, header->file_alignment);
-  printfln("OS version                : %"PRIu16".%"PRIu16,
-      header->major_operating_system_version,
-      header->minor_operating_system_version);
-  printfln("image version             : %"PRIu16".%"PRIu16,
-      header->major_image_version, header->minor_image_version);
-  printfln("subsystem version         : %"PRIu16".%"PRIu16,
-      header->major_subsystem_version, header->minor_subsystem_version);
-  printfln("size of image             : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_image, header->size_of_image);
-  printfln("size of headers           : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_headers, header->size_of_headers);
-  printfln("checksum                  : 0x%08"PRIX32" = %"PRIu32,
-      header->checksum, header->checksum);
-  printfln("subsystem                 : %s (0x%04"PRIX16")",
-      readpe_output_stringify_optional_subsystem_(header->subsystem),
-      header->subsystem);
-
-  printfln("dll characteristics       : 0x%04"PRIX16,
-      header->dll_characteristics);
-
-# define p(flag, desc) do {  \
-    if (header->dll_characteristics & flag) {  \
-      printfln("  - %s (0x%04"PRIX16")", #flag, flag);  \
-      printfln("      %s", desc);  \
-    }  \
-  } while (0)
-
-  p(PE_IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE,
-      "the dll can be relocated at load time");
-  p(PE_IMAGE_DLLCHARACTERISTICS_FORCE_INTEGRITY,
-      "integrity checks are forced");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NX_COMPAT,
-      "the image is compatible with data execution prevention");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NO_ISOLATION,
-      "the image is isolation aware");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NO_SEH,
-      "the image does not use structured exception handling");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NO_BIND,
-      "don't bind the image");
-  p(PE_IMAGE_DLLCHARACTERISTICS_WDM_DRIVER,
-      "A WDM driver");
-  p(PE_IMAGE_DLLCHARACTERISTICS_TERMINAL_SERVER_AWARE,
-      "the image is terminal server aware");
-
-# undef p
-
-  printfln("size of stack reserve     : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_stack_reserve, header->size_of_stack_reserve);
-  printfln("size of stack commit      : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_stack_commit, header->size_of_stack_commit);
-  printfln("size of heap reserve      : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_heap_reserve, header->size_of_heap_reserve);
-  printfln("size of heap commit       : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_heap_commit, header->size_of_heap_commit);
-
-  printfln("number of RVA and sizes   : %"PRIu32,
-      header->number_of_rva_and_sizes);
-
-  readpe_output_data_directories_(
-      header->data_directory, header->number_of_rva_and_sizes);
+#define READPE_OUTPUT_BITS 32
+#include "./output_optional_header.h"
+
+#define READPE_OUTPUT_BITS 64
+#include "./output_optional_header.h"
+
+static void readpe_output_export_(
+    readpe_output_t*       out,
+    const readpe_export_t* exp,
+    size_t                 name_width,
+    int64_t                ordinal) {
+  assert(out != NULL);
+  assert(exp != NULL);
+
+  const char* name     = exp->name;
+  size_t      name_len = exp->name_length;
+  if (name == NULL) {
+    name     = "[anonymous function]";
+    name_len = strlen(name);
+  }
 
-  readpe_output_end_group_();
+  readpe_output_indent_(out);
+  readpe_output_put(out, name, name_len);
+  if (name_width > name_len) {
+    readpe_output_fill(out, ' ', name_width - name_len);
+  }
+  readpe_output_putc(out, '@');
+  readpe_output_put_dec(out,
+      ordinal < 0? -(uint64_t) ordinal: (uint64_t) ordinal, ordinal < 0, -10);
+  readpe_output_put(out, " 0x", 3);
+  readpe_output_put_hex(out, exp->rva, 8);
+
+  if (exp->forwarded) {
+    readpe_output_put(out, " (forwarded to '", 16);
+    if (exp->forwarder != NULL) {
+      readpe_output_put(out, exp->forwarder, exp->forwarder_length);
+    }
+    readpe_output_put(out, "')", 2);
+  }
+  readpe_output_putc(out, '\n');
 }
 
-static void readpe_output_optional_header64_(
-    const pe64_image_optional_header_t* header) {
-  assert(header != NULL);
+bool readpe_output_parse_format(
+    const char* name, readpe_output_format_t* format) {
+  assert(name   != NULL);
+  assert(format != NULL);
+
+  if (strcmp(name, "text") == 0) {
+    *format = READPE_OUTPUT_FORMAT_TEXT;
+  } else if (strcmp(name, "json") == 0) {
+    *format = READPE_OUTPUT_FORMAT_JSON;
+  } else if (strcmp(name, "ndjson") == 0) {
+    *format = READPE_OUTPUT_FORMAT_NDJSON;
+  } else if (strcmp(name, "record") == 0) {
+    *format = READPE_OUTPUT_FORMAT_RECORD;
+  } else {
+    return false;
+  }
+  return true;
+}
 
-  readpe_output_begin_group_("OPTIONAL HEADER 64-bit");
-
-  printfln("magic                     : %s (0x%04"PRIX16")",
-      readpe_output_stringify_optional_magic_(header->magic), header->magic);
-  printfln("linker version            : %"PRIu8".%"PRIu8,
-      header->major_linker_version, header->minor_linker_version);
-  printfln("size of code              : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_code, header->size_of_code);
-  printfln("size of initialized data  : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_initialized_data, header->size_of_initialized_data);
-  printfln("size of uninitialized data: 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_uninitialized_data, header->size_of_uninitialized_data);
-  printfln("address of entrypoint     : 0x%08"PRIX32" RVA",
-      header->address_of_entrypoint);
-  printfln("base of code              : 0x%08"PRIX32" RVA",
-      header->base_of_code);
-  printfln("image base                : 0x%016"PRIX64,
-      header->image_base);
-  printfln("section alignment         : 0x%08"PRIX32" = %"PRIu32,
-      header->section_alignment, header->section_alignment);
-  printfln("file alignment            : 0x%08"PRIX32" = %"PRIu32,
-      header->file_alignment, header->file_alignment);
-  printfln("OS version                : %"PRIu16".%"PRIu16,
-      header->major_operating_system_version,
-      header->minor_operating_system_version);
-  printfln("image version             : %"PRIu16".%"PRIu16,
-      header->major_image_version, header->minor_image_version);
-  printfln("subsystem version         : %"PRIu16".%"PRIu16,
-      header->major_subsystem_version, header->minor_subsystem_version);
-  printfln("size of image             : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_image, header->size_of_image);
-  printfln("size of headers           : 0x%08"PRIX32" = %"PRIu32,
-      header->size_of_headers, header->size_of_headers);
-  printfln("checksum                  : 0x%08"PRIX32" = %"PRIu32,
-      header->checksum, header->checksum);
-  printfln("subsystem                 : %s (0x%04"PRIX16")",
-      readpe_output_stringify_optional_subsystem_(header->subsystem),
-      header->subsystem);
-
-  printfln("dll characteristics       : 0x%04"PRIX16,
-      header->dll_characteristics);
+const char* readpe_output_get_separator(
+    readpe_output_format_t format, bool batch) {
+  return format == READPE_OUTPUT_FORMAT_JSON && batch? ",": NULL;
+}
 
-# define p(flag, desc) do {  \
-    if (header->dll_characteristics & flag) {  \
-      printfln("  - %s (0x%04"PRIX16")", #flag, flag);  \
-      printfln("      %s", desc);  \
-    }  \
-  } while (0)
+void readpe_output_begin_file(
+    readpe_output_t* out, const char* path, bool batch) {
+  assert(out  != NULL);
+  assert(path != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_begin_file(out, path, batch),
+      readpe_output_record_begin_file(out, path));
+  if (batch) {
+    readpe_output_put(out, "==== ", 5);
+    readpe_output_put(out, path, strlen(path));
+    readpe_output_putc(out, '\n');
+  }
+}
 
-  p(PE_IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE,
-      "the dll can be relocated at load time");
-  p(PE_IMAGE_DLLCHARACTERISTICS_FORCE_INTEGRITY,
-      "integrity checks are forced");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NX_COMPAT,
-      "the image is compatible with data execution prevention");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NO_ISOLATION,
-      "the image is isolation aware");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NO_SEH,
-      "the image does not use structured exception handling");
-  p(PE_IMAGE_DLLCHARACTERISTICS_NO_BIND,
-      "don't bind the image");
-  p(PE_IMAGE_DLLCHARACTERISTICS_WDM_DRIVER,
-      "A WDM driver");
-  p(PE_IMAGE_DLLCHARACTERISTICS_TERMINAL_SERVER_AWARE,
-      "the image is terminal server aware");
+void readpe_output_end_file(readpe_output_t* out, readpe_error_t err) {
+  assert(out != NULL);
 
-# undef p
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_end_file(out, err),
+      readpe_output_record_end_file(out, err));
+}
 
-  printfln("size of stack reserve     : 0x%016"PRIX64" = %"PRIu64,
-      header->size_of_stack_reserve, header->size_of_stack_reserve);
-  printfln("size of stack commit      : 0x%016"PRIX64" = %"PRIu64,
-      header->size_of_stack_commit, header->size_of_stack_commit);
-  printfln("size of heap reserve      : 0x%016"PRIX64" = %"PRIu64,
-      header->size_of_heap_reserve, header->size_of_heap_reserve);
-  printfln("size of heap commit       : 0x%016"PRIX64" = %"PRIu64,
-      header->size_of_heap_commit, header->size_of_heap_commit);
+void readpe_output_begin_batch(readpe_output_t* out, bool batch) {
+  assert(out != NULL);
 
-  printfln("number of RVA and sizes   : %"PRIu32,
-      header->number_of_rva_and_sizes);
+  if (out->format == READPE_OUTPUT_FORMAT_JSON && batch) {
+    readpe_output_putc(out, '[');
+  }
+}
 
-  readpe_output_data_directories_(
-      header->data_directory, header->number_of_rva_and_sizes);
+void readpe_output_end_batch(readpe_output_t* out, bool batch) {
+  assert(out != NULL);
 
-  readpe_output_end_group_();
+  if (out->format == READPE_OUTPUT_FORMAT_JSON && batch) {
+    readpe_output_put(out, "\n]\n", 3);
+  }
 }
 
-void readpe_output_dos_header(const pe_dos_header_t* dos_header) {
+void readpe_output_dos_header(
+    readpe_output_t* out, const pe_dos_header_t* dos_header) {
+  assert(out        != NULL);
   assert(dos_header != NULL);
 
-  readpe_output_begin_group_("DOS HEADER");
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_dos_header(out, dos_header),
+      (void) 0);
+
+  readpe_output_begin_group_(out, "DOS HEADER");
 
   printfln("e_magic : 0x%04"PRIX16, dos_header->e_magic);
   printfln("e_lfanew: 0x%08"PRIX32, dos_header->e_lfanew);
 
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
-void readpe_output_dos_stub(const uint8_t* body, size_t len) {
+void readpe_output_dos_stub(
+    readpe_output_t* out, const uint8_t* body, size_t len) {
+  assert(out  != NULL);
   assert(body != NULL || len == 0);
 
-  readpe_output_begin_group_("DOS STUB");
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_dos_stub(out, body, len),
+      (void) 0);
+
+  readpe_output_begin_group_(out, "DOS STUB");
 
-  readpe_output_binary_(body, len);
+  readpe_output_binary_(out, body, len);
 
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
-void readpe_output_nt_header(const pe_nt_header_t* header) {
+void readpe_output_nt_header(
+    readpe_output_t* out, const pe_nt_header_t* header) {
+  assert(out    != NULL);
   assert(header != NULL);
 
-  readpe_output_begin_group_("NT HEADER");
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_nt_header(out, header),
+      (void) 0);
+
+  readpe_output_begin_group_(out, "NT HEADER");
 
   printfln("signature: %s (0x%04"PRIX16")",
       readpe_output_stringify_image_signature_(header->signature),
       header->signature);
 
-  readpe_output_image_file_header_(&header->file);
+  readpe_output_image_file_header_(out, &header->file);
 
   switch (header->file.machine) {
   case PE_IMAGE_FILE_MACHINE_I386:
-    readpe_output_optional_header32_(&header->optional._32bit);
+    readpe_output_optional_header32_(out, &header->optional._32bit);
     break;
   case PE_IMAGE_FILE_MACHINE_AMD64:
   case PE_IMAGE_FILE_MACHINE_IA64:
-    readpe_output_optional_header64_(&header->optional._64bit);
+    readpe_output_optional_header64_(out, &header->optional._64bit);
     break;
   }
 
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
 void readpe_output_section_table(
-    const pe_image_section_header_t* table, size_t rows) {
+    readpe_output_t*                 out,
+    const pe_image_section_header_t* table,
+    size_t                           rows) {
+  assert(out   != NULL);
   assert(table != NULL || rows == 0);
 
-  readpe_output_begin_group_("section table");
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_section_table(out, table, rows),
+      readpe_output_record_section_table(out, table, rows));
+
+  readpe_output_begin_group_(out, "section table");
 
   for (size_t i = 0; i < rows; ++i) {
     printfln("%zu:", i);
@@ -600,89 +653,76 @@ void readpe_output_section_table(
 #   undef p
   }
 
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
 void readpe_output_export_table(
-    const uint8_t*                     img,
-    const pe_image_export_directory_t* table,
-    size_t                             section_length) {
-  assert(img != NULL);
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_export_table(out, ctx),
+      readpe_output_record_export_table(out, ctx));
 
-  readpe_output_begin_group_("export table");
+  readpe_output_begin_group_(out, "export table");
 
+  const pe_image_export_directory_t* table = ctx->export_;
   if (table == NULL) {
     printfln("%s", "no export table found");
     goto FINALIZE;
   }
 
-  assert((uint8_t*) table >= img);
-  assert(section_length >= PE_IMAGE_EXPORT_DIRECTORY_SIZE);
+  assert(ctx->export_section_length >= PE_IMAGE_EXPORT_DIRECTORY_SIZE);
 
-  const uint32_t* addrs = (uint32_t*) (img + table->address_of_functions);
-  const uint32_t* names = (uint32_t*) (img + table->address_of_names);
-  const uint16_t* ordis = (uint16_t*) (img + table->address_of_name_ordinals);
-
-  const uintptr_t table_base = (uint8_t*) table - img;
+  const uint32_t* names = ctx->export_names;
 
   size_t longest = 0;
   for (size_t i = 0; i < table->number_of_names; ++i) {
-    const size_t len = strlen((char*) &img[names[i]]);
+    size_t len;
+    readpe_context_resolve_string(ctx, names[i], &len);
     if (len > longest) longest = len;
   }
 
   for (size_t i = 0; i < table->number_of_functions; ++i) {
-    const char* name    = "[anonymous function]";
-    int32_t     ordinal = -1;
-
-    for (size_t j = 0; j < table->number_of_names; ++j) {
-      if (ordis[j] == i) {
-        name    = (char*) &img[names[j]];
-        ordinal = ordis[j] + table->base;
-        break;
-      }
-    }
-
-    if (table_base <= addrs[i] && addrs[i] < table_base + section_length) {
-      printfln(
-          "%-*s@%-10"PRId32" 0x%08"PRIX32" (forwarded to '%s')",
-          (int) longest,
-          name,
-          ordinal,
-          addrs[i],
-          (char*) &img[addrs[i]]);
-    } else {
-      printfln(
-          "%-*s@%-10"PRId32" 0x%08"PRIX32,
-          (int) longest,
-          name,
-          ordinal,
-          addrs[i]);
-    }
+    readpe_export_t exp;
+    readpe_context_get_export(ctx, i, &exp);
+    readpe_output_export_(
+        out, &exp, longest, exp.name != NULL? (int64_t) exp.ordinal: -1);
   }
 
 FINALIZE:
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
 void readpe_output_import_table(
-    const uint8_t*                      img,
-    const pe_image_import_descriptor_t* table,
-    bool                                _64bit) {
-  assert(img != NULL);
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
 
-  readpe_output_begin_group_("import table");
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_import_table(out, ctx),
+      readpe_output_record_import_table(out, ctx));
 
-  if (table == NULL) {
+  char time[64];
+
+  readpe_output_begin_group_(out, "import table");
+
+  if (ctx->imports == NULL) {
     printfln("%s", "no import table found");
     goto FINALIZE;
   }
 
-  const pe_image_import_descriptor_t* itr = table;
-  for (size_t i = 0; itr->characteristics != 0; ++i, ++itr) {
+  const readpe_import_entries_t* e = &ctx->import_entries;
+
+  const pe_image_import_descriptor_t* itr = ctx->imports;
+  for (size_t i = 0; i < ctx->imports_length; ++i, ++itr) {
+    size_t      name_len;
+    const char* name = readpe_context_resolve_string(ctx, itr->name, &name_len);
+
     printfln("%zu:", i);
-    printfln("  name                : %s",
-        &img[itr->name]);
+    printfln("  name                : %.*s",
+        (int) name_len, name);
     printfln("  original first thunk: 0x%08"PRIX32,
         itr->original_first_thunk);
     printfln("  first thunk         : 0x%08"PRIX32,
@@ -694,84 +734,584 @@ void readpe_output_import_table(
       printfln("  time date stamp     : %d", 0);
     } else {
       printfln("  time date stamp     : %s",
-          readpe_output_stringify_time_(itr->time_date_stamp));
+          readpe_output_stringify_time_(
+              time, sizeof(time), itr->time_date_stamp));
     }
 
     printfln("%s", "  INT                 :");
 
-    const uint8_t* int_itr = img + itr->original_first_thunk;
-    for (;;) {
-      uintmax_t value   = 0;
-      bool      ordinal = false;
-
-      if (_64bit) {
-        value = ((pe64_image_thunk_data_t*) int_itr)->address_of_data;
-        int_itr += PE64_IMAGE_THUNK_DATA_SIZE;
-        if (value == 0) break;
-
-        ordinal = value & PE64_IMAGE_ORDINAL_FLAG;
-        if (ordinal) value &= PE64_IMAGE_ORDINAL;
-
-      } else {
-        value = ((pe32_image_thunk_data_t*) int_itr)->address_of_data;
-        int_itr += PE32_IMAGE_THUNK_DATA_SIZE;
-        if (value == 0) break;
-
-        ordinal = value & PE32_IMAGE_ORDINAL_FLAG;
-        if (ordinal) value &= PE32_IMAGE_ORDINAL;
-      }
-
-      if (ordinal) {
-        printfln("    @%7"PRIuMAX": [anonymous function]", value);
+    for (size_t j = e->dll_begin[i]; j < e->dll_begin[i+1]; ++j) {
+      readpe_output_indent_(out);
+      if (e->by_ordinal[j]) {
+        readpe_output_put(out, "    @", 5);
+        readpe_output_put_dec(out, e->hint[j], false, 7);
+        readpe_output_put(out, ": [anonymous function]\n", 23);
       } else {
-        const pe_image_import_by_name_t* ibn = (typeof(ibn)) (img + value);
-        printfln("    %8"PRIu32": %s", ibn->hint, ibn->name);
+        size_t      fn_len;
+        const char* fn = readpe_context_resolve_string(ctx, e->name[j], &fn_len);
+        readpe_output_put(out, "    ", 4);
+        readpe_output_put_dec(out, e->hint[j], false, 8);
+        readpe_output_put(out, ": ", 2);
+        readpe_output_put(out, fn, fn != NULL? fn_len: 0);
+        readpe_output_putc(out, '\n');
       }
     }
   }
 
 FINALIZE:
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
 }
 
-void readpe_output_relocation_table(const uint8_t* table, size_t length) {
-  readpe_output_begin_group_("relocation table");
+void readpe_output_relocation_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
 
-  if (table == NULL) {
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_relocation_table(out, ctx),
+      readpe_output_record_relocation_table(out, ctx));
+
+  readpe_output_begin_group_(out, "relocation table");
+
+  if (ctx->relocations == NULL) {
     printfln("%s", "no relocation table found");
     goto FINALIZE;
   }
 
-  size_t relocs = 0;
+  const readpe_relocation_entries_t* e = &ctx->relocation_entries;
 
-  const uint8_t* itr = table;
-  const uint8_t* end = itr + length;
-  for (size_t cnt = 0; itr < end; ++cnt) {
+  const uint8_t* itr = ctx->relocations;
+  for (size_t i = 0; i < e->blocks; ++i) {
     const pe_base_relocation_block_t* block = (typeof(block)) itr;
-    itr += PE_BASE_RELOCATION_BLOCK_SIZE;
 
-    printfln("block %zu:", cnt);
+    const size_t cnt = e->block_begin[i+1] - e->block_begin[i];
+    itr += PE_BASE_RELOCATION_BLOCK_SIZE + cnt*PE_BASE_RELOCATION_ENTRY_SIZE;
+
+    printfln("block %zu:", i);
     printfln("  virtual address: 0x%08"PRIX32,
         block->virtual_address);
     printfln("  block size     : 0x%08"PRIX32" = %"PRIu32,
         block->size_of_block, block->size_of_block);
-
-    const size_t cnt = (block->size_of_block - PE_BASE_RELOCATION_BLOCK_SIZE) /
-        PE_BASE_RELOCATION_ENTRY_SIZE;
     printfln("  entries        : %zu found", cnt);
 
-    for (size_t i = 0; i < cnt; ++i) {
-      const pe_base_relocation_entry_t* entry = (typeof(entry)) itr;
-      itr += PE_BASE_RELOCATION_ENTRY_SIZE;
-
-      printfln("    0x%08"PRIX32": type=%2"PRIu8,
-          entry->offset + block->virtual_address,
-          entry->type);
+    for (size_t j = e->block_begin[i]; j < e->block_begin[i+1]; ++j) {
+      readpe_output_indent_(out);
+      readpe_output_put(out, "    0x", 6);
+      readpe_output_put_hex(out, e->rva[j], 8);
+      readpe_output_put(out, ": type=", 7);
+      readpe_output_put_dec(out, e->type[j], false, 2);
+      readpe_output_putc(out, '\n');
     }
-    relocs += cnt;
   }
-  printfln("total %zu addresses to be relocated found", relocs);
+  printfln("total %zu addresses to be relocated found", e->length);
+
+FINALIZE:
+  readpe_output_end_group_(out);
+}
+
+void readpe_output_relocation_density(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_relocation_density(out, ctx),
+      readpe_output_record_relocation_density(out, ctx));
+
+  readpe_output_begin_group_(out, "relocation density");
+
+  size_t          pages;
+  const uint32_t* density = readpe_context_get_relocation_density(ctx, &pages);
+  if (density == NULL) {
+    printfln("%s", "no relocation table found");
+    goto FINALIZE;
+  }
+
+  size_t used = 0;
+  for (size_t i = 0; i < pages; ++i) {
+    if (density[i] == 0) continue;
+    printfln("page 0x%08zX: %"PRIu32" fixups",
+        i*READPE_RELOCATION_PAGE_SIZE, density[i]);
+    ++used;
+  }
+  printfln("%zu of %zu pages have fixups", used, pages);
 
 FINALIZE:
-  readpe_output_end_group_();
+  readpe_output_end_group_(out);
+}
+
+void readpe_output_authenticode(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_authenticode(out, ctx),
+      readpe_output_record_authenticode(out, ctx));
+
+  readpe_output_begin_group_(out, "authenticode");
+
+  const uint32_t stored = ctx->_64bit?
+      ctx->nt_header->optional._64bit.checksum:
+      ctx->nt_header->optional._32bit.checksum;
+  const uint32_t computed = readpe_context_get_checksum(ctx);
+
+  printfln("checksum (header)  : 0x%08"PRIX32, stored);
+  printfln("checksum (computed): 0x%08"PRIX32" %s", computed,
+      stored == 0? "(not set)": stored == computed? "(match)": "(mismatch)");
+  printfln("signed             : %s",
+      readpe_context_is_signed(ctx)? "yes": "no");
+
+  const readpe_hash_t* hash = readpe_context_get_authenticode_hash(ctx);
+
+  readpe_output_indent_(out);
+  readpe_output_put(out, "sha1               : ", 21);
+  readpe_output_put_digest(out, hash->sha1, sizeof(hash->sha1));
+  readpe_output_putc(out, '\n');
+
+  readpe_output_indent_(out);
+  readpe_output_put(out, "sha256             : ", 21);
+  readpe_output_put_digest(out, hash->sha256, sizeof(hash->sha256));
+  readpe_output_putc(out, '\n');
+
+  readpe_output_end_group_(out);
+}
+
+static void readpe_output_fingerprint_(
+    readpe_output_t* out,
+    const char*      name,
+    const uint8_t*   digest,
+    size_t           len,
+    const char*      missing) {
+  readpe_output_indent_(out);
+  readpe_output_put(out, name, strlen(name));
+  if (digest != NULL) {
+    readpe_output_put_digest(out, digest, len);
+  } else {
+    readpe_output_put(out, missing, strlen(missing));
+  }
+  readpe_output_putc(out, '\n');
+}
+
+void readpe_output_fingerprints(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_fingerprints(out, ctx),
+      readpe_output_record_fingerprints(out, ctx));
+
+  readpe_output_begin_group_(out, "fingerprints");
+
+  const readpe_fingerprints_t* fp = readpe_context_get_fingerprints(ctx);
+  readpe_output_fingerprint_(out, "imphash  : ",
+      fp->imphash_found? fp->imphash: NULL, sizeof(fp->imphash),
+      "(no imports)");
+  readpe_output_fingerprint_(out, "exphash  : ",
+      fp->exphash_found? fp->exphash: NULL, sizeof(fp->exphash),
+      "(no exports)");
+  readpe_output_fingerprint_(out, "rich hash: ",
+      fp->rich_hash_found? fp->rich_hash: NULL, sizeof(fp->rich_hash),
+      "(no rich header)");
+
+  readpe_output_end_group_(out);
+}
+
+static void readpe_output_hash_(
+    readpe_output_t* out, const readpe_hash_t* hash) {
+  readpe_output_indent_(out);
+  readpe_output_put(out, "  md5   : ", 10);
+  readpe_output_put_digest(out, hash->md5, sizeof(hash->md5));
+  readpe_output_putc(out, '\n');
+
+  readpe_output_indent_(out);
+  readpe_output_put(out, "  sha1  : ", 10);
+  readpe_output_put_digest(out, hash->sha1, sizeof(hash->sha1));
+  readpe_output_putc(out, '\n');
+
+  readpe_output_indent_(out);
+  readpe_output_put(out, "  sha256: ", 10);
+  readpe_output_put_digest(out, hash->sha256, sizeof(hash->sha256));
+  readpe_output_putc(out, '\n');
+}
+
+void readpe_output_hashes(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_hashes(out, ctx),
+      readpe_output_record_hashes(out, ctx));
+
+  readpe_output_begin_group_(out, "hashes");
+
+  printfln("file (%zu bytes):", ctx->file_length);
+  readpe_output_hash_(out, readpe_context_get_file_hash(ctx));
+
+  const readpe_hash_t* hashes = readpe_context_get_section_hashes(ctx);
+  for (size_t i = 0; i < ctx->nt_header->file.number_of_sections; ++i) {
+    const pe_image_section_header_t* s = &ctx->sections[i];
+    printfln("section %zu (%.*s, %"PRIu32" bytes):",
+        i, PE_IMAGE_SECTION_NAME_SIZE, s->name, s->size_of_raw_data);
+    readpe_output_hash_(out, &hashes[i]);
+  }
+
+  readpe_output_end_group_(out);
+}
+
+void readpe_output_section_stats(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_section_stats(out, ctx),
+      readpe_output_record_section_stats(out, ctx));
+
+  readpe_output_begin_group_(out, "section stats");
+
+  printfln("%-8s  %10s  %7s  %7s  %14s",
+      "name", "bytes", "entropy", "zeros", "chi-square");
+
+  const readpe_section_stats_t* stats = readpe_context_get_section_stats(ctx);
+  for (size_t i = 0; i < ctx->nt_header->file.number_of_sections; ++i) {
+    const pe_image_section_header_t* s  = &ctx->sections[i];
+    const readpe_section_stats_t*    st = &stats[i];
+    printfln("%-8.*s  %10"PRIu64"  %7.4f  %6.2f%%  %14.2f",
+        PE_IMAGE_SECTION_NAME_SIZE, s->name, st->length,
+        st->entropy, st->zero_ratio*100, st->chi_square);
+  }
+
+  readpe_output_end_group_(out);
+}
+
+typedef struct readpe_output_strings_t {
+  readpe_output_t*        out;
+  const readpe_context_t* ctx;
+} readpe_output_strings_t;
+
+static void readpe_output_string_found_(
+    void* udata, const readpe_string_t* str) {
+  readpe_output_strings_t* st  = udata;
+  readpe_output_t*         out = st->out;
+
+  const pe_image_section_header_t* s = &st->ctx->sections[str->section];
+  const size_t name_len =
+      strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE);
+
+  readpe_output_indent_(out);
+  readpe_output_put_hex(out, str->rva, 8);
+  readpe_output_put(out, "  ", 2);
+  readpe_output_put(out, (const char*) s->name, name_len);
+  readpe_output_fill(out, ' ', PE_IMAGE_SECTION_NAME_SIZE - name_len + 2);
+
+  if (str->encoding == READPE_STRING_UTF16LE) {
+    readpe_output_put(out, "W  ", 3);
+    readpe_output_put_narrow(out, str->data, str->length);
+  } else {
+    readpe_output_put(out, "A  ", 3);
+    readpe_output_put(out, (const char*) str->data, str->length);
+  }
+
+  switch (str->tag) {
+  case READPE_STRING_UNTAGGED:
+    break;
+  case READPE_STRING_IMPORT_NAME:
+    readpe_output_put(out, "  (import)", 10);
+    break;
+  case READPE_STRING_EXPORT_NAME:
+    readpe_output_put(out, "  (export)", 10);
+    break;
+  case READPE_STRING_DLL_NAME:
+    readpe_output_put(out, "  (dll)", 7);
+    break;
+  }
+  readpe_output_putc(out, '\n');
+}
+
+readpe_error_t readpe_output_strings(
+    readpe_output_t*                out,
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts) {
+  assert(out  != NULL);
+  assert(ctx  != NULL);
+  assert(opts != NULL);
+
+  switch (out->format) {
+  case READPE_OUTPUT_FORMAT_TEXT:
+    break;
+  case READPE_OUTPUT_FORMAT_JSON:
+  case READPE_OUTPUT_FORMAT_NDJSON:
+    return readpe_output_json_strings(out, ctx, opts);
+  case READPE_OUTPUT_FORMAT_RECORD:
+    return readpe_output_record_strings(out, ctx, opts);
+  }
+
+  readpe_output_strings_t st = { .out = out, .ctx = ctx, };
+
+  /* the buffer is flushed as it grows, so strings are streamed */
+  readpe_output_begin_group_(out, "strings");
+  const readpe_error_t err = readpe_context_extract_strings(
+      ctx, opts, readpe_output_string_found_, &st);
+  readpe_output_end_group_(out);
+  return err;
+}
+
+typedef struct readpe_output_signatures_t {
+  readpe_output_t*           out;
+  const readpe_context_t*    ctx;
+  const readpe_signatures_t* sigs;
+} readpe_output_signatures_t;
+
+static void readpe_output_signature_found_(
+    void* udata, const readpe_signature_match_t* m) {
+  readpe_output_signatures_t* st  = udata;
+  readpe_output_t*            out = st->out;
+
+  readpe_output_indent_(out);
+  if (m->rva != UINTMAX_MAX) {
+    readpe_output_put_hex(out, m->rva, 8);
+  } else {
+    readpe_output_fill(out, '-', 8);
+  }
+  readpe_output_put(out, "  ", 2);
+
+  size_t name_len = 0;
+  if (m->section != READPE_SIGNATURE_NO_SECTION) {
+    const pe_image_section_header_t* s = &st->ctx->sections[m->section];
+    name_len = strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE);
+    readpe_output_put(out, (const char*) s->name, name_len);
+  }
+  readpe_output_fill(out, ' ', PE_IMAGE_SECTION_NAME_SIZE - name_len + 2);
+
+  if (m->offset != UINTMAX_MAX) {
+    readpe_output_put_hex(out, m->offset, 8);
+  } else {
+    readpe_output_fill(out, '-', 8);
+  }
+  readpe_output_put(out, "  ", 2);
+
+  size_t      len;
+  const char* name = readpe_signatures_get_name(st->sigs, m->signature, &len);
+  readpe_output_put(out, name, len);
+  readpe_output_putc(out, '\n');
+}
+
+readpe_error_t readpe_output_signatures(
+    readpe_output_t*           out,
+    const readpe_context_t*    ctx,
+    const readpe_signatures_t* sigs,
+    readpe_signature_layout_t  layout) {
+  assert(out  != NULL);
+  assert(ctx  != NULL);
+  assert(sigs != NULL);
+
+  switch (out->format) {
+  case READPE_OUTPUT_FORMAT_TEXT:
+    break;
+  case READPE_OUTPUT_FORMAT_JSON:
+  case READPE_OUTPUT_FORMAT_NDJSON:
+    return readpe_output_json_signatures(out, ctx, sigs, layout);
+  case READPE_OUTPUT_FORMAT_RECORD:
+    return readpe_output_record_signatures(out, ctx, sigs, layout);
+  }
+
+  readpe_output_signatures_t st = {
+    .out  = out,
+    .ctx  = ctx,
+    .sigs = sigs,
+  };
+
+  readpe_output_begin_group_(out, "signatures");
+  printfln("%-8s  %-8s  %-8s  %s", "rva", "section", "offset", "name");
+  const readpe_error_t err = readpe_context_scan_signatures(
+      ctx, sigs, layout, readpe_output_signature_found_, &st);
+  readpe_output_end_group_(out);
+  return err;
+}
+
+void readpe_output_export_lookup(
+    readpe_output_t* out, const readpe_context_t* ctx, const char* query) {
+  assert(out   != NULL);
+  assert(ctx   != NULL);
+  assert(query != NULL);
+
+  readpe_export_t exp;
+
+  bool found;
+  if (query[0] == '@') {
+    char* end;
+    const unsigned long ordinal = strtoul(query+1, &end, 0);
+    found = *end == 0 && ordinal <= UINT32_MAX &&
+        readpe_context_find_export_by_ordinal(ctx, ordinal, &exp);
+  } else {
+    found = readpe_context_find_export_by_name(ctx, query, &exp);
+  }
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_export_lookup(out, query, found? &exp: NULL),
+      (void) 0);
+
+  readpe_output_begin_group_(out, "export lookup");
+
+  if (found) {
+    readpe_output_export_(out, &exp, 0, exp.ordinal);
+  } else {
+    printfln("%s: not found", query);
+  }
+
+  readpe_output_end_group_(out);
+}
+
+readpe_error_t readpe_output_index_query(
+    readpe_output_t*      out,
+    const readpe_index_t* idx,
+    const char*           query,
+    size_t                begin,
+    size_t                end,
+    bool                  batch) {
+  assert(out   != NULL);
+  assert(idx   != NULL);
+  assert(query != NULL);
+
+  switch (out->format) {
+  case READPE_OUTPUT_FORMAT_TEXT:
+    break;
+  case READPE_OUTPUT_FORMAT_JSON:
+  case READPE_OUTPUT_FORMAT_NDJSON:
+    return readpe_output_json_index_query(
+        out, idx, query, begin, end, batch);
+  case READPE_OUTPUT_FORMAT_RECORD:
+    assert(false);
+    return READPE_ERROR_INVALID_INDEX;
+  }
+
+  if (batch) {
+    readpe_output_put(out, "==== ", 5);
+    readpe_output_put(out, query, strlen(query));
+    readpe_output_putc(out, '\n');
+  }
+  for (size_t i = begin; i < end; ++i) {
+    readpe_index_symbol_t sym;
+    if (!readpe_index_get_symbol(idx, i, &sym)) {
+      return READPE_ERROR_INVALID_INDEX;
+    }
+    readpe_output_put(out, sym.name, sym.name_length);
+    readpe_output_printf(out, " (%s, %zu files)\n",
+        sym.kind == READPE_INDEX_IMPORT? "import": "export",
+        sym.files_length);
+
+    ++out->indent;
+    for (size_t j = 0; j < sym.files_length; ++j) {
+      size_t      len;
+      const char* path = readpe_index_get_path(idx, sym.files[j], &len);
+      if (path == NULL) {
+        --out->indent;
+        return READPE_ERROR_INVALID_INDEX;
+      }
+      readpe_output_indent_(out);
+      readpe_output_put(out, path, len);
+      readpe_output_putc(out, '\n');
+    }
+    --out->indent;
+  }
+  return READPE_OK;
+}
+
+void readpe_output_bindings(
+    readpe_output_t* out, const readpe_modules_t* mods, size_t index) {
+  assert(out  != NULL);
+  assert(mods != NULL);
+
+  READPE_OUTPUT_DISPATCH_(
+      readpe_output_json_bindings(out, mods, index),
+      readpe_output_record_bindings(out, mods, index));
+
+  const readpe_context_t*        ctx = readpe_modules_get_context(mods, index);
+  const readpe_import_entries_t* e   = &ctx->import_entries;
+
+  size_t                  n;
+  const readpe_binding_t* b = readpe_modules_get_bindings(mods, index, &n);
+  assert(n == e->length);
+
+  readpe_output_begin_group_(out, "bindings");
+  for (size_t i = 0; i < n; ++i) {
+    size_t      dll_len = 0;
+    const char* dll     = readpe_context_resolve_string(
+        ctx, ctx->imports[e->dll[i]].name, &dll_len);
+
+    readpe_output_indent_(out);
+    if (dll != NULL) readpe_output_put(out, dll, dll_len);
+    readpe_output_putc(out, '!');
+    if (e->by_ordinal[i]) {
+      readpe_output_printf(out, "#%"PRIu16, e->hint[i]);
+    } else {
+      size_t      fn_len = 0;
+      const char* fn = readpe_context_resolve_string(ctx, e->name[i], &fn_len);
+      if (fn != NULL) readpe_output_put(out, fn, fn_len);
+    }
+
+    if (b[i].module != READPE_MODULES_NOT_FOUND) {
+      const char* path = readpe_modules_get_path(mods, b[i].module);
+      readpe_output_put(out, " -> ", 4);
+      readpe_output_put(out, path, strlen(path));
+    }
+    if (b[i].status == READPE_BINDING_RESOLVED) {
+      readpe_output_putc(out, '!');
+      if (b[i].exp.name != NULL) {
+        readpe_output_put(out, b[i].exp.name, b[i].exp.name_length);
+      } else {
+        readpe_output_printf(out, "#%"PRIu32, b[i].exp.ordinal);
+      }
+    } else {
+      readpe_output_printf(out, " (%s",
+          readpe_binding_status_stringify(b[i].status));
+    }
+    if (b[i].forwards > 0) {
+      readpe_output_printf(out, "%s%zu forwards",
+          b[i].status == READPE_BINDING_RESOLVED? " (": ", ", b[i].forwards);
+    }
+    if (b[i].status != READPE_BINDING_RESOLVED || b[i].forwards > 0) {
+      readpe_output_putc(out, ')');
+    }
+    readpe_output_putc(out, '\n');
+  }
+  readpe_output_end_group_(out);
+}
+
+readpe_error_t readpe_output_load_order(
+    readpe_output_t* out, const readpe_modules_t* mods, size_t index) {
+  assert(out  != NULL);
+  assert(mods != NULL);
+
+  switch (out->format) {
+  case READPE_OUTPUT_FORMAT_TEXT:
+    break;
+  case READPE_OUTPUT_FORMAT_JSON:
+  case READPE_OUTPUT_FORMAT_NDJSON:
+    return readpe_output_json_load_order(out, mods, index);
+  case READPE_OUTPUT_FORMAT_RECORD:
+    return readpe_output_record_load_order(out, mods, index);
+  }
+
+  uint32_t* order = calloc(readpe_modules_get_length(mods), sizeof(*order));
+  if (order == NULL) return READPE_ERROR_NO_MEMORY;
+
+  size_t n;
+  const readpe_error_t err =
+      readpe_modules_get_load_order(mods, index, order, &n);
+  if (err == READPE_OK) {
+    readpe_output_begin_group_(out, "load order");
+    for (size_t i = 0; i < n; ++i) {
+      const char* path = readpe_modules_get_path(mods, order[i]);
+      readpe_output_indent_(out);
+      readpe_output_put(out, path, strlen(path));
+      readpe_output_putc(out, '\n');
+    }
+    readpe_output_end_group_(out);
+  }
+  free(order);
+  return err;
 }
@@ -3,48 +3,225 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "pe.h"
 
+#include "lib/context.h"
+
+typedef enum readpe_output_format_t {
+  READPE_OUTPUT_FORMAT_TEXT,
+  READPE_OUTPUT_FORMAT_JSON,
+  READPE_OUTPUT_FORMAT_NDJSON,  /* one compact JSON record per line */
+  READPE_OUTPUT_FORMAT_RECORD,  /* binary records defined in lib/readpe.h */
+} readpe_output_format_t;
+
+typedef struct readpe_output_t {
+  FILE*  fp;  /* NULLABLE: keeps everything in the buffer if NULL */
+  size_t indent;
+
+  readpe_output_format_t format;
+  bool continued;  /* JSON: a value precedes in the current container */
+  bool keyed;      /* JSON: a member name is waiting for its value */
+
+  char*  buf;
+  size_t length;
+  size_t reserved;
+  size_t flushed;  /* bytes already written to fp */
+  bool   broken;   /* some output was dropped by allocation failure */
+
+  /* Called when the buffer kept without fp would grow beyond spill_limit,
+   * to set fp so that the rest is written through. */
+  void (*spill)(struct readpe_output_t* out);  /* NULLABLE */
+  void*  spill_udata;
+  size_t spill_limit;
+} readpe_output_t;
+
+void
+readpe_output_initialize(
+    readpe_output_t*       out,
+    FILE*                  fp,  /* NULLABLE */
+    readpe_output_format_t format
+);
+
+void
+readpe_output_deinitialize(
+    readpe_output_t* out
+);
+    /* Flushes the rest of the buffer before releasing it. */
+
+void
+readpe_output_flush(
+    readpe_output_t* out
+);
+
+void
+readpe_output_printf(
+    readpe_output_t* out,
+    const char*      fmt,
+    ...
+) __attribute__((format(printf, 2, 3)));
+
+bool
+readpe_output_parse_format(
+    const char*             name,
+    readpe_output_format_t* format
+);
+
+const char*
+readpe_output_get_separator(
+    readpe_output_format_t format,
+    bool                   batch
+);
+    /* Returns what goes between results of two files, or NULL. */
+
+void
+readpe_output_begin_file(
+    readpe_output_t* out,
+    const char*      path,
+    bool             batch
+);
+
+void
+readpe_output_end_file(
+    readpe_output_t* out,
+    readpe_error_t   err
+);
+
+void
+readpe_output_begin_batch(
+    readpe_output_t* out,
+    bool             batch
+);
+
+void
+readpe_output_end_batch(
+    readpe_output_t* out,
+    bool             batch
+);
+
 void
 readpe_output_dos_header(
+    readpe_output_t*       out,
     const pe_dos_header_t* dos_header
 );
 
 void
 readpe_output_dos_stub(
-    const uint8_t* body,
-    size_t         len
+    readpe_output_t* out,
+    const uint8_t*   body,
+    size_t           len
 );
 
 void
 readpe_output_nt_header(
+    readpe_output_t*      out,
     const pe_nt_header_t* header
 );
 
 void
 readpe_output_section_table(
+    readpe_output_t*                 out,
     const pe_image_section_header_t* table,
     size_t                           rows
 );
 
+void
+readpe_output_section_stats(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
 void
 readpe_output_export_table(
-    const uint8_t*                     img,
-    const pe_image_export_directory_t* table,
-        /* NULLABLE, a pointer to an entity in the img */
-    size_t                             section_length
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_export_lookup(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx,
+    const char*             query  /* a name, or an ordinal prefixed by '@' */
 );
 
 void
 readpe_output_import_table(
-    const uint8_t*                      img,
-    const pe_image_import_descriptor_t* table,  /* NULLABLE */
-    bool                                _64bit
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
 );
 
 void
 readpe_output_relocation_table(
-    const uint8_t* table,  /* NULLABLE */
-    size_t         length
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_relocation_density(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_hashes(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_authenticode(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_fingerprints(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+readpe_error_t
+readpe_output_strings(
+    readpe_output_t*                out,
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts
+);
+    /* Extracts strings of the sections, printing each as soon as found. */
+
+readpe_error_t
+readpe_output_signatures(
+    readpe_output_t*           out,
+    const readpe_context_t*    ctx,
+    const readpe_signatures_t* sigs,
+    readpe_signature_layout_t  layout
+);
+    /* Scans the signatures, printing each match as soon as found. */
+
+readpe_error_t
+readpe_output_index_query(
+    readpe_output_t*      out,
+    const readpe_index_t* idx,
+    const char*           query,
+    size_t                begin,  /* range of symbols found by the query */
+    size_t                end,
+    bool                  batch   /* more than one query is given */
+);
+    /* Prints the symbols with paths of the files. Returns
+     * READPE_ERROR_INVALID_INDEX if an entry is broken. */
+
+void
+readpe_output_bindings(
+    readpe_output_t*        out,
+    const readpe_modules_t* mods,
+    size_t                  index
+);
+    /* Prints where each import of the module is bound in the linked set. */
+
+readpe_error_t
+readpe_output_load_order(
+    readpe_output_t*        out,
+    const readpe_modules_t* mods,
+    size_t                  index
 );
+    /* Prints paths of the dependency closure of the module in load order. */
@@ -0,0 +1,135 @@
+#pragma once
+
+/* Formatting primitives writing straight into the buffer of
+ * readpe_output_t, shared by the text and structured printers. */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./output.h"
+
+bool
+readpe_output_grow(
+    readpe_output_t* out,
+    size_t           n
+);
+    /* Makes room for n bytes, flushing first if possible. Returns false
+     * and marks the output broken on allocation failure. */
+
+#define READPE_OUTPUT_HEX16_(h)  \
+  h"0" h"1" h"2" h"3" h"4" h"5" h"6" h"7"  \
+  h"8" h"9" h"A" h"B" h"C" h"D" h"E" h"F"
+static const char readpe_output_hex_table[] =
+  READPE_OUTPUT_HEX16_("0") READPE_OUTPUT_HEX16_("1")
+  READPE_OUTPUT_HEX16_("2") READPE_OUTPUT_HEX16_("3")
+  READPE_OUTPUT_HEX16_("4") READPE_OUTPUT_HEX16_("5")
+  READPE_OUTPUT_HEX16_("6") READPE_OUTPUT_HEX16_("7")
+  READPE_OUTPUT_HEX16_("8") READPE_OUTPUT_HEX16_("9")
+  READPE_OUTPUT_HEX16_("A") READPE_OUTPUT_HEX16_("B")
+  READPE_OUTPUT_HEX16_("C") READPE_OUTPUT_HEX16_("D")
+  READPE_OUTPUT_HEX16_("E") READPE_OUTPUT_HEX16_("F");
+#undef READPE_OUTPUT_HEX16_
+
+#define READPE_OUTPUT_DEC10_(d)  \
+  d"0" d"1" d"2" d"3" d"4" d"5" d"6" d"7" d"8" d"9"
+static const char readpe_output_dec_table[] =
+  READPE_OUTPUT_DEC10_("0") READPE_OUTPUT_DEC10_("1")
+  READPE_OUTPUT_DEC10_("2") READPE_OUTPUT_DEC10_("3")
+  READPE_OUTPUT_DEC10_("4") READPE_OUTPUT_DEC10_("5")
+  READPE_OUTPUT_DEC10_("6") READPE_OUTPUT_DEC10_("7")
+  READPE_OUTPUT_DEC10_("8") READPE_OUTPUT_DEC10_("9");
+#undef READPE_OUTPUT_DEC10_
+
+static inline bool readpe_output_reserve(readpe_output_t* out, size_t n) {
+  return out->length + n <= out->reserved || readpe_output_grow(out, n);
+}
+
+static inline void readpe_output_put(
+    readpe_output_t* out, const char* str, size_t len) {
+  if (!readpe_output_reserve(out, len)) return;
+  memcpy(out->buf + out->length, str, len);
+  out->length += len;
+}
+static inline void readpe_output_putc(readpe_output_t* out, char c) {
+  if (!readpe_output_reserve(out, 1)) return;
+  out->buf[out->length++] = c;
+}
+static inline void readpe_output_fill(
+    readpe_output_t* out, char c, size_t n) {
+  if (!readpe_output_reserve(out, n)) return;
+  memset(out->buf + out->length, c, n);
+  out->length += n;
+}
+
+/* same as "%0*"PRIX64 with the width of digits */
+static inline void readpe_output_put_hex(
+    readpe_output_t* out, uint64_t v, size_t digits) {
+  size_t need = 1;
+  for (uint64_t x = v >> 4; x > 0; x >>= 4) ++need;
+  if (need > digits) digits = need;
+
+  if (!readpe_output_reserve(out, digits)) return;
+
+  char* p = out->buf + out->length + digits;
+  size_t i = digits;
+  for (; i >= 2; i -= 2, v >>= 8) {
+    p -= 2;
+    memcpy(p, &readpe_output_hex_table[(v & 0xFF)*2], 2);
+  }
+  if (i > 0) *(--p) = readpe_output_hex_table[(v & 0xF)*2+1];
+  out->length += digits;
+}
+
+/* writes bytes in lower case hex, as digests are usually shown */
+static inline void readpe_output_put_digest(
+    readpe_output_t* out, const uint8_t* bytes, size_t len) {
+  if (!readpe_output_reserve(out, len*2)) return;
+
+  static const char digits[] = "0123456789abcdef";
+  char* p = out->buf + out->length;
+  for (size_t i = 0; i < len; ++i) {
+    *(p++) = digits[bytes[i] >> 4];
+    *(p++) = digits[bytes[i] & 0xF];
+  }
+  out->length += len*2;
+}
+
+/* writes the lower bytes of 16-bit units, which hold ASCII characters */
+static inline void readpe_output_put_narrow(
+    readpe_output_t* out, const uint8_t* units, size_t len) {
+  if (!readpe_output_reserve(out, len)) return;
+
+  char* p = out->buf + out->length;
+  for (size_t i = 0; i < len; ++i) p[i] = (char) units[i*2];
+  out->length += len;
+}
+
+/* same as "%*"PRIu64, left-aligned if the width is negative */
+static inline void readpe_output_put_dec(
+    readpe_output_t* out, uint64_t v, bool negative, int width) {
+  char  buf[24];
+  char* end = buf + sizeof(buf);
+  char* p   = end;
+  for (; v >= 100; v /= 100) {
+    p -= 2;
+    memcpy(p, &readpe_output_dec_table[(v % 100)*2], 2);
+  }
+  if (v >= 10) {
+    p -= 2;
+    memcpy(p, &readpe_output_dec_table[v*2], 2);
+  } else {
+    *(--p) = (char) ('0' + v);
+  }
+  if (negative) *(--p) = '-';
+
+  const size_t len = (size_t) (end - p);
+  const size_t w   = (size_t) (width < 0? -width: width);
+  const size_t pad = w > len? w - len: 0;
+
+  if (width > 0) readpe_output_fill(out, ' ', pad);
+  readpe_output_put(out, p, len);
+  if (width < 0) readpe_output_fill(out, ' ', pad);
+}
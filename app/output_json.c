@@ -0,0 +1,934 @@
+#include "./output_json.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pe.h"
+
+#include "./output.h"
+#include "./output_buffer.h"
+
+static inline void readpe_output_json_newline_(readpe_output_t* out) {
+  if (out->format != READPE_OUTPUT_FORMAT_JSON) return;
+  readpe_output_putc(out, '\n');
+  readpe_output_fill(out, ' ', out->indent*2);
+}
+
+static void readpe_output_json_begin_value_(readpe_output_t* out) {
+  if (out->keyed) {
+    out->keyed = false;
+    return;
+  }
+  if (out->continued) readpe_output_putc(out, ',');
+  if (out->indent > 0) readpe_output_json_newline_(out);
+}
+
+static void readpe_output_json_open_(readpe_output_t* out, char c) {
+  readpe_output_json_begin_value_(out);
+  readpe_output_putc(out, c);
+  ++out->indent;
+  out->continued = false;
+}
+
+static void readpe_output_json_close_(readpe_output_t* out, char c) {
+  assert(out->indent > 0);
+
+  --out->indent;
+  if (out->continued) readpe_output_json_newline_(out);
+  readpe_output_putc(out, c);
+  out->continued = true;
+}
+
+/* Returns the length of the valid UTF-8 sequence beginning at str, or 0 if
+ * it is not. Overlong forms, surrogates and code points beyond U+10FFFF are
+ * invalid. */
+static size_t readpe_output_json_utf8_length_(const uint8_t* str, size_t len) {
+  assert(len > 0);
+
+  const uint8_t c = str[0];
+  size_t   n;
+  uint8_t  lo = 0x80, hi = 0xBF;  /* range of the second byte */
+  if (c < 0x80) {
+    return 1;
+  } else if (c >= 0xC2 && c <= 0xDF) {
+    n = 2;
+  } else if (c >= 0xE0 && c <= 0xEF) {
+    n = 3;
+    if (c == 0xE0) lo = 0xA0;
+    if (c == 0xED) hi = 0x9F;
+  } else if (c >= 0xF0 && c <= 0xF4) {
+    n = 4;
+    if (c == 0xF0) lo = 0x90;
+    if (c == 0xF4) hi = 0x8F;
+  } else {
+    return 0;
+  }
+  if (len < n) return 0;
+  if (str[1] < lo || str[1] > hi) return 0;
+  for (size_t i = 2; i < n; ++i) {
+    if ((str[i] & 0xC0) != 0x80) return 0;
+  }
+  return n;
+}
+
+static void readpe_output_json_escape_chars_(
+    readpe_output_t* out, const char* str, size_t len) {
+  /* valid UTF-8 is passed through, and each invalid byte becomes U+FFFD */
+  const uint8_t* u = (const uint8_t*) str;
+
+  size_t begin = 0;
+  for (size_t i = 0; i < len;) {
+    const uint8_t c = u[i];
+    if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+      ++i;
+      continue;
+    }
+    if (c >= 0x80) {
+      const size_t n = readpe_output_json_utf8_length_(u + i, len - i);
+      if (n > 0) {
+        i += n;
+        continue;
+      }
+    }
+
+    readpe_output_put(out, str + begin, i - begin);
+    begin = ++i;
+
+    if (c == '"' || c == '\\') {
+      readpe_output_putc(out, '\\');
+      readpe_output_putc(out, (char) c);
+    } else if (c >= 0x80) {
+      readpe_output_put(out, "\\ufffd", 6);
+    } else {
+      readpe_output_put(out, "\\u00", 4);
+      readpe_output_put(out, &readpe_output_hex_table[c*2], 2);
+    }
+  }
+  readpe_output_put(out, str + begin, len - begin);
+}
+
+static void readpe_output_json_escape_(
+    readpe_output_t* out, const char* str, size_t len) {
+  readpe_output_putc(out, '"');
+  readpe_output_json_escape_chars_(out, str, len);
+  readpe_output_putc(out, '"');
+}
+
+static void readpe_output_json_key_(readpe_output_t* out, const char* key) {
+  readpe_output_json_begin_value_(out);
+  readpe_output_json_escape_(out, key, strlen(key));
+  readpe_output_putc(out, ':');
+  if (out->format == READPE_OUTPUT_FORMAT_JSON) readpe_output_putc(out, ' ');
+  out->keyed = true;
+}
+
+static void readpe_output_json_uint_(readpe_output_t* out, uint64_t v) {
+  readpe_output_json_begin_value_(out);
+  readpe_output_put_dec(out, v, false, 0);
+  out->continued = true;
+}
+
+static void readpe_output_json_string_(
+    readpe_output_t* out, const char* str, size_t len) {
+  readpe_output_json_begin_value_(out);
+  if (str != NULL) {
+    readpe_output_json_escape_(out, str, len);
+  } else {
+    readpe_output_put(out, "null", 4);
+  }
+  out->continued = true;
+}
+
+static void readpe_output_json_double_(readpe_output_t* out, double v) {
+  readpe_output_json_begin_value_(out);
+  readpe_output_printf(out, "%.6f", v);
+  out->continued = true;
+}
+
+static void readpe_output_json_null_(readpe_output_t* out) {
+  readpe_output_json_string_(out, NULL, 0);
+}
+
+static void readpe_output_json_bool_(readpe_output_t* out, bool v) {
+  readpe_output_json_begin_value_(out);
+  if (v) {
+    readpe_output_put(out, "true", 4);
+  } else {
+    readpe_output_put(out, "false", 5);
+  }
+  out->continued = true;
+}
+
+#define open_(key, c) do {  \
+  readpe_output_json_key_(out, key);  \
+  readpe_output_json_open_(out, c);  \
+} while (0)
+
+#define uint_(key, v) do {  \
+  readpe_output_json_key_(out, key);  \
+  readpe_output_json_uint_(out, v);  \
+} while (0)
+
+#define double_(key, v) do {  \
+  readpe_output_json_key_(out, key);  \
+  readpe_output_json_double_(out, v);  \
+} while (0)
+
+#define string_(key, str, len) do {  \
+  readpe_output_json_key_(out, key);  \
+  readpe_output_json_string_(out, str, len);  \
+} while (0)
+
+#define bool_(key, v) do {  \
+  readpe_output_json_key_(out, key);  \
+  readpe_output_json_bool_(out, v);  \
+} while (0)
+
+#define null_(key) do {  \
+  readpe_output_json_key_(out, key);  \
+  readpe_output_json_null_(out);  \
+} while (0)
+
+static void readpe_output_json_export_(
+    readpe_output_t* out, const readpe_export_t* exp) {
+  readpe_output_json_open_(out, '{');
+
+  uint_("ordinal", exp->ordinal);
+  uint_("rva",     exp->rva);
+  string_("name", exp->name, exp->name_length);
+  if (exp->forwarded) {
+    string_("forwarder",
+        exp->forwarder != NULL? exp->forwarder: "", exp->forwarder_length);
+  } else {
+    null_("forwarder");
+  }
+
+  readpe_output_json_close_(out, '}');
+}
+
+static void readpe_output_json_data_directories_(
+    readpe_output_t* out, const pe_image_data_directory_t* dirs, size_t len) {
+  open_("data_directories", '[');
+  for (size_t i = 0; i < len; ++i) {
+    readpe_output_json_open_(out, '{');
+    uint_("virtual_address", dirs[i].virtual_address);
+    uint_("size",            dirs[i].size);
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+}
+
+/* both of PE32 and PE32+ headers have the fields in the same names */
+#define READPE_OUTPUT_JSON_OPTIONAL_HEADER_(h) do {  \
+  uint_("magic",                      h->magic);  \
+  uint_("major_linker_version",       h->major_linker_version);  \
+  uint_("minor_linker_version",       h->minor_linker_version);  \
+  uint_("size_of_code",               h->size_of_code);  \
+  uint_("size_of_initialized_data",   h->size_of_initialized_data);  \
+  uint_("size_of_uninitialized_data", h->size_of_uninitialized_data);  \
+  uint_("address_of_entrypoint",      h->address_of_entrypoint);  \
+  uint_("base_of_code",               h->base_of_code);  \
+  uint_("image_base",                 h->image_base);  \
+  uint_("section_alignment",          h->section_alignment);  \
+  uint_("file_alignment",             h->file_alignment);  \
+  uint_("major_operating_system_version",  \
+      h->major_operating_system_version);  \
+  uint_("minor_operating_system_version",  \
+      h->minor_operating_system_version);  \
+  uint_("major_image_version",        h->major_image_version);  \
+  uint_("minor_image_version",        h->minor_image_version);  \
+  uint_("major_subsystem_version",    h->major_subsystem_version);  \
+  uint_("minor_subsystem_version",    h->minor_subsystem_version);  \
+  uint_("size_of_image",              h->size_of_image);  \
+  uint_("size_of_headers",            h->size_of_headers);  \
+  uint_("checksum",                   h->checksum);  \
+  uint_("subsystem",                  h->subsystem);  \
+  uint_("dll_characteristics",        h->dll_characteristics);  \
+  uint_("size_of_stack_reserve",      h->size_of_stack_reserve);  \
+  uint_("size_of_stack_commit",       h->size_of_stack_commit);  \
+  uint_("size_of_heap_reserve",       h->size_of_heap_reserve);  \
+  uint_("size_of_heap_commit",        h->size_of_heap_commit);  \
+  uint_("loader_flags",               h->loader_flags);  \
+  uint_("number_of_rva_and_sizes",    h->number_of_rva_and_sizes);  \
+  readpe_output_json_data_directories_(  \
+      out, h->data_directory, h->number_of_rva_and_sizes);  \
+} while (0)
+
+void readpe_output_json_begin_file(
+    readpe_output_t* out, const char* path, bool batch) {
+  assert(out  != NULL);
+  assert(path != NULL);
+
+  /* records of a JSON batch are the elements of an array */
+  out->indent    = batch && out->format == READPE_OUTPUT_FORMAT_JSON;
+  out->continued = false;
+  out->keyed     = false;
+
+  readpe_output_json_open_(out, '{');
+  string_("path", path, strlen(path));
+}
+
+void readpe_output_json_end_file(readpe_output_t* out, readpe_error_t err) {
+  assert(out != NULL);
+
+  if (err != READPE_OK) {
+    const char* msg = readpe_error_stringify(err);
+    string_("error", msg, strlen(msg));
+  }
+  readpe_output_json_close_(out, '}');
+
+  if (out->indent == 0) readpe_output_putc(out, '\n');
+  out->indent    = 0;
+  out->continued = false;
+}
+
+void readpe_output_json_dos_header(
+    readpe_output_t* out, const pe_dos_header_t* dos_header) {
+  assert(out        != NULL);
+  assert(dos_header != NULL);
+
+  open_("dos_header", '{');
+  uint_("e_magic",  dos_header->e_magic);
+  uint_("e_lfanew", (uint32_t) dos_header->e_lfanew);
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_dos_stub(
+    readpe_output_t* out, const uint8_t* body, size_t len) {
+  assert(out  != NULL);
+  assert(body != NULL || len == 0);
+
+  readpe_output_json_key_(out, "dos_stub");
+  readpe_output_json_begin_value_(out);
+
+  readpe_output_putc(out, '"');
+  for (size_t i = 0; i < len; ++i) {
+    readpe_output_put(out, &readpe_output_hex_table[body[i]*2], 2);
+  }
+  readpe_output_putc(out, '"');
+  out->continued = true;
+}
+
+void readpe_output_json_nt_header(
+    readpe_output_t* out, const pe_nt_header_t* header) {
+  assert(out    != NULL);
+  assert(header != NULL);
+
+  open_("nt_header", '{');
+
+  uint_("signature", header->signature);
+
+  const pe_image_file_header_t* file = &header->file;
+  open_("file_header", '{');
+  uint_("machine",                 file->machine);
+  uint_("number_of_sections",      file->number_of_sections);
+  uint_("time_date_stamp",         file->time_date_stamp);
+  uint_("pointer_to_symbol_table", file->pointer_to_symbol_table);
+  uint_("number_of_symbols",       file->number_of_symbols);
+  uint_("size_of_optional_header", file->size_of_optional_header);
+  uint_("characteristics",         file->characteristics);
+  readpe_output_json_close_(out, '}');
+
+  switch (header->file.machine) {
+  case PE_IMAGE_FILE_MACHINE_I386:
+    {
+      const pe32_image_optional_header_t* h = &header->optional._32bit;
+      open_("optional_header", '{');
+      uint_("base_of_data", h->base_of_data);
+      READPE_OUTPUT_JSON_OPTIONAL_HEADER_(h);
+      readpe_output_json_close_(out, '}');
+    }
+    break;
+  case PE_IMAGE_FILE_MACHINE_AMD64:
+  case PE_IMAGE_FILE_MACHINE_IA64:
+    {
+      const pe64_image_optional_header_t* h = &header->optional._64bit;
+      open_("optional_header", '{');
+      READPE_OUTPUT_JSON_OPTIONAL_HEADER_(h);
+      readpe_output_json_close_(out, '}');
+    }
+    break;
+  default:
+    null_("optional_header");
+    break;
+  }
+
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_section_table(
+    readpe_output_t*                 out,
+    const pe_image_section_header_t* table,
+    size_t                           rows) {
+  assert(out   != NULL);
+  assert(table != NULL || rows == 0);
+
+  open_("section_table", '[');
+  for (size_t i = 0; i < rows; ++i) {
+    const pe_image_section_header_t* s = &table[i];
+
+    readpe_output_json_open_(out, '{');
+    string_("name", (const char*) s->name,
+        strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE));
+    uint_("virtual_size",           s->misc.virtual_size);
+    uint_("virtual_address",        s->virtual_address);
+    uint_("size_of_raw_data",       s->size_of_raw_data);
+    uint_("pointer_to_raw_data",    s->pointer_to_raw_data);
+    uint_("pointer_to_relocations", s->pointer_to_relocations);
+    uint_("pointer_to_linenumbers", s->pointer_to_linenumbers);
+    uint_("number_of_relocations",  s->number_of_relocations);
+    uint_("number_of_linenumbers",  s->number_of_linenumbers);
+    uint_("characteristics",        s->characteristics);
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+}
+
+void readpe_output_json_export_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const pe_image_export_directory_t* table = ctx->export_;
+  if (table == NULL) {
+    null_("export_table");
+    return;
+  }
+
+  open_("export_table", '{');
+
+  size_t      name_len = 0;
+  const char* name = readpe_context_resolve_string(ctx, table->name, &name_len);
+  string_("name", name, name_len);
+  uint_("time_date_stamp", table->time_date_stamp);
+  uint_("base",            table->base);
+
+  open_("exports", '[');
+  for (size_t i = 0; i < table->number_of_functions; ++i) {
+    readpe_export_t exp;
+    readpe_context_get_export(ctx, i, &exp);
+    readpe_output_json_export_(out, &exp);
+  }
+  readpe_output_json_close_(out, ']');
+
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_export_lookup(
+    readpe_output_t* out, const char* query, const readpe_export_t* exp) {
+  assert(out   != NULL);
+  assert(query != NULL);
+
+  open_("export_lookup", '{');
+  string_("query", query, strlen(query));
+  readpe_output_json_key_(out, "result");
+  if (exp != NULL) {
+    readpe_output_json_export_(out, exp);
+  } else {
+    readpe_output_json_null_(out);
+  }
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_import_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  if (ctx->imports == NULL) {
+    null_("import_table");
+    return;
+  }
+
+  const readpe_import_entries_t* e = &ctx->import_entries;
+
+  open_("import_table", '[');
+  const pe_image_import_descriptor_t* itr = ctx->imports;
+  for (size_t i = 0; i < ctx->imports_length; ++i, ++itr) {
+    size_t      name_len = 0;
+    const char* name = readpe_context_resolve_string(ctx, itr->name, &name_len);
+
+    readpe_output_json_open_(out, '{');
+    string_("name", name, name_len);
+    uint_("original_first_thunk", itr->original_first_thunk);
+    uint_("first_thunk",          itr->first_thunk);
+    uint_("forwarder_chain",      itr->forwarder_chain);
+    uint_("time_date_stamp",      itr->time_date_stamp);
+
+    open_("entries", '[');
+    for (size_t j = e->dll_begin[i]; j < e->dll_begin[i+1]; ++j) {
+      readpe_output_json_open_(out, '{');
+      if (e->by_ordinal[j]) {
+        uint_("ordinal", e->hint[j]);
+      } else {
+        size_t      fn_len = 0;
+        const char* fn = readpe_context_resolve_string(ctx, e->name[j], &fn_len);
+        uint_("hint", e->hint[j]);
+        string_("name", fn, fn_len);
+      }
+      uint_("iat", e->iat[j]);
+      readpe_output_json_close_(out, '}');
+    }
+    readpe_output_json_close_(out, ']');
+
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+}
+
+void readpe_output_json_relocation_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  if (ctx->relocations == NULL) {
+    null_("relocation_table");
+    return;
+  }
+
+  const readpe_relocation_entries_t* e = &ctx->relocation_entries;
+
+  open_("relocation_table", '[');
+
+  const uint8_t* itr = ctx->relocations;
+  for (size_t i = 0; i < e->blocks; ++i) {
+    const pe_base_relocation_block_t* block = (typeof(block)) itr;
+
+    const size_t cnt = e->block_begin[i+1] - e->block_begin[i];
+    itr += PE_BASE_RELOCATION_BLOCK_SIZE + cnt*PE_BASE_RELOCATION_ENTRY_SIZE;
+
+    readpe_output_json_open_(out, '{');
+    uint_("virtual_address", block->virtual_address);
+    uint_("size_of_block",   block->size_of_block);
+
+    open_("entries", '[');
+    for (size_t j = e->block_begin[i]; j < e->block_begin[i+1]; ++j) {
+      readpe_output_json_open_(out, '{');
+      uint_("rva",  e->rva[j]);
+      uint_("type", e->type[j]);
+      readpe_output_json_close_(out, '}');
+    }
+    readpe_output_json_close_(out, ']');
+
+    readpe_output_json_close_(out, '}');
+  }
+
+  readpe_output_json_close_(out, ']');
+}
+
+void readpe_output_json_relocation_density(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  size_t          pages;
+  const uint32_t* density = readpe_context_get_relocation_density(ctx, &pages);
+  if (density == NULL) {
+    null_("relocation_density");
+    return;
+  }
+
+  open_("relocation_density", '[');
+  for (size_t i = 0; i < pages; ++i) {
+    if (density[i] == 0) continue;
+    readpe_output_json_open_(out, '{');
+    uint_("rva",    (uint64_t) i*READPE_RELOCATION_PAGE_SIZE);
+    uint_("fixups", density[i]);
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+}
+
+static void readpe_output_json_digest_(
+    readpe_output_t* out, const char* key, const uint8_t* bytes, size_t len) {
+  readpe_output_json_key_(out, key);
+  readpe_output_json_begin_value_(out);
+  readpe_output_putc(out, '"');
+  readpe_output_put_digest(out, bytes, len);
+  readpe_output_putc(out, '"');
+  out->continued = true;
+}
+
+static void readpe_output_json_hash_(
+    readpe_output_t* out, const readpe_hash_t* hash) {
+  readpe_output_json_digest_(out, "md5",    hash->md5,    sizeof(hash->md5));
+  readpe_output_json_digest_(out, "sha1",   hash->sha1,   sizeof(hash->sha1));
+  readpe_output_json_digest_(out, "sha256", hash->sha256, sizeof(hash->sha256));
+}
+
+void readpe_output_json_hashes(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  open_("hashes", '{');
+
+  open_("file", '{');
+  uint_("size", ctx->file_length);
+  readpe_output_json_hash_(out, readpe_context_get_file_hash(ctx));
+  readpe_output_json_close_(out, '}');
+
+  const readpe_hash_t* hashes = readpe_context_get_section_hashes(ctx);
+
+  open_("sections", '[');
+  for (size_t i = 0; i < ctx->nt_header->file.number_of_sections; ++i) {
+    const pe_image_section_header_t* s = &ctx->sections[i];
+
+    readpe_output_json_open_(out, '{');
+    string_("name", (const char*) s->name,
+        strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE));
+    uint_("size", s->size_of_raw_data);
+    readpe_output_json_hash_(out, &hashes[i]);
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_authenticode(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const readpe_hash_t* hash = readpe_context_get_authenticode_hash(ctx);
+
+  open_("authenticode", '{');
+  uint_("checksum", ctx->_64bit?
+      ctx->nt_header->optional._64bit.checksum:
+      ctx->nt_header->optional._32bit.checksum);
+  uint_("computed_checksum", readpe_context_get_checksum(ctx));
+  bool_("signed", readpe_context_is_signed(ctx));
+  readpe_output_json_digest_(out, "sha1",   hash->sha1,   sizeof(hash->sha1));
+  readpe_output_json_digest_(out, "sha256", hash->sha256, sizeof(hash->sha256));
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_fingerprints(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const readpe_fingerprints_t* fp = readpe_context_get_fingerprints(ctx);
+
+  open_("fingerprints", '{');
+  if (fp->imphash_found) {
+    readpe_output_json_digest_(
+        out, "imphash", fp->imphash, sizeof(fp->imphash));
+  } else {
+    null_("imphash");
+  }
+  if (fp->exphash_found) {
+    readpe_output_json_digest_(
+        out, "exphash", fp->exphash, sizeof(fp->exphash));
+  } else {
+    null_("exphash");
+  }
+  if (fp->rich_hash_found) {
+    readpe_output_json_digest_(
+        out, "rich_hash", fp->rich_hash, sizeof(fp->rich_hash));
+  } else {
+    null_("rich_hash");
+  }
+  readpe_output_json_close_(out, '}');
+}
+
+void readpe_output_json_section_stats(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const readpe_section_stats_t* stats = readpe_context_get_section_stats(ctx);
+
+  open_("section_stats", '[');
+  for (size_t i = 0; i < ctx->nt_header->file.number_of_sections; ++i) {
+    const pe_image_section_header_t* s  = &ctx->sections[i];
+    const readpe_section_stats_t*    st = &stats[i];
+
+    readpe_output_json_open_(out, '{');
+    string_("name", (const char*) s->name,
+        strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE));
+    uint_("size", st->length);
+    double_("entropy",    st->entropy);
+    double_("zero_ratio", st->zero_ratio);
+    double_("chi_square", st->chi_square);
+
+    open_("histogram", '[');
+    for (size_t j = 0; j < 256; ++j) {
+      readpe_output_json_uint_(out, st->histogram[j]);
+    }
+    readpe_output_json_close_(out, ']');
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+}
+
+typedef struct readpe_output_json_strings_t {
+  readpe_output_t*        out;
+  const readpe_context_t* ctx;
+} readpe_output_json_strings_t;
+
+static void readpe_output_json_string_value_(
+    readpe_output_t* out, const readpe_string_t* str) {
+  if (str->encoding == READPE_STRING_ASCII) {
+    readpe_output_json_string_(out, (const char*) str->data, str->length);
+    return;
+  }
+
+  readpe_output_json_begin_value_(out);
+  readpe_output_putc(out, '"');
+  for (size_t i = 0; i < str->length;) {
+    char   buf[256];
+    size_t n = str->length - i;
+    if (n > sizeof(buf)) n = sizeof(buf);
+    for (size_t j = 0; j < n; ++j) buf[j] = (char) str->data[(i+j)*2];
+    readpe_output_json_escape_chars_(out, buf, n);
+    i += n;
+  }
+  readpe_output_putc(out, '"');
+  out->continued = true;
+}
+
+static void readpe_output_json_string_found_(
+    void* udata, const readpe_string_t* str) {
+  readpe_output_json_strings_t* st  = udata;
+  readpe_output_t*              out = st->out;
+
+  const pe_image_section_header_t* s = &st->ctx->sections[str->section];
+
+  readpe_output_json_open_(out, '{');
+  string_("section", (const char*) s->name,
+      strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE));
+  uint_("rva", str->rva);
+  if (str->encoding == READPE_STRING_ASCII) {
+    string_("encoding", "ascii", 5);
+  } else {
+    string_("encoding", "utf16le", 7);
+  }
+  switch (str->tag) {
+  case READPE_STRING_UNTAGGED:    null_("tag");                break;
+  case READPE_STRING_IMPORT_NAME: string_("tag", "import", 6); break;
+  case READPE_STRING_EXPORT_NAME: string_("tag", "export", 6); break;
+  case READPE_STRING_DLL_NAME:    string_("tag", "dll", 3);    break;
+  }
+  readpe_output_json_key_(out, "value");
+  readpe_output_json_string_value_(out, str);
+  readpe_output_json_close_(out, '}');
+}
+
+readpe_error_t readpe_output_json_strings(
+    readpe_output_t*                out,
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts) {
+  assert(out  != NULL);
+  assert(ctx  != NULL);
+  assert(opts != NULL);
+
+  readpe_output_json_strings_t st = { .out = out, .ctx = ctx, };
+
+  open_("strings", '[');
+  const readpe_error_t err = readpe_context_extract_strings(
+      ctx, opts, readpe_output_json_string_found_, &st);
+  readpe_output_json_close_(out, ']');
+  return err;
+}
+
+typedef struct readpe_output_json_signatures_t {
+  readpe_output_t*           out;
+  const readpe_context_t*    ctx;
+  const readpe_signatures_t* sigs;
+} readpe_output_json_signatures_t;
+
+static void readpe_output_json_signature_found_(
+    void* udata, const readpe_signature_match_t* m) {
+  readpe_output_json_signatures_t* st  = udata;
+  readpe_output_t*                 out = st->out;
+
+  size_t      len;
+  const char* name = readpe_signatures_get_name(st->sigs, m->signature, &len);
+
+  readpe_output_json_open_(out, '{');
+  string_("name", name, len);
+  if (m->section != READPE_SIGNATURE_NO_SECTION) {
+    const pe_image_section_header_t* s = &st->ctx->sections[m->section];
+    string_("section", (const char*) s->name,
+        strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE));
+  } else {
+    null_("section");
+  }
+  if (m->rva != UINTMAX_MAX) {
+    uint_("rva", m->rva);
+  } else {
+    null_("rva");
+  }
+  if (m->offset != UINTMAX_MAX) {
+    uint_("offset", m->offset);
+  } else {
+    null_("offset");
+  }
+  readpe_output_json_close_(out, '}');
+}
+
+readpe_error_t readpe_output_json_signatures(
+    readpe_output_t*           out,
+    const readpe_context_t*    ctx,
+    const readpe_signatures_t* sigs,
+    readpe_signature_layout_t  layout) {
+  assert(out  != NULL);
+  assert(ctx  != NULL);
+  assert(sigs != NULL);
+
+  readpe_output_json_signatures_t st = {
+    .out  = out,
+    .ctx  = ctx,
+    .sigs = sigs,
+  };
+
+  open_("signatures", '[');
+  const readpe_error_t err = readpe_context_scan_signatures(
+      ctx, sigs, layout, readpe_output_json_signature_found_, &st);
+  readpe_output_json_close_(out, ']');
+  return err;
+}
+
+readpe_error_t readpe_output_json_index_query(
+    readpe_output_t*      out,
+    const readpe_index_t* idx,
+    const char*           query,
+    size_t                begin,
+    size_t                end,
+    bool                  batch) {
+  assert(out   != NULL);
+  assert(idx   != NULL);
+  assert(query != NULL);
+
+  /* each query is a record in place of a file */
+  out->indent    = batch && out->format == READPE_OUTPUT_FORMAT_JSON;
+  out->continued = false;
+  out->keyed     = false;
+
+  readpe_output_json_open_(out, '{');
+  string_("query", query, strlen(query));
+
+  readpe_error_t err = READPE_OK;
+
+  open_("symbols", '[');
+  for (size_t i = begin; err == READPE_OK && i < end; ++i) {
+    readpe_index_symbol_t sym;
+    if (!readpe_index_get_symbol(idx, i, &sym)) {
+      err = READPE_ERROR_INVALID_INDEX;
+      break;
+    }
+    readpe_output_json_open_(out, '{');
+    string_("name", sym.name, sym.name_length);
+    if (sym.kind == READPE_INDEX_IMPORT) {
+      string_("kind", "import", 6);
+    } else {
+      string_("kind", "export", 6);
+    }
+
+    open_("files", '[');
+    for (size_t j = 0; j < sym.files_length; ++j) {
+      size_t      len;
+      const char* path = readpe_index_get_path(idx, sym.files[j], &len);
+      if (path == NULL) {
+        err = READPE_ERROR_INVALID_INDEX;
+        break;
+      }
+      readpe_output_json_string_(out, path, len);
+    }
+    readpe_output_json_close_(out, ']');
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+
+  if (err != READPE_OK) {
+    const char* msg = readpe_error_stringify(err);
+    string_("error", msg, strlen(msg));
+  }
+  readpe_output_json_close_(out, '}');
+
+  if (out->indent == 0) readpe_output_putc(out, '\n');
+  out->indent    = 0;
+  out->continued = false;
+  return err;
+}
+
+void readpe_output_json_bindings(
+    readpe_output_t* out, const readpe_modules_t* mods, size_t index) {
+  assert(out  != NULL);
+  assert(mods != NULL);
+
+  const readpe_context_t*        ctx = readpe_modules_get_context(mods, index);
+  const readpe_import_entries_t* e   = &ctx->import_entries;
+
+  size_t                  n;
+  const readpe_binding_t* b = readpe_modules_get_bindings(mods, index, &n);
+  assert(n == e->length);
+
+  open_("bindings", '[');
+  for (size_t i = 0; i < n; ++i) {
+    readpe_output_json_open_(out, '{');
+
+    size_t      dll_len = 0;
+    const char* dll     = readpe_context_resolve_string(
+        ctx, ctx->imports[e->dll[i]].name, &dll_len);
+    string_("dll", dll, dll_len);
+    if (e->by_ordinal[i]) {
+      uint_("ordinal", e->hint[i]);
+    } else {
+      size_t      fn_len = 0;
+      const char* fn = readpe_context_resolve_string(ctx, e->name[i], &fn_len);
+      string_("name", fn, fn_len);
+    }
+
+    const char* status = readpe_binding_status_stringify(b[i].status);
+    string_("status", status, strlen(status));
+    if (b[i].module != READPE_MODULES_NOT_FOUND) {
+      const char* path = readpe_modules_get_path(mods, b[i].module);
+      string_("module", path, strlen(path));
+    } else {
+      null_("module");
+    }
+    if (b[i].status == READPE_BINDING_RESOLVED) {
+      open_("export", '{');
+      uint_("ordinal", b[i].exp.ordinal);
+      uint_("rva",     b[i].exp.rva);
+      string_("name", b[i].exp.name, b[i].exp.name_length);
+      readpe_output_json_close_(out, '}');
+    } else {
+      null_("export");
+    }
+    uint_("forwards", b[i].forwards);
+
+    readpe_output_json_close_(out, '}');
+  }
+  readpe_output_json_close_(out, ']');
+}
+
+readpe_error_t readpe_output_json_load_order(
+    readpe_output_t* out, const readpe_modules_t* mods, size_t index) {
+  assert(out  != NULL);
+  assert(mods != NULL);
+
+  uint32_t* order = calloc(readpe_modules_get_length(mods), sizeof(*order));
+  if (order == NULL) return READPE_ERROR_NO_MEMORY;
+
+  size_t n;
+  const readpe_error_t err =
+      readpe_modules_get_load_order(mods, index, order, &n);
+  if (err == READPE_OK) {
+    open_("load_order", '[');
+    for (size_t i = 0; i < n; ++i) {
+      const char* path = readpe_modules_get_path(mods, order[i]);
+      readpe_output_json_string_(out, path, strlen(path));
+    }
+    readpe_output_json_close_(out, ']');
+  }
+  free(order);
+  return err;
+}
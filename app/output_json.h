@@ -0,0 +1,148 @@
+#pragma once
+
+/* JSON printers behind readpe_output_*, used when the format of the
+ * output is READPE_OUTPUT_FORMAT_JSON or READPE_OUTPUT_FORMAT_NDJSON.
+ * Every file becomes one object and each printer adds one member to it,
+ * so the output is streamed without holding the whole record. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pe.h"
+
+#include "lib/context.h"
+
+#include "./output.h"
+
+void
+readpe_output_json_begin_file(
+    readpe_output_t* out,
+    const char*      path,
+    bool             batch
+);
+
+void
+readpe_output_json_end_file(
+    readpe_output_t* out,
+    readpe_error_t   err
+);
+
+void
+readpe_output_json_dos_header(
+    readpe_output_t*       out,
+    const pe_dos_header_t* dos_header
+);
+
+void
+readpe_output_json_dos_stub(
+    readpe_output_t* out,
+    const uint8_t*   body,
+    size_t           len
+);
+
+void
+readpe_output_json_nt_header(
+    readpe_output_t*      out,
+    const pe_nt_header_t* header
+);
+
+void
+readpe_output_json_section_table(
+    readpe_output_t*                 out,
+    const pe_image_section_header_t* table,
+    size_t                           rows
+);
+
+void
+readpe_output_json_export_table(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_export_lookup(
+    readpe_output_t*       out,
+    const char*            query,
+    const readpe_export_t* exp  /* NULLABLE: not found */
+);
+
+void
+readpe_output_json_import_table(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_relocation_table(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_relocation_density(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_hashes(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_authenticode(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_fingerprints(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_json_section_stats(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+readpe_error_t
+readpe_output_json_strings(
+    readpe_output_t*                out,
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts
+);
+
+readpe_error_t
+readpe_output_json_signatures(
+    readpe_output_t*           out,
+    const readpe_context_t*    ctx,
+    const readpe_signatures_t* sigs,
+    readpe_signature_layout_t  layout
+);
+
+readpe_error_t
+readpe_output_json_index_query(
+    readpe_output_t*      out,
+    const readpe_index_t* idx,
+    const char*           query,
+    size_t                begin,
+    size_t                end,
+    bool                  batch
+);
+
+void
+readpe_output_json_bindings(
+    readpe_output_t*        out,
+    const readpe_modules_t* mods,
+    size_t                  index
+);
+
+readpe_error_t
+readpe_output_json_load_order(
+    readpe_output_t*        out,
+    const readpe_modules_t* mods,
+    size_t                  index
+);
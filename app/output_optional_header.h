@@ -0,0 +1,124 @@
+/* A template of the optional header printer, included by output.c once for
+ * each width with READPE_OUTPUT_BITS defined to 32 or 64. */
+
+#if !defined(READPE_OUTPUT_BITS)
+# error "READPE_OUTPUT_BITS must be defined"
+#endif
+
+#define READPE_OUTPUT_CAT__(a, b, c) a##b##c
+#define READPE_OUTPUT_CAT_(a, b, c)  READPE_OUTPUT_CAT__(a, b, c)
+
+#if READPE_OUTPUT_BITS == 32
+# define WORD_HEX_ "0x%08"PRIX32
+# define WORD_DEC_ "%"PRIu32
+# define TITLE_    "OPTIONAL HEADER 32-bit"
+#else
+# define WORD_HEX_ "0x%016"PRIX64
+# define WORD_DEC_ "%"PRIu64
+# define TITLE_    "OPTIONAL HEADER 64-bit"
+#endif
+
+static void READPE_OUTPUT_CAT_(
+    readpe_output_optional_header, READPE_OUTPUT_BITS, _)(
+    readpe_output_t* out,
+    const READPE_OUTPUT_CAT_(pe, READPE_OUTPUT_BITS, _image_optional_header_t)*
+        header) {
+  assert(out    != NULL);
+  assert(header != NULL);
+
+  readpe_output_begin_group_(out, TITLE_);
+
+  printfln("magic                     : %s (0x%04"PRIX16")",
+      readpe_output_stringify_optional_magic_(header->magic), header->magic);
+  printfln("linker version            : %"PRIu8".%"PRIu8,
+      header->major_linker_version, header->minor_linker_version);
+  printfln("size of code              : 0x%08"PRIX32" = %"PRIu32,
+      header->size_of_code, header->size_of_code);
+  printfln("size of initialized data  : 0x%08"PRIX32" = %"PRIu32,
+      header->size_of_initialized_data, header->size_of_initialized_data);
+  printfln("size of uninitialized data: 0x%08"PRIX32" = %"PRIu32,
+      header->size_of_uninitialized_data, header->size_of_uninitialized_data);
+  printfln("address of entrypoint     : 0x%08"PRIX32" RVA",
+      header->address_of_entrypoint);
+  printfln("base of code              : 0x%08"PRIX32" RVA",
+      header->base_of_code);
+#if READPE_OUTPUT_BITS == 32
+  printfln("base of data              : 0x%08"PRIX32" RVA",
+      header->base_of_data);
+#endif
+  printfln("image base                : "WORD_HEX_,
+      header->image_base);
+  printfln("section alignment         : 0x%08"PRIX32" = %"PRIu32,
+      header->section_alignment, header->section_alignment);
+  printfln("file alignment            : 0x%08"PRIX32" = %"PRIu32,
+      header->file_alignment, header->file_alignment);
+  printfln("OS version                : %"PRIu16".%"PRIu16,
+      header->major_operating_system_version,
+      header->minor_operating_system_version);
+  printfln("image version             : %"PRIu16".%"PRIu16,
+      header->major_image_version, header->minor_image_version);
+  printfln("subsystem version         : %"PRIu16".%"PRIu16,
+      header->major_subsystem_version, header->minor_subsystem_version);
+  printfln("size of image             : 0x%08"PRIX32" = %"PRIu32,
+      header->size_of_image, header->size_of_image);
+  printfln("size of headers           : 0x%08"PRIX32" = %"PRIu32,
+      header->size_of_headers, header->size_of_headers);
+  printfln("checksum                  : 0x%08"PRIX32" = %"PRIu32,
+      header->checksum, header->checksum);
+  printfln("subsystem                 : %s (0x%04"PRIX16")",
+      readpe_output_stringify_optional_subsystem_(header->subsystem),
+      header->subsystem);
+
+  printfln("dll characteristics       : 0x%04"PRIX16,
+      header->dll_characteristics);
+
+# define p(flag, desc) do {  \
+    if (header->dll_characteristics & flag) {  \
+      printfln("  - %s (0x%04"PRIX16")", #flag, flag);  \
+      printfln("      %s", desc);  \
+    }  \
+  } while (0)
+
+  p(PE_IMAGE_DLLCHARACTERISTICS_DYNAMIC_BASE,
+      "the dll can be relocated at load time");
+  p(PE_IMAGE_DLLCHARACTERISTICS_FORCE_INTEGRITY,
+      "integrity checks are forced");
+  p(PE_IMAGE_DLLCHARACTERISTICS_NX_COMPAT,
+      "the image is compatible with data execution prevention");
+  p(PE_IMAGE_DLLCHARACTERISTICS_NO_ISOLATION,
+      "the image is isolation aware");
+  p(PE_IMAGE_DLLCHARACTERISTICS_NO_SEH,
+      "the image does not use structured exception handling");
+  p(PE_IMAGE_DLLCHARACTERISTICS_NO_BIND,
+      "don't bind the image");
+  p(PE_IMAGE_DLLCHARACTERISTICS_WDM_DRIVER,
+      "A WDM driver");
+  p(PE_IMAGE_DLLCHARACTERISTICS_TERMINAL_SERVER_AWARE,
+      "the image is terminal server aware");
+
+# undef p
+
+  printfln("size of stack reserve     : "WORD_HEX_" = "WORD_DEC_,
+      header->size_of_stack_reserve, header->size_of_stack_reserve);
+  printfln("size of stack commit      : "WORD_HEX_" = "WORD_DEC_,
+      header->size_of_stack_commit, header->size_of_stack_commit);
+  printfln("size of heap reserve      : "WORD_HEX_" = "WORD_DEC_,
+      header->size_of_heap_reserve, header->size_of_heap_reserve);
+  printfln("size of heap commit       : "WORD_HEX_" = "WORD_DEC_,
+      header->size_of_heap_commit, header->size_of_heap_commit);
+
+  printfln("number of RVA and sizes   : %"PRIu32,
+      header->number_of_rva_and_sizes);
+
+  readpe_output_data_directories_(out,
+      header->data_directory, header->number_of_rva_and_sizes);
+
+  readpe_output_end_group_(out);
+}
+
+#undef TITLE_
+#undef WORD_DEC_
+#undef WORD_HEX_
+#undef READPE_OUTPUT_CAT_
+#undef READPE_OUTPUT_CAT__
+#undef READPE_OUTPUT_BITS
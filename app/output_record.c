@@ -0,0 +1,822 @@
+#include "./output_record.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pe.h"
+
+#include "./output.h"
+#include "./output_buffer.h"
+
+typedef struct readpe_output_record_column_t {
+  readpe_record_type_t type;
+  const char*          name;
+  uint64_t             length;  /* bytes of strings, for string columns */
+} readpe_output_record_column_t;
+
+typedef const char* (*readpe_output_record_string_t)(
+    const void* udata, size_t row, size_t* len);
+
+static inline size_t readpe_output_record_align_(size_t n) {
+  return (n + 7) & ~(size_t) 7;
+}
+
+static inline void readpe_output_record_pad_(readpe_output_t* out, size_t n) {
+  readpe_output_fill(out, 0, readpe_output_record_align_(n) - n);
+}
+
+static size_t readpe_output_record_column_length_(
+    const readpe_output_record_column_t* col, size_t rows) {
+  switch (col->type) {
+  case READPE_RECORD_TYPE_U8:     return rows;
+  case READPE_RECORD_TYPE_U16:    return rows*2;
+  case READPE_RECORD_TYPE_U32:    return rows*4;
+  case READPE_RECORD_TYPE_U64:    return rows*8;
+  case READPE_RECORD_TYPE_F64:    return rows*8;
+  case READPE_RECORD_TYPE_STRING: return (rows+1)*4 + col->length;
+  }
+  assert(false);
+  return 0;
+}
+
+static void readpe_output_record_begin_table_(
+    readpe_output_t*                     out,
+    readpe_record_table_kind_t           kind,
+    size_t                               rows,
+    const readpe_output_record_column_t* cols,
+    size_t                               columns) {
+  size_t names  = 0;
+  size_t length = READPE_RECORD_TABLE_HEADER_SIZE +
+      columns*READPE_RECORD_COLUMN_HEADER_SIZE;
+  for (size_t i = 0; i < columns; ++i) {
+    names  += strlen(cols[i].name);
+    length += readpe_output_record_align_(
+        readpe_output_record_column_length_(&cols[i], rows));
+  }
+  length += readpe_output_record_align_(names);
+
+  const readpe_record_table_header_t header = {
+    .kind    = kind,
+    .columns = columns,
+    .rows    = rows,
+    .length  = length,
+  };
+  readpe_output_put(out, (const char*) &header, sizeof(header));
+
+  for (size_t i = 0; i < columns; ++i) {
+    const readpe_record_column_header_t col = {
+      .type        = cols[i].type,
+      .name_length = strlen(cols[i].name),
+      .length      = readpe_output_record_column_length_(&cols[i], rows),
+    };
+    readpe_output_put(out, (const char*) &col, sizeof(col));
+  }
+  for (size_t i = 0; i < columns; ++i) {
+    readpe_output_put(out, cols[i].name, strlen(cols[i].name));
+  }
+  readpe_output_record_pad_(out, names);
+}
+
+static uint64_t readpe_output_record_strings_length_(
+    size_t rows, readpe_output_record_string_t get, const void* udata) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < rows; ++i) {
+    size_t len = 0;
+    if (get(udata, i, &len) == NULL) len = 0;
+    total += len;
+  }
+  return total;
+}
+
+static void readpe_output_record_strings_(
+    readpe_output_t*              out,
+    size_t                        rows,
+    readpe_output_record_string_t get,
+    const void*                   udata) {
+  uint32_t offset = 0;
+  readpe_output_put(out, (const char*) &offset, sizeof(offset));
+  for (size_t i = 0; i < rows; ++i) {
+    size_t len = 0;
+    if (get(udata, i, &len) == NULL) len = 0;
+    offset += len;
+    readpe_output_put(out, (const char*) &offset, sizeof(offset));
+  }
+  for (size_t i = 0; i < rows; ++i) {
+    size_t      len = 0;
+    const char* str = get(udata, i, &len);
+    if (str != NULL) readpe_output_put(out, str, len);
+  }
+  readpe_output_record_pad_(out, (rows+1)*4 + offset);
+}
+
+/* writes a fixed-width column whose i-th value is the expression */
+#define column_(T, rows, expr) do {  \
+  for (size_t i = 0; i < (rows); ++i) {  \
+    const T v_ = (T) (expr);  \
+    readpe_output_put(out, (const char*) &v_, sizeof(v_));  \
+  }  \
+  readpe_output_record_pad_(out, (rows)*sizeof(T));  \
+} while (0)
+
+static const char* readpe_output_record_section_name_(
+    const void* udata, size_t row, size_t* len) {
+  const pe_image_section_header_t* s =
+      &((const pe_image_section_header_t*) udata)[row];
+  *len = strnlen((const char*) s->name, PE_IMAGE_SECTION_NAME_SIZE);
+  return (const char*) s->name;
+}
+
+static const char* readpe_output_record_export_name_(
+    const void* udata, size_t row, size_t* len) {
+  readpe_export_t exp;
+  readpe_context_get_export(udata, row, &exp);
+  *len = exp.name_length;
+  return exp.name;
+}
+
+static const char* readpe_output_record_export_forwarder_(
+    const void* udata, size_t row, size_t* len) {
+  readpe_export_t exp;
+  readpe_context_get_export(udata, row, &exp);
+  *len = exp.forwarder_length;
+  return exp.forwarded? exp.forwarder: NULL;
+}
+
+static const char* readpe_output_record_import_dll_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_context_t* ctx = udata;
+  return readpe_context_resolve_string(ctx, ctx->imports[row].name, len);
+}
+
+static const char* readpe_output_record_import_name_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_context_t*        ctx = udata;
+  const readpe_import_entries_t* e   = &ctx->import_entries;
+  if (e->by_ordinal[row]) return NULL;
+  return readpe_context_resolve_string(ctx, e->name[row], len);
+}
+
+void readpe_output_record_begin_file(readpe_output_t* out, const char* path) {
+  assert(out  != NULL);
+  assert(path != NULL);
+
+  const size_t len = strlen(path);
+
+  readpe_record_header_t header = {
+    .version     = READPE_RECORD_VERSION,
+    .path_length = len,
+  };
+  memcpy(header.magic, READPE_RECORD_MAGIC, sizeof(header.magic));
+
+  readpe_output_put(out, (const char*) &header, sizeof(header));
+  readpe_output_put(out, path, len);
+  readpe_output_record_pad_(out, len);
+}
+
+void readpe_output_record_end_file(readpe_output_t* out, readpe_error_t err) {
+  assert(out != NULL);
+
+  const readpe_record_table_header_t header = {
+    .kind   = READPE_RECORD_TABLE_END,
+    .status = err,
+    .length = READPE_RECORD_TABLE_HEADER_SIZE,
+  };
+  readpe_output_put(out, (const char*) &header, sizeof(header));
+}
+
+void readpe_output_record_section_table(
+    readpe_output_t*                 out,
+    const pe_image_section_header_t* table,
+    size_t                           rows) {
+  assert(out   != NULL);
+  assert(table != NULL || rows == 0);
+
+  const readpe_output_record_string_t name = readpe_output_record_section_name_;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_STRING, "name",
+      readpe_output_record_strings_length_(rows, name, table), },
+    { READPE_RECORD_TYPE_U32, "virtual_size",           0, },
+    { READPE_RECORD_TYPE_U32, "virtual_address",        0, },
+    { READPE_RECORD_TYPE_U32, "size_of_raw_data",       0, },
+    { READPE_RECORD_TYPE_U32, "pointer_to_raw_data",    0, },
+    { READPE_RECORD_TYPE_U32, "pointer_to_relocations", 0, },
+    { READPE_RECORD_TYPE_U32, "pointer_to_linenumbers", 0, },
+    { READPE_RECORD_TYPE_U16, "number_of_relocations",  0, },
+    { READPE_RECORD_TYPE_U16, "number_of_linenumbers",  0, },
+    { READPE_RECORD_TYPE_U32, "characteristics",        0, },
+  };
+  readpe_output_record_begin_table_(out,
+      READPE_RECORD_TABLE_SECTIONS, rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  readpe_output_record_strings_(out, rows, name, table);
+  column_(uint32_t, rows, table[i].misc.virtual_size);
+  column_(uint32_t, rows, table[i].virtual_address);
+  column_(uint32_t, rows, table[i].size_of_raw_data);
+  column_(uint32_t, rows, table[i].pointer_to_raw_data);
+  column_(uint32_t, rows, table[i].pointer_to_relocations);
+  column_(uint32_t, rows, table[i].pointer_to_linenumbers);
+  column_(uint16_t, rows, table[i].number_of_relocations);
+  column_(uint16_t, rows, table[i].number_of_linenumbers);
+  column_(uint32_t, rows, table[i].characteristics);
+}
+
+void readpe_output_record_export_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  if (ctx->export_ == NULL) return;
+
+  const size_t rows = ctx->export_->number_of_functions;
+
+  const readpe_output_record_string_t name =
+      readpe_output_record_export_name_;
+  const readpe_output_record_string_t forwarder =
+      readpe_output_record_export_forwarder_;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32,    "ordinal",   0, },
+    { READPE_RECORD_TYPE_U32,    "rva",       0, },
+    { READPE_RECORD_TYPE_STRING, "name",
+      readpe_output_record_strings_length_(rows, name, ctx), },
+    { READPE_RECORD_TYPE_U8,     "forwarded", 0, },
+    { READPE_RECORD_TYPE_STRING, "forwarder",
+      readpe_output_record_strings_length_(rows, forwarder, ctx), },
+  };
+  readpe_output_record_begin_table_(out,
+      READPE_RECORD_TABLE_EXPORTS, rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  column_(uint32_t, rows, i + ctx->export_->base);
+  column_(uint32_t, rows, ctx->export_functions[i]);
+  readpe_output_record_strings_(out, rows, name, ctx);
+  for (size_t i = 0; i < rows; ++i) {
+    readpe_export_t exp;
+    readpe_context_get_export(ctx, i, &exp);
+    readpe_output_putc(out, exp.forwarded);
+  }
+  readpe_output_record_pad_(out, rows);
+  readpe_output_record_strings_(out, rows, forwarder, ctx);
+}
+
+void readpe_output_record_import_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  if (ctx->imports == NULL) return;
+
+  const readpe_import_entries_t* e = &ctx->import_entries;
+
+  const size_t dlls = ctx->imports_length;
+  const readpe_output_record_string_t dll = readpe_output_record_import_dll_;
+
+  const readpe_output_record_column_t dll_cols[] = {
+    { READPE_RECORD_TYPE_STRING, "name",
+      readpe_output_record_strings_length_(dlls, dll, ctx), },
+    { READPE_RECORD_TYPE_U32, "original_first_thunk", 0, },
+    { READPE_RECORD_TYPE_U32, "first_thunk",          0, },
+    { READPE_RECORD_TYPE_U32, "forwarder_chain",      0, },
+    { READPE_RECORD_TYPE_U32, "time_date_stamp",      0, },
+  };
+  readpe_output_record_begin_table_(out,
+      READPE_RECORD_TABLE_IMPORT_DESCRIPTORS, dlls,
+      dll_cols, sizeof(dll_cols)/sizeof(dll_cols[0]));
+
+  readpe_output_record_strings_(out, dlls, dll, ctx);
+  column_(uint32_t, dlls, ctx->imports[i].original_first_thunk);
+  column_(uint32_t, dlls, ctx->imports[i].first_thunk);
+  column_(uint32_t, dlls, ctx->imports[i].forwarder_chain);
+  column_(uint32_t, dlls, ctx->imports[i].time_date_stamp);
+
+  const size_t rows = e->length;
+  const readpe_output_record_string_t name = readpe_output_record_import_name_;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32,    "dll",        0, },
+    { READPE_RECORD_TYPE_U16,    "hint",       0, },
+    { READPE_RECORD_TYPE_U8,     "by_ordinal", 0, },
+    { READPE_RECORD_TYPE_STRING, "name",
+      readpe_output_record_strings_length_(rows, name, ctx), },
+    { READPE_RECORD_TYPE_U32,    "iat",        0, },
+  };
+  readpe_output_record_begin_table_(out,
+      READPE_RECORD_TABLE_IMPORTS, rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  column_(uint32_t, rows, e->dll[i]);
+  column_(uint16_t, rows, e->hint[i]);
+  column_(uint8_t,  rows, e->by_ordinal[i]);
+  readpe_output_record_strings_(out, rows, name, ctx);
+  column_(uint32_t, rows, e->iat[i]);
+}
+
+void readpe_output_record_relocation_table(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  if (ctx->relocations == NULL) return;
+
+  const readpe_relocation_entries_t* e = &ctx->relocation_entries;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32, "rva",  0, },
+    { READPE_RECORD_TYPE_U8,  "type", 0, },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_RELOCATIONS,
+      e->length, cols, sizeof(cols)/sizeof(cols[0]));
+
+  readpe_output_put(out, (const char*) e->rva, e->length*sizeof(*e->rva));
+  readpe_output_record_pad_(out, e->length*sizeof(*e->rva));
+  readpe_output_put(out, (const char*) e->type, e->length*sizeof(*e->type));
+  readpe_output_record_pad_(out, e->length*sizeof(*e->type));
+}
+
+void readpe_output_record_relocation_density(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  size_t          pages;
+  const uint32_t* density = readpe_context_get_relocation_density(ctx, &pages);
+  if (density == NULL) return;
+
+  size_t rows = 0;
+  for (size_t i = 0; i < pages; ++i) rows += density[i] > 0;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32, "rva",    0, },
+    { READPE_RECORD_TYPE_U32, "fixups", 0, },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_RELOCATION_DENSITY,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  for (size_t i = 0; i < pages; ++i) {
+    if (density[i] == 0) continue;
+    const uint32_t rva = i*READPE_RELOCATION_PAGE_SIZE;
+    readpe_output_put(out, (const char*) &rva, sizeof(rva));
+  }
+  readpe_output_record_pad_(out, rows*sizeof(uint32_t));
+  for (size_t i = 0; i < pages; ++i) {
+    if (density[i] == 0) continue;
+    readpe_output_put(out, (const char*) &density[i], sizeof(density[i]));
+  }
+  readpe_output_record_pad_(out, rows*sizeof(uint32_t));
+}
+
+/* ctx->hashes has the whole file first, followed by each section */
+static const char* readpe_output_record_md5_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_hash_t* h = &((const readpe_hash_t*) udata)[row];
+  *len = sizeof(h->md5);
+  return (const char*) h->md5;
+}
+
+static const char* readpe_output_record_sha1_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_hash_t* h = &((const readpe_hash_t*) udata)[row];
+  *len = sizeof(h->sha1);
+  return (const char*) h->sha1;
+}
+
+static const char* readpe_output_record_sha256_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_hash_t* h = &((const readpe_hash_t*) udata)[row];
+  *len = sizeof(h->sha256);
+  return (const char*) h->sha256;
+}
+
+void readpe_output_record_hashes(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const size_t         rows   = ctx->nt_header->file.number_of_sections + 1;
+  const readpe_hash_t* hashes = ctx->hashes;
+  assert(hashes != NULL);
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32,    "section", 0, },
+    { READPE_RECORD_TYPE_STRING, "md5",     rows*sizeof(hashes->md5), },
+    { READPE_RECORD_TYPE_STRING, "sha1",    rows*sizeof(hashes->sha1), },
+    { READPE_RECORD_TYPE_STRING, "sha256",  rows*sizeof(hashes->sha256), },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_HASHES,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  /* UINT32_MAX stands for the whole file */
+  column_(uint32_t, rows, i == 0? UINT32_MAX: i-1);
+  readpe_output_record_strings_(out, rows, readpe_output_record_md5_, hashes);
+  readpe_output_record_strings_(out, rows, readpe_output_record_sha1_, hashes);
+  readpe_output_record_strings_(
+      out, rows, readpe_output_record_sha256_, hashes);
+}
+
+void readpe_output_record_authenticode(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const readpe_hash_t* hash = readpe_context_get_authenticode_hash(ctx);
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32,    "checksum",          0, },
+    { READPE_RECORD_TYPE_U32,    "computed_checksum", 0, },
+    { READPE_RECORD_TYPE_U8,     "signed",            0, },
+    { READPE_RECORD_TYPE_STRING, "sha1",   sizeof(hash->sha1), },
+    { READPE_RECORD_TYPE_STRING, "sha256", sizeof(hash->sha256), },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_AUTHENTICODE,
+      1, cols, sizeof(cols)/sizeof(cols[0]));
+
+  column_(uint32_t, 1, ctx->_64bit?
+      ctx->nt_header->optional._64bit.checksum:
+      ctx->nt_header->optional._32bit.checksum);
+  column_(uint32_t, 1, readpe_context_get_checksum(ctx));
+  column_(uint8_t,  1, readpe_context_is_signed(ctx));
+  readpe_output_record_strings_(out, 1, readpe_output_record_sha1_, hash);
+  readpe_output_record_strings_(out, 1, readpe_output_record_sha256_, hash);
+}
+
+static const char* readpe_output_record_imphash_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_fingerprints_t* fp = udata;
+  (void) row;
+  *len = fp->imphash_found? sizeof(fp->imphash): 0;
+  return (const char*) fp->imphash;
+}
+
+static const char* readpe_output_record_exphash_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_fingerprints_t* fp = udata;
+  (void) row;
+  *len = fp->exphash_found? sizeof(fp->exphash): 0;
+  return (const char*) fp->exphash;
+}
+
+static const char* readpe_output_record_rich_hash_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_fingerprints_t* fp = udata;
+  (void) row;
+  *len = fp->rich_hash_found? sizeof(fp->rich_hash): 0;
+  return (const char*) fp->rich_hash;
+}
+
+void readpe_output_record_fingerprints(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const readpe_fingerprints_t* fp = readpe_context_get_fingerprints(ctx);
+
+  const readpe_output_record_string_t imphash = readpe_output_record_imphash_;
+  const readpe_output_record_string_t exphash = readpe_output_record_exphash_;
+  const readpe_output_record_string_t rich    = readpe_output_record_rich_hash_;
+
+  /* an empty string stands for a missing fingerprint */
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_STRING, "imphash",
+      readpe_output_record_strings_length_(1, imphash, fp), },
+    { READPE_RECORD_TYPE_STRING, "exphash",
+      readpe_output_record_strings_length_(1, exphash, fp), },
+    { READPE_RECORD_TYPE_STRING, "rich_hash",
+      readpe_output_record_strings_length_(1, rich, fp), },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_FINGERPRINTS,
+      1, cols, sizeof(cols)/sizeof(cols[0]));
+
+  readpe_output_record_strings_(out, 1, imphash, fp);
+  readpe_output_record_strings_(out, 1, exphash, fp);
+  readpe_output_record_strings_(out, 1, rich,    fp);
+}
+
+void readpe_output_record_section_stats(
+    readpe_output_t* out, const readpe_context_t* ctx) {
+  assert(out != NULL);
+  assert(ctx != NULL);
+
+  const size_t rows = ctx->nt_header->file.number_of_sections;
+  const readpe_section_stats_t* stats = readpe_context_get_section_stats(ctx);
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32, "section",    0, },
+    { READPE_RECORD_TYPE_U64, "length",     0, },
+    { READPE_RECORD_TYPE_F64, "entropy",    0, },
+    { READPE_RECORD_TYPE_F64, "zero_ratio", 0, },
+    { READPE_RECORD_TYPE_F64, "chi_square", 0, },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_SECTION_STATS,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  column_(uint32_t, rows, i);
+  column_(uint64_t, rows, stats[i].length);
+  column_(double,   rows, stats[i].entropy);
+  column_(double,   rows, stats[i].zero_ratio);
+  column_(double,   rows, stats[i].chi_square);
+
+  /* 256 rows per section, in the order of byte values */
+  const size_t hrows = rows*256;
+
+  const readpe_output_record_column_t hcols[] = {
+    { READPE_RECORD_TYPE_U32, "section", 0, },
+    { READPE_RECORD_TYPE_U8,  "byte",    0, },
+    { READPE_RECORD_TYPE_U64, "count",   0, },
+  };
+  readpe_output_record_begin_table_(out,
+      READPE_RECORD_TABLE_SECTION_HISTOGRAMS,
+      hrows, hcols, sizeof(hcols)/sizeof(hcols[0]));
+
+  column_(uint32_t, hrows, i/256);
+  column_(uint8_t,  hrows, i%256);
+  column_(uint64_t, hrows, stats[i/256].histogram[i%256]);
+}
+
+typedef struct readpe_output_record_found_t {
+  readpe_string_t* strings;
+  size_t           length;
+  size_t           reserved;
+  bool             broken;
+} readpe_output_record_found_t;
+
+static void readpe_output_record_string_found_(
+    void* udata, const readpe_string_t* str) {
+  readpe_output_record_found_t* f = udata;
+  if (f->broken) return;
+
+  if (f->length >= f->reserved) {
+    const size_t n = f->reserved? f->reserved*2: 256;
+    readpe_string_t* ptr = realloc(f->strings, n*sizeof(*ptr));
+    if (ptr == NULL) {
+      f->broken = true;
+      return;
+    }
+    f->strings  = ptr;
+    f->reserved = n;
+  }
+  f->strings[f->length++] = *str;
+}
+
+/* values are the bytes in the file, so UTF-16LE ones have 2 per character */
+static const char* readpe_output_record_string_value_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_string_t* str = &((const readpe_string_t*) udata)[row];
+  *len = str->encoding == READPE_STRING_UTF16LE? str->length*2: str->length;
+  return (const char*) str->data;
+}
+
+readpe_error_t readpe_output_record_strings(
+    readpe_output_t*                out,
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts) {
+  assert(out  != NULL);
+  assert(ctx  != NULL);
+  assert(opts != NULL);
+
+  /* columns need the number of rows first, so strings are collected */
+  readpe_output_record_found_t f = {0};
+
+  readpe_error_t err = readpe_context_extract_strings(
+      ctx, opts, readpe_output_record_string_found_, &f);
+  if (err == READPE_OK && f.broken) err = READPE_ERROR_NO_MEMORY;
+  if (err != READPE_OK) {
+    free(f.strings);
+    return err;
+  }
+
+  const size_t           rows = f.length;
+  const readpe_string_t* strs = f.strings;
+
+  const readpe_output_record_string_t value =
+      readpe_output_record_string_value_;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32,    "section",  0, },
+    { READPE_RECORD_TYPE_U32,    "rva",      0, },
+    { READPE_RECORD_TYPE_U8,     "encoding", 0, },
+    { READPE_RECORD_TYPE_U8,     "tag",      0, },
+    { READPE_RECORD_TYPE_STRING, "value",
+      readpe_output_record_strings_length_(rows, value, strs), },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_STRINGS,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  column_(uint32_t, rows, strs[i].section);
+  column_(uint32_t, rows, strs[i].rva);
+  column_(uint8_t,  rows, strs[i].encoding);
+  column_(uint8_t,  rows, strs[i].tag);
+  readpe_output_record_strings_(out, rows, value, strs);
+
+  free(f.strings);
+  return READPE_OK;
+}
+
+typedef struct readpe_output_record_matches_t {
+  readpe_signature_match_t* matches;
+  size_t                    length;
+  size_t                    reserved;
+  bool                      broken;
+} readpe_output_record_matches_t;
+
+static void readpe_output_record_signature_found_(
+    void* udata, const readpe_signature_match_t* m) {
+  readpe_output_record_matches_t* f = udata;
+  if (f->broken) return;
+
+  if (f->length >= f->reserved) {
+    const size_t n = f->reserved? f->reserved*2: 64;
+    readpe_signature_match_t* ptr = realloc(f->matches, n*sizeof(*ptr));
+    if (ptr == NULL) {
+      f->broken = true;
+      return;
+    }
+    f->matches  = ptr;
+    f->reserved = n;
+  }
+  f->matches[f->length++] = *m;
+}
+
+typedef struct readpe_output_record_signature_names_t {
+  const readpe_signatures_t*      sigs;
+  const readpe_signature_match_t* matches;
+} readpe_output_record_signature_names_t;
+
+static const char* readpe_output_record_signature_name_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_output_record_signature_names_t* n = udata;
+  return readpe_signatures_get_name(
+      n->sigs, n->matches[row].signature, len);
+}
+
+readpe_error_t readpe_output_record_signatures(
+    readpe_output_t*           out,
+    const readpe_context_t*    ctx,
+    const readpe_signatures_t* sigs,
+    readpe_signature_layout_t  layout) {
+  assert(out  != NULL);
+  assert(ctx  != NULL);
+  assert(sigs != NULL);
+
+  /* columns need the number of rows first, so matches are collected */
+  readpe_output_record_matches_t f = {0};
+
+  readpe_error_t err = readpe_context_scan_signatures(
+      ctx, sigs, layout, readpe_output_record_signature_found_, &f);
+  if (err == READPE_OK && f.broken) err = READPE_ERROR_NO_MEMORY;
+  if (err != READPE_OK) {
+    free(f.matches);
+    return err;
+  }
+
+  const size_t                    rows = f.length;
+  const readpe_signature_match_t* m    = f.matches;
+
+  const readpe_output_record_signature_names_t names = {
+    .sigs    = sigs,
+    .matches = m,
+  };
+  const readpe_output_record_string_t name =
+      readpe_output_record_signature_name_;
+
+  /* UINT32_MAX or UINT64_MAX stands for a missing value */
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U32,    "signature", 0, },
+    { READPE_RECORD_TYPE_STRING, "name",
+      readpe_output_record_strings_length_(rows, name, &names), },
+    { READPE_RECORD_TYPE_U32,    "section",   0, },
+    { READPE_RECORD_TYPE_U64,    "rva",       0, },
+    { READPE_RECORD_TYPE_U64,    "offset",    0, },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_SIGNATURES,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+  column_(uint32_t, rows, m[i].signature);
+  readpe_output_record_strings_(out, rows, name, &names);
+  column_(uint32_t, rows, m[i].section == READPE_SIGNATURE_NO_SECTION?
+      UINT32_MAX: m[i].section);
+  column_(uint64_t, rows, m[i].rva    == UINTMAX_MAX? UINT64_MAX: m[i].rva);
+  column_(uint64_t, rows, m[i].offset == UINTMAX_MAX? UINT64_MAX: m[i].offset);
+
+  free(f.matches);
+  return READPE_OK;
+}
+
+typedef struct readpe_output_record_bindings_t {
+  const readpe_modules_t* mods;
+  const readpe_binding_t* bindings;
+} readpe_output_record_bindings_t;
+
+static const char* readpe_output_record_binding_module_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_output_record_bindings_t* b = udata;
+
+  const size_t module = b->bindings[row].module;
+  if (module == READPE_MODULES_NOT_FOUND) return NULL;
+
+  const char* path = readpe_modules_get_path(b->mods, module);
+  *len = strlen(path);
+  return path;
+}
+
+static const char* readpe_output_record_binding_name_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_output_record_bindings_t* b = udata;
+
+  const readpe_binding_t* itr = &b->bindings[row];
+  if (itr->status != READPE_BINDING_RESOLVED) return NULL;
+  *len = itr->exp.name_length;
+  return itr->exp.name;
+}
+
+void readpe_output_record_bindings(
+    readpe_output_t* out, const readpe_modules_t* mods, size_t index) {
+  assert(out  != NULL);
+  assert(mods != NULL);
+
+  size_t                  rows;
+  const readpe_binding_t* b = readpe_modules_get_bindings(mods, index, &rows);
+
+  const readpe_output_record_bindings_t bindings = {
+    .mods     = mods,
+    .bindings = b,
+  };
+  const readpe_output_record_string_t module =
+      readpe_output_record_binding_module_;
+  const readpe_output_record_string_t name =
+      readpe_output_record_binding_name_;
+
+  /* ordinal and rva of the export are 0 unless resolved */
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_U8,     "status",   0, },
+    { READPE_RECORD_TYPE_U8,     "forwards", 0, },
+    { READPE_RECORD_TYPE_STRING, "module",
+      readpe_output_record_strings_length_(rows, module, &bindings), },
+    { READPE_RECORD_TYPE_U32,    "ordinal",  0, },
+    { READPE_RECORD_TYPE_U32,    "rva",      0, },
+    { READPE_RECORD_TYPE_STRING, "name",
+      readpe_output_record_strings_length_(rows, name, &bindings), },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_BINDINGS,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+
+# define resolved_(i) (b[i].status == READPE_BINDING_RESOLVED)
+  column_(uint8_t,  rows, b[i].status);
+  column_(uint8_t,  rows, b[i].forwards);
+  readpe_output_record_strings_(out, rows, module, &bindings);
+  column_(uint32_t, rows, resolved_(i)? b[i].exp.ordinal: 0);
+  column_(uint32_t, rows, resolved_(i)? b[i].exp.rva:     0);
+  readpe_output_record_strings_(out, rows, name, &bindings);
+# undef resolved_
+}
+
+typedef struct readpe_output_record_load_order_t {
+  const readpe_modules_t* mods;
+  const uint32_t*         order;
+} readpe_output_record_load_order_t;
+
+static const char* readpe_output_record_load_order_path_(
+    const void* udata, size_t row, size_t* len) {
+  const readpe_output_record_load_order_t* o = udata;
+
+  const char* path = readpe_modules_get_path(o->mods, o->order[row]);
+  *len = strlen(path);
+  return path;
+}
+
+readpe_error_t readpe_output_record_load_order(
+    readpe_output_t* out, const readpe_modules_t* mods, size_t index) {
+  assert(out  != NULL);
+  assert(mods != NULL);
+
+  uint32_t* order = calloc(readpe_modules_get_length(mods), sizeof(*order));
+  if (order == NULL) return READPE_ERROR_NO_MEMORY;
+
+  size_t rows;
+  const readpe_error_t err =
+      readpe_modules_get_load_order(mods, index, order, &rows);
+  if (err != READPE_OK) {
+    free(order);
+    return err;
+  }
+
+  const readpe_output_record_load_order_t o = {
+    .mods  = mods,
+    .order = order,
+  };
+  const readpe_output_record_string_t path =
+      readpe_output_record_load_order_path_;
+
+  const readpe_output_record_column_t cols[] = {
+    { READPE_RECORD_TYPE_STRING, "path",
+      readpe_output_record_strings_length_(rows, path, &o), },
+  };
+  readpe_output_record_begin_table_(out, READPE_RECORD_TABLE_LOAD_ORDER,
+      rows, cols, sizeof(cols)/sizeof(cols[0]));
+  readpe_output_record_strings_(out, rows, path, &o);
+
+  free(order);
+  return READPE_OK;
+}
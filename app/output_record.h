@@ -0,0 +1,110 @@
+#pragma once
+
+/* Binary record printers behind readpe_output_*, used when the format of
+ * the output is READPE_OUTPUT_FORMAT_RECORD. The layout is described in
+ * lib/readpe.h, and only the tables defined there are written. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pe.h"
+
+#include "lib/context.h"
+
+#include "./output.h"
+
+void
+readpe_output_record_begin_file(
+    readpe_output_t* out,
+    const char*      path
+);
+
+void
+readpe_output_record_end_file(
+    readpe_output_t* out,
+    readpe_error_t   err
+);
+
+void
+readpe_output_record_section_table(
+    readpe_output_t*                 out,
+    const pe_image_section_header_t* table,
+    size_t                           rows
+);
+
+void
+readpe_output_record_export_table(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_import_table(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_relocation_table(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_relocation_density(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_hashes(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_authenticode(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_fingerprints(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+void
+readpe_output_record_section_stats(
+    readpe_output_t*        out,
+    const readpe_context_t* ctx
+);
+
+readpe_error_t
+readpe_output_record_strings(
+    readpe_output_t*                out,
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts
+);
+
+readpe_error_t
+readpe_output_record_signatures(
+    readpe_output_t*           out,
+    const readpe_context_t*    ctx,
+    const readpe_signatures_t* sigs,
+    readpe_signature_layout_t  layout
+);
+
+void
+readpe_output_record_bindings(
+    readpe_output_t*        out,
+    const readpe_modules_t* mods,
+    size_t                  index
+);
+
+readpe_error_t
+readpe_output_record_load_order(
+    readpe_output_t*        out,
+    const readpe_modules_t* mods,
+    size_t                  index
+);
@@ -0,0 +1,786 @@
+/* struct statx */
+#define _GNU_SOURCE
+
+#include "./read_ahead.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+# define READPE_READ_AHEAD_URING_ 1
+#endif
+
+#if defined(READPE_READ_AHEAD_URING_)
+
+#include <errno.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "pe.h"
+
+#define READPE_READ_AHEAD_DEPTH_     64          /* files in flight */
+#define READPE_READ_AHEAD_WINDOW_    128         /* files ahead of users */
+#define READPE_READ_AHEAD_BYTES_MAX_ (256 << 20)  /* held by files not taken */
+#define READPE_READ_AHEAD_FILE_MAX_  (64 << 20)   /* larger reads are mapped */
+#define READPE_READ_AHEAD_HEADERS_   4096  /* read first, covering most */
+
+typedef enum readpe_read_ahead_state_t_ {
+  READPE_READ_AHEAD_PENDING_,
+  READPE_READ_AHEAD_STATING_,
+  READPE_READ_AHEAD_STATED_,   /* waits for memory to open */
+  READPE_READ_AHEAD_OPENING_,
+  READPE_READ_AHEAD_PLANNED_,  /* waits for memory to read more */
+  READPE_READ_AHEAD_READING_,
+  READPE_READ_AHEAD_DONE_,
+} readpe_read_ahead_state_t_;
+
+typedef struct readpe_read_ahead_range_t_ {
+  size_t begin;
+  size_t end;
+} readpe_read_ahead_range_t_;
+
+typedef struct readpe_read_ahead_item_t_ {
+  readpe_read_ahead_state_t_ state;  /* owned by the reader thread */
+  bool                       done;   /* guarded by mtx */
+
+  int    fd;
+  size_t slot;  /* of statx buffer while stating */
+
+  uint8_t* body;  /* NULLABLE: mapped with the length of the file */
+  size_t   len;
+  size_t   held;  /* bytes counted as buffered */
+  size_t   need;  /* bytes to be counted before going on */
+
+  /* The beginning is read up to the target while the ranges are NULL,
+   * then the ranges are read in order. */
+  size_t                      prefix;
+  size_t                      target;
+  readpe_read_ahead_range_t_* ranges;  /* NULLABLE */
+  size_t                      ranges_length;
+  size_t                      range;
+  size_t                      offset;  /* where the next read begins */
+} readpe_read_ahead_item_t_;
+
+struct readpe_read_ahead_t {
+  char* const* paths;
+  size_t       length;
+
+  readpe_read_ahead_extent_t extent;
+  readpe_read_ahead_item_t_* items;
+
+  /* rings shared with the kernel */
+  int       ring;
+  void*     ring_map;
+  size_t    ring_map_length;
+  struct io_uring_sqe* sqes;
+  size_t               sqes_length;
+
+  uint32_t* sq_head;
+  uint32_t* sq_tail;
+  uint32_t* sq_mask;
+  uint32_t* sq_array;
+  uint32_t  sq_entries;
+  uint32_t  sq_tail_local;  /* entries filled, published on submission */
+
+  uint32_t*            cq_head;
+  uint32_t*            cq_tail;
+  uint32_t*            cq_mask;
+  struct io_uring_cqe* cqes;
+
+  /* owned by the reader thread */
+  size_t next;      /* the first item not started */
+  size_t first;     /* the first item not done */
+  size_t inflight;  /* operations submitted and not completed */
+
+  struct statx stx[READPE_READ_AHEAD_DEPTH_];
+  size_t       stx_free[READPE_READ_AHEAD_DEPTH_];
+  size_t       stx_free_length;
+
+  pthread_t       thread;
+  pthread_mutex_t mtx;
+  pthread_cond_t  done_cond;   /* some item is done */
+  pthread_cond_t  taken_cond;  /* some item is taken */
+
+  /* guarded by mtx */
+  size_t taken;
+  size_t wanted;      /* items up to which some users are waiting for */
+  size_t generation;  /* changed whenever the above changes */
+  size_t buffered;  /* bytes of items reserved and not taken */
+  bool   stopping;
+};
+
+static int readpe_read_ahead_setup_(
+    uint32_t entries, struct io_uring_params* p) {
+  return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int readpe_read_ahead_enter_(
+    int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+  return (int) syscall(__NR_io_uring_enter,
+      fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static bool readpe_read_ahead_map_(readpe_read_ahead_t* ra) {
+  assert(ra != NULL);
+
+  struct io_uring_params p = {0};
+  ra->ring = readpe_read_ahead_setup_(READPE_READ_AHEAD_DEPTH_, &p);
+  if (ra->ring < 0) return false;
+
+  /* older kernels mapping the rings separately are not supported */
+  if (!(p.features & IORING_FEAT_SINGLE_MMAP)) return false;
+
+  const size_t sq_len = p.sq_off.array + p.sq_entries*sizeof(uint32_t);
+  const size_t cq_len =
+      p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+  ra->ring_map_length = sq_len > cq_len? sq_len: cq_len;
+
+  ra->ring_map = mmap(NULL, ra->ring_map_length, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ra->ring, IORING_OFF_SQ_RING);
+  if (ra->ring_map == MAP_FAILED) {
+    ra->ring_map = NULL;
+    return false;
+  }
+
+  ra->sqes_length = p.sq_entries*sizeof(struct io_uring_sqe);
+  ra->sqes = mmap(NULL, ra->sqes_length, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ra->ring, IORING_OFF_SQES);
+  if (ra->sqes == MAP_FAILED) {
+    ra->sqes = NULL;
+    return false;
+  }
+
+  uint8_t* m = ra->ring_map;
+  ra->sq_head    = (uint32_t*) (m + p.sq_off.head);
+  ra->sq_tail    = (uint32_t*) (m + p.sq_off.tail);
+  ra->sq_mask    = (uint32_t*) (m + p.sq_off.ring_mask);
+  ra->sq_array   = (uint32_t*) (m + p.sq_off.array);
+  ra->sq_entries = p.sq_entries;
+  ra->sq_tail_local = *ra->sq_tail;
+
+  ra->cq_head = (uint32_t*) (m + p.cq_off.head);
+  ra->cq_tail = (uint32_t*) (m + p.cq_off.tail);
+  ra->cq_mask = (uint32_t*) (m + p.cq_off.ring_mask);
+  ra->cqes    = (struct io_uring_cqe*) (m + p.cq_off.cqes);
+  return true;
+}
+
+static void readpe_read_ahead_unmap_(readpe_read_ahead_t* ra) {
+  assert(ra != NULL);
+
+  if (ra->sqes     != NULL) munmap(ra->sqes, ra->sqes_length);
+  if (ra->ring_map != NULL) munmap(ra->ring_map, ra->ring_map_length);
+  if (ra->ring     >= 0)    close(ra->ring);
+}
+
+/* Operations in flight never exceed the depth, so the queue is never full. */
+static struct io_uring_sqe* readpe_read_ahead_push_(
+    readpe_read_ahead_t* ra, size_t index, uint8_t opcode) {
+  assert(ra != NULL);
+
+  const uint32_t tail = ra->sq_tail_local++;
+  assert(tail - __atomic_load_n(ra->sq_head, __ATOMIC_ACQUIRE) <
+      ra->sq_entries);
+
+  const uint32_t i = tail & *ra->sq_mask;
+  struct io_uring_sqe* sqe = &ra->sqes[i];
+  *sqe = (typeof(*sqe)) {
+    .opcode    = opcode,
+    .user_data = index,
+  };
+  ra->sq_array[i] = i;
+
+  ++ra->inflight;
+  return sqe;
+}
+
+/* Returns the number of entries which the kernel has not consumed yet. */
+static uint32_t readpe_read_ahead_publish_(readpe_read_ahead_t* ra) {
+  assert(ra != NULL);
+
+  __atomic_store_n(ra->sq_tail, ra->sq_tail_local, __ATOMIC_RELEASE);
+  return ra->sq_tail_local - __atomic_load_n(ra->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/* Files are stated before opened, so FIFOs and devices, whose open may
+ * block, are never opened here. */
+static void readpe_read_ahead_stat_(readpe_read_ahead_t* ra, size_t index) {
+  assert(ra != NULL);
+  assert(ra->stx_free_length > 0);
+
+  readpe_read_ahead_item_t_* item = &ra->items[index];
+  item->state = READPE_READ_AHEAD_STATING_;
+  item->slot  = ra->stx_free[--ra->stx_free_length];
+
+  struct io_uring_sqe* sqe =
+      readpe_read_ahead_push_(ra, index, IORING_OP_STATX);
+  sqe->fd   = AT_FDCWD;
+  sqe->addr = (uintptr_t) ra->paths[index];
+  sqe->len  = STATX_TYPE | STATX_SIZE;
+  sqe->off  = (uintptr_t) &ra->stx[item->slot];
+}
+
+static void readpe_read_ahead_open_(readpe_read_ahead_t* ra, size_t index) {
+  assert(ra != NULL);
+
+  readpe_read_ahead_item_t_* item = &ra->items[index];
+  item->state = READPE_READ_AHEAD_OPENING_;
+
+  struct io_uring_sqe* sqe =
+      readpe_read_ahead_push_(ra, index, IORING_OP_OPENAT);
+  sqe->fd         = AT_FDCWD;
+  sqe->addr       = (uintptr_t) ra->paths[index];
+  sqe->open_flags = O_RDONLY | O_CLOEXEC;
+}
+
+static void readpe_read_ahead_read_(readpe_read_ahead_t* ra, size_t index) {
+  assert(ra != NULL);
+
+  readpe_read_ahead_item_t_* item = &ra->items[index];
+  item->state = READPE_READ_AHEAD_READING_;
+
+  const size_t end = item->ranges != NULL?
+      item->ranges[item->range].end: item->target;
+  assert(item->offset < end);
+
+  struct io_uring_sqe* sqe =
+      readpe_read_ahead_push_(ra, index, IORING_OP_READ);
+  sqe->fd   = item->fd;
+  sqe->addr = (uintptr_t) (item->body + item->offset);
+  sqe->len  = end - item->offset;
+  sqe->off  = item->offset;
+}
+
+/* the optional header is read up to the data directories before its size
+ * is validated */
+#define READPE_READ_AHEAD_NT_SIZE_  \
+    (offsetof(pe_nt_header_t, optional) +  \
+     offsetof(pe64_image_optional_header_t, data_directory))
+
+/* Returns the length of the beginning which parsing the headers reads, as
+ * far as the first len bytes tell. Anything after the DOS header is left
+ * out if parsing fails before reaching it. */
+static size_t readpe_read_ahead_headers_length_(
+    const uint8_t* buf, size_t len, size_t size) {
+  assert(buf != NULL);
+
+  if (size < PE_DOS_HEADER_SIZE) return size;
+  if (len  < PE_DOS_HEADER_SIZE) return PE_DOS_HEADER_SIZE;
+
+  const pe_dos_header_t* dos_header = (typeof(dos_header)) buf;
+  if (dos_header->e_magic != PE_DOS_MAGIC || dos_header->e_lfanew < 0) {
+    return PE_DOS_HEADER_SIZE;
+  }
+
+  const uintmax_t nt_end =
+      (uintmax_t) dos_header->e_lfanew + READPE_READ_AHEAD_NT_SIZE_;
+  if (nt_end > size) return PE_DOS_HEADER_SIZE;
+  if (nt_end > len)  return nt_end;
+
+  const pe_nt_header_t* nt_header =
+      (typeof(nt_header)) (buf + dos_header->e_lfanew);
+
+  uintmax_t headers;
+  switch (nt_header->file.machine) {
+  case PE_IMAGE_FILE_MACHINE_I386:
+    headers = nt_header->optional._32bit.size_of_headers;
+    break;
+  case PE_IMAGE_FILE_MACHINE_AMD64:
+  case PE_IMAGE_FILE_MACHINE_IA64:
+    headers = nt_header->optional._64bit.size_of_headers;
+    break;
+  default:
+    return nt_end;
+  }
+  if (headers > size || headers <= nt_end) return nt_end;
+  return headers;
+}
+
+static int readpe_read_ahead_compare_ranges_(const void* a, const void* b) {
+  const readpe_read_ahead_range_t_* x = a;
+  const readpe_read_ahead_range_t_* y = b;
+  return (x->begin > y->begin) - (x->begin < y->begin);
+}
+
+/* Lists raw data of sections not read yet, merging overlaps. Sections out
+ * of the file are skipped, as parsing fails on them before touching any
+ * raw data. Returns false on allocation failure. */
+static bool readpe_read_ahead_plan_sections_(
+    readpe_read_ahead_item_t_* item) {
+  assert(item != NULL);
+
+  const uint8_t* buf = item->body;
+
+  const pe_dos_header_t* dos_header = (typeof(dos_header)) buf;
+  if (item->prefix < PE_DOS_HEADER_SIZE ||
+      dos_header->e_magic != PE_DOS_MAGIC ||
+      dos_header->e_lfanew < 0 ||
+      (uintmax_t) dos_header->e_lfanew + READPE_READ_AHEAD_NT_SIZE_ >
+        item->prefix) {
+    return true;
+  }
+  const pe_nt_header_t* nt_header =
+      (typeof(nt_header)) (buf + dos_header->e_lfanew);
+
+  const uintmax_t table =
+      (uintmax_t) dos_header->e_lfanew +
+      sizeof(nt_header->signature) +
+      PE_IMAGE_FILE_HEADER_SIZE +
+      nt_header->file.size_of_optional_header;
+  const size_t n = nt_header->file.number_of_sections;
+  if (n == 0 || table + n*PE_IMAGE_SECTION_HEADER_SIZE > item->prefix) {
+    return true;
+  }
+  const pe_image_section_header_t* sections =
+      (typeof(sections)) (buf + table);
+
+  item->ranges = malloc(n*sizeof(*item->ranges));
+  if (item->ranges == NULL) return false;
+
+  size_t k = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const pe_image_section_header_t* s = &sections[i];
+
+    uintmax_t begin = s->pointer_to_raw_data;
+    uintmax_t end   = begin + s->size_of_raw_data;
+    if (end > item->len) continue;
+    if (begin < item->prefix) begin = item->prefix;
+    if (begin >= end) continue;
+
+    item->ranges[k++] = (readpe_read_ahead_range_t_) {
+      .begin = begin,
+      .end   = end,
+    };
+  }
+  if (k > 1) {
+    qsort(item->ranges, k, sizeof(*item->ranges),
+        readpe_read_ahead_compare_ranges_);
+  }
+
+  size_t m = 0;
+  for (size_t i = 0; i < k; ++i) {
+    readpe_read_ahead_range_t_* r = &item->ranges[i];
+    if (m > 0 && r->begin <= item->ranges[m-1].end) {
+      if (item->ranges[m-1].end < r->end) item->ranges[m-1].end = r->end;
+    } else {
+      item->ranges[m++] = *r;
+    }
+  }
+  item->ranges_length = m;
+  return true;
+}
+
+/* The item is given up, and left to be read as usual. */
+static void readpe_read_ahead_drop_(
+    readpe_read_ahead_t* ra, readpe_read_ahead_item_t_* item) {
+  assert(ra   != NULL);
+  assert(item != NULL);
+
+  if (item->fd >= 0) close(item->fd);
+  item->fd = -1;
+
+  if (item->body != NULL) munmap(item->body, item->len);
+  item->body = NULL;
+  item->len  = 0;
+
+  pthread_mutex_lock(&ra->mtx);
+  ra->buffered -= item->held;
+  pthread_mutex_unlock(&ra->mtx);
+  item->held = 0;
+}
+
+static void readpe_read_ahead_finish_(
+    readpe_read_ahead_t* ra, readpe_read_ahead_item_t_* item) {
+  assert(ra   != NULL);
+  assert(item != NULL);
+
+  if (item->fd >= 0) close(item->fd);
+  item->fd = -1;
+
+  free(item->ranges);
+  item->ranges        = NULL;
+  item->ranges_length = 0;
+
+  item->state = READPE_READ_AHEAD_DONE_;
+
+  pthread_mutex_lock(&ra->mtx);
+  item->done = true;
+  pthread_cond_broadcast(&ra->done_cond);
+  pthread_mutex_unlock(&ra->mtx);
+}
+
+/* Reserves memory of items waiting for it in order. The first item not
+ * done always gets it, as users are waiting for it. The contents are
+ * mapped, so parts never read take no memory. */
+static void readpe_read_ahead_reserve_(readpe_read_ahead_t* ra) {
+  assert(ra != NULL);
+
+  while (ra->first < ra->next &&
+      ra->items[ra->first].state == READPE_READ_AHEAD_DONE_) {
+    ++ra->first;
+  }
+
+  for (size_t i = ra->first; i < ra->next; ++i) {
+    readpe_read_ahead_item_t_* item = &ra->items[i];
+    if (item->state != READPE_READ_AHEAD_STATED_ &&
+        item->state != READPE_READ_AHEAD_PLANNED_) {
+      continue;
+    }
+    if (ra->inflight >= READPE_READ_AHEAD_DEPTH_) break;
+
+    pthread_mutex_lock(&ra->mtx);
+    const bool ok = i == ra->first ||
+        ra->buffered + item->need <= READPE_READ_AHEAD_BYTES_MAX_;
+    if (ok) ra->buffered += item->need;
+    pthread_mutex_unlock(&ra->mtx);
+    if (!ok) break;
+
+    item->held += item->need;
+    item->need  = 0;
+
+    if (item->state == READPE_READ_AHEAD_PLANNED_) {
+      readpe_read_ahead_read_(ra, i);
+      continue;
+    }
+
+    item->body = mmap(NULL, item->len, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (item->body == MAP_FAILED) {
+      item->body = NULL;
+      readpe_read_ahead_drop_(ra, item);
+      readpe_read_ahead_finish_(ra, item);
+      continue;
+    }
+    readpe_read_ahead_open_(ra, i);
+  }
+}
+
+/* Goes on after the part being read is done: the headers are read up to
+ * their whole length, and then raw data of sections if needed. */
+static void readpe_read_ahead_advance_(
+    readpe_read_ahead_t* ra, size_t index) {
+  assert(ra != NULL);
+
+  readpe_read_ahead_item_t_* item = &ra->items[index];
+
+  if (item->ranges != NULL) {
+    if (++item->range < item->ranges_length) {
+      item->offset = item->ranges[item->range].begin;
+      readpe_read_ahead_read_(ra, index);
+      return;
+    }
+    readpe_read_ahead_finish_(ra, item);
+    return;
+  }
+
+  item->prefix = item->target;
+  if (ra->extent == READPE_READ_AHEAD_WHOLE) {
+    readpe_read_ahead_finish_(ra, item);
+    return;
+  }
+
+  const size_t headers =
+      readpe_read_ahead_headers_length_(item->body, item->prefix, item->len);
+  if (headers > item->prefix) {
+    if (headers > READPE_READ_AHEAD_FILE_MAX_) goto DROP;
+    item->target = headers;
+    item->need   = headers - item->prefix;
+    item->state  = READPE_READ_AHEAD_PLANNED_;
+    return;
+  }
+  if (ra->extent == READPE_READ_AHEAD_HEADERS) {
+    readpe_read_ahead_finish_(ra, item);
+    return;
+  }
+
+  if (!readpe_read_ahead_plan_sections_(item)) goto DROP;
+  if (item->ranges_length == 0) {
+    readpe_read_ahead_finish_(ra, item);
+    return;
+  }
+
+  size_t total = 0;
+  for (size_t i = 0; i < item->ranges_length; ++i) {
+    total += item->ranges[i].end - item->ranges[i].begin;
+  }
+  if (total > READPE_READ_AHEAD_FILE_MAX_) goto DROP;
+
+  item->range  = 0;
+  item->offset = item->ranges[0].begin;
+  item->need   = total;
+  item->state  = READPE_READ_AHEAD_PLANNED_;
+  return;
+
+DROP:
+  readpe_read_ahead_drop_(ra, item);
+  readpe_read_ahead_finish_(ra, item);
+}
+
+static void readpe_read_ahead_complete_(
+    readpe_read_ahead_t* ra, size_t index, int res, bool stopping) {
+  assert(ra != NULL);
+
+  readpe_read_ahead_item_t_* item = &ra->items[index];
+  --ra->inflight;
+
+  switch (item->state) {
+  case READPE_READ_AHEAD_STATING_: {
+      const struct statx* stx = &ra->stx[item->slot];
+      ra->stx_free[ra->stx_free_length++] = item->slot;
+
+      if (res < 0 || stopping || !S_ISREG(stx->stx_mode) ||
+          stx->stx_size == 0 || stx->stx_size > SIZE_MAX) {
+        break;
+      }
+      item->len = stx->stx_size;
+
+      if (ra->extent == READPE_READ_AHEAD_WHOLE) {
+        if (item->len > READPE_READ_AHEAD_FILE_MAX_) break;
+        item->target = item->len;
+      } else {
+        item->target = item->len < READPE_READ_AHEAD_HEADERS_?
+            item->len: READPE_READ_AHEAD_HEADERS_;
+      }
+      item->need  = item->target;
+      item->state = READPE_READ_AHEAD_STATED_;
+    }
+    return;
+
+  case READPE_READ_AHEAD_OPENING_:
+    if (res < 0) break;
+    item->fd = res;
+    if (stopping) break;
+    readpe_read_ahead_read_(ra, index);
+    return;
+
+  case READPE_READ_AHEAD_READING_: {
+      /* files shrunk while read are left to be reported as usual */
+      if (res <= 0 || stopping) break;
+      item->offset += res;
+
+      const size_t end = item->ranges != NULL?
+          item->ranges[item->range].end: item->target;
+      if (item->offset < end) {
+        readpe_read_ahead_read_(ra, index);
+      } else {
+        readpe_read_ahead_advance_(ra, index);
+      }
+    }
+    return;
+
+  default:
+    assert(false);
+    return;
+  }
+  readpe_read_ahead_drop_(ra, item);
+  readpe_read_ahead_finish_(ra, item);
+}
+
+static void* readpe_read_ahead_main_(void* ptr) {
+  readpe_read_ahead_t* ra = ptr;
+
+  for (;;) {
+    pthread_mutex_lock(&ra->mtx);
+    const bool   stopping   = ra->stopping;
+    const size_t generation = ra->generation;
+    const bool   room       = ra->buffered < READPE_READ_AHEAD_BYTES_MAX_;
+
+    /* items waited for are started even beyond the window */
+    size_t limit = ra->taken + READPE_READ_AHEAD_WINDOW_;
+    if (limit < ra->wanted) limit = ra->wanted;
+    pthread_mutex_unlock(&ra->mtx);
+
+    if (!stopping) {
+      readpe_read_ahead_reserve_(ra);
+      while (room && ra->next < ra->length && ra->next < limit &&
+          ra->inflight < READPE_READ_AHEAD_DEPTH_) {
+        readpe_read_ahead_stat_(ra, ra->next++);
+      }
+    }
+
+    if (ra->inflight == 0) {
+      if (stopping || ra->first >= ra->length) break;
+
+      /* nothing can be read until users take some */
+      pthread_mutex_lock(&ra->mtx);
+      while (!ra->stopping && ra->generation == generation) {
+        pthread_cond_wait(&ra->taken_cond, &ra->mtx);
+      }
+      pthread_mutex_unlock(&ra->mtx);
+      continue;
+    }
+
+    const uint32_t to_submit = readpe_read_ahead_publish_(ra);
+    if (readpe_read_ahead_enter_(
+          ra->ring, to_submit, 1, IORING_ENTER_GETEVENTS) < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+      break;
+    }
+
+    uint32_t       head = *ra->cq_head;
+    const uint32_t tail = __atomic_load_n(ra->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const struct io_uring_cqe* cqe = &ra->cqes[head & *ra->cq_mask];
+      readpe_read_ahead_complete_(ra, cqe->user_data, cqe->res, stopping);
+    }
+    __atomic_store_n(ra->cq_head, head, __ATOMIC_RELEASE);
+  }
+
+  /* items left are read as usual by users */
+  for (size_t i = ra->first; i < ra->length; ++i) {
+    readpe_read_ahead_item_t_* item = &ra->items[i];
+    if (item->state == READPE_READ_AHEAD_DONE_) continue;
+
+    /* buffers of operations in flight are still written by the kernel,
+     * which happens only if io_uring_enter failed */
+    if (item->state == READPE_READ_AHEAD_READING_) item->body = NULL;
+    readpe_read_ahead_drop_(ra, item);
+    readpe_read_ahead_finish_(ra, item);
+  }
+  return NULL;
+}
+
+bool readpe_read_ahead_start(
+    readpe_read_ahead_t**      ra,
+    char* const*               paths,
+    size_t                     len,
+    readpe_read_ahead_extent_t extent) {
+  assert(ra    != NULL);
+  assert(paths != NULL || len == 0);
+  assert(extent != READPE_READ_AHEAD_NONE);
+
+  *ra = calloc(1, sizeof(**ra));
+  if (*ra == NULL) return false;
+
+  readpe_read_ahead_t* r = *ra;
+  r->paths  = paths;
+  r->length = len;
+  r->extent = extent;
+  r->ring   = -1;
+  r->items  = calloc(len > 0? len: 1, sizeof(*r->items));
+  if (r->items == NULL || !readpe_read_ahead_map_(r)) goto ABORT;
+
+  for (size_t i = 0; i < len; ++i) r->items[i].fd = -1;
+  for (size_t i = 0; i < READPE_READ_AHEAD_DEPTH_; ++i) {
+    r->stx_free[r->stx_free_length++] = i;
+  }
+
+  pthread_mutex_init(&r->mtx, NULL);
+  pthread_cond_init(&r->done_cond, NULL);
+  pthread_cond_init(&r->taken_cond, NULL);
+  if (pthread_create(&r->thread, NULL, readpe_read_ahead_main_, r) != 0) {
+    pthread_cond_destroy(&r->taken_cond);
+    pthread_cond_destroy(&r->done_cond);
+    pthread_mutex_destroy(&r->mtx);
+    goto ABORT;
+  }
+  return true;
+
+ABORT:
+  readpe_read_ahead_unmap_(r);
+  free(r->items);
+  free(r);
+  *ra = NULL;
+  return false;
+}
+
+void readpe_read_ahead_take(
+    readpe_read_ahead_t* ra, size_t index, uint8_t** body, size_t* len) {
+  assert(ra   != NULL);
+  assert(body != NULL);
+  assert(len  != NULL);
+  assert(index < ra->length);
+
+  readpe_read_ahead_item_t_* item = &ra->items[index];
+
+  pthread_mutex_lock(&ra->mtx);
+  if (!item->done && ra->wanted <= index) {
+    ra->wanted = index+1;
+    ++ra->generation;
+    pthread_cond_signal(&ra->taken_cond);
+  }
+  while (!item->done) {
+    pthread_cond_wait(&ra->done_cond, &ra->mtx);
+  }
+  *body = item->body;
+  *len  = item->len;
+  item->body = NULL;
+
+  ra->buffered -= item->held;
+  ++ra->taken;
+  ++ra->generation;
+  pthread_cond_signal(&ra->taken_cond);
+  pthread_mutex_unlock(&ra->mtx);
+}
+
+void readpe_read_ahead_release(uint8_t* body, size_t len) {
+  if (body != NULL) munmap(body, len);
+}
+
+void readpe_read_ahead_stop(readpe_read_ahead_t* ra) {
+  if (ra == NULL) return;
+
+  pthread_mutex_lock(&ra->mtx);
+  ra->stopping = true;
+  pthread_cond_signal(&ra->taken_cond);
+  pthread_mutex_unlock(&ra->mtx);
+  pthread_join(ra->thread, NULL);
+
+  for (size_t i = 0; i < ra->length; ++i) {
+    readpe_read_ahead_release(ra->items[i].body, ra->items[i].len);
+  }
+
+  pthread_cond_destroy(&ra->taken_cond);
+  pthread_cond_destroy(&ra->done_cond);
+  pthread_mutex_destroy(&ra->mtx);
+  readpe_read_ahead_unmap_(ra);
+  free(ra->items);
+  free(ra);
+}
+
+#else  /* !READPE_READ_AHEAD_URING_ */
+
+bool readpe_read_ahead_start(
+    readpe_read_ahead_t**      ra,
+    char* const*               paths,
+    size_t                     len,
+    readpe_read_ahead_extent_t extent) {
+  assert(ra != NULL);
+
+  (void) paths;
+  (void) len;
+  (void) extent;
+
+  *ra = NULL;
+  return false;
+}
+
+void readpe_read_ahead_take(
+    readpe_read_ahead_t* ra, size_t index, uint8_t** body, size_t* len) {
+  (void) ra;
+  (void) index;
+
+  *body = NULL;
+  *len  = 0;
+}
+
+void readpe_read_ahead_release(uint8_t* body, size_t len) {
+  (void) body;
+  (void) len;
+}
+
+void readpe_read_ahead_stop(readpe_read_ahead_t* ra) {
+  (void) ra;
+}
+
+#endif
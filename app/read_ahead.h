@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Reads files of a list ahead of their users through io_uring, keeping
+ * many reads in flight at once. The headers of each file are read first,
+ * then only the parts its users touch. Files are read in order of the list
+ * within a window, so the memory held stays bounded. */
+typedef struct readpe_read_ahead_t readpe_read_ahead_t;
+
+/* parts of files which users touch */
+typedef enum readpe_read_ahead_extent_t {
+  READPE_READ_AHEAD_NONE,      /* files are read as usual */
+  READPE_READ_AHEAD_HEADERS,   /* up to the section table */
+  READPE_READ_AHEAD_SECTIONS,  /* and raw data of sections */
+  READPE_READ_AHEAD_WHOLE,
+} readpe_read_ahead_extent_t;
+
+bool
+readpe_read_ahead_start(
+    readpe_read_ahead_t**      ra,
+    char* const*               paths,  /* must be alive until stopped */
+    size_t                     len,
+    readpe_read_ahead_extent_t extent
+);
+    /* Returns false if io_uring is unavailable, then files should be read
+     * as usual. */
+
+void
+readpe_read_ahead_take(
+    readpe_read_ahead_t* ra,
+    size_t               index,
+    uint8_t**            body,  /* NULL if the file was not read ahead */
+    size_t*              len
+);
+    /* Waits for the file to be read, and passes the contents to the caller,
+     * who must release them. The contents have the length of the file,
+     * with zeros in parts out of the extent. Files which cannot be opened,
+     * are not regular or are too large are left to be read as usual, so
+     * their errors are reported in the same way. Each file must be taken
+     * once. */
+
+void
+readpe_read_ahead_release(
+    uint8_t* body,  /* NULLABLE */
+    size_t   len
+);
+
+void
+readpe_read_ahead_stop(
+    readpe_read_ahead_t* ra  /* NULLABLE */
+);
+    /* Cancels files not taken yet. */
@@ -0,0 +1,145 @@
+#include "./resolve_command.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lib/readpe.h"
+
+#include "./args.h"
+#include "./batch.h"
+#include "./output.h"
+
+typedef struct readpe_resolve_command_t {
+  const readpe_args_t* args;
+  readpe_modules_t*    mods;
+  bool                 batch;  /* more than one module is printed */
+} readpe_resolve_command_t;
+
+static bool readpe_resolve_command_load_(
+    void* udata, readpe_output_t* out, const readpe_batch_file_t* file) {
+  readpe_resolve_command_t* r = udata;
+  assert(r    != NULL);
+  assert(out  != NULL);
+  assert(file != NULL);
+
+  (void) out;
+
+  const char* path = file->path;
+
+  /* each module is parsed once here, and shared by all importers */
+  readpe_context_t* ctx;
+  readpe_error_t    err = readpe_context_create(&ctx, path);
+  if (err == READPE_OK) {
+    err = readpe_modules_add(r->mods, path, &ctx);
+    readpe_context_destroy(ctx);
+  }
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s: %s\n", path, readpe_error_stringify(err));
+  }
+  return err == READPE_OK;
+}
+
+static bool readpe_resolve_command_print_(
+    void* udata, readpe_output_t* out, const readpe_batch_file_t* file) {
+  readpe_resolve_command_t* r = udata;
+  assert(r    != NULL);
+  assert(out  != NULL);
+  assert(file != NULL);
+
+  const char* path = file->path;
+
+  /* modules are ordered by their paths once linked */
+  size_t l = 0, h = readpe_modules_get_length(r->mods);
+  while (l < h) {
+    const size_t m = l + (h-l)/2;
+    if (strcmp(readpe_modules_get_path(r->mods, m), path) < 0) {
+      l = m+1;
+    } else {
+      h = m;
+    }
+  }
+  assert(l < readpe_modules_get_length(r->mods));
+
+  readpe_output_begin_file(out, path, r->batch);
+  readpe_output_bindings(out, r->mods, l);
+
+  const readpe_error_t err = readpe_output_load_order(out, r->mods, l);
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s: %s\n", path, readpe_error_stringify(err));
+  }
+  readpe_output_end_file(out, err);
+  return err == READPE_OK;
+}
+
+bool readpe_resolve_command_run(const readpe_args_t* args) {
+  assert(args != NULL);
+
+  bool ret = false;
+
+  readpe_resolve_command_t r = { .args = args, };
+
+  readpe_batch_t inputs, modules;
+  readpe_batch_initialize(&inputs);
+  readpe_batch_initialize(&modules);
+
+  readpe_error_t err = readpe_modules_create(&r.mods);
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s\n", readpe_error_stringify(err));
+    goto FINALIZE;
+  }
+
+  for (size_t i = 0; i < args->inputs_length; ++i) {
+    if (!readpe_batch_add_path(&inputs, args->inputs[i], stderr)) goto FINALIZE;
+  }
+  if (args->stdin_list) {
+    const char delim = args->null_separated? '\0': '\n';
+    if (!readpe_batch_add_list(&inputs, stdin, delim, stderr)) goto FINALIZE;
+  }
+
+  /* the set is made of the files parsed, even if some are broken, and
+   * they are mapped as the contexts outlive the jobs */
+  ret = readpe_batch_run(&inputs, args->jobs, false, READPE_READ_AHEAD_NONE,
+      stdout, stderr, READPE_OUTPUT_FORMAT_TEXT, NULL,
+      readpe_resolve_command_load_, &r);
+
+  err = readpe_modules_link(r.mods, args->jobs);
+  if (err != READPE_OK) {
+    fprintf(stderr, "%s\n", readpe_error_stringify(err));
+    ret = false;
+    goto FINALIZE;
+  }
+
+  const size_t n = readpe_modules_get_length(r.mods);
+  for (size_t i = 0; i < n; ++i) {
+    const char* path = readpe_modules_get_path(r.mods, i);
+    if (!readpe_batch_add_path(&modules, path, stderr)) {
+      ret = false;
+      goto FINALIZE;
+    }
+  }
+  r.batch = args->batch || n != 1;
+
+  readpe_output_t out;
+  readpe_output_initialize(&out, stdout, args->format);
+  readpe_output_begin_batch(&out, r.batch);
+  readpe_output_flush(&out);
+
+  const char* sep = readpe_output_get_separator(args->format, r.batch);
+  if (!readpe_batch_run(&modules, args->jobs, !args->unordered,
+        READPE_READ_AHEAD_NONE, stdout, stderr, args->format, sep,
+        readpe_resolve_command_print_, &r)) {
+    ret = false;
+  }
+
+  readpe_output_end_batch(&out, r.batch);
+  readpe_output_deinitialize(&out);
+
+FINALIZE:
+  readpe_modules_destroy(r.mods);
+  readpe_batch_deinitialize(&modules);
+  readpe_batch_deinitialize(&inputs);
+  return ret;
+}
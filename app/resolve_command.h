@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "./args.h"
+
+bool
+readpe_resolve_command_run(
+    const readpe_args_t* args
+);
+    /* Takes every input as a module of one set, binds their imports to
+     * each other and prints the bindings and the load order of each.
+     * Files failing to parse are reported and left out of the set. */
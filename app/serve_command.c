@@ -0,0 +1,464 @@
+/* unshare() and accept4() */
+#define _GNU_SOURCE
+
+#include "./serve_command.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "./args.h"
+#include "./context_lru.h"
+#include "./inspect_command.h"
+
+/* A request is a uint32_t length followed by the arguments, each terminated
+ * by NUL, sent with the descriptors of stdin, stdout, stderr and the working
+ * directory of the client. The server answers one byte, 0 on success, after
+ * closing its copies of the streams. */
+#define READPE_SERVE_COMMAND_FDS_ 4
+#define READPE_SERVE_COMMAND_REQUEST_MAX_ (1 << 20)
+
+/* a client sending no request in time is dropped to free the worker */
+#define READPE_SERVE_COMMAND_TIMEOUT_SEC_ 10
+
+typedef struct readpe_serve_command_t {
+  const readpe_args_t* args;
+  int                  listener;
+
+  readpe_context_lru_t contexts;
+
+  pthread_mutex_t mtx;
+  bool            stopping;
+} readpe_serve_command_t;
+
+static bool readpe_serve_command_address_(
+    struct sockaddr_un* addr, const char* path) {
+  assert(addr != NULL);
+  assert(path != NULL);
+
+  *addr = (typeof(*addr)) { .sun_family = AF_UNIX, };
+
+  const size_t len = strlen(path);
+  if (len >= sizeof(addr->sun_path)) return false;
+  memcpy(addr->sun_path, path, len+1);
+  return true;
+}
+
+static bool readpe_serve_command_read_(int fd, void* buf, size_t len) {
+  uint8_t* p = buf;
+  while (len > 0) {
+    const ssize_t n = read(fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p   += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool readpe_serve_command_write_(int fd, const void* buf, size_t len) {
+  const uint8_t* p = buf;
+  while (len > 0) {
+    const ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p   += n;
+    len -= n;
+  }
+  return true;
+}
+
+/* Tells if the peer runs as the same user as this process, as the server
+ * and the client trust each other with their files and streams. */
+static bool readpe_serve_command_trust_(int sock) {
+  struct ucred cred;
+  socklen_t    len = sizeof(cred);
+  return
+      getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+      len == sizeof(cred) &&
+      cred.uid == geteuid();
+}
+
+/* Takes the arguments and the descriptors, which are closed. */
+static bool readpe_serve_command_process_(
+    readpe_serve_command_t* s, char* payload, size_t len, int* fds) {
+  assert(s       != NULL);
+  assert(payload != NULL || len == 0);
+  assert(fds     != NULL);
+
+  bool success = false;
+
+  const char** argv = NULL;
+  FILE* in  = NULL;
+  FILE* out = NULL;
+  FILE* err = NULL;
+
+  in  = fdopen(fds[0], "r");
+  if (in  != NULL) fds[0] = -1;
+  out = fdopen(fds[1], "w");
+  if (out != NULL) fds[1] = -1;
+  err = fdopen(fds[2], "w");
+  if (err != NULL) fds[2] = -1;
+  if (in == NULL || out == NULL || err == NULL) goto FINALIZE;
+
+  /* reported without buffering as this process does */
+  setvbuf(err, NULL, _IONBF, 0);
+
+  /* the working directory is of this worker only, by unshare(CLONE_FS) */
+  if (fchdir(fds[3]) != 0) {
+    fprintf(err, "failed to enter the working directory\n");
+    goto FINALIZE;
+  }
+
+  if (len > 0 && payload[len-1] != 0) {
+    fprintf(err, "broken request\n");
+    goto FINALIZE;
+  }
+  int argc = 1;
+  for (size_t i = 0; i < len; ++i) argc += payload[i] == 0;
+
+  argv = malloc(argc*sizeof(*argv));
+  if (argv == NULL) {
+    fprintf(err, "failed to allocate memory for args\n");
+    goto FINALIZE;
+  }
+  argv[0] = "readpe";
+  for (size_t i = 0, j = 1; i < len; i += strlen(payload+i) + 1) {
+    argv[j++] = payload + i;
+  }
+
+  readpe_args_t args;
+  if (!readpe_args_parse(&args, argc, argv, err)) {
+    fprintf(err, "failed to parse args\n");
+    goto FINALIZE;
+  }
+  if (args.help || args.mode != READPE_ARGS_MODE_INSPECT ||
+      args.serve != NULL) {
+    fprintf(err, "the server only inspects files\n");
+  } else {
+    success = readpe_inspect_command_run(&args, &s->contexts, in, out, err);
+  }
+  readpe_args_deinitialize(&args);
+
+FINALIZE:
+  if (in  != NULL) fclose(in);
+  if (out != NULL && fclose(out) != 0) success = false;
+  if (err != NULL) fclose(err);
+  for (size_t i = 0; i < READPE_SERVE_COMMAND_FDS_; ++i) {
+    if (fds[i] >= 0) close(fds[i]);
+  }
+  free(argv);
+  return success;
+}
+
+static void readpe_serve_command_handle_(
+    readpe_serve_command_t* s, int conn) {
+  assert(s != NULL);
+
+  if (!readpe_serve_command_trust_(conn)) {
+    fprintf(stderr, "refused a client of another user\n");
+    return;
+  }
+
+  const struct timeval timeout = {
+    .tv_sec = READPE_SERVE_COMMAND_TIMEOUT_SEC_,
+  };
+  setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  int    fds[READPE_SERVE_COMMAND_FDS_];
+  size_t fds_length = 0;
+
+  uint32_t len;
+  union {
+    struct cmsghdr hdr;
+    char           buf[CMSG_SPACE(sizeof(fds))];
+  } ctl;
+  struct iovec  iov = { .iov_base = &len, .iov_len = sizeof(len), };
+  struct msghdr msg = {
+    .msg_iov        = &iov,
+    .msg_iovlen     = 1,
+    .msg_control    = ctl.buf,
+    .msg_controllen = sizeof(ctl.buf),
+  };
+  ssize_t n;
+  do {
+    n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) return;
+
+  for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c != NULL;
+      c = CMSG_NXTHDR(&msg, c)) {
+    if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+
+    const size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; ++i) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(c) + i*sizeof(int), sizeof(fd));
+      if (fds_length < READPE_SERVE_COMMAND_FDS_) {
+        fds[fds_length++] = fd;
+      } else {
+        close(fd);
+      }
+    }
+  }
+
+  char* payload = NULL;
+  bool  valid   =
+      !(msg.msg_flags & MSG_CTRUNC) &&
+      fds_length == READPE_SERVE_COMMAND_FDS_ &&
+      readpe_serve_command_read_(
+          conn, (uint8_t*) &len + n, sizeof(len) - n) &&
+      len <= READPE_SERVE_COMMAND_REQUEST_MAX_;
+  if (valid && len > 0) {
+    payload = malloc(len);
+    valid   = payload != NULL && readpe_serve_command_read_(conn, payload, len);
+  }
+  if (!valid) {
+    for (size_t i = 0; i < fds_length; ++i) close(fds[i]);
+    free(payload);
+    return;
+  }
+
+  const bool    success = readpe_serve_command_process_(s, payload, len, fds);
+  const uint8_t status  = success? 0: 1;
+  readpe_serve_command_write_(conn, &status, sizeof(status));
+  free(payload);
+}
+
+static void* readpe_serve_command_worker_main_(void* ptr) {
+  readpe_serve_command_t* s = ptr;
+
+  /* each request is processed in the working directory of its client */
+  if (unshare(CLONE_FS) != 0) {
+    fprintf(stderr, "failed to separate the working directory of a worker\n");
+    return NULL;
+  }
+
+  for (;;) {
+    const int conn = accept4(s->listener, NULL, NULL, SOCK_CLOEXEC);
+    if (conn < 0) {
+      pthread_mutex_lock(&s->mtx);
+      const bool stopping = s->stopping;
+      pthread_mutex_unlock(&s->mtx);
+      if (stopping) break;
+
+      /* waits for some descriptors to be released */
+      if (errno == EMFILE || errno == ENFILE) usleep(100*1000);
+      continue;
+    }
+    readpe_serve_command_handle_(s, conn);
+    close(conn);
+  }
+  return NULL;
+}
+
+/* Binds the socket, replacing one left by a server gone. */
+static int readpe_serve_command_listen_(const char* path) {
+  assert(path != NULL);
+
+  struct sockaddr_un addr;
+  if (!readpe_serve_command_address_(&addr, path)) {
+    fprintf(stderr, "too long socket path: %s\n", path);
+    return -1;
+  }
+
+  struct stat st;
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const bool alive = probe >= 0 &&
+        connect(probe, (const struct sockaddr*) &addr, sizeof(addr)) == 0;
+    if (probe >= 0) close(probe);
+    if (alive) {
+      fprintf(stderr, "another server is listening: %s\n", path);
+      return -1;
+    }
+    unlink(path);
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    fprintf(stderr, "failed to create socket\n");
+    return -1;
+  }
+  /* only the owner may connect, as requests are served with the
+   * privileges of this process; umask() is safe with no worker yet */
+  const mode_t mask  = umask(077);
+  const int    bound = bind(fd, (const struct sockaddr*) &addr, sizeof(addr));
+  umask(mask);
+  if (bound != 0 || listen(fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "failed to listen: %s\n", path);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool readpe_serve_command_run(const readpe_args_t* args) {
+  assert(args        != NULL);
+  assert(args->serve != NULL);
+
+  /* the signals are waited by this thread only, and workers inherit the
+   * mask */
+  sigset_t sigs;
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+  /* clients may go away while their results are written */
+  signal(SIGPIPE, SIG_IGN);
+
+  readpe_serve_command_t s = {
+    .args     = args,
+    .listener = readpe_serve_command_listen_(args->serve),
+  };
+  if (s.listener < 0) return false;
+
+  size_t jobs = args->jobs;
+  if (jobs == 0) {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = n > 0? (size_t) n: 1;
+  }
+  pthread_t* threads = calloc(jobs, sizeof(*threads));
+  if (threads == NULL) {
+    fprintf(stderr, "failed to allocate memory for workers\n");
+    close(s.listener);
+    unlink(args->serve);
+    return false;
+  }
+
+  readpe_context_lru_initialize(&s.contexts, args->keep);
+  pthread_mutex_init(&s.mtx, NULL);
+
+  size_t started = 0;
+  for (; started < jobs; ++started) {
+    if (pthread_create(&threads[started], NULL,
+          readpe_serve_command_worker_main_, &s) != 0) {
+      break;
+    }
+  }
+  if (started == 0) {
+    fprintf(stderr, "failed to start workers\n");
+  } else {
+    int sig;
+    sigwait(&sigs, &sig);
+  }
+
+  /* blocked accept() returns by shutting the listener down */
+  pthread_mutex_lock(&s.mtx);
+  s.stopping = true;
+  pthread_mutex_unlock(&s.mtx);
+  shutdown(s.listener, SHUT_RDWR);
+
+  for (size_t i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  close(s.listener);
+  unlink(args->serve);
+
+  pthread_mutex_destroy(&s.mtx);
+  readpe_context_lru_deinitialize(&s.contexts);
+  free(threads);
+  return started > 0;
+}
+
+bool readpe_serve_command_request(
+    const char*        path,
+    int                argc,
+    const char* const* argv,
+    bool*              success) {
+  assert(path    != NULL);
+  assert(argv    != NULL);
+  assert(success != NULL);
+
+  struct sockaddr_un addr;
+  if (!readpe_serve_command_address_(&addr, path)) return false;
+
+  size_t len = 0;
+  for (int i = 1; i < argc; ++i) len += strlen(argv[i]) + 1;
+  if (len > READPE_SERVE_COMMAND_REQUEST_MAX_) return false;
+
+  uint32_t* req = malloc(sizeof(*req) + len);
+  if (req == NULL) return false;
+  req[0] = len;
+
+  char* p = (char*) (req + 1);
+  for (int i = 1; i < argc; ++i) {
+    const size_t n = strlen(argv[i]) + 1;
+    memcpy(p, argv[i], n);
+    p += n;
+  }
+
+  const int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  const int cwd  = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (sock < 0 || cwd < 0 ||
+      connect(sock, (const struct sockaddr*) &addr, sizeof(addr)) != 0 ||
+      !readpe_serve_command_trust_(sock)) {
+    if (sock >= 0) close(sock);
+    if (cwd  >= 0) close(cwd);
+    free(req);
+    return false;
+  }
+
+  const int fds[READPE_SERVE_COMMAND_FDS_] = {
+    STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, cwd,
+  };
+  union {
+    struct cmsghdr hdr;
+    char           buf[CMSG_SPACE(sizeof(fds))];
+  } ctl = {0};
+  struct iovec  iov = { .iov_base = req, .iov_len = sizeof(*req) + len, };
+  struct msghdr msg = {
+    .msg_iov        = &iov,
+    .msg_iovlen     = 1,
+    .msg_control    = ctl.buf,
+    .msg_controllen = sizeof(ctl.buf),
+  };
+  struct cmsghdr* c = CMSG_FIRSTHDR(&msg);
+  c->cmsg_level = SOL_SOCKET;
+  c->cmsg_type  = SCM_RIGHTS;
+  c->cmsg_len   = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+  /* nothing is written yet, so the request can still fall back to this
+   * process if the server refuses it */
+  ssize_t n;
+  do {
+    n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  close(cwd);
+  if (n <= 0) {
+    close(sock);
+    free(req);
+    return false;
+  }
+
+  uint8_t    status;
+  const bool answered =
+      readpe_serve_command_write_(
+          sock, (uint8_t*) req + n, sizeof(*req) + len - n) &&
+      readpe_serve_command_read_(sock, &status, sizeof(status));
+  if (!answered) {
+    fprintf(stderr, "lost the connection to the server: %s\n", path);
+  }
+  *success = answered && status == 0;
+
+  close(sock);
+  free(req);
+  return true;
+}
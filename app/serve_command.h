@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "./args.h"
+
+bool
+readpe_serve_command_run(
+    const readpe_args_t* args
+);
+    /* Listens on the Unix socket at args->serve until SIGINT or SIGTERM,
+     * and inspects files as requested by readpe_serve_command_request on
+     * args->jobs workers. Parsed files are kept for later requests. */
+
+bool
+readpe_serve_command_request(
+    const char*        path,  /* of the socket */
+    int                argc,
+    const char* const* argv,
+    bool*              success
+);
+    /* Sends the arguments to the server with the standard streams and the
+     * working directory of this process, so the result is written as if
+     * this process inspected the files. Returns false without doing
+     * anything if the server cannot be reached, otherwise sets *success to
+     * what the server returns. */
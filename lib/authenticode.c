@@ -0,0 +1,175 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./hash.h"
+#include "./readpe.h"
+
+/* The file is read once in chunks, each of which is summed for the checksum
+ * and then hashed except the excluded ranges, while it is still in cache. */
+#define READPE_AUTHENTICODE_CHUNK_SIZE (16*1024)
+
+/* Returns the sum of little-endian 16-bit words without folding carries.
+ * Carries are folded at last, which gives the same result as folding at
+ * each addition. An odd byte at the end is taken as a word by itself. */
+static uint64_t readpe_authenticode_sum_(const uint8_t* p, size_t len) {
+  uint64_t sum = 0;
+  size_t   i   = 0;
+
+#if defined(__SSE2__)
+  /* a word is (low byte + high byte*256), so the low and high bytes are
+   * summed separately into 64-bit lanes, which never overflow */
+  const __m128i mask = _mm_set1_epi16(0x00FF);
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i lo = zero, hi = zero;
+  for (; i+16 <= len; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+    lo = _mm_add_epi64(lo, _mm_sad_epu8(_mm_and_si128(v, mask), zero));
+    hi = _mm_add_epi64(hi, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+  }
+
+  uint64_t l[2], h[2];
+  _mm_storeu_si128((__m128i*) l, lo);
+  _mm_storeu_si128((__m128i*) h, hi);
+  sum = l[0] + l[1] + ((h[0] + h[1]) << 8);
+#endif
+
+  for (; i+2 <= len; i += 2) {
+    sum += (uint32_t) p[i] | (uint32_t) p[i+1] << 8;
+  }
+  if (i < len) sum += p[i];
+  return sum;
+}
+
+typedef struct readpe_authenticode_range_t {
+  size_t begin;
+  size_t end;
+} readpe_authenticode_range_t;
+
+/* hashes [begin, end) of the file except the ranges sorted by begin */
+static void readpe_authenticode_hash_(
+    readpe_hash_state_t*               st,
+    const uint8_t*                     file,
+    size_t                             begin,
+    size_t                             end,
+    const readpe_authenticode_range_t* skips,
+    size_t                             n) {
+  size_t itr = begin;
+  for (size_t i = 0; i < n && itr < end; ++i) {
+    if (skips[i].end <= itr) continue;
+
+    const size_t until = skips[i].begin < end? skips[i].begin: end;
+    if (until > itr) {
+      readpe_hash_update(st, file + itr, until - itr);
+    }
+    if (skips[i].end > itr) itr = skips[i].end;
+  }
+  if (itr < end) readpe_hash_update(st, file + itr, end - itr);
+}
+
+readpe_error_t readpe_context_compute_authenticode(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  if (ctx->authenticode_computed) return READPE_OK;
+
+  const uint8_t* checksum = ctx->_64bit?
+      (const uint8_t*) &ctx->nt_header->optional._64bit.checksum:
+      (const uint8_t*) &ctx->nt_header->optional._32bit.checksum;
+
+  /* the checksum field, the certificate table entry of the data directory
+   * and the certificate table itself are excluded from the digest */
+  readpe_authenticode_range_t skips[3];
+  size_t n = 0;
+
+  const size_t checksum_offset = checksum - ctx->file;
+  skips[n++] = (typeof(skips[0])) {
+    .begin = checksum_offset,
+    .end   = checksum_offset + sizeof(uint32_t),
+  };
+
+  if (ctx->data_directory_length > PE_IMAGE_DIRECTORY_ENTRY_SECURITY) {
+    const pe_image_data_directory_t* dir =
+        &ctx->data_directory[PE_IMAGE_DIRECTORY_ENTRY_SECURITY];
+
+    const size_t entry = (const uint8_t*) dir - ctx->file;
+    skips[n++] = (typeof(skips[0])) {
+      .begin = entry,
+      .end   = entry + PE_IMAGE_DATA_DIRECTORY_SIZE,
+    };
+
+    /* the virtual address of the certificate table is a file offset */
+    if (dir->size > 0) {
+      if ((uintmax_t) dir->virtual_address + dir->size > ctx->file_length) {
+        return READPE_ERROR_INVALID_CERTIFICATE_TABLE;
+      }
+      skips[n++] = (typeof(skips[0])) {
+        .begin = dir->virtual_address,
+        .end   = (size_t) dir->virtual_address + dir->size,
+      };
+      ctx->signed_ = true;
+    }
+  }
+  if (n == 3 && skips[2].begin < skips[1].begin) {
+    const readpe_authenticode_range_t temp = skips[2];
+    skips[2] = skips[1];
+    skips[1] = temp;
+    if (skips[1].begin < skips[0].begin) {
+      skips[1] = skips[0];
+      skips[0] = temp;
+    }
+  }
+
+  readpe_hash_state_t st;
+  readpe_hash_initialize(&st, READPE_HASH_SHA1 | READPE_HASH_SHA256);
+
+  uint64_t sum = 0;
+  for (size_t off = 0; off < ctx->file_length;) {
+    size_t len = ctx->file_length - off;
+    if (len > READPE_AUTHENTICODE_CHUNK_SIZE) {
+      len = READPE_AUTHENTICODE_CHUNK_SIZE;
+    }
+    sum += readpe_authenticode_sum_(ctx->file + off, len);
+    readpe_authenticode_hash_(&st, ctx->file, off, off+len, skips, n);
+    off += len;
+  }
+  readpe_hash_finalize(&st, &ctx->authenticode);
+
+  /* the checksum is computed as if the field were zero */
+  for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+    sum -= (uint64_t) checksum[i] << ((checksum_offset+i)%2*8);
+  }
+  while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+  ctx->checksum = (uint32_t) (sum + ctx->file_length);
+
+  ctx->authenticode_computed = true;
+  return READPE_OK;
+}
+
+const readpe_hash_t* readpe_context_get_authenticode_hash(
+    const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+  assert(ctx->authenticode_computed);
+  return &ctx->authenticode;
+}
+
+bool readpe_context_is_signed(const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+  assert(ctx->authenticode_computed);
+  return ctx->signed_;
+}
+
+uint32_t readpe_context_get_checksum(const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+  assert(ctx->authenticode_computed);
+  return ctx->checksum;
+}
@@ -0,0 +1,608 @@
+#include "./context.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pe.h"
+
+#include "./import.h"
+#include "./relocation.h"
+
+static bool readpe_context_validate_string_(
+    const readpe_context_t* ctx, uintmax_t rva) {
+  assert(ctx != NULL);
+
+  return readpe_context_resolve_string(ctx, rva, NULL) != NULL;
+}
+
+static readpe_error_t readpe_context_read_file_(
+    readpe_context_t* ctx, int fd) {
+  assert(ctx != NULL);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) return READPE_ERROR_READ;
+
+  if (st.st_size <= 0) return READPE_ERROR_INVALID_DOS_HEADER;
+  ctx->file_length = st.st_size;
+
+  void* ptr = mmap(NULL, ctx->file_length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr != MAP_FAILED) {
+    ctx->file        = ptr;
+    ctx->file_mapped = true;
+    return READPE_OK;
+  }
+
+  /* fallback for files which cannot be mapped */
+  uint8_t* buf = malloc(ctx->file_length);
+  if (buf == NULL) return READPE_ERROR_NO_MEMORY;
+
+  ctx->file       = buf;
+  ctx->file_owned = true;
+
+  size_t read_bytes = 0;
+  while (read_bytes < ctx->file_length) {
+    /* reads from the beginning wherever the offset of fd is */
+    const ssize_t n = pread(
+        fd, buf + read_bytes, ctx->file_length - read_bytes, read_bytes);
+    if (n <= 0) return READPE_ERROR_READ;
+    read_bytes += n;
+  }
+  return READPE_OK;
+}
+
+static readpe_error_t readpe_context_find_headers_(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  if (ctx->file_length < PE_DOS_HEADER_SIZE) {
+    return READPE_ERROR_INVALID_DOS_HEADER;
+  }
+  const pe_dos_header_t* dos_header = (typeof(dos_header)) ctx->file;
+
+  if (dos_header->e_magic != PE_DOS_MAGIC) {
+    return READPE_ERROR_INVALID_DOS_MAGIC;
+  }
+  if (dos_header->e_lfanew < 0) {
+    return READPE_ERROR_INVALID_DOS_HEADER;
+  }
+
+  /* the optional header is accessed up to the data directories
+   * before its actual size gets validated */
+  static const size_t ntsz =
+      offsetof(pe_nt_header_t, optional) +
+      offsetof(pe64_image_optional_header_t, data_directory);
+  if ((uintmax_t) dos_header->e_lfanew + ntsz > ctx->file_length) {
+    return READPE_ERROR_INVALID_NT_HEADER;
+  }
+  const pe_nt_header_t* nt_header =
+      (typeof(nt_header)) (ctx->file + dos_header->e_lfanew);
+
+  /* a wrong signature is not an error, as the output shows it */
+
+  switch (nt_header->file.machine) {
+  case PE_IMAGE_FILE_MACHINE_I386:
+    ctx->image_base    = nt_header->optional._32bit.image_base;
+    ctx->image_length  = nt_header->optional._32bit.size_of_image;
+    ctx->header_length = nt_header->optional._32bit.size_of_headers;
+    break;
+  case PE_IMAGE_FILE_MACHINE_AMD64:
+  case PE_IMAGE_FILE_MACHINE_IA64:
+    ctx->_64bit = true;
+    ctx->image_base    = nt_header->optional._64bit.image_base;
+    ctx->image_length  = nt_header->optional._64bit.size_of_image;
+    ctx->header_length = nt_header->optional._64bit.size_of_headers;
+    break;
+  default:
+    return READPE_ERROR_UNKNOWN_MACHINE;
+  }
+
+  if (ctx->image_length  == 0 ||
+      ctx->header_length == 0 ||
+      ctx->header_length > ctx->image_length ||
+      ctx->header_length > ctx->file_length) {
+    return READPE_ERROR_INVALID_OPTIONAL_HEADER;
+  }
+  return READPE_OK;
+}
+
+static readpe_error_t readpe_context_find_addresses_(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  const uint8_t* header_end = ctx->file + ctx->header_length;
+
+  /* ---- dos header ---- */
+  ctx->dos_header = (pe_dos_header_t*) ctx->file;
+
+  if (ctx->header_length < PE_DOS_HEADER_SIZE) {
+    return READPE_ERROR_INVALID_DOS_HEADER;
+  }
+
+  /* ---- dos stub ---- */
+  ctx->dos_stub        = ctx->file + PE_DOS_HEADER_SIZE;
+  ctx->dos_stub_length = ctx->dos_header->e_lfanew - PE_DOS_HEADER_SIZE;
+
+  if (ctx->dos_header->e_lfanew < PE_DOS_HEADER_SIZE ||
+      (size_t) ctx->dos_header->e_lfanew > ctx->header_length) {
+    return READPE_ERROR_INVALID_DOS_STUB;
+  }
+
+  /* ---- nt header ---- */
+  ctx->nt_header = (pe_nt_header_t*) (ctx->file + ctx->dos_header->e_lfanew);
+
+  if ((uint8_t*) &ctx->nt_header->optional > header_end) {
+    return READPE_ERROR_INVALID_NT_HEADER;
+  }
+
+  /* ---- data directory ---- */
+  if (ctx->_64bit) {
+    ctx->data_directory_length =
+        ctx->nt_header->optional._64bit.number_of_rva_and_sizes;
+    ctx->data_directory = ctx->nt_header->optional._64bit.data_directory;
+  } else {
+    ctx->data_directory_length =
+        ctx->nt_header->optional._32bit.number_of_rva_and_sizes;
+    ctx->data_directory = ctx->nt_header->optional._32bit.data_directory;
+  }
+  if ((uint8_t*) ctx->data_directory +
+        ctx->data_directory_length*PE_IMAGE_DATA_DIRECTORY_SIZE > header_end) {
+    return READPE_ERROR_INVALID_OPTIONAL_HEADER;
+  }
+
+  /* ---- section table ---- */
+  ctx->sections = (pe_image_section_header_t*) (
+      ctx->file +
+      ctx->dos_header->e_lfanew +
+      sizeof(ctx->nt_header->signature) +
+      PE_IMAGE_FILE_HEADER_SIZE +
+      ctx->nt_header->file.size_of_optional_header);
+
+  if ((uint8_t*) ctx->sections +
+        ctx->nt_header->file.number_of_sections*PE_IMAGE_SECTION_HEADER_SIZE >
+        header_end) {
+    return READPE_ERROR_INVALID_SECTION_TABLE;
+  }
+  return READPE_OK;
+}
+
+static readpe_error_t readpe_context_build_image_(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  const size_t n = ctx->nt_header->file.number_of_sections;
+  if (!readpe_image_initialize(&ctx->image, ctx->image_length, n+1)) {
+    return READPE_ERROR_NO_MEMORY;
+  }
+
+  const readpe_image_extent_t header = {
+    .rva            = 0,
+    .virtual_length = ctx->header_length,
+    .data           = ctx->file,
+    .length         = ctx->header_length,
+  };
+  readpe_image_add_extent(&ctx->image, &header);
+
+  for (size_t i = 0; i < n; ++i) {
+    const pe_image_section_header_t* s = &ctx->sections[i];
+    if (s->size_of_raw_data == 0) continue;
+
+    if ((uintmax_t) s->virtual_address + s->misc.virtual_size >
+          ctx->image_length) {
+      return READPE_ERROR_INVALID_SECTION;
+    }
+    if ((uintmax_t) s->pointer_to_raw_data + s->size_of_raw_data >
+          ctx->file_length) {
+      return READPE_ERROR_INVALID_SECTION;
+    }
+
+    readpe_image_extent_t ext = {
+      .rva            = s->virtual_address,
+      .virtual_length = s->misc.virtual_size,
+      .data           = ctx->file + s->pointer_to_raw_data,
+      .length         = s->size_of_raw_data,
+    };
+    if (ext.virtual_length == 0) {
+      ext.virtual_length = ext.length;
+    }
+    if (ext.length > ext.virtual_length) {
+      ext.length = ext.virtual_length;
+    }
+    readpe_image_add_extent(&ctx->image, &ext);
+  }
+
+  readpe_image_build_index(&ctx->image);
+  return READPE_OK;
+}
+
+static readpe_error_t readpe_context_parse_(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  readpe_error_t err;
+  if ((err = readpe_context_find_headers_(ctx))   != READPE_OK ||
+      (err = readpe_context_find_addresses_(ctx)) != READPE_OK ||
+      (err = readpe_context_build_image_(ctx))    != READPE_OK) {
+    return err;
+  }
+  return READPE_OK;
+}
+
+static bool readpe_context_find_export_table_(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  if (ctx->data_directory_length <= PE_IMAGE_DIRECTORY_ENTRY_EXPORT) {
+    return true;
+  }
+
+  const pe_image_data_directory_t* dir =
+      &ctx->data_directory[PE_IMAGE_DIRECTORY_ENTRY_EXPORT];
+  if (dir->virtual_address == 0 || dir->size == 0) return true;
+
+  size_t len;
+  ctx->export_ = (typeof(ctx->export_))
+      readpe_context_resolve_rva(ctx, dir->virtual_address, &len);
+  ctx->export_section_length = dir->size;
+
+  if (ctx->export_ == NULL ||
+      len < PE_IMAGE_EXPORT_DIRECTORY_SIZE ||
+      (uintmax_t) dir->virtual_address + dir->size > ctx->image_length ||
+      dir->size < PE_IMAGE_EXPORT_DIRECTORY_SIZE) {
+    return false;
+  }
+
+  if (!readpe_context_validate_string_(ctx, ctx->export_->name)) {
+    return false;
+  }
+
+  ctx->export_functions = (uint32_t*) readpe_context_resolve_rva(
+      ctx, ctx->export_->address_of_functions, &len);
+  if (ctx->export_->number_of_functions > 0 && (
+        ctx->export_functions == NULL ||
+        len/sizeof(uint32_t) < ctx->export_->number_of_functions)) {
+    return false;
+  }
+  ctx->export_names = (uint32_t*) readpe_context_resolve_rva(
+      ctx, ctx->export_->address_of_names, &len);
+  if (ctx->export_->number_of_names > 0 && (
+        ctx->export_names == NULL ||
+        len/sizeof(uint32_t) < ctx->export_->number_of_names)) {
+    return false;
+  }
+  ctx->export_name_ordinals = (uint16_t*) readpe_context_resolve_rva(
+      ctx, ctx->export_->address_of_name_ordinals, &len);
+  if (ctx->export_->number_of_names > 0 && (
+        ctx->export_name_ordinals == NULL ||
+        len/sizeof(uint16_t) < ctx->export_->number_of_names)) {
+    return false;
+  }
+
+  const uint32_t* funcs = ctx->export_functions;
+  for (size_t i = 0; i < ctx->export_->number_of_functions; ++i) {
+    if (funcs[i] >= ctx->image_length) {
+      return false;
+    }
+  }
+
+  ctx->export_name_indices = malloc(
+      ctx->export_->number_of_functions*sizeof(*ctx->export_name_indices));
+  if (ctx->export_->number_of_functions > 0 &&
+      ctx->export_name_indices == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < ctx->export_->number_of_functions; ++i) {
+    ctx->export_name_indices[i] = READPE_CONTEXT_EXPORT_NO_NAME;
+  }
+
+  const uint32_t* names = ctx->export_names;
+  const uint16_t* ordis = ctx->export_name_ordinals;
+
+  const char* prev     = NULL;
+  size_t      prev_len = 0;
+
+  ctx->export_names_sorted = true;
+  for (size_t i = 0; i < ctx->export_->number_of_names; ++i) {
+    size_t      len;
+    const char* name = readpe_context_resolve_string(ctx, names[i], &len);
+    if (name == NULL) {
+      return false;
+    }
+
+    /* lookups by name use binary search only if the names are sorted
+     * as the specification requires */
+    if (prev != NULL) {
+      const int c = memcmp(prev, name, prev_len < len? prev_len: len);
+      if (c > 0 || (c == 0 && prev_len > len)) {
+        ctx->export_names_sorted = false;
+      }
+    }
+    prev     = name;
+    prev_len = len;
+
+    /* the first name wins when some names refer the same function */
+    if (ordis[i] < ctx->export_->number_of_functions &&
+        ctx->export_name_indices[ordis[i]] == READPE_CONTEXT_EXPORT_NO_NAME) {
+      ctx->export_name_indices[ordis[i]] = i;
+    }
+  }
+  return true;
+}
+
+static readpe_error_t readpe_context_find_directory_(
+    readpe_context_t* ctx,
+    size_t            index,
+    bool            (*find)(readpe_context_t*),
+    readpe_error_t    err) {
+  assert(ctx  != NULL);
+  assert(find != NULL);
+
+  const uint32_t bit = UINT32_C(1) << index;
+  if (ctx->directories_found  & bit) return READPE_OK;
+  if (ctx->directories_broken & bit) return err;
+
+  if (!find(ctx)) {
+    ctx->directories_broken |= bit;
+    return err;
+  }
+  ctx->directories_found |= bit;
+  return READPE_OK;
+}
+
+readpe_error_t readpe_context_initialize(
+    readpe_context_t* ctx, const char* filename) {
+  assert(ctx      != NULL);
+  assert(filename != NULL);
+
+  *ctx = (typeof(*ctx)) {0};
+
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) return READPE_ERROR_OPEN;
+
+  readpe_error_t err = readpe_context_read_file_(ctx, fd);
+  close(fd);
+
+  if (err == READPE_OK) err = readpe_context_parse_(ctx);
+  if (err != READPE_OK) readpe_context_deinitialize(ctx);
+  return err;
+}
+
+readpe_error_t readpe_context_initialize_from_fd(
+    readpe_context_t* ctx, int fd) {
+  assert(ctx != NULL);
+
+  *ctx = (typeof(*ctx)) {0};
+
+  readpe_error_t err = readpe_context_read_file_(ctx, fd);
+  if (err == READPE_OK) err = readpe_context_parse_(ctx);
+  if (err != READPE_OK) readpe_context_deinitialize(ctx);
+  return err;
+}
+
+readpe_error_t readpe_context_initialize_from_memory(
+    readpe_context_t* ctx, const uint8_t* buf, size_t len) {
+  assert(ctx != NULL);
+  assert(buf != NULL || len == 0);
+
+  *ctx = (typeof(*ctx)) {
+    .file        = buf,
+    .file_length = len,
+  };
+
+  const readpe_error_t err = readpe_context_parse_(ctx);
+  if (err != READPE_OK) readpe_context_deinitialize(ctx);
+  return err;
+}
+
+void readpe_context_deinitialize(readpe_context_t* ctx) {
+  if (ctx == NULL) return;
+
+  free(ctx->section_stats);
+  free(ctx->hashes);
+  free(ctx->relocation_density);
+  free(ctx->relocation_bitmaps);
+  free(ctx->relocation_pages);
+  readpe_relocation_deinitialize(&ctx->relocation_entries);
+  readpe_import_deinitialize(&ctx->import_entries);
+  free(ctx->export_hash);
+  free(ctx->export_name_indices);
+  readpe_image_deinitialize(&ctx->image);
+
+  if (ctx->file_mapped) {
+    munmap((void*) ctx->file, ctx->file_length);
+  } else if (ctx->file_owned) {
+    free((void*) ctx->file);
+  }
+  *ctx = (typeof(*ctx)) {0};
+}
+
+readpe_error_t readpe_context_create(
+    readpe_context_t** ctx, const char* filename) {
+  assert(ctx      != NULL);
+  assert(filename != NULL);
+
+  *ctx = malloc(sizeof(**ctx));
+  if (*ctx == NULL) return READPE_ERROR_NO_MEMORY;
+
+  const readpe_error_t err = readpe_context_initialize(*ctx, filename);
+  if (err != READPE_OK) {
+    free(*ctx);
+    *ctx = NULL;
+  }
+  return err;
+}
+
+readpe_error_t readpe_context_create_from_fd(
+    readpe_context_t** ctx, int fd) {
+  assert(ctx != NULL);
+
+  *ctx = malloc(sizeof(**ctx));
+  if (*ctx == NULL) return READPE_ERROR_NO_MEMORY;
+
+  const readpe_error_t err = readpe_context_initialize_from_fd(*ctx, fd);
+  if (err != READPE_OK) {
+    free(*ctx);
+    *ctx = NULL;
+  }
+  return err;
+}
+
+readpe_error_t readpe_context_create_from_memory(
+    readpe_context_t** ctx, const uint8_t* buf, size_t len) {
+  assert(ctx != NULL);
+
+  *ctx = malloc(sizeof(**ctx));
+  if (*ctx == NULL) return READPE_ERROR_NO_MEMORY;
+
+  const readpe_error_t err =
+      readpe_context_initialize_from_memory(*ctx, buf, len);
+  if (err != READPE_OK) {
+    free(*ctx);
+    *ctx = NULL;
+  }
+  return err;
+}
+
+void readpe_context_destroy(readpe_context_t* ctx) {
+  if (ctx == NULL) return;
+
+  readpe_context_deinitialize(ctx);
+  free(ctx);
+}
+
+const uint8_t* readpe_context_resolve_rva(
+    const readpe_context_t* ctx, uintmax_t rva, size_t* len) {
+  assert(ctx != NULL);
+  assert(len != NULL);
+
+  return readpe_image_resolve(&ctx->image, rva, len, NULL);
+}
+
+const char* readpe_context_resolve_string(
+    const readpe_context_t* ctx, uintmax_t rva, size_t* len) {
+  assert(ctx != NULL);
+
+  size_t    mlen;
+  uintmax_t vlen;
+  const char* str = (char*) readpe_image_resolve(&ctx->image, rva, &mlen, &vlen);
+  if (str == NULL) return NULL;
+
+  /* a string reaching the end of raw data is terminated by the zero-fill
+   * unless it also reaches the end of the section */
+  const size_t slen = strnlen(str, mlen);
+  if (slen == mlen && vlen == mlen) return NULL;
+
+  if (len != NULL) *len = slen;
+  return str;
+}
+
+bool readpe_context_is_64bit(const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  return ctx->_64bit;
+}
+
+const pe_dos_header_t* readpe_context_get_dos_header(
+    const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  return ctx->dos_header;
+}
+
+const pe_nt_header_t* readpe_context_get_nt_header(
+    const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  return ctx->nt_header;
+}
+
+const pe_image_section_header_t* readpe_context_get_sections(
+    const readpe_context_t* ctx, size_t* len) {
+  assert(ctx != NULL);
+  assert(len != NULL);
+
+  *len = ctx->nt_header->file.number_of_sections;
+  return ctx->sections;
+}
+
+const pe_image_data_directory_t* readpe_context_get_data_directory(
+    const readpe_context_t* ctx, size_t* len) {
+  assert(ctx != NULL);
+  assert(len != NULL);
+
+  *len = ctx->data_directory_length;
+  return ctx->data_directory;
+}
+
+readpe_error_t readpe_context_find_export_table(readpe_context_t* ctx) {
+  return readpe_context_find_directory_(ctx,
+      PE_IMAGE_DIRECTORY_ENTRY_EXPORT,
+      readpe_context_find_export_table_,
+      READPE_ERROR_INVALID_EXPORT_TABLE);
+}
+
+readpe_error_t readpe_context_find_import_table(readpe_context_t* ctx) {
+  return readpe_context_find_directory_(ctx,
+      PE_IMAGE_DIRECTORY_ENTRY_IMPORT,
+      readpe_import_parse,
+      READPE_ERROR_INVALID_IMPORT_TABLE);
+}
+
+readpe_error_t readpe_context_find_relocation_table(readpe_context_t* ctx) {
+  return readpe_context_find_directory_(ctx,
+      PE_IMAGE_DIRECTORY_ENTRY_BASERELOC,
+      readpe_relocation_parse,
+      READPE_ERROR_INVALID_RELOCATION_TABLE);
+}
+
+const char* readpe_error_stringify(readpe_error_t err) {
+  switch (err) {
+  case READPE_OK:
+    return "no error";
+  case READPE_ERROR_OPEN:
+    return "failed to open the file";
+  case READPE_ERROR_READ:
+    return "failed to read the file";
+  case READPE_ERROR_NO_MEMORY:
+    return "failed to allocate memory";
+  case READPE_ERROR_INVALID_DOS_MAGIC:
+    return "magic number in dos header is wrong";
+  case READPE_ERROR_INVALID_DOS_HEADER:
+    return "invalid dos header";
+  case READPE_ERROR_INVALID_DOS_STUB:
+    return "invalid dos stub";
+  case READPE_ERROR_INVALID_NT_HEADER:
+    return "invalid nt header";
+  case READPE_ERROR_UNKNOWN_MACHINE:
+    return "unknown machine code";
+  case READPE_ERROR_INVALID_OPTIONAL_HEADER:
+    return "invalid image optional header";
+  case READPE_ERROR_INVALID_SECTION_TABLE:
+    return "invalid section table";
+  case READPE_ERROR_INVALID_SECTION:
+    return "invalid section";
+  case READPE_ERROR_INVALID_EXPORT_TABLE:
+    return "invalid export table";
+  case READPE_ERROR_INVALID_IMPORT_TABLE:
+    return "invalid import table";
+  case READPE_ERROR_INVALID_RELOCATION_TABLE:
+    return "invalid relocation table";
+  case READPE_ERROR_UNSUPPORTED_RELOCATION:
+    return "unsupported relocation type";
+  case READPE_ERROR_INVALID_CERTIFICATE_TABLE:
+    return "invalid certificate table";
+  case READPE_ERROR_INVALID_RECORD:
+    return "invalid record";
+  case READPE_ERROR_INVALID_SIGNATURE:
+    return "invalid signature";
+  case READPE_ERROR_INVALID_INDEX:
+    return "invalid index";
+  case READPE_ERROR_WRITE:
+    return "failed to write";
+  default:
+    return "unknown error";
+  }
+}
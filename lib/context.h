@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pe.h"
+
+#include "./image.h"
+#include "./readpe.h"
+
+/* The definition is exposed to the readpe executable only, which keeps
+ * contexts on stack. Other users should treat it as an opaque type. */
+struct readpe_context_t {
+  bool _64bit;
+
+  const uint8_t* file;
+  size_t         file_length;
+  bool           file_mapped;
+  bool           file_owned;
+
+  size_t    image_length;
+  uintptr_t image_base;
+  size_t    header_length;
+
+  readpe_image_t image;
+
+  const pe_dos_header_t* dos_header;
+
+  const uint8_t* dos_stub;
+  size_t         dos_stub_length;
+
+  const pe_nt_header_t* nt_header;
+
+  const pe_image_data_directory_t* data_directory;
+  size_t                           data_directory_length;
+
+  const pe_image_section_header_t* sections;
+
+  /* bit flags indexed by PE_IMAGE_DIRECTORY_ENTRY_* */
+  uint32_t directories_found;
+  uint32_t directories_broken;
+
+  const pe_image_export_directory_t* export_;
+  size_t export_section_length;
+
+  const uint32_t* export_functions;
+  const uint32_t* export_names;
+  const uint16_t* export_name_ordinals;
+
+  /* indexed by function index, READPE_CONTEXT_EXPORT_NO_NAME if anonymous */
+  uint32_t* export_name_indices;
+# define READPE_CONTEXT_EXPORT_NO_NAME UINT32_MAX
+
+  bool export_names_sorted;
+
+  /* open addressing table of (name index + 1), 0 means an empty slot */
+  uint32_t* export_hash;  /* NULLABLE */
+  size_t    export_hash_length;
+
+  const pe_image_import_descriptor_t* imports;
+  size_t imports_length;
+
+  readpe_import_entries_t import_entries;
+
+  const uint8_t* relocations;
+  size_t         relocations_length;
+
+  readpe_relocation_entries_t relocation_entries;
+
+  /* built on demand, (bitmap index + 1) for each page, 0 if no fixup */
+  uint32_t* relocation_pages;  /* NULLABLE */
+  size_t    relocation_pages_length;
+  uint64_t* relocation_bitmaps;
+  uint32_t* relocation_density;
+# define READPE_CONTEXT_RELOCATION_BITMAP_WORDS  \
+    (READPE_RELOCATION_PAGE_SIZE/64)
+
+  /* computed on demand, the whole file followed by each section */
+  readpe_hash_t* hashes;  /* NULLABLE */
+
+  bool          authenticode_computed;
+  bool          signed_;
+  readpe_hash_t authenticode;
+  uint32_t      checksum;
+
+  bool                  fingerprints_computed;
+  readpe_fingerprints_t fingerprints;
+
+  readpe_section_stats_t* section_stats;  /* NULLABLE */
+};
+
+readpe_error_t
+readpe_context_initialize(
+    readpe_context_t* ctx,
+    const char*       filename
+);
+
+readpe_error_t
+readpe_context_initialize_from_fd(
+    readpe_context_t* ctx,
+    int               fd  /* not closed, and can be closed after the call */
+);
+
+readpe_error_t
+readpe_context_initialize_from_memory(
+    readpe_context_t* ctx,
+    const uint8_t*    buf,  /* must be alive until the context is deinitialized */
+    size_t            len
+);
+
+void
+readpe_context_deinitialize(
+    readpe_context_t* ctx
+);
@@ -0,0 +1,214 @@
+#include "./context.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pe.h"
+
+#include "./readpe.h"
+
+static int readpe_export_compare_names_(
+    const char* a, size_t alen, const char* b, size_t blen) {
+  const int c = memcmp(a, b, alen < blen? alen: blen);
+  if (c != 0) return c;
+  return (alen > blen) - (alen < blen);
+}
+
+static uint64_t readpe_export_hash_(const char* str, size_t len) {
+  /* FNV-1a */
+  uint64_t h = UINT64_C(0xCBF29CE484222325);
+  for (size_t i = 0; i < len; ++i) {
+    h ^= (uint8_t) str[i];
+    h *= UINT64_C(0x100000001B3);
+  }
+  return h;
+}
+
+static bool readpe_export_find_name_index_(
+    const readpe_context_t* ctx, const char* name, size_t len, size_t* index) {
+  assert(ctx   != NULL);
+  assert(name  != NULL);
+  assert(index != NULL);
+
+  const uint32_t* names = ctx->export_names;
+  const size_t    n     = ctx->export_->number_of_names;
+
+  if (ctx->export_hash != NULL) {
+    const size_t mask = ctx->export_hash_length - 1;
+    for (size_t i = readpe_export_hash_(name, len) & mask; ; i = (i+1) & mask) {
+      const uint32_t v = ctx->export_hash[i];
+      if (v == 0) return false;
+
+      size_t      ilen;
+      const char* iname = readpe_context_resolve_string(ctx, names[v-1], &ilen);
+      if (ilen == len && memcmp(iname, name, len) == 0) {
+        *index = v-1;
+        return true;
+      }
+    }
+  }
+
+  if (ctx->export_names_sorted) {
+    size_t l = 0, r = n;
+    while (l < r) {
+      const size_t m = l + (r-l)/2;
+
+      size_t      mlen;
+      const char* mname = readpe_context_resolve_string(ctx, names[m], &mlen);
+
+      const int c = readpe_export_compare_names_(mname, mlen, name, len);
+      if (c == 0) {
+        *index = m;
+        return true;
+      }
+      if (c < 0) {
+        l = m+1;
+      } else {
+        r = m;
+      }
+    }
+    return false;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    size_t      ilen;
+    const char* iname = readpe_context_resolve_string(ctx, names[i], &ilen);
+    if (ilen == len && memcmp(iname, name, len) == 0) {
+      *index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* readpe_context_get_export_name(
+    const readpe_context_t* ctx, size_t index, size_t* len) {
+  assert(ctx != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_EXPORT));
+
+  if (ctx->export_ == NULL || index >= ctx->export_->number_of_functions) {
+    return NULL;
+  }
+
+  const uint32_t i = ctx->export_name_indices[index];
+  if (i == READPE_CONTEXT_EXPORT_NO_NAME) return NULL;
+
+  return readpe_context_resolve_string(ctx, ctx->export_names[i], len);
+}
+
+bool readpe_context_get_export(
+    const readpe_context_t* ctx, size_t index, readpe_export_t* exp) {
+  assert(ctx != NULL);
+  assert(exp != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_EXPORT));
+
+  if (ctx->export_ == NULL || index >= ctx->export_->number_of_functions) {
+    return false;
+  }
+
+  *exp = (typeof(*exp)) {
+    .ordinal = index + ctx->export_->base,
+    .rva     = ctx->export_functions[index],
+  };
+  exp->name = readpe_context_get_export_name(ctx, index, &exp->name_length);
+
+  /* an address inside of the export section is a forwarder string */
+  const uintmax_t begin =
+      ctx->data_directory[PE_IMAGE_DIRECTORY_ENTRY_EXPORT].virtual_address;
+  const uintmax_t end = begin + ctx->export_section_length;
+  if (begin <= exp->rva && exp->rva < end) {
+    exp->forwarded = true;
+    exp->forwarder = readpe_context_resolve_string(
+        ctx, exp->rva, &exp->forwarder_length);
+  }
+  return true;
+}
+
+bool readpe_context_find_export_by_name(
+    const readpe_context_t* ctx, const char* name, readpe_export_t* exp) {
+  assert(name != NULL);
+
+  return readpe_context_find_export_by_string(ctx, name, strlen(name), exp);
+}
+
+bool readpe_context_find_export_by_string(
+    const readpe_context_t* ctx,
+    const char*             name,
+    size_t                  len,
+    readpe_export_t*        exp) {
+  assert(ctx  != NULL);
+  assert(name != NULL || len == 0);
+  assert(exp  != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_EXPORT));
+
+  if (ctx->export_ == NULL) return false;
+
+  size_t i;
+  if (!readpe_export_find_name_index_(ctx, name, len, &i)) return false;
+
+  if (!readpe_context_get_export(ctx, ctx->export_name_ordinals[i], exp)) {
+    return false;
+  }
+
+  /* the function may have other names */
+  exp->name = readpe_context_resolve_string(
+      ctx, ctx->export_names[i], &exp->name_length);
+  return true;
+}
+
+bool readpe_context_find_export_by_ordinal(
+    const readpe_context_t* ctx, uint32_t ordinal, readpe_export_t* exp) {
+  assert(ctx != NULL);
+  assert(exp != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_EXPORT));
+
+  if (ctx->export_ == NULL || ordinal < ctx->export_->base) return false;
+
+  const size_t index = ordinal - ctx->export_->base;
+  if (!readpe_context_get_export(ctx, index, exp)) return false;
+
+  /* an empty slot of the address table */
+  return exp->rva != 0;
+}
+
+readpe_error_t readpe_context_build_export_hash(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  const readpe_error_t err = readpe_context_find_export_table(ctx);
+  if (err != READPE_OK) return err;
+
+  if (ctx->export_ == NULL || ctx->export_hash != NULL) return READPE_OK;
+
+  const size_t n = ctx->export_->number_of_names;
+
+  size_t len = 16;
+  while (len < n*2) len *= 2;
+
+  uint32_t* table = calloc(len, sizeof(*table));
+  if (table == NULL) return READPE_ERROR_NO_MEMORY;
+
+  const size_t mask = len - 1;
+  for (size_t i = 0; i < n; ++i) {
+    size_t      nlen;
+    const char* name =
+        readpe_context_resolve_string(ctx, ctx->export_names[i], &nlen);
+
+    size_t j = readpe_export_hash_(name, nlen) & mask;
+    for (; table[j] != 0; j = (j+1) & mask) {
+      /* keeps the first one of duplicated names */
+      size_t      jlen;
+      const char* jname = readpe_context_resolve_string(
+          ctx, ctx->export_names[table[j]-1], &jlen);
+      if (jlen == nlen && memcmp(jname, name, nlen) == 0) break;
+    }
+    if (table[j] == 0) table[j] = i+1;
+  }
+
+  ctx->export_hash        = table;
+  ctx->export_hash_length = len;
+  return READPE_OK;
+}
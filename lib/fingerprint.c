@@ -0,0 +1,260 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./hash.h"
+#include "./readpe.h"
+
+#include "./fingerprint_ordinals.h"
+
+static const char* readpe_fingerprint_lookup_ordinal_(
+    const char* dll, size_t len, uint16_t ordinal) {
+  const readpe_fingerprint_ordinal_t* table = NULL;
+  size_t n = 0;
+
+# define dll_(str, t) do {  \
+    if (len == sizeof(str)-1 && strncasecmp(dll, str, len) == 0) {  \
+      table = t;  \
+      n     = sizeof(t)/sizeof(t[0]);  \
+    }  \
+  } while (0)
+
+  dll_("ws2_32.dll",   readpe_fingerprint_ws2_32_);
+  dll_("wsock32.dll",  readpe_fingerprint_ws2_32_);
+  dll_("oleaut32.dll", readpe_fingerprint_oleaut32_);
+
+# undef dll_
+
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    const size_t mid = lo + (hi-lo)/2;
+    if (table[mid].ordinal == ordinal) return table[mid].name;
+    if (table[mid].ordinal < ordinal) {
+      lo = mid+1;
+    } else {
+      hi = mid;
+    }
+  }
+  return NULL;
+}
+
+/* feeds the string in lower case */
+static void readpe_fingerprint_update_lower_(
+    readpe_hash_state_t* st, const char* str, size_t len) {
+  char buf[256];
+  while (len > 0) {
+    const size_t n = len < sizeof(buf)? len: sizeof(buf);
+    for (size_t i = 0; i < n; ++i) {
+      const char c = str[i];
+      buf[i] = 'A' <= c && c <= 'Z'? c - 'A' + 'a': c;
+    }
+    readpe_hash_update(st, buf, n);
+    str += n;
+    len -= n;
+  }
+}
+
+/* The imphash is MD5 of "dll.function" strings in lower case joined by
+ * commas, where the dll has its extension removed if it is dll, ocx or
+ * sys, and functions imported by ordinal are named or taken as "ord<n>". */
+static bool readpe_fingerprint_imphash_(
+    const readpe_context_t* ctx, uint8_t* dst) {
+  const readpe_import_entries_t* e = &ctx->import_entries;
+  if (e->length == 0) return false;
+
+  readpe_hash_state_t st;
+  readpe_hash_initialize(&st, READPE_HASH_MD5);
+
+  for (size_t i = 0; i < ctx->imports_length; ++i) {
+    size_t      dll_len = 0;
+    const char* dll = readpe_context_resolve_string(
+        ctx, ctx->imports[i].name, &dll_len);
+    if (dll == NULL) dll = "";
+
+    size_t stem = dll_len;
+    for (size_t j = dll_len; j > 0; --j) {
+      if (dll[j-1] != '.') continue;
+      const char*  ext     = dll + j;
+      const size_t ext_len = dll_len - j;
+      if (ext_len == 3 && (
+            strncasecmp(ext, "dll", 3) == 0 ||
+            strncasecmp(ext, "ocx", 3) == 0 ||
+            strncasecmp(ext, "sys", 3) == 0)) {
+        stem = j-1;
+      }
+      break;
+    }
+
+    for (size_t j = e->dll_begin[i]; j < e->dll_begin[i+1]; ++j) {
+      if (j > 0) readpe_hash_update(&st, ",", 1);
+      readpe_fingerprint_update_lower_(&st, dll, stem);
+      readpe_hash_update(&st, ".", 1);
+
+      size_t      fn_len = 0;
+      const char* fn     = NULL;
+      char        ord[16];
+      if (e->by_ordinal[j]) {
+        fn = readpe_fingerprint_lookup_ordinal_(dll, dll_len, e->hint[j]);
+        if (fn != NULL) {
+          fn_len = strlen(fn);
+        } else {
+          int n = snprintf(ord, sizeof(ord), "ord%u", (unsigned) e->hint[j]);
+          fn     = ord;
+          fn_len = n;
+        }
+      } else {
+        fn = readpe_context_resolve_string(ctx, e->name[j], &fn_len);
+      }
+      if (fn != NULL) readpe_fingerprint_update_lower_(&st, fn, fn_len);
+    }
+  }
+
+  readpe_hash_t h;
+  readpe_hash_finalize(&st, &h);
+  memcpy(dst, h.md5, sizeof(h.md5));
+  return true;
+}
+
+typedef struct readpe_fingerprint_name_t {
+  const char* str;
+  size_t      len;
+} readpe_fingerprint_name_t;
+
+static int readpe_fingerprint_compare_names_(const void* a, const void* b) {
+  const readpe_fingerprint_name_t* x = a;
+  const readpe_fingerprint_name_t* y = b;
+
+  const int c = memcmp(x->str, y->str, x->len < y->len? x->len: y->len);
+  if (c != 0) return c;
+  return (x->len > y->len) - (x->len < y->len);
+}
+
+/* The export hash is SHA-256 of the export names joined by commas, sorted
+ * in byte order as the loader requires the name table to be. */
+static readpe_error_t readpe_fingerprint_exphash_(
+    const readpe_context_t* ctx, uint8_t* dst, bool* found) {
+  *found = false;
+  if (ctx->export_ == NULL || ctx->export_->number_of_names == 0) {
+    return READPE_OK;
+  }
+
+  const size_t n = ctx->export_->number_of_names;
+
+  readpe_fingerprint_name_t* names = malloc(n*sizeof(*names));
+  if (names == NULL) return READPE_ERROR_NO_MEMORY;
+
+  for (size_t i = 0; i < n; ++i) {
+    names[i].str = readpe_context_resolve_string(
+        ctx, ctx->export_names[i], &names[i].len);
+    if (names[i].str == NULL) {
+      names[i] = (typeof(names[i])) { .str = "", };
+    }
+  }
+  if (!ctx->export_names_sorted) {
+    qsort(names, n, sizeof(*names), readpe_fingerprint_compare_names_);
+  }
+
+  readpe_hash_state_t st;
+  readpe_hash_initialize(&st, READPE_HASH_SHA256);
+  for (size_t i = 0; i < n; ++i) {
+    if (i > 0) readpe_hash_update(&st, ",", 1);
+    readpe_hash_update(&st, names[i].str, names[i].len);
+  }
+  free(names);
+
+  readpe_hash_t h;
+  readpe_hash_finalize(&st, &h);
+  memcpy(dst, h.sha256, sizeof(h.sha256));
+  *found = true;
+  return READPE_OK;
+}
+
+/* The Rich header lies between the DOS header and the NT header, as dwords
+ * XORed with a key following "Rich". Its hash is MD5 of the decoded dwords
+ * from "DanS" up to just before "Rich". */
+static bool readpe_fingerprint_rich_hash_(
+    const readpe_context_t* ctx, uint8_t* dst) {
+  const size_t begin = PE_DOS_HEADER_SIZE;
+  const size_t end   = ctx->dos_header->e_lfanew;
+
+  static const uint32_t rich = 0x68636952;  /* "Rich" */
+  static const uint32_t dans = 0x536E6144;  /* "DanS" */
+
+  size_t   tail = 0;
+  uint32_t key  = 0;
+  for (size_t i = begin; i+8 <= end; i += 4) {
+    uint32_t v;
+    memcpy(&v, ctx->file + i, sizeof(v));
+    if (v == rich) {
+      memcpy(&key, ctx->file + i+4, sizeof(key));
+      tail = i;
+      break;
+    }
+  }
+  if (tail == 0) return false;
+
+  size_t head  = tail;
+  bool   found = false;
+  while (!found && head > begin) {
+    head -= 4;
+
+    uint32_t v;
+    memcpy(&v, ctx->file + head, sizeof(v));
+    found = (v ^ key) == dans;
+  }
+  if (!found) return false;
+
+  readpe_hash_state_t st;
+  readpe_hash_initialize(&st, READPE_HASH_MD5);
+  for (size_t i = head; i < tail; i += 4) {
+    uint32_t v;
+    memcpy(&v, ctx->file + i, sizeof(v));
+    v ^= key;
+    readpe_hash_update(&st, &v, sizeof(v));
+  }
+
+  readpe_hash_t h;
+  readpe_hash_finalize(&st, &h);
+  memcpy(dst, h.md5, sizeof(h.md5));
+  return true;
+}
+
+readpe_error_t readpe_context_compute_fingerprints(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  readpe_error_t err = readpe_context_find_import_table(ctx);
+  if (err != READPE_OK) return err;
+
+  err = readpe_context_find_export_table(ctx);
+  if (err != READPE_OK) return err;
+
+  if (ctx->fingerprints_computed) return READPE_OK;
+
+  readpe_fingerprints_t* fp = &ctx->fingerprints;
+  *fp = (typeof(*fp)) {0};
+
+  fp->imphash_found = readpe_fingerprint_imphash_(ctx, fp->imphash);
+
+  err = readpe_fingerprint_exphash_(ctx, fp->exphash, &fp->exphash_found);
+  if (err != READPE_OK) return err;
+
+  fp->rich_hash_found = readpe_fingerprint_rich_hash_(ctx, fp->rich_hash);
+
+  ctx->fingerprints_computed = true;
+  return READPE_OK;
+}
+
+const readpe_fingerprints_t* readpe_context_get_fingerprints(
+    const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+  assert(ctx->fingerprints_computed);
+  return &ctx->fingerprints;
+}
@@ -0,0 +1,597 @@
+#include "./hash.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&  \
+    !defined(READPE_HASH_NO_SHANI)
+# define READPE_HASH_SHANI
+# include <immintrin.h>
+#endif
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./readpe.h"
+
+#define READPE_HASH_BLOCK_SIZE 64
+
+#define rol_(x, n) (((x) << (n)) | ((x) >> (32-(n))))
+#define ror_(x, n) (((x) >> (n)) | ((x) << (32-(n))))
+
+static inline uint32_t readpe_hash_le32_(const uint8_t* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 |
+      (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+static inline uint32_t readpe_hash_be32_(const uint8_t* p) {
+  return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+      (uint32_t) p[2] << 8 | (uint32_t) p[3];
+}
+
+#if defined(READPE_HASH_SHANI)
+/* constants of each MD5 step, used where steps are interleaved */
+static const uint32_t readpe_hash_md5_k_[64] = {
+  0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE,
+  0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+  0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE,
+  0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+  0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA,
+  0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+  0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED,
+  0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+  0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C,
+  0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+  0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05,
+  0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+  0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039,
+  0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+  0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1,
+  0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391,
+};
+static const uint8_t readpe_hash_md5_s_[16] = {
+  7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21,
+};
+#endif
+
+static void readpe_hash_md5_(uint32_t* h, const uint8_t* blk) {
+  uint32_t x[16];
+  for (size_t i = 0; i < 16; ++i) x[i] = readpe_hash_le32_(blk + i*4);
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+
+# define f_(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+# define g_(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+# define h_(x, y, z) ((x) ^ (y) ^ (z))
+# define i_(x, y, z) ((y) ^ ((x) | ~(z)))
+# define step_(f, a, b, c, d, k, s, t) do {  \
+    a += f(b, c, d) + x[k] + UINT32_C(t);  \
+    a  = rol_(a, s) + b;  \
+  } while (0)
+
+  step_(f_, a, b, c, d,  0,  7, 0xD76AA478);
+  step_(f_, d, a, b, c,  1, 12, 0xE8C7B756);
+  step_(f_, c, d, a, b,  2, 17, 0x242070DB);
+  step_(f_, b, c, d, a,  3, 22, 0xC1BDCEEE);
+  step_(f_, a, b, c, d,  4,  7, 0xF57C0FAF);
+  step_(f_, d, a, b, c,  5, 12, 0x4787C62A);
+  step_(f_, c, d, a, b,  6, 17, 0xA8304613);
+  step_(f_, b, c, d, a,  7, 22, 0xFD469501);
+  step_(f_, a, b, c, d,  8,  7, 0x698098D8);
+  step_(f_, d, a, b, c,  9, 12, 0x8B44F7AF);
+  step_(f_, c, d, a, b, 10, 17, 0xFFFF5BB1);
+  step_(f_, b, c, d, a, 11, 22, 0x895CD7BE);
+  step_(f_, a, b, c, d, 12,  7, 0x6B901122);
+  step_(f_, d, a, b, c, 13, 12, 0xFD987193);
+  step_(f_, c, d, a, b, 14, 17, 0xA679438E);
+  step_(f_, b, c, d, a, 15, 22, 0x49B40821);
+
+  step_(g_, a, b, c, d,  1,  5, 0xF61E2562);
+  step_(g_, d, a, b, c,  6,  9, 0xC040B340);
+  step_(g_, c, d, a, b, 11, 14, 0x265E5A51);
+  step_(g_, b, c, d, a,  0, 20, 0xE9B6C7AA);
+  step_(g_, a, b, c, d,  5,  5, 0xD62F105D);
+  step_(g_, d, a, b, c, 10,  9, 0x02441453);
+  step_(g_, c, d, a, b, 15, 14, 0xD8A1E681);
+  step_(g_, b, c, d, a,  4, 20, 0xE7D3FBC8);
+  step_(g_, a, b, c, d,  9,  5, 0x21E1CDE6);
+  step_(g_, d, a, b, c, 14,  9, 0xC33707D6);
+  step_(g_, c, d, a, b,  3, 14, 0xF4D50D87);
+  step_(g_, b, c, d, a,  8, 20, 0x455A14ED);
+  step_(g_, a, b, c, d, 13,  5, 0xA9E3E905);
+  step_(g_, d, a, b, c,  2,  9, 0xFCEFA3F8);
+  step_(g_, c, d, a, b,  7, 14, 0x676F02D9);
+  step_(g_, b, c, d, a, 12, 20, 0x8D2A4C8A);
+
+  step_(h_, a, b, c, d,  5,  4, 0xFFFA3942);
+  step_(h_, d, a, b, c,  8, 11, 0x8771F681);
+  step_(h_, c, d, a, b, 11, 16, 0x6D9D6122);
+  step_(h_, b, c, d, a, 14, 23, 0xFDE5380C);
+  step_(h_, a, b, c, d,  1,  4, 0xA4BEEA44);
+  step_(h_, d, a, b, c,  4, 11, 0x4BDECFA9);
+  step_(h_, c, d, a, b,  7, 16, 0xF6BB4B60);
+  step_(h_, b, c, d, a, 10, 23, 0xBEBFBC70);
+  step_(h_, a, b, c, d, 13,  4, 0x289B7EC6);
+  step_(h_, d, a, b, c,  0, 11, 0xEAA127FA);
+  step_(h_, c, d, a, b,  3, 16, 0xD4EF3085);
+  step_(h_, b, c, d, a,  6, 23, 0x04881D05);
+  step_(h_, a, b, c, d,  9,  4, 0xD9D4D039);
+  step_(h_, d, a, b, c, 12, 11, 0xE6DB99E5);
+  step_(h_, c, d, a, b, 15, 16, 0x1FA27CF8);
+  step_(h_, b, c, d, a,  2, 23, 0xC4AC5665);
+
+  step_(i_, a, b, c, d,  0,  6, 0xF4292244);
+  step_(i_, d, a, b, c,  7, 10, 0x432AFF97);
+  step_(i_, c, d, a, b, 14, 15, 0xAB9423A7);
+  step_(i_, b, c, d, a,  5, 21, 0xFC93A039);
+  step_(i_, a, b, c, d, 12,  6, 0x655B59C3);
+  step_(i_, d, a, b, c,  3, 10, 0x8F0CCC92);
+  step_(i_, c, d, a, b, 10, 15, 0xFFEFF47D);
+  step_(i_, b, c, d, a,  1, 21, 0x85845DD1);
+  step_(i_, a, b, c, d,  8,  6, 0x6FA87E4F);
+  step_(i_, d, a, b, c, 15, 10, 0xFE2CE6E0);
+  step_(i_, c, d, a, b,  6, 15, 0xA3014314);
+  step_(i_, b, c, d, a, 13, 21, 0x4E0811A1);
+  step_(i_, a, b, c, d,  4,  6, 0xF7537E82);
+  step_(i_, d, a, b, c, 11, 10, 0xBD3AF235);
+  step_(i_, c, d, a, b,  2, 15, 0x2AD7D2BB);
+  step_(i_, b, c, d, a,  9, 21, 0xEB86D391);
+
+# undef step_
+# undef i_
+# undef h_
+# undef g_
+# undef f_
+
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+}
+
+static void readpe_hash_sha1_(uint32_t* h, const uint8_t* blk) {
+  uint32_t w[16];
+  for (size_t i = 0; i < 16; ++i) w[i] = readpe_hash_be32_(blk + i*4);
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+# define f0_(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+# define f1_(x, y, z) ((x) ^ (y) ^ (z))
+# define f2_(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+# define w_(i) (w[(i)&15] = rol_(  \
+      w[((i)+13)&15] ^ w[((i)+8)&15] ^ w[((i)+2)&15] ^ w[(i)&15], 1))
+# define step_(f, k, wi, a, b, c, d, e) do {  \
+    e += rol_(a, 5) + f(b, c, d) + UINT32_C(k) + (wi);  \
+    b  = rol_(b, 30);  \
+  } while (0)
+# define step5_(f, k, W, i) do {  \
+    step_(f, k, W((i)+0), a, b, c, d, e);  \
+    step_(f, k, W((i)+1), e, a, b, c, d);  \
+    step_(f, k, W((i)+2), d, e, a, b, c);  \
+    step_(f, k, W((i)+3), c, d, e, a, b);  \
+    step_(f, k, W((i)+4), b, c, d, e, a);  \
+  } while (0)
+# define wl_(i) w[i]
+
+  step5_(f0_, 0x5A827999, wl_,  0);
+  step5_(f0_, 0x5A827999, wl_,  5);
+  step5_(f0_, 0x5A827999, wl_, 10);
+  step_(f0_, 0x5A827999, w[15], a, b, c, d, e);
+  step_(f0_, 0x5A827999, w_(16), e, a, b, c, d);
+  step_(f0_, 0x5A827999, w_(17), d, e, a, b, c);
+  step_(f0_, 0x5A827999, w_(18), c, d, e, a, b);
+  step_(f0_, 0x5A827999, w_(19), b, c, d, e, a);
+
+  step5_(f1_, 0x6ED9EBA1, w_, 20);
+  step5_(f1_, 0x6ED9EBA1, w_, 25);
+  step5_(f1_, 0x6ED9EBA1, w_, 30);
+  step5_(f1_, 0x6ED9EBA1, w_, 35);
+
+  step5_(f2_, 0x8F1BBCDC, w_, 40);
+  step5_(f2_, 0x8F1BBCDC, w_, 45);
+  step5_(f2_, 0x8F1BBCDC, w_, 50);
+  step5_(f2_, 0x8F1BBCDC, w_, 55);
+
+  step5_(f1_, 0xCA62C1D6, w_, 60);
+  step5_(f1_, 0xCA62C1D6, w_, 65);
+  step5_(f1_, 0xCA62C1D6, w_, 70);
+  step5_(f1_, 0xCA62C1D6, w_, 75);
+
+# undef wl_
+# undef step5_
+# undef step_
+# undef w_
+# undef f2_
+# undef f1_
+# undef f0_
+
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static const uint32_t readpe_hash_sha256_k_[64] = {
+  0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+  0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+  0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+  0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+  0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+  0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+  0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+  0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+  0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+  0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+  0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+  0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+  0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+  0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+  0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+  0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static void readpe_hash_sha256_(uint32_t* h, const uint8_t* blk) {
+  uint32_t w[64];
+  for (size_t i = 0; i < 16; ++i) w[i] = readpe_hash_be32_(blk + i*4);
+  for (size_t i = 16; i < 64; ++i) {
+    const uint32_t s0 =
+        ror_(w[i-15], 7) ^ ror_(w[i-15], 18) ^ (w[i-15] >> 3);
+    const uint32_t s1 =
+        ror_(w[i-2], 17) ^ ror_(w[i-2], 19) ^ (w[i-2] >> 10);
+    w[i] = w[i-16] + s0 + w[i-7] + s1;
+  }
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+  uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+
+# define step_(i, a, b, c, d, e, f, g, h) do {  \
+    const uint32_t t =  h +  \
+        (ror_(e, 6) ^ ror_(e, 11) ^ ror_(e, 25)) + (g ^ (e & (f ^ g))) +  \
+        readpe_hash_sha256_k_[i] + w[i];  \
+    d += t;  \
+    h  = t + (ror_(a, 2) ^ ror_(a, 13) ^ ror_(a, 22)) +  \
+        ((a & b) | (c & (a | b)));  \
+  } while (0)
+
+  for (size_t i = 0; i < 64; i += 8) {
+    step_(i+0, a, b, c, d, e, f, g, k);
+    step_(i+1, k, a, b, c, d, e, f, g);
+    step_(i+2, g, k, a, b, c, d, e, f);
+    step_(i+3, f, g, k, a, b, c, d, e);
+    step_(i+4, e, f, g, k, a, b, c, d);
+    step_(i+5, d, e, f, g, k, a, b, c);
+    step_(i+6, c, d, e, f, g, k, a, b);
+    step_(i+7, b, c, d, e, f, g, k, a);
+  }
+
+# undef step_
+
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+  h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+#undef ror_
+#undef rol_
+
+#if defined(READPE_HASH_SHANI)
+__attribute__((target("sha,sse4.1")))
+static inline void readpe_hash_sha1_shani_group_(
+    size_t j, __m128i* w, __m128i* abcd, __m128i* e0, __m128i* prev) {
+  if (j >= 4) {
+    w[j&3] = _mm_sha1msg2_epu32(_mm_xor_si128(
+          _mm_sha1msg1_epu32(w[j&3], w[(j+1)&3]), w[(j+2)&3]), w[(j+3)&3]);
+  }
+  const __m128i e = j == 0?
+      _mm_add_epi32(*e0, w[0]): _mm_sha1nexte_epu32(*prev, w[j&3]);
+  *prev = *abcd;
+  switch (j/5) {
+  case 0: *abcd = _mm_sha1rnds4_epu32(*abcd, e, 0); break;
+  case 1: *abcd = _mm_sha1rnds4_epu32(*abcd, e, 1); break;
+  case 2: *abcd = _mm_sha1rnds4_epu32(*abcd, e, 2); break;
+  case 3: *abcd = _mm_sha1rnds4_epu32(*abcd, e, 3); break;
+  }
+}
+
+__attribute__((target("sha,sse4.1")))
+static inline void readpe_hash_sha256_shani_group_(
+    size_t j, __m128i* w, __m128i* abef, __m128i* cdgh) {
+  if (j >= 4) {
+    w[j&3] = _mm_sha256msg2_epu32(_mm_add_epi32(
+          _mm_sha256msg1_epu32(w[j&3], w[(j+1)&3]),
+          _mm_alignr_epi8(w[(j+3)&3], w[(j+2)&3], 4)), w[(j+3)&3]);
+  }
+  __m128i m = _mm_add_epi32(w[j&3],
+      _mm_loadu_si128((const __m128i*) &readpe_hash_sha256_k_[j*4]));
+  *cdgh = _mm_sha256rnds2_epu32(*cdgh, *abef, m);
+  m     = _mm_shuffle_epi32(m, 0x0E);
+  *abef = _mm_sha256rnds2_epu32(*abef, *cdgh, m);
+}
+
+/* With SHA extensions, SHA-1 and SHA-256 run on the vector units while
+ * MD5 keeps the scalar ALUs busy. Their rounds are interleaved within each
+ * block, so that the three independent chains overlap in the core instead
+ * of running one after another. */
+__attribute__((target("sha,sse4.1")))
+static void readpe_hash_blocks_shani_(
+    readpe_hash_state_t* st, const uint8_t* data, size_t blocks) {
+  const bool md5    = st->algorithms & READPE_HASH_MD5;
+  const bool sha1   = st->algorithms & READPE_HASH_SHA1;
+  const bool sha256 = st->algorithms & READPE_HASH_SHA256;
+
+  const __m128i sha1_bswap =
+      _mm_set_epi64x(0x0001020304050607LL, 0x08090A0B0C0D0E0FLL);
+  const __m128i sha256_bswap =
+      _mm_set_epi64x(0x0C0D0E0F08090A0BLL, 0x0405060700010203LL);
+
+  uint32_t a = st->md5[0], b = st->md5[1], c = st->md5[2], d = st->md5[3];
+
+  /* SHA-1 keeps ABCD in reversed order and E in the highest word */
+  __m128i abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128((const __m128i*) st->sha1), 0x1B);
+  __m128i e0 = _mm_set_epi32((int) st->sha1[4], 0, 0, 0);
+
+  /* SHA-256 keeps the state as ABEF and CDGH */
+  __m128i t0 = _mm_shuffle_epi32(
+      _mm_loadu_si128((const __m128i*) &st->sha256[0]), 0xB1);
+  __m128i t1 = _mm_shuffle_epi32(
+      _mm_loadu_si128((const __m128i*) &st->sha256[4]), 0x1B);
+  __m128i abef = _mm_alignr_epi8(t0, t1, 8);
+  __m128i cdgh = _mm_blend_epi16(t1, t0, 0xF0);
+
+  for (size_t i = 0; i < blocks; ++i) {
+    const uint8_t* blk = data + i*READPE_HASH_BLOCK_SIZE;
+
+    uint32_t x[16];
+    __m128i  w1[4], w256[4];
+    for (size_t j = 0; j < 16; ++j) x[j] = readpe_hash_le32_(blk + j*4);
+    for (size_t j = 0; j < 4; ++j) {
+      const __m128i v = _mm_loadu_si128((const __m128i*) (blk + j*16));
+      w1[j]   = _mm_shuffle_epi8(v, sha1_bswap);
+      w256[j] = _mm_shuffle_epi8(v, sha256_bswap);
+    }
+
+    const uint32_t a0 = a, b0 = b, c0 = c, d0 = d;
+    const __m128i abcd_save = abcd, e_save = e0;
+    const __m128i abef_save = abef, cdgh_save = cdgh;
+    __m128i prev = abcd;
+
+    /* each of 16 slots takes 4 steps of MD5, 4 rounds of SHA-256 and
+     * 5 rounds of SHA-1 in average */
+#   pragma GCC unroll 16
+    for (size_t j = 0; j < 16; ++j) {
+      if (md5) {
+        for (size_t k = j*4; k < j*4+4; ++k) {
+          uint32_t f;
+          size_t   g;
+          switch (k/16) {
+          case 0:  f = d ^ (b & (c ^ d)); g = k;          break;
+          case 1:  f = c ^ (d & (b ^ c)); g = (5*k+1)%16; break;
+          case 2:  f = b ^ c ^ d;         g = (3*k+5)%16; break;
+          default: f = c ^ (b | ~d);      g = (7*k)%16;   break;
+          }
+          const uint32_t t = a + f + readpe_hash_md5_k_[k] + x[g];
+          const unsigned r = readpe_hash_md5_s_[k/16*4 + k%4];
+          a = d; d = c; c = b;
+          b += (t << r) | (t >> (32-r));
+        }
+      }
+      if (sha256) {
+        readpe_hash_sha256_shani_group_(j, w256, &abef, &cdgh);
+      }
+      if (sha1) {
+        for (size_t k = j*5/4; k < (j+1)*5/4; ++k) {
+          readpe_hash_sha1_shani_group_(k, w1, &abcd, &e0, &prev);
+        }
+      }
+    }
+
+    a += a0; b += b0; c += c0; d += d0;
+    if (sha1) {
+      e0   = _mm_sha1nexte_epu32(prev, e_save);
+      abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+    abef = _mm_add_epi32(abef, abef_save);
+    cdgh = _mm_add_epi32(cdgh, cdgh_save);
+  }
+
+  st->md5[0] = a; st->md5[1] = b; st->md5[2] = c; st->md5[3] = d;
+
+  _mm_storeu_si128((__m128i*) st->sha1, _mm_shuffle_epi32(abcd, 0x1B));
+  st->sha1[4] = (uint32_t) _mm_extract_epi32(e0, 3);
+
+  t0 = _mm_shuffle_epi32(abef, 0x1B);
+  t1 = _mm_shuffle_epi32(cdgh, 0xB1);
+  _mm_storeu_si128((__m128i*) &st->sha256[0], _mm_blend_epi16(t0, t1, 0xF0));
+  _mm_storeu_si128((__m128i*) &st->sha256[4], _mm_alignr_epi8(t1, t0, 8));
+}
+#endif
+
+/* Without hardware support, each algorithm runs over a run of blocks at
+ * once instead. The scalar compressions saturate the ALUs by themselves,
+ * so interleaving them gains nothing, while the run is short enough to
+ * stay in L1 cache and the input is read from memory only once. */
+static void readpe_hash_blocks_(
+    readpe_hash_state_t* st, const uint8_t* data, size_t blocks) {
+#if defined(READPE_HASH_SHANI)
+  if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+    readpe_hash_blocks_shani_(st, data, blocks);
+    return;
+  }
+#endif
+
+  if (st->algorithms & READPE_HASH_MD5) {
+    for (size_t i = 0; i < blocks; ++i) {
+      readpe_hash_md5_(st->md5, data + i*READPE_HASH_BLOCK_SIZE);
+    }
+  }
+  if (st->algorithms & READPE_HASH_SHA1) {
+    for (size_t i = 0; i < blocks; ++i) {
+      readpe_hash_sha1_(st->sha1, data + i*READPE_HASH_BLOCK_SIZE);
+    }
+  }
+  if (st->algorithms & READPE_HASH_SHA256) {
+    for (size_t i = 0; i < blocks; ++i) {
+      readpe_hash_sha256_(st->sha256, data + i*READPE_HASH_BLOCK_SIZE);
+    }
+  }
+}
+
+void readpe_hash_initialize(readpe_hash_state_t* st, unsigned algorithms) {
+  assert(st != NULL);
+
+  *st = (typeof(*st)) {
+    .algorithms = algorithms,
+    .md5    = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, },
+    .sha1   = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0, },
+    .sha256 = {
+      0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+      0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+    },
+  };
+}
+
+void readpe_hash_update(
+    readpe_hash_state_t* st, const void* data, size_t len) {
+  assert(st   != NULL);
+  assert(data != NULL || len == 0);
+
+  if (len == 0) return;
+
+  const uint8_t* itr = data;
+  st->length += len;
+
+  if (st->buffer_length > 0) {
+    size_t n = READPE_HASH_BLOCK_SIZE - st->buffer_length;
+    if (n > len) n = len;
+    memcpy(st->buffer + st->buffer_length, itr, n);
+    st->buffer_length += n;
+    itr += n;
+    len -= n;
+
+    if (st->buffer_length < READPE_HASH_BLOCK_SIZE) return;
+    readpe_hash_blocks_(st, st->buffer, 1);
+    st->buffer_length = 0;
+  }
+
+  static const size_t run = 16*1024/READPE_HASH_BLOCK_SIZE;
+  while (len >= READPE_HASH_BLOCK_SIZE) {
+    size_t blocks = len/READPE_HASH_BLOCK_SIZE;
+    if (blocks > run) blocks = run;
+
+    readpe_hash_blocks_(st, itr, blocks);
+    itr += blocks*READPE_HASH_BLOCK_SIZE;
+    len -= blocks*READPE_HASH_BLOCK_SIZE;
+  }
+
+  memcpy(st->buffer, itr, len);
+  st->buffer_length = len;
+}
+
+void readpe_hash_finalize(readpe_hash_state_t* st, readpe_hash_t* hash) {
+  assert(st   != NULL);
+  assert(hash != NULL);
+
+  const uint64_t bits = st->length*8;
+
+  uint8_t pad[READPE_HASH_BLOCK_SIZE*2] = { 0x80, };
+  const size_t n = (st->buffer_length < 56? 56: 120) - st->buffer_length;
+
+  /* MD5 takes the length in little endian, and SHA in big endian */
+  uint8_t le[8], be[8];
+  for (size_t i = 0; i < 8; ++i) {
+    le[i]   = (uint8_t) (bits >> (i*8));
+    be[7-i] = (uint8_t) (bits >> (i*8));
+  }
+
+  readpe_hash_state_t sha = *st;
+  sha.algorithms &= ~READPE_HASH_MD5;
+  st->algorithms &= READPE_HASH_MD5;
+
+  readpe_hash_update(st, pad, n);
+  readpe_hash_update(st, le, sizeof(le));
+  readpe_hash_update(&sha, pad, n);
+  readpe_hash_update(&sha, be, sizeof(be));
+
+  *hash = (typeof(*hash)) {0};
+  if (st->algorithms & READPE_HASH_MD5) {
+    for (size_t i = 0; i < 16; ++i) {
+      hash->md5[i] = (uint8_t) (st->md5[i/4] >> (i%4*8));
+    }
+  }
+  if (sha.algorithms & READPE_HASH_SHA1) {
+    for (size_t i = 0; i < 20; ++i) {
+      hash->sha1[i] = (uint8_t) (sha.sha1[i/4] >> (24 - i%4*8));
+    }
+  }
+  if (sha.algorithms & READPE_HASH_SHA256) {
+    for (size_t i = 0; i < 32; ++i) {
+      hash->sha256[i] = (uint8_t) (sha.sha256[i/4] >> (24 - i%4*8));
+    }
+  }
+}
+
+
+/* The file is read once from the beginning in chunks small enough to stay
+ * in L1 cache. Each chunk goes to the file hash and then to the hashes of
+ * sections overlapping it, so the sections are hashed from cache. */
+#define READPE_HASH_CHUNK_SIZE (16*1024)
+
+readpe_error_t readpe_context_compute_hashes(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  if (ctx->hashes != NULL) return READPE_OK;
+
+  const size_t n = ctx->nt_header->file.number_of_sections;
+
+  readpe_hash_state_t* st = calloc(n+1, sizeof(*st));
+  if (st == NULL) return READPE_ERROR_NO_MEMORY;
+
+  ctx->hashes = calloc(n+1, sizeof(*ctx->hashes));
+  if (ctx->hashes == NULL) {
+    free(st);
+    return READPE_ERROR_NO_MEMORY;
+  }
+
+  for (size_t i = 0; i < n+1; ++i) {
+    readpe_hash_initialize(&st[i], READPE_HASH_ALL);
+  }
+
+  for (size_t off = 0; off < ctx->file_length;) {
+    size_t len = ctx->file_length - off;
+    if (len > READPE_HASH_CHUNK_SIZE) len = READPE_HASH_CHUNK_SIZE;
+
+    readpe_hash_update(&st[0], ctx->file + off, len);
+
+    for (size_t i = 0; i < n; ++i) {
+      const pe_image_section_header_t* s = &ctx->sections[i];
+
+      /* the raw data is known to be in the file since initialization */
+      const size_t begin = s->pointer_to_raw_data;
+      const size_t end   = begin + s->size_of_raw_data;
+      if (s->size_of_raw_data == 0 || end <= off || off+len <= begin) {
+        continue;
+      }
+      const size_t b = begin > off?     begin: off;
+      const size_t e = end   < off+len? end:   off+len;
+      readpe_hash_update(&st[i+1], ctx->file + b, e-b);
+    }
+    off += len;
+  }
+
+  for (size_t i = 0; i < n+1; ++i) {
+    readpe_hash_finalize(&st[i], &ctx->hashes[i]);
+  }
+  free(st);
+  return READPE_OK;
+}
+
+const readpe_hash_t* readpe_context_get_file_hash(
+    const readpe_context_t* ctx) {
+  assert(ctx         != NULL);
+  assert(ctx->hashes != NULL);
+  return &ctx->hashes[0];
+}
+
+const readpe_hash_t* readpe_context_get_section_hashes(
+    const readpe_context_t* ctx) {
+  assert(ctx         != NULL);
+  assert(ctx->hashes != NULL);
+  return &ctx->hashes[1];
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./readpe.h"
+
+/* bit flags to choose the algorithms to run */
+#define READPE_HASH_MD5    (1u << 0)
+#define READPE_HASH_SHA1   (1u << 1)
+#define READPE_HASH_SHA256 (1u << 2)
+#define READPE_HASH_ALL  \
+    (READPE_HASH_MD5 | READPE_HASH_SHA1 | READPE_HASH_SHA256)
+
+/* All of the algorithms consume 64-byte blocks, so a state shares one
+ * block buffer between them and each block is fed to all at once. */
+typedef struct readpe_hash_state_t {
+  unsigned algorithms;
+
+  uint32_t md5[4];
+  uint32_t sha1[5];
+  uint32_t sha256[8];
+
+  uint64_t length;
+  uint8_t  buffer[64];
+  size_t   buffer_length;
+} readpe_hash_state_t;
+
+void
+readpe_hash_initialize(
+    readpe_hash_state_t* st,
+    unsigned             algorithms
+);
+
+void
+readpe_hash_update(
+    readpe_hash_state_t* st,
+    const void*          data,
+    size_t               len
+);
+
+void
+readpe_hash_finalize(
+    readpe_hash_state_t* st,
+    readpe_hash_t*       hash
+);
+    /* Digests of algorithms not chosen are filled with zeros. */
@@ -0,0 +1,135 @@
+#include "./image.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool readpe_image_initialize(
+    readpe_image_t* img, uintmax_t length, size_t reserve) {
+  assert(img != NULL);
+
+  *img = (typeof(*img)) {
+    .length           = length,
+    .extents_reserved = reserve,
+  };
+  if (reserve == 0) return true;
+
+  img->extents = calloc(reserve, sizeof(*img->extents));
+  if (img->extents == NULL) {
+    img->extents_reserved = 0;
+    return false;
+  }
+  return true;
+}
+
+void readpe_image_deinitialize(readpe_image_t* img) {
+  if (img == NULL) return;
+
+  free(img->extents);
+  *img = (typeof(*img)) {0};
+}
+
+bool readpe_image_add_extent(
+    readpe_image_t* img, const readpe_image_extent_t* ext) {
+  assert(img != NULL);
+  assert(ext != NULL);
+  assert(ext->data != NULL || ext->length == 0);
+  assert(ext->length <= ext->virtual_length);
+
+  if (ext->virtual_length == 0) return true;
+
+  if (img->extents_length >= img->extents_reserved) {
+    const size_t n = img->extents_reserved*2 + 1;
+
+    readpe_image_extent_t* ptr = realloc(img->extents, n*sizeof(*ptr));
+    if (ptr == NULL) return false;
+
+    img->extents          = ptr;
+    img->extents_reserved = n;
+  }
+  img->extents[img->extents_length++] = *ext;
+  return true;
+}
+
+static int readpe_image_compare_extents_(const void* a, const void* b) {
+  const readpe_image_extent_t* x = a;
+  const readpe_image_extent_t* y = b;
+  return (x->rva > y->rva) - (x->rva < y->rva);
+}
+
+void readpe_image_build_index(readpe_image_t* img) {
+  assert(img != NULL);
+
+  qsort(img->extents, img->extents_length,
+      sizeof(*img->extents), readpe_image_compare_extents_);
+
+  size_t n = 0;
+  for (size_t i = 0; i < img->extents_length; ++i) {
+    readpe_image_extent_t* ext = &img->extents[i];
+
+    if (i+1 < img->extents_length) {
+      const uintmax_t next = img->extents[i+1].rva;
+      if (ext->rva + ext->virtual_length > next) {
+        ext->virtual_length = next - ext->rva;
+        if (ext->length > ext->virtual_length) {
+          ext->length = ext->virtual_length;
+        }
+      }
+    }
+    if (ext->virtual_length > 0) img->extents[n++] = *ext;
+  }
+  img->extents_length = n;
+}
+
+const uint8_t* readpe_image_resolve(
+    const readpe_image_t* img, uintmax_t rva, size_t* len, uintmax_t* vlen) {
+  assert(img != NULL);
+  assert(len != NULL);
+
+  if (rva >= img->length) return NULL;
+
+  /* finds the last extent beginning at or before the rva */
+  size_t l = 0, r = img->extents_length;
+  while (l < r) {
+    const size_t m = l + (r-l)/2;
+    if (img->extents[m].rva <= rva) {
+      l = m+1;
+    } else {
+      r = m;
+    }
+  }
+  if (l == 0) return NULL;
+
+  const readpe_image_extent_t* ext = &img->extents[l-1];
+
+  const uintmax_t offset = rva - ext->rva;
+  if (offset >= ext->virtual_length) return NULL;
+
+  if (vlen != NULL) *vlen = ext->virtual_length - offset;
+  if (offset >= ext->length) return NULL;
+
+  *len = ext->length - offset;
+  return ext->data + offset;
+}
+
+void readpe_image_load(const readpe_image_t* img, uint8_t* dst) {
+  assert(img != NULL);
+  assert(dst != NULL || img->length == 0);
+
+  uintmax_t cur = 0;
+  for (size_t i = 0; i < img->extents_length; ++i) {
+    const readpe_image_extent_t* ext = &img->extents[i];
+    if (ext->rva >= img->length) break;
+
+    uintmax_t len = ext->length;
+    if (len > img->length - ext->rva) len = img->length - ext->rva;
+
+    memset(dst + cur, 0, ext->rva - cur);
+    memcpy(dst + ext->rva, ext->data, len);
+    cur = ext->rva + len;
+  }
+  memset(dst + cur, 0, img->length - cur);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* An image is a set of extents laid out on RVA space. Each extent refers to
+ * its own storage, so memory usage never depends on the declared image size.
+ * Bytes between length and virtual_length are zero-filled on loading. */
+typedef struct readpe_image_extent_t {
+  uintmax_t rva;
+  uintmax_t virtual_length;
+
+  const uint8_t* data;  /* NULLABLE if length is 0 */
+  size_t         length;
+} readpe_image_extent_t;
+
+typedef struct readpe_image_t {
+  uintmax_t length;
+
+  readpe_image_extent_t* extents;
+  size_t                 extents_length;
+  size_t                 extents_reserved;
+} readpe_image_t;
+
+bool
+readpe_image_initialize(
+    readpe_image_t* img,
+    uintmax_t       length,
+    size_t          reserve
+);
+
+void
+readpe_image_deinitialize(
+    readpe_image_t* img
+);
+
+bool
+readpe_image_add_extent(
+    readpe_image_t*              img,
+    const readpe_image_extent_t* ext
+);
+
+void
+readpe_image_build_index(
+    readpe_image_t* img
+);
+    /* Sorts extents by RVA. An extent overlapped by the next one is
+     * truncated where the next one begins. */
+
+const uint8_t*  /* NULLABLE */
+readpe_image_resolve(
+    const readpe_image_t* img,
+    uintmax_t             rva,
+    size_t*               len,   /* bytes readable from the returned pointer */
+    uintmax_t*            vlen   /* NULLABLE, bytes until the extent ends */
+);
+
+void
+readpe_image_load(
+    const readpe_image_t* img,
+    uint8_t*              dst  /* must have img->length bytes */
+);
+    /* Lays out all extents on RVA space, zero-filling the rest. */
@@ -0,0 +1,121 @@
+#include "./import.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./readpe.h"
+
+static bool readpe_import_reserve_(
+    readpe_import_entries_t* entries, size_t* reserved) {
+  assert(entries  != NULL);
+  assert(reserved != NULL);
+
+  if (entries->length < *reserved) return true;
+
+  const size_t n = *reserved*2 + 64;
+
+# define realloc_(name) do {  \
+    typeof(entries->name) ptr =  \
+        realloc(entries->name, n*sizeof(*entries->name));  \
+    if (ptr == NULL) return false;  \
+    entries->name = ptr;  \
+  } while (0)
+
+  realloc_(dll);
+  realloc_(hint);
+  realloc_(name);
+  realloc_(by_ordinal);
+  realloc_(iat);
+
+# undef realloc_
+
+  *reserved = n;
+  return true;
+}
+
+#define READPE_IMPORT_BITS 32
+#include "./import_thunk.h"
+
+#define READPE_IMPORT_BITS 64
+#include "./import_thunk.h"
+
+bool readpe_import_parse(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  if (ctx->data_directory_length <= PE_IMAGE_DIRECTORY_ENTRY_IMPORT) {
+    return true;
+  }
+
+  const pe_image_data_directory_t* dir =
+      &ctx->data_directory[PE_IMAGE_DIRECTORY_ENTRY_IMPORT];
+  if (dir->virtual_address == 0 || dir->size == 0) return true;
+
+  size_t len;
+  ctx->imports = (typeof(ctx->imports))
+      readpe_context_resolve_rva(ctx, dir->virtual_address, &len);
+
+  static const size_t minsz =
+      offsetof(pe_image_import_descriptor_t, characteristics) +
+      sizeof(ctx->imports->characteristics);
+  if (ctx->imports == NULL || len < minsz) {
+    return false;
+  }
+
+  const pe_image_import_descriptor_t* end = ctx->imports;
+  while (end->characteristics != 0) {
+    ++end;
+    if ((uint8_t*) end + minsz > (uint8_t*) ctx->imports + len) {
+      return false;
+    }
+  }
+  ctx->imports_length = end - ctx->imports;
+
+  if (ctx->imports_length*PE_IMAGE_IMPORT_DESCRIPTOR_SIZE > len) {
+    return false;
+  }
+
+  ctx->import_entries.dll_begin = malloc(
+      (ctx->imports_length+1)*sizeof(*ctx->import_entries.dll_begin));
+  if (ctx->import_entries.dll_begin == NULL) return false;
+
+  /* the width of thunks is dispatched only once here */
+  return ctx->_64bit?
+      readpe_import_parse_entries64_(ctx):
+      readpe_import_parse_entries32_(ctx);
+}
+
+void readpe_import_deinitialize(readpe_import_entries_t* entries) {
+  if (entries == NULL) return;
+
+  free(entries->dll);
+  free(entries->hint);
+  free(entries->name);
+  free(entries->by_ordinal);
+  free(entries->iat);
+  free(entries->dll_begin);
+  *entries = (typeof(*entries)) {0};
+}
+
+const pe_image_import_descriptor_t* readpe_context_get_import_descriptors(
+    const readpe_context_t* ctx, size_t* len) {
+  assert(ctx != NULL);
+  assert(len != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_IMPORT));
+
+  *len = ctx->imports_length;
+  return ctx->imports;
+}
+
+const readpe_import_entries_t* readpe_context_get_import_entries(
+    const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_IMPORT));
+
+  return &ctx->import_entries;
+}
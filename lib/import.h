@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "./context.h"
+#include "./readpe.h"
+
+bool
+readpe_import_parse(
+    readpe_context_t* ctx
+);
+    /* Validates the import directory and decodes its entries. */
+
+void
+readpe_import_deinitialize(
+    readpe_import_entries_t* entries
+);
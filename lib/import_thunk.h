@@ -0,0 +1,102 @@
+/* A template of the INT/IAT decoder, included by import.c once for each
+ * width of thunks with READPE_IMPORT_BITS defined to 32 or 64. */
+
+#if !defined(READPE_IMPORT_BITS)
+# error "READPE_IMPORT_BITS must be defined"
+#endif
+
+#define READPE_IMPORT_CAT__(a, b, c) a##b##c
+#define READPE_IMPORT_CAT_(a, b, c)  READPE_IMPORT_CAT__(a, b, c)
+
+#define thunk_t_ \
+    READPE_IMPORT_CAT_(pe, READPE_IMPORT_BITS, _image_thunk_data_t)
+#define ORDINAL_FLAG_ \
+    READPE_IMPORT_CAT_(PE, READPE_IMPORT_BITS, _IMAGE_ORDINAL_FLAG)
+#define ORDINAL_ \
+    READPE_IMPORT_CAT_(PE, READPE_IMPORT_BITS, _IMAGE_ORDINAL)
+#define THUNK_DATA_SIZE_ \
+    READPE_IMPORT_CAT_(PE, READPE_IMPORT_BITS, _IMAGE_THUNK_DATA_SIZE)
+
+static bool READPE_IMPORT_CAT_(
+    readpe_import_parse_entries, READPE_IMPORT_BITS, _)(
+    readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  readpe_import_entries_t* entries  = &ctx->import_entries;
+  size_t                   reserved = 0;
+
+  const pe_image_import_descriptor_t* itr = ctx->imports;
+  for (size_t i = 0; i < ctx->imports_length; ++i, ++itr) {
+    entries->dll_begin[i] = entries->length;
+
+    size_t int_avail;
+    const thunk_t_* int_itr = (typeof(int_itr)) readpe_context_resolve_rva(
+        ctx, itr->original_first_thunk, &int_avail);
+    if (int_itr == NULL) {
+      return false;
+    }
+    if (readpe_context_resolve_string(ctx, itr->name, NULL) == NULL) {
+      return false;
+    }
+    size_t iat_avail;
+    const thunk_t_* iat_itr = (typeof(iat_itr)) readpe_context_resolve_rva(
+        ctx, itr->first_thunk, &iat_avail);
+    if (iat_itr == NULL) {
+      return false;
+    }
+
+    const size_t int_max = int_avail/THUNK_DATA_SIZE_;
+    const size_t iat_max = iat_avail/THUNK_DATA_SIZE_;
+    for (size_t j = 0; ; ++j) {
+      if (j >= int_max) {
+        return false;
+      }
+
+      uint64_t value = int_itr[j].address_of_data;
+      if (value == 0) break;
+
+      const bool ordinal = value & ORDINAL_FLAG_;
+      if (ordinal) value &= ORDINAL_;
+
+      /* the IAT must be as long as the INT */
+      if (j >= iat_max || iat_itr[j].address_of_data == 0) {
+        return false;
+      }
+
+      uint16_t hint = value;
+      if (!ordinal) {
+        size_t ibn_len;
+        const pe_image_import_by_name_t* ibn = (typeof(ibn))
+            readpe_context_resolve_rva(ctx, value, &ibn_len);
+        if (ibn == NULL ||
+            ibn_len < offsetof(pe_image_import_by_name_t, name) ||
+            readpe_context_resolve_string(
+              ctx, value + offsetof(pe_image_import_by_name_t, name),
+              NULL) == NULL) {
+          return false;
+        }
+        hint = ibn->hint;
+      }
+
+      if (!readpe_import_reserve_(entries, &reserved)) return false;
+
+      const size_t k = entries->length++;
+      entries->dll[k]        = i;
+      entries->hint[k]       = hint;
+      entries->name[k]       = ordinal?
+          0: value + offsetof(pe_image_import_by_name_t, name);
+      entries->by_ordinal[k] = ordinal;
+      entries->iat[k]        = itr->first_thunk + j*THUNK_DATA_SIZE_;
+    }
+  }
+  entries->dll_begin[ctx->imports_length] = entries->length;
+  return true;
+}
+
+#undef THUNK_DATA_SIZE_
+#undef ORDINAL_
+#undef ORDINAL_FLAG_
+#undef thunk_t_
+#undef READPE_IMPORT_CAT_
+#undef READPE_IMPORT_CAT__
+#undef READPE_IMPORT_BITS
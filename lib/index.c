@@ -0,0 +1,741 @@
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./readpe.h"
+
+static inline size_t readpe_index_align_(size_t n) {
+  return (n + 7) & ~(size_t) 7;
+}
+
+static bool readpe_index_reserve_(
+    void** ptr, size_t* reserved, size_t n, size_t size) {
+  if (n <= *reserved) return true;
+
+  size_t cap = *reserved*2 + 64;
+  while (cap < n) cap *= 2;
+  if (cap > SIZE_MAX/size) return false;
+
+  void* p = realloc(*ptr, cap*size);
+  if (p == NULL) return false;
+  *ptr      = p;
+  *reserved = cap;
+  return true;
+}
+
+static int readpe_index_compare_keys_(
+    uint16_t ak, const char* a, size_t alen,
+    uint16_t bk, const char* b, size_t blen) {
+  if (ak != bk) return ak < bk? -1: 1;
+
+  const int c = memcmp(a, b, alen < blen? alen: blen);
+  if (c != 0) return c;
+  return (alen > blen) - (alen < blen);
+}
+
+
+/* ---- builder ---- */
+
+typedef struct readpe_index_builder_symbol_t {
+  uint64_t name;  /* offset in the pool */
+  uint32_t length;
+  uint16_t kind;
+  uint64_t hash;
+} readpe_index_builder_symbol_t;
+
+typedef struct readpe_index_builder_file_t {
+  char*  path;
+  size_t refs_begin;
+  size_t refs_length;
+} readpe_index_builder_file_t;
+
+/* Symbols are interned into the pool by an open addressing table, and each
+ * file refers to its symbols by indices, so the postings are made only when
+ * written. */
+struct readpe_index_builder_t {
+  pthread_mutex_t mtx;
+
+  char*  pool;
+  size_t pool_length;
+  size_t pool_reserved;
+
+  readpe_index_builder_symbol_t* symbols;
+  size_t                         symbols_length;
+  size_t                         symbols_reserved;
+
+  uint32_t* table;  /* (symbol + 1), 0 means an empty slot */
+  size_t    table_length;
+
+  readpe_index_builder_file_t* files;
+  size_t                       files_length;
+  size_t                       files_reserved;
+
+  uint32_t* refs;
+  size_t    refs_length;
+  size_t    refs_reserved;
+};
+
+/* symbols of a file being added, before interned */
+typedef struct readpe_index_key_t {
+  uint16_t    kind;
+  const char* str;
+  size_t      len;
+} readpe_index_key_t;
+
+typedef struct readpe_index_keys_t {
+  char*  buf;
+  size_t buf_length;
+  size_t buf_reserved;
+
+  readpe_index_key_t* keys;
+  size_t              length;
+  size_t              reserved;
+} readpe_index_keys_t;
+
+static uint64_t readpe_index_hash_(uint16_t kind, const char* str, size_t len) {
+  /* FNV-1a */
+  uint64_t h = 0xCBF29CE484222325u ^ kind;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= (uint8_t) str[i];
+    h *= 0x100000001B3u;
+  }
+  return h;
+}
+
+/* Appends a key made of the parts. Strings of keys are fixed up as offsets
+ * until the buffer stops moving. */
+static bool readpe_index_push_key_(
+    readpe_index_keys_t* k,
+    uint16_t             kind,
+    const char*          dll,  /* NULLABLE, to be lowered */
+    size_t               dll_len,
+    const char*          name,
+    size_t               name_len) {
+  const size_t len = (dll != NULL? dll_len + 1: 0) + name_len;
+  if (!readpe_index_reserve_((void**) &k->buf, &k->buf_reserved,
+        k->buf_length + len, 1) ||
+      !readpe_index_reserve_((void**) &k->keys, &k->reserved,
+        k->length + 1, sizeof(*k->keys))) {
+    return false;
+  }
+
+  char* dst = k->buf + k->buf_length;
+  if (dll != NULL) {
+    for (size_t i = 0; i < dll_len; ++i) {
+      *(dst++) = (char) tolower((unsigned char) dll[i]);
+    }
+    *(dst++) = '!';
+  }
+  memcpy(dst, name, name_len);
+
+  k->keys[k->length++] = (readpe_index_key_t) {
+    .kind = kind,
+    .str  = (const char*) (uintptr_t) k->buf_length,
+    .len  = len,
+  };
+  k->buf_length += len;
+  return true;
+}
+
+static bool readpe_index_collect_keys_(
+    const readpe_context_t* ctx, readpe_index_keys_t* k) {
+  const readpe_import_entries_t* e = &ctx->import_entries;
+  for (size_t i = 0; i < ctx->imports_length; ++i) {
+    size_t      dll_len;
+    const char* dll = readpe_context_resolve_string(
+        ctx, ctx->imports[i].name, &dll_len);
+    if (dll == NULL) continue;
+
+    for (size_t j = e->dll_begin[i]; j < e->dll_begin[i+1]; ++j) {
+      size_t      fn_len;
+      const char* fn;
+      char        ord[16];
+      if (e->by_ordinal[j]) {
+        fn_len = snprintf(ord, sizeof(ord), "#%u", (unsigned) e->hint[j]);
+        fn     = ord;
+      } else {
+        fn = readpe_context_resolve_string(ctx, e->name[j], &fn_len);
+        if (fn == NULL) continue;
+      }
+      if (!readpe_index_push_key_(
+            k, READPE_INDEX_IMPORT, dll, dll_len, fn, fn_len)) {
+        return false;
+      }
+    }
+  }
+
+  if (ctx->export_ != NULL) {
+    for (size_t i = 0; i < ctx->export_->number_of_names; ++i) {
+      size_t      len;
+      const char* name = readpe_context_resolve_string(
+          ctx, ctx->export_names[i], &len);
+      if (name == NULL) continue;
+      if (!readpe_index_push_key_(
+            k, READPE_INDEX_EXPORT, NULL, 0, name, len)) {
+        return false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < k->length; ++i) {
+    k->keys[i].str = k->buf + (uintptr_t) k->keys[i].str;
+  }
+  return true;
+}
+
+static int readpe_index_compare_key_items_(const void* a, const void* b) {
+  const readpe_index_key_t* x = a;
+  const readpe_index_key_t* y = b;
+  return readpe_index_compare_keys_(
+      x->kind, x->str, x->len, y->kind, y->str, y->len);
+}
+
+static bool readpe_index_builder_rehash_(
+    readpe_index_builder_t* b, size_t n) {
+  uint32_t* table = calloc(n, sizeof(*table));
+  if (table == NULL) return false;
+
+  for (size_t i = 0; i < b->symbols_length; ++i) {
+    size_t slot = b->symbols[i].hash & (n-1);
+    while (table[slot] != 0) slot = (slot+1) & (n-1);
+    table[slot] = i+1;
+  }
+  free(b->table);
+  b->table        = table;
+  b->table_length = n;
+  return true;
+}
+
+/* returns the index of the symbol, interning it if new, or -1 */
+static int64_t readpe_index_builder_intern_(
+    readpe_index_builder_t* b, const readpe_index_key_t* key) {
+  if ((b->symbols_length+1)*2 > b->table_length) {
+    if (!readpe_index_builder_rehash_(
+          b, b->table_length? b->table_length*2: 1024)) {
+      return -1;
+    }
+  }
+
+  const uint64_t h    = readpe_index_hash_(key->kind, key->str, key->len);
+  size_t         slot = h & (b->table_length-1);
+  for (; b->table[slot] != 0; slot = (slot+1) & (b->table_length-1)) {
+    const uint32_t                       i = b->table[slot] - 1;
+    const readpe_index_builder_symbol_t* s = &b->symbols[i];
+    if (s->hash == h && s->kind == key->kind && s->length == key->len &&
+        memcmp(b->pool + s->name, key->str, key->len) == 0) {
+      return i;
+    }
+  }
+
+  if (b->symbols_length >= UINT32_MAX || key->len > UINT32_MAX) return -1;
+  if (!readpe_index_reserve_((void**) &b->pool, &b->pool_reserved,
+        b->pool_length + key->len, 1) ||
+      !readpe_index_reserve_((void**) &b->symbols, &b->symbols_reserved,
+        b->symbols_length + 1, sizeof(*b->symbols))) {
+    return -1;
+  }
+  memcpy(b->pool + b->pool_length, key->str, key->len);
+
+  const size_t i = b->symbols_length++;
+  b->symbols[i] = (readpe_index_builder_symbol_t) {
+    .name   = b->pool_length,
+    .length = key->len,
+    .kind   = key->kind,
+    .hash   = h,
+  };
+  b->pool_length += key->len;
+  b->table[slot]  = i+1;
+  return i;
+}
+
+readpe_error_t readpe_index_builder_create(readpe_index_builder_t** builder) {
+  assert(builder != NULL);
+
+  readpe_index_builder_t* b = calloc(1, sizeof(*b));
+  if (b == NULL) return READPE_ERROR_NO_MEMORY;
+
+  pthread_mutex_init(&b->mtx, NULL);
+  *builder = b;
+  return READPE_OK;
+}
+
+void readpe_index_builder_destroy(readpe_index_builder_t* builder) {
+  if (builder == NULL) return;
+
+  for (size_t i = 0; i < builder->files_length; ++i) {
+    free(builder->files[i].path);
+  }
+  pthread_mutex_destroy(&builder->mtx);
+  free(builder->pool);
+  free(builder->symbols);
+  free(builder->table);
+  free(builder->files);
+  free(builder->refs);
+  free(builder);
+}
+
+readpe_error_t readpe_index_builder_add(
+    readpe_index_builder_t* builder, const char* path, readpe_context_t* ctx) {
+  assert(builder != NULL);
+  assert(path    != NULL);
+  assert(ctx     != NULL);
+
+  readpe_error_t err = readpe_context_find_import_table(ctx);
+  if (err != READPE_OK) return err;
+
+  err = readpe_context_find_export_table(ctx);
+  if (err != READPE_OK) return err;
+
+  /* keys are made and deduplicated before taking the lock */
+  readpe_index_keys_t k = {0};
+  char* dup = strdup(path);
+
+  err = READPE_ERROR_NO_MEMORY;
+  if (dup == NULL || !readpe_index_collect_keys_(ctx, &k)) goto FINALIZE;
+
+  qsort(k.keys, k.length, sizeof(*k.keys), readpe_index_compare_key_items_);
+  size_t n = 0;
+  for (size_t i = 0; i < k.length; ++i) {
+    if (n > 0 && readpe_index_compare_key_items_(
+          &k.keys[n-1], &k.keys[i]) == 0) {
+      continue;
+    }
+    k.keys[n++] = k.keys[i];
+  }
+
+  pthread_mutex_lock(&builder->mtx);
+  readpe_index_builder_t* b = builder;
+
+  const size_t refs_begin = b->refs_length;
+  bool ok =
+      b->files_length < UINT32_MAX &&
+      readpe_index_reserve_((void**) &b->files, &b->files_reserved,
+        b->files_length + 1, sizeof(*b->files)) &&
+      readpe_index_reserve_((void**) &b->refs, &b->refs_reserved,
+        b->refs_length + n, sizeof(*b->refs));
+  for (size_t i = 0; ok && i < n; ++i) {
+    const int64_t sym = readpe_index_builder_intern_(b, &k.keys[i]);
+    ok = sym >= 0;
+    if (ok) b->refs[b->refs_length++] = sym;
+  }
+  if (ok) {
+    b->files[b->files_length++] = (readpe_index_builder_file_t) {
+      .path        = dup,
+      .refs_begin  = refs_begin,
+      .refs_length = n,
+    };
+    dup = NULL;
+  } else {
+    /* interned symbols without references are only written unused */
+    b->refs_length = refs_begin;
+  }
+  pthread_mutex_unlock(&builder->mtx);
+
+  if (ok) err = READPE_OK;
+
+FINALIZE:
+  free(dup);
+  free(k.buf);
+  free(k.keys);
+  return err;
+}
+
+/* qsort has no context, so the items carry what they are compared by */
+typedef struct readpe_index_order_t {
+  uint16_t    kind;
+  const char* str;
+  size_t      len;
+  uint32_t    index;
+} readpe_index_order_t;
+
+static int readpe_index_compare_orders_(const void* a, const void* b) {
+  const readpe_index_order_t* x = a;
+  const readpe_index_order_t* y = b;
+  return readpe_index_compare_keys_(
+      x->kind, x->str, x->len, y->kind, y->str, y->len);
+}
+
+static bool readpe_index_write_padded_(
+    FILE* fp, const void* data, size_t len) {
+  static const uint8_t zeros[8] = {0};
+  if (len > 0 && fwrite(data, len, 1, fp) != 1) return false;
+
+  const size_t pad = readpe_index_align_(len) - len;
+  return pad == 0 || fwrite(zeros, pad, 1, fp) == 1;
+}
+
+readpe_error_t readpe_index_builder_write(
+    const readpe_index_builder_t* builder, const char* path) {
+  assert(builder != NULL);
+  assert(path    != NULL);
+
+  const readpe_index_builder_t* b = builder;
+
+  const size_t nf = b->files_length;
+  const size_t ns = b->symbols_length;
+
+  readpe_index_order_t* files   = calloc(nf+1, sizeof(*files));
+  readpe_index_order_t* symbols = calloc(ns+1, sizeof(*symbols));
+  uint32_t* symbol_ids = calloc(ns+1, sizeof(*symbol_ids));
+  uint64_t* begins     = calloc(ns+1, sizeof(*begins));
+  uint32_t* postings   = calloc(b->refs_length+1, sizeof(*postings));
+
+  FILE* fp = NULL;
+
+  readpe_error_t err = READPE_ERROR_NO_MEMORY;
+  if (files == NULL || symbols == NULL || symbol_ids == NULL ||
+      begins == NULL || postings == NULL) {
+    goto FINALIZE;
+  }
+
+  for (size_t i = 0; i < nf; ++i) {
+    files[i] = (readpe_index_order_t) {
+      .str   = b->files[i].path,
+      .len   = strlen(b->files[i].path),
+      .index = i,
+    };
+  }
+  qsort(files, nf, sizeof(*files), readpe_index_compare_orders_);
+
+  for (size_t i = 0; i < ns; ++i) {
+    const readpe_index_builder_symbol_t* s = &b->symbols[i];
+    symbols[i] = (readpe_index_order_t) {
+      .kind  = s->kind,
+      .str   = b->pool + s->name,
+      .len   = s->length,
+      .index = i,
+    };
+  }
+  qsort(symbols, ns, sizeof(*symbols), readpe_index_compare_orders_);
+  for (size_t i = 0; i < ns; ++i) symbol_ids[symbols[i].index] = i;
+
+  /* Postings are placed by counting, visiting files in the written order,
+   * so that each list is sorted without sorting. */
+  for (size_t i = 0; i < b->refs_length; ++i) {
+    ++begins[symbol_ids[b->refs[i]]+1];
+  }
+  for (size_t i = 0; i < ns; ++i) begins[i+1] += begins[i];
+  {
+    uint64_t* next = calloc(ns+1, sizeof(*next));
+    if (next == NULL) goto FINALIZE;
+    memcpy(next, begins, (ns+1)*sizeof(*next));
+
+    for (size_t i = 0; i < nf; ++i) {
+      const readpe_index_builder_file_t* f = &b->files[files[i].index];
+      for (size_t j = 0; j < f->refs_length; ++j) {
+        const uint32_t sym = symbol_ids[b->refs[f->refs_begin + j]];
+        postings[next[sym]++] = i;
+      }
+    }
+    free(next);
+  }
+
+  err = READPE_ERROR_OPEN;
+  fp = fopen(path, "wb");
+  if (fp == NULL) goto FINALIZE;
+
+  uint64_t names_length = 0;
+  for (size_t i = 0; i < ns; ++i) names_length += symbols[i].len;
+  uint64_t paths_length = 0;
+  for (size_t i = 0; i < nf; ++i) paths_length += files[i].len;
+
+  readpe_index_header_t header = {
+    .version        = READPE_INDEX_VERSION,
+    .files          = nf,
+    .symbols        = ns,
+    .postings       = b->refs_length,
+    .strings_length = names_length + paths_length,
+  };
+  memcpy(header.magic, READPE_INDEX_MAGIC, sizeof(header.magic));
+
+  err = READPE_ERROR_WRITE;
+  bool ok = readpe_index_write_padded_(fp, &header, sizeof(header));
+
+  /* the pool has the names of symbols and then the paths */
+  uint64_t offset = names_length;
+  for (size_t i = 0; ok && i < nf; ++i) {
+    const readpe_index_file_entry_t f = {
+      .path        = offset,
+      .path_length = files[i].len,
+    };
+    ok     = fwrite(&f, sizeof(f), 1, fp) == 1;
+    offset += files[i].len;
+  }
+
+  offset = 0;
+  for (size_t i = 0; ok && i < ns; ++i) {
+    const readpe_index_symbol_entry_t s = {
+      .name        = offset,
+      .name_length = symbols[i].len,
+      .kind        = symbols[i].kind,
+      .postings    = begins[i],
+      .count       = begins[i+1] - begins[i],
+    };
+    ok     = fwrite(&s, sizeof(s), 1, fp) == 1;
+    offset += symbols[i].len;
+  }
+
+  ok = ok && readpe_index_write_padded_(
+      fp, postings, b->refs_length*sizeof(*postings));
+
+  for (size_t i = 0; ok && i < ns; ++i) {
+    ok = symbols[i].len == 0 ||
+        fwrite(symbols[i].str, symbols[i].len, 1, fp) == 1;
+  }
+  for (size_t i = 0; ok && i < nf; ++i) {
+    ok = files[i].len == 0 || fwrite(files[i].str, files[i].len, 1, fp) == 1;
+  }
+  const size_t pad =
+      readpe_index_align_(header.strings_length) - header.strings_length;
+  ok = ok && (pad == 0 || fwrite("\0\0\0\0\0\0\0", pad, 1, fp) == 1);
+
+  if (fclose(fp) != 0) ok = false;
+  fp = NULL;
+  if (ok) err = READPE_OK;
+
+FINALIZE:
+  if (fp != NULL) fclose(fp);
+  free(files);
+  free(symbols);
+  free(symbol_ids);
+  free(begins);
+  free(postings);
+  return err;
+}
+
+
+/* ---- reader ---- */
+
+struct readpe_index_t {
+  void*  map;
+  size_t map_length;
+
+  const readpe_index_header_t*       header;
+  const readpe_index_file_entry_t*   files;
+  const readpe_index_symbol_entry_t* symbols;
+  const uint32_t*                    postings;
+  const char*                        strings;
+};
+
+static const char* readpe_index_string_(
+    const readpe_index_t* idx, uint64_t offset, uint64_t len) {
+  const uint64_t total = idx->header->strings_length;
+  if (offset > total || len > total - offset) return NULL;
+  return idx->strings + offset;
+}
+
+readpe_error_t readpe_index_open(readpe_index_t** idx, const char* path) {
+  assert(idx  != NULL);
+  assert(path != NULL);
+
+  *idx = NULL;
+
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return READPE_ERROR_OPEN;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return READPE_ERROR_READ;
+  }
+  if ((uintmax_t) st.st_size < READPE_INDEX_HEADER_SIZE) {
+    close(fd);
+    return READPE_ERROR_INVALID_INDEX;
+  }
+  const size_t len = st.st_size;
+
+  void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return READPE_ERROR_READ;
+
+  readpe_index_t* ret = calloc(1, sizeof(*ret));
+  if (ret == NULL) {
+    munmap(map, len);
+    return READPE_ERROR_NO_MEMORY;
+  }
+  ret->map        = map;
+  ret->map_length = len;
+
+  const readpe_index_header_t* h = map;
+  ret->header = h;
+
+  /* every part must fit in the file, taking care of overflows */
+  const uint64_t limit = len;
+  bool ok =
+      memcmp(h->magic, READPE_INDEX_MAGIC, sizeof(h->magic)) == 0 &&
+      h->version == READPE_INDEX_VERSION &&
+      h->files    <= limit/READPE_INDEX_FILE_ENTRY_SIZE &&
+      h->symbols  <= limit/READPE_INDEX_SYMBOL_ENTRY_SIZE &&
+      h->postings <= limit/4 &&
+      h->strings_length <= limit;
+  if (ok) {
+    const uint64_t total =
+        READPE_INDEX_HEADER_SIZE +
+        h->files*READPE_INDEX_FILE_ENTRY_SIZE +
+        h->symbols*READPE_INDEX_SYMBOL_ENTRY_SIZE +
+        readpe_index_align_(h->postings*4) +
+        readpe_index_align_(h->strings_length);
+    ok = total == limit;
+  }
+  if (!ok) {
+    readpe_index_close(ret);
+    return READPE_ERROR_INVALID_INDEX;
+  }
+
+  const uint8_t* itr = (const uint8_t*) map + READPE_INDEX_HEADER_SIZE;
+  ret->files    = (const readpe_index_file_entry_t*) itr;
+  itr += h->files*READPE_INDEX_FILE_ENTRY_SIZE;
+  ret->symbols  = (const readpe_index_symbol_entry_t*) itr;
+  itr += h->symbols*READPE_INDEX_SYMBOL_ENTRY_SIZE;
+  ret->postings = (const uint32_t*) itr;
+  itr += readpe_index_align_(h->postings*4);
+  ret->strings  = (const char*) itr;
+
+  *idx = ret;
+  return READPE_OK;
+}
+
+void readpe_index_close(readpe_index_t* idx) {
+  if (idx == NULL) return;
+
+  munmap(idx->map, idx->map_length);
+  free(idx);
+}
+
+size_t readpe_index_get_files_length(const readpe_index_t* idx) {
+  assert(idx != NULL);
+  return idx->header->files;
+}
+
+const char* readpe_index_get_path(
+    const readpe_index_t* idx, size_t index, size_t* len) {
+  assert(idx != NULL);
+  assert(len != NULL);
+
+  if (index >= idx->header->files) return NULL;
+
+  const readpe_index_file_entry_t* f = &idx->files[index];
+  *len = f->path_length;
+  return readpe_index_string_(idx, f->path, f->path_length);
+}
+
+bool readpe_index_get_symbol(
+    const readpe_index_t* idx, size_t index, readpe_index_symbol_t* sym) {
+  assert(idx != NULL);
+  assert(sym != NULL);
+  assert(index < idx->header->symbols);
+
+  const readpe_index_symbol_entry_t* s = &idx->symbols[index];
+
+  const char* name = readpe_index_string_(idx, s->name, s->name_length);
+  if (name == NULL) return false;
+
+  const uint64_t total = idx->header->postings;
+  if (s->postings > total || s->count > total - s->postings) return false;
+
+  *sym = (readpe_index_symbol_t) {
+    .kind         = s->kind,
+    .name         = name,
+    .name_length  = s->name_length,
+    .files        = idx->postings + s->postings,
+    .files_length = s->count,
+  };
+  return true;
+}
+
+/* compares the i-th symbol with the key, only up to the key if prefix */
+static int readpe_index_compare_symbol_(
+    const readpe_index_t* idx,
+    size_t                i,
+    uint16_t              kind,
+    const char*           key,
+    size_t                len,
+    bool                  prefix) {
+  const readpe_index_symbol_entry_t* s = &idx->symbols[i];
+
+  size_t      name_len = s->name_length;
+  const char* name     = readpe_index_string_(idx, s->name, name_len);
+  if (name == NULL) {
+    /* a broken entry is taken as empty, which keeps the search bounded */
+    name     = "";
+    name_len = 0;
+  }
+  if (prefix && name_len > len) name_len = len;
+
+  return readpe_index_compare_keys_(s->kind, name, name_len, kind, key, len);
+}
+
+/* returns the first symbol greater than the key if upper, otherwise the
+ * first one not less than the key */
+static size_t readpe_index_bound_(
+    const readpe_index_t* idx,
+    uint16_t              kind,
+    const char*           key,
+    size_t                len,
+    bool                  prefix,
+    bool                  upper) {
+  size_t lo = 0, hi = idx->header->symbols;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo)/2;
+    const int    c   =
+        readpe_index_compare_symbol_(idx, mid, kind, key, len, prefix);
+    if (c < 0 || (upper && c == 0)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+readpe_error_t readpe_index_find(
+    const readpe_index_t* idx,
+    readpe_index_kind_t   kind,
+    const char*           key,
+    size_t                len,
+    bool                  prefix,
+    size_t*               begin,
+    size_t*               end) {
+  assert(idx   != NULL);
+  assert(key   != NULL || len == 0);
+  assert(begin != NULL);
+  assert(end   != NULL);
+
+  /* room for ".dll" to be inserted */
+  char* norm = malloc(len + 4 + 1);
+  if (norm == NULL) return READPE_ERROR_NO_MEMORY;
+  if (len > 0) memcpy(norm, key, len);
+
+  if (kind == READPE_INDEX_IMPORT) {
+    const char* bang = memchr(norm, '!', len);
+    const size_t dll = bang != NULL? (size_t) (bang - norm): len;
+
+    for (size_t i = 0; i < dll; ++i) {
+      norm[i] = (char) tolower((unsigned char) norm[i]);
+    }
+    if (bang != NULL && memchr(norm, '.', dll) == NULL) {
+      memmove(norm + dll + 4, norm + dll, len - dll);
+      memcpy(norm + dll, ".dll", 4);
+      len += 4;
+    }
+  }
+
+  *begin = readpe_index_bound_(idx, kind, norm, len, prefix, false);
+  *end   = readpe_index_bound_(idx, kind, norm, len, prefix, true);
+  free(norm);
+  return READPE_OK;
+}
@@ -0,0 +1,74 @@
+#include "./parallel.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct readpe_parallel_worker_t {
+  pthread_t thread;
+
+  size_t n;
+  size_t begin;
+  size_t step;
+  void (*fn)(void*, size_t);
+  void*  udata;
+} readpe_parallel_worker_t;
+
+static void* readpe_parallel_work_(void* udata) {
+  readpe_parallel_worker_t* w = udata;
+  for (size_t i = w->begin; i < w->n; i += w->step) w->fn(w->udata, i);
+  return NULL;
+}
+
+size_t readpe_parallel_threads(size_t threads, size_t n) {
+  if (threads == 0) {
+    const long procs = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = procs > 0? (size_t) procs: 1;
+  }
+  if (threads > n) threads = n;
+  return threads > 0? threads: 1;
+}
+
+void readpe_parallel_for(
+    size_t n, size_t threads, void (*fn)(void*, size_t), void* udata) {
+  assert(fn != NULL);
+
+  threads = readpe_parallel_threads(threads, n);
+
+  readpe_parallel_worker_t* workers = NULL;
+  if (threads > 1) workers = calloc(threads, sizeof(*workers));
+  if (workers == NULL) {
+    for (size_t i = 0; i < n; ++i) fn(udata, i);
+    return;
+  }
+
+  /* the caller thread takes the first share, and also the shares of
+   * workers failing to start */
+  for (size_t i = 0; i < threads; ++i) {
+    workers[i] = (readpe_parallel_worker_t) {
+      .n     = n,
+      .begin = i,
+      .step  = threads,
+      .fn    = fn,
+      .udata = udata,
+    };
+  }
+  size_t started = 1;
+  for (; started < threads; ++started) {
+    if (pthread_create(&workers[started].thread, NULL,
+          readpe_parallel_work_, &workers[started]) != 0) {
+      break;
+    }
+  }
+  readpe_parallel_work_(&workers[0]);
+  for (size_t i = 1; i < started; ++i) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  for (size_t i = started; i < threads; ++i) {
+    readpe_parallel_work_(&workers[i]);
+  }
+  free(workers);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+
+size_t
+readpe_parallel_threads(
+    size_t threads,  /* 0 means the number of processors */
+    size_t n         /* of items to be shared */
+);
+    /* Returns the number of threads worth starting for n items, which is at
+     * least 1. */
+
+void
+readpe_parallel_for(
+    size_t n,
+    size_t threads,  /* 0 means the number of processors */
+    void (*fn)(void* udata, size_t index),
+    void*  udata
+);
+    /* Calls fn for each index below n on some threads, and returns after all
+     * calls. Indices are dealt out in turn, so items should take about the
+     * same time. */
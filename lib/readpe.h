@@ -0,0 +1,946 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pe.h"
+
+/* Public interface of libreadpe. The library has no global state, so
+ * contexts can be used from different threads at once, but one context
+ * must not be shared by threads without synchronization. */
+
+typedef enum readpe_error_t {
+  READPE_OK = 0,
+
+  READPE_ERROR_OPEN,
+  READPE_ERROR_READ,
+  READPE_ERROR_NO_MEMORY,
+
+  READPE_ERROR_INVALID_DOS_MAGIC,
+  READPE_ERROR_INVALID_DOS_HEADER,
+  READPE_ERROR_INVALID_DOS_STUB,
+  READPE_ERROR_INVALID_NT_HEADER,
+  READPE_ERROR_UNKNOWN_MACHINE,
+  READPE_ERROR_INVALID_OPTIONAL_HEADER,
+  READPE_ERROR_INVALID_SECTION_TABLE,
+  READPE_ERROR_INVALID_SECTION,
+
+  READPE_ERROR_INVALID_EXPORT_TABLE,
+  READPE_ERROR_INVALID_IMPORT_TABLE,
+  READPE_ERROR_INVALID_RELOCATION_TABLE,
+  READPE_ERROR_UNSUPPORTED_RELOCATION,
+  READPE_ERROR_INVALID_CERTIFICATE_TABLE,
+
+  READPE_ERROR_INVALID_RECORD,
+
+  READPE_ERROR_INVALID_SIGNATURE,
+
+  READPE_ERROR_INVALID_INDEX,
+  READPE_ERROR_WRITE,
+} readpe_error_t;
+
+typedef struct readpe_context_t readpe_context_t;
+
+const char*
+readpe_error_stringify(
+    readpe_error_t err
+);
+
+readpe_error_t
+readpe_context_create(
+    readpe_context_t** ctx,
+    const char*        filename
+);
+
+readpe_error_t
+readpe_context_create_from_fd(
+    readpe_context_t** ctx,
+    int                fd  /* not closed, and can be closed after the call */
+);
+
+readpe_error_t
+readpe_context_create_from_memory(
+    readpe_context_t** ctx,
+    const uint8_t*     buf,  /* must be alive until the context is destroyed */
+    size_t             len
+);
+
+void
+readpe_context_destroy(
+    readpe_context_t* ctx  /* NULLABLE */
+);
+
+bool
+readpe_context_is_64bit(
+    const readpe_context_t* ctx
+);
+
+const pe_dos_header_t*
+readpe_context_get_dos_header(
+    const readpe_context_t* ctx
+);
+
+const pe_nt_header_t*
+readpe_context_get_nt_header(
+    const readpe_context_t* ctx
+);
+
+const pe_image_section_header_t*
+readpe_context_get_sections(
+    const readpe_context_t* ctx,
+    size_t*                 len
+);
+
+const pe_image_data_directory_t*
+readpe_context_get_data_directory(
+    const readpe_context_t* ctx,
+    size_t*                 len
+);
+
+/* Each data directory is validated on the first call of the following
+ * functions and the result is memorized. */
+readpe_error_t
+readpe_context_find_export_table(
+    readpe_context_t* ctx
+);
+
+readpe_error_t
+readpe_context_find_import_table(
+    readpe_context_t* ctx
+);
+
+readpe_error_t
+readpe_context_find_relocation_table(
+    readpe_context_t* ctx
+);
+
+/* The following export functions require
+ * readpe_context_find_export_table to have succeeded. */
+typedef struct readpe_export_t {
+  uint32_t ordinal;  /* biased by the base of the export table */
+  uint32_t rva;
+
+  const char* name;  /* NULLABLE if exported by ordinal only */
+  size_t      name_length;
+
+  bool        forwarded;
+  const char* forwarder;  /* NULLABLE, even if forwarded to broken string */
+  size_t      forwarder_length;
+} readpe_export_t;
+
+const char*  /* NULLABLE */
+readpe_context_get_export_name(
+    const readpe_context_t* ctx,
+    size_t                  index,  /* index of address_of_functions */
+    size_t*                 len     /* NULLABLE */
+);
+    /* Returns NULL if the function is exported by ordinal only. */
+
+bool
+readpe_context_get_export(
+    const readpe_context_t* ctx,
+    size_t                  index,  /* index of address_of_functions */
+    readpe_export_t*        exp
+);
+
+bool
+readpe_context_find_export_by_name(
+    const readpe_context_t* ctx,
+    const char*             name,
+    readpe_export_t*        exp
+);
+    /* Uses the hash index if built, otherwise binary search over the
+     * name table (or linear search if the table is not sorted). */
+
+bool
+readpe_context_find_export_by_string(
+    const readpe_context_t* ctx,
+    const char*             name,  /* not terminated */
+    size_t                  len,
+    readpe_export_t*        exp
+);
+    /* Takes a name which may not be terminated, such as one resolved from
+     * another context. */
+
+bool
+readpe_context_find_export_by_ordinal(
+    const readpe_context_t* ctx,
+    uint32_t                ordinal,  /* biased by the base */
+    readpe_export_t*        exp
+);
+
+readpe_error_t
+readpe_context_build_export_hash(
+    readpe_context_t* ctx
+);
+    /* Builds a hash index of export names for repeated lookups. */
+
+/* Import entries decoded from all INTs at once. The following functions
+ * require readpe_context_find_import_table to have succeeded. */
+typedef struct readpe_import_entries_t {
+  size_t length;
+
+  /* struct of arrays, each has the length */
+  uint32_t* dll;         /* index of the import descriptor */
+  uint16_t* hint;        /* or the ordinal if by_ordinal */
+  uint32_t* name;        /* RVA of the function name, 0 if by_ordinal */
+  bool*     by_ordinal;
+  uint32_t* iat;         /* RVA of the IAT slot */
+
+  size_t* dll_begin;
+      /* index of the first entry for each descriptor,
+       * has (number of descriptors + 1) items and the last one is length */
+} readpe_import_entries_t;
+
+const pe_image_import_descriptor_t*  /* NULLABLE */
+readpe_context_get_import_descriptors(
+    const readpe_context_t* ctx,
+    size_t*                 len
+);
+
+const readpe_import_entries_t*
+readpe_context_get_import_entries(
+    const readpe_context_t* ctx
+);
+
+typedef struct readpe_relocation_entries_t {
+  size_t length;
+
+  uint32_t* rva;
+  uint8_t*  type;  /* PE_IMAGE_REL_BASED_* */
+
+  size_t  blocks;
+  size_t* block_begin;
+      /* index of the first entry for each block,
+       * has (blocks + 1) items and the last one is length */
+} readpe_relocation_entries_t;
+
+const readpe_relocation_entries_t*
+readpe_context_get_relocation_entries(
+    const readpe_context_t* ctx
+);
+
+#define READPE_RELOCATION_PAGE_SIZE 4096
+
+readpe_error_t
+readpe_context_build_relocation_index(
+    readpe_context_t* ctx
+);
+    /* Builds a page-indexed bitmap of relocated RVAs and the number of
+     * fixups in each page, finding the relocation table if not yet. */
+
+bool
+readpe_context_is_relocated(
+    const readpe_context_t* ctx,
+    uintmax_t               rva
+);
+    /* Returns true if a fixup begins at the rva, in constant time.
+     * Requires readpe_context_build_relocation_index to have succeeded. */
+
+const uint32_t*  /* NULLABLE */
+readpe_context_get_relocation_density(
+    const readpe_context_t* ctx,
+    size_t*                 pages
+);
+    /* Returns the number of fixups in each page of
+     * READPE_RELOCATION_PAGE_SIZE bytes, or NULL if no relocation table.
+     * Requires readpe_context_build_relocation_index to have succeeded. */
+
+uintmax_t
+readpe_context_get_image_base(
+    const readpe_context_t* ctx
+);
+
+size_t
+readpe_context_get_image_length(
+    const readpe_context_t* ctx
+);
+
+void
+readpe_context_load_image(
+    const readpe_context_t* ctx,
+    uint8_t*                dst  /* must have the image length bytes */
+);
+    /* Lays out the headers and sections as the loader does. */
+
+readpe_error_t
+readpe_context_rebase_image(
+    const readpe_context_t* ctx,
+    uint8_t*                image,  /* laid out by readpe_context_load_image */
+    uintmax_t               base
+);
+    /* Applies base relocations for the new base address, and writes it to
+     * ImageBase of the optional header in the image as the loader does.
+     * Needs the relocation table to be found. The image is kept untouched
+     * on error. */
+
+typedef struct readpe_hash_t {
+  uint8_t md5[16];
+  uint8_t sha1[20];
+  uint8_t sha256[32];
+} readpe_hash_t;
+
+readpe_error_t
+readpe_context_compute_hashes(
+    readpe_context_t* ctx
+);
+    /* Hashes the whole file and the raw data of each section in a single
+     * pass over the file. Does nothing if already computed. */
+
+const readpe_hash_t*
+readpe_context_get_file_hash(
+    const readpe_context_t* ctx
+);
+    /* Requires readpe_context_compute_hashes to have succeeded. */
+
+const readpe_hash_t*
+readpe_context_get_section_hashes(
+    const readpe_context_t* ctx
+);
+    /* Returns an array indexed like the section table.
+     * Requires readpe_context_compute_hashes to have succeeded. */
+
+readpe_error_t
+readpe_context_compute_authenticode(
+    readpe_context_t* ctx
+);
+    /* Computes the Authenticode digest and the PE checksum in a single pass
+     * over the file. Does nothing if already computed. */
+
+const readpe_hash_t*
+readpe_context_get_authenticode_hash(
+    const readpe_context_t* ctx
+);
+    /* Returns SHA-1 and SHA-256 digests of the file excluding the checksum,
+     * the certificate table and its data directory entry. MD5 is zero.
+     * Requires readpe_context_compute_authenticode to have succeeded. */
+
+bool
+readpe_context_is_signed(
+    const readpe_context_t* ctx
+);
+    /* Returns true if the file has a certificate table.
+     * Requires readpe_context_compute_authenticode to have succeeded. */
+
+uint32_t
+readpe_context_get_checksum(
+    const readpe_context_t* ctx
+);
+    /* Returns the checksum computed as the loader does, which should equal
+     * the one in the optional header if it is not zero.
+     * Requires readpe_context_compute_authenticode to have succeeded. */
+
+typedef struct readpe_fingerprints_t {
+  /* MD5 of "dll.function" of each import in lower case, joined by commas,
+   * compatible with the imphash of pefile */
+  bool    imphash_found;
+  uint8_t imphash[16];
+
+  /* SHA-256 of export names sorted in byte order, joined by commas */
+  bool    exphash_found;
+  uint8_t exphash[32];
+
+  /* MD5 of the decoded Rich header from "DanS" up to "Rich" */
+  bool    rich_hash_found;
+  uint8_t rich_hash[16];
+} readpe_fingerprints_t;
+
+readpe_error_t
+readpe_context_compute_fingerprints(
+    readpe_context_t* ctx
+);
+    /* Finds the import and export tables if not yet, and computes
+     * fingerprints from them. Does nothing if already computed. */
+
+const readpe_fingerprints_t*
+readpe_context_get_fingerprints(
+    const readpe_context_t* ctx
+);
+    /* Requires readpe_context_compute_fingerprints to have succeeded. */
+
+typedef struct readpe_section_stats_t {
+  uint64_t histogram[256];  /* counts of each byte value */
+  uint64_t length;          /* bytes of the raw data */
+
+  double entropy;     /* Shannon entropy in bits per byte, from 0 to 8 */
+  double zero_ratio;
+  double chi_square;  /* against the uniform distribution */
+} readpe_section_stats_t;
+
+readpe_error_t
+readpe_context_compute_section_stats(
+    readpe_context_t* ctx,
+    size_t            threads  /* 0 means the number of processors */
+);
+    /* Counts bytes in the raw data of each section, splitting large ones
+     * into slices counted by threads. Does nothing if already computed. */
+
+const readpe_section_stats_t*
+readpe_context_get_section_stats(
+    const readpe_context_t* ctx
+);
+    /* Returns an array indexed like the section table.
+     * Requires readpe_context_compute_section_stats to have succeeded. */
+
+typedef enum readpe_string_encoding_t {
+  READPE_STRING_ASCII   = 1,
+  READPE_STRING_UTF16LE = 2,
+} readpe_string_encoding_t;
+
+typedef enum readpe_string_tag_t {
+  READPE_STRING_UNTAGGED    = 0,
+  READPE_STRING_IMPORT_NAME = 1,
+  READPE_STRING_EXPORT_NAME = 2,
+  READPE_STRING_DLL_NAME    = 3,  /* of an import descriptor or the exports */
+} readpe_string_tag_t;
+
+typedef struct readpe_string_t {
+  size_t   section;  /* index of the section table */
+  uint32_t rva;
+
+  readpe_string_encoding_t encoding;
+  readpe_string_tag_t      tag;
+
+  const uint8_t* data;    /* in the file, 2 bytes per character if UTF-16LE */
+  size_t         length;  /* in characters */
+} readpe_string_t;
+
+typedef struct readpe_strings_options_t {
+  size_t min_length;  /* in characters, 0 means 4 */
+  bool   skip_names;  /* drops strings tagged as names */
+  size_t threads;     /* 0 means the number of processors */
+} readpe_strings_options_t;
+
+typedef void (*readpe_string_callback_t)(
+    void*                  udata,
+    const readpe_string_t* str
+);
+
+readpe_error_t
+readpe_context_extract_strings(
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts,
+    readpe_string_callback_t        callback,
+    void*                           udata
+);
+    /* Finds runs of printable ASCII characters (and tabs) in the raw data of
+     * each section, as single bytes and as UTF-16LE units at any alignment.
+     * Strings are passed to the callback on the caller thread in order of
+     * sections and offsets, while following slices are scanned by threads.
+     * Strings starting at names of the import and export tables are tagged,
+     * finding the tables if not yet. A broken table just tags nothing. */
+
+const uint8_t*  /* NULLABLE */
+readpe_context_resolve_rva(
+    const readpe_context_t* ctx,
+    uintmax_t               rva,
+    size_t*                 len
+        /* receives a number of bytes readable from the returned pointer */
+);
+
+const char*  /* NULLABLE */
+readpe_context_resolve_string(
+    const readpe_context_t* ctx,
+    uintmax_t               rva,
+    size_t*                 len  /* NULLABLE, receives a length of the string */
+);
+
+
+/* ---- byte signatures ----
+ * A signature file has a signature in each line, as "<name>: <pattern>".
+ * The pattern is hex bytes where '?' is a wildcard of a nibble, such as
+ * "55 8B EC 6A ?? 68". Empty lines and lines beginning with '#' are
+ * skipped. A set of signatures is immutable once created, so it can be
+ * shared by threads scanning different contexts. */
+typedef struct readpe_signatures_t readpe_signatures_t;
+
+readpe_error_t
+readpe_signatures_create(
+    readpe_signatures_t** sigs,
+    const char*           text,
+    size_t                len,
+    size_t*               line  /* NULLABLE, receives the line of an error */
+);
+    /* Compiles the signatures into an Aho-Corasick automaton over the
+     * longest run of bytes without wildcards in each pattern. */
+
+readpe_error_t
+readpe_signatures_load(
+    readpe_signatures_t** sigs,
+    const char*           path,
+    size_t*               line  /* NULLABLE, receives the line of an error */
+);
+
+void
+readpe_signatures_destroy(
+    readpe_signatures_t* sigs  /* NULLABLE */
+);
+
+size_t
+readpe_signatures_get_length(
+    const readpe_signatures_t* sigs
+);
+
+const char*
+readpe_signatures_get_name(
+    const readpe_signatures_t* sigs,
+    size_t                     index,
+    size_t*                    len  /* NULLABLE */
+);
+
+typedef enum readpe_signature_layout_t {
+  READPE_SIGNATURE_RAW,    /* the whole file as is */
+  READPE_SIGNATURE_IMAGE,  /* the image laid out on RVA space */
+} readpe_signature_layout_t;
+
+typedef struct readpe_signature_match_t {
+  size_t signature;  /* index in the set */
+
+  size_t section;  /* index of the section table */
+# define READPE_SIGNATURE_NO_SECTION SIZE_MAX
+
+  uintmax_t rva;     /* UINTMAX_MAX if not mapped, such as in the overlay */
+  uintmax_t offset;  /* in the file, UINTMAX_MAX if zero-filled */
+} readpe_signature_match_t;
+
+typedef void (*readpe_signature_callback_t)(
+    void*                           udata,
+    const readpe_signature_match_t* match
+);
+
+readpe_error_t
+readpe_context_scan_signatures(
+    const readpe_context_t*     ctx,
+    const readpe_signatures_t*  sigs,
+    readpe_signature_layout_t   layout,
+    readpe_signature_callback_t callback,
+    void*                       udata
+);
+    /* Passes matches to the callback in order of the ends of their
+     * anchors. The image is scanned through the extents without loading
+     * it, taking bytes out of the file data as zeros. */
+
+
+/* ---- binary records ----
+ * A stream of records, one per file, written by `readpe --format=record`.
+ * A record is a header and the path, followed by tables, and closed by a
+ * table of READPE_RECORD_TABLE_END. Every table is a header, the column
+ * headers, the column names and then the data of each column. Values are
+ * little-endian, and every part is padded with zeros to 8 bytes.
+ *
+ * Fixed-width columns are arrays of rows values. A string column is an
+ * array of (rows + 1) uint32_t offsets followed by the bytes, where the
+ * i-th string is between offsets[i] and offsets[i+1]. */
+
+#define READPE_RECORD_MAGIC   "RPEr"
+#define READPE_RECORD_VERSION 1
+
+typedef enum readpe_record_table_kind_t {
+  READPE_RECORD_TABLE_END                = 0,
+  READPE_RECORD_TABLE_SECTIONS           = 1,
+  READPE_RECORD_TABLE_EXPORTS            = 2,
+  READPE_RECORD_TABLE_IMPORT_DESCRIPTORS = 3,
+  READPE_RECORD_TABLE_IMPORTS            = 4,
+  READPE_RECORD_TABLE_RELOCATIONS        = 5,
+  READPE_RECORD_TABLE_RELOCATION_DENSITY = 6,
+  READPE_RECORD_TABLE_HASHES             = 7,
+  READPE_RECORD_TABLE_AUTHENTICODE       = 8,
+  READPE_RECORD_TABLE_FINGERPRINTS       = 9,
+  READPE_RECORD_TABLE_SECTION_STATS      = 10,
+  READPE_RECORD_TABLE_SECTION_HISTOGRAMS = 11,
+  READPE_RECORD_TABLE_STRINGS            = 12,
+      /* values are as in the file, so UTF-16LE ones take 2 bytes a char */
+  READPE_RECORD_TABLE_SIGNATURES         = 13,
+  READPE_RECORD_TABLE_BINDINGS           = 14,
+      /* rows are in the same order as READPE_RECORD_TABLE_IMPORTS */
+  READPE_RECORD_TABLE_LOAD_ORDER         = 15,
+} readpe_record_table_kind_t;
+
+typedef enum readpe_record_type_t {
+  READPE_RECORD_TYPE_U8     = 1,
+  READPE_RECORD_TYPE_U16    = 2,
+  READPE_RECORD_TYPE_U32    = 3,
+  READPE_RECORD_TYPE_U64    = 4,
+  READPE_RECORD_TYPE_STRING = 5,
+  READPE_RECORD_TYPE_F64    = 6,  /* IEEE 754 binary64 */
+} readpe_record_type_t;
+
+typedef struct readpe_record_header_t {
+# define READPE_RECORD_HEADER_SIZE 16
+
+  char     magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t path_length;  /* the path follows */
+  uint32_t reserved2;
+} readpe_record_header_t;
+
+typedef struct readpe_record_table_header_t {
+# define READPE_RECORD_TABLE_HEADER_SIZE 24
+
+  uint16_t kind;     /* readpe_record_table_kind_t */
+  uint16_t columns;
+  uint32_t status;   /* readpe_error_t of the file, only in the end table */
+  uint64_t rows;
+  uint64_t length;   /* of the whole table including this header */
+} readpe_record_table_header_t;
+
+typedef struct readpe_record_column_header_t {
+# define READPE_RECORD_COLUMN_HEADER_SIZE 16
+
+  uint8_t  type;  /* readpe_record_type_t */
+  uint8_t  reserved;
+  uint16_t name_length;
+  uint32_t reserved2;
+  uint64_t length;  /* of the data without the padding */
+} readpe_record_column_header_t;
+
+typedef struct readpe_record_t {
+  const char* path;  /* not terminated */
+  size_t      path_length;
+
+  readpe_error_t status;
+
+  const uint8_t* tables;  /* except the end table */
+  size_t         tables_length;
+} readpe_record_t;
+
+typedef struct readpe_record_table_t {
+  readpe_record_table_kind_t kind;
+  size_t rows;
+  size_t columns;
+
+  const readpe_record_table_header_t* header;
+} readpe_record_table_t;
+
+typedef struct readpe_record_column_t {
+  const char*          name;  /* not terminated */
+  size_t               name_length;
+  readpe_record_type_t type;
+  size_t               rows;
+
+  const void* data;  /* values, or offsets of strings */
+  const char* bytes;  /* NULLABLE, bytes of strings */
+} readpe_record_column_t;
+
+readpe_error_t
+readpe_record_read(
+    const uint8_t*   buf,  /* must be aligned to 8 bytes */
+    size_t           len,
+    size_t*          offset,
+    readpe_record_t* rec
+);
+    /* Validates the whole record at *offset and moves *offset to the next
+     * record. The accessors below trust a record read by this. */
+
+bool
+readpe_record_next_table(
+    const readpe_record_t* rec,
+    size_t*                offset,  /* starts from 0 */
+    readpe_record_table_t* table
+);
+
+bool
+readpe_record_get_column(
+    const readpe_record_table_t* table,
+    size_t                       index,
+    readpe_record_column_t*      column
+);
+
+bool
+readpe_record_find_column(
+    const readpe_record_table_t* table,
+    const char*                  name,
+    readpe_record_column_t*      column
+);
+
+uint64_t
+readpe_record_get_value(
+    const readpe_record_column_t* column,
+    size_t                        row
+);
+    /* Returns a value of fixed-width integer column widened to 64 bits. */
+
+double
+readpe_record_get_double(
+    const readpe_record_column_t* column,
+    size_t                        row
+);
+
+const char*
+readpe_record_get_string(
+    const readpe_record_column_t* column,
+    size_t                        row,
+    size_t*                       len
+);
+
+
+/* ---- symbol index ----
+ * An immutable file of the imported and exported symbols of many files,
+ * built once and queried through a mapping without the original files.
+ *
+ * The file is a header followed by the file table, the symbol dictionary
+ * sorted by kind and then name in byte order, the posting lists and the
+ * string pool. Each symbol refers to its names in the pool and to a run of
+ * the postings, which are uint32_t indices of the file table in ascending
+ * order. Values are little-endian, and every part is padded with zeros to 8
+ * bytes.
+ *
+ * Keys of imports are "<dll>!<function>" or "<dll>!#<ordinal>", where the
+ * DLL name is in lower case. Keys of exports are the exported names. */
+
+#define READPE_INDEX_MAGIC   "RPEx"
+#define READPE_INDEX_VERSION 1
+
+typedef enum readpe_index_kind_t {
+  READPE_INDEX_IMPORT = 1,
+  READPE_INDEX_EXPORT = 2,
+} readpe_index_kind_t;
+
+typedef struct readpe_index_header_t {
+# define READPE_INDEX_HEADER_SIZE 40
+
+  char     magic[4];
+  uint16_t version;
+  uint16_t reserved;
+  uint64_t files;
+  uint64_t symbols;
+  uint64_t postings;
+  uint64_t strings_length;
+} readpe_index_header_t;
+
+typedef struct readpe_index_file_entry_t {
+# define READPE_INDEX_FILE_ENTRY_SIZE 16
+
+  uint64_t path;  /* offset in the string pool */
+  uint32_t path_length;
+  uint32_t reserved;
+} readpe_index_file_entry_t;
+
+typedef struct readpe_index_symbol_entry_t {
+# define READPE_INDEX_SYMBOL_ENTRY_SIZE 32
+
+  uint64_t name;  /* offset in the string pool */
+  uint32_t name_length;
+  uint16_t kind;  /* readpe_index_kind_t */
+  uint16_t reserved;
+  uint64_t postings;  /* index of the first posting */
+  uint64_t count;
+} readpe_index_symbol_entry_t;
+
+typedef struct readpe_index_builder_t readpe_index_builder_t;
+
+readpe_error_t
+readpe_index_builder_create(
+    readpe_index_builder_t** builder
+);
+
+void
+readpe_index_builder_destroy(
+    readpe_index_builder_t* builder  /* NULLABLE */
+);
+
+readpe_error_t
+readpe_index_builder_add(
+    readpe_index_builder_t* builder,
+    const char*             path,
+    readpe_context_t*       ctx
+);
+    /* Finds the import and export tables of the context and adds its
+     * symbols as the file of the path. May be called from many threads at
+     * once. */
+
+readpe_error_t
+readpe_index_builder_write(
+    const readpe_index_builder_t* builder,
+    const char*                   path
+);
+    /* Files are ordered by their paths, so the index doesn't depend on
+     * the order of addition. */
+
+typedef struct readpe_index_t readpe_index_t;
+
+typedef struct readpe_index_symbol_t {
+  readpe_index_kind_t kind;
+
+  const char* name;  /* not terminated */
+  size_t      name_length;
+
+  const uint32_t* files;  /* indices of the file table */
+  size_t          files_length;
+} readpe_index_symbol_t;
+
+readpe_error_t
+readpe_index_open(
+    readpe_index_t** idx,
+    const char*      path
+);
+    /* Maps the file and validates the layout. Entries are validated as
+     * accessed, so opening takes constant time. */
+
+void
+readpe_index_close(
+    readpe_index_t* idx  /* NULLABLE */
+);
+
+size_t
+readpe_index_get_files_length(
+    const readpe_index_t* idx
+);
+
+const char*  /* NULLABLE */
+readpe_index_get_path(
+    const readpe_index_t* idx,
+    size_t                index,
+    size_t*               len
+);
+    /* Returns NULL if the index is out of range or the entry is broken. */
+
+bool
+readpe_index_get_symbol(
+    const readpe_index_t*  idx,
+    size_t                 index,
+    readpe_index_symbol_t* sym
+);
+    /* Returns false if the entry is broken. */
+
+readpe_error_t
+readpe_index_find(
+    const readpe_index_t* idx,
+    readpe_index_kind_t   kind,
+    const char*           key,
+    size_t                len,
+    bool                  prefix,
+    size_t*               begin,
+    size_t*               end
+);
+    /* Finds the symbols of the key, or those beginning with the key if
+     * prefix, as the range [begin, end). The DLL name of an import key is
+     * matched in any case, and ".dll" is assumed if it has no extension. */
+
+
+/* ---- module resolver ----
+ * A set of modules binding the imports of each one to the exports of
+ * another, as the loader would do within the set. Modules are named by the
+ * file names of their paths in lower case. Contexts are taken into the set
+ * from many threads, and the set is linked once, after which it's
+ * immutable and may be read from any threads. */
+typedef struct readpe_modules_t readpe_modules_t;
+
+#define READPE_MODULES_NOT_FOUND SIZE_MAX
+
+/* forwarders deeper than this are taken as broken */
+#define READPE_MODULES_FORWARD_LIMIT 16
+
+typedef enum readpe_binding_status_t {
+  READPE_BINDING_RESOLVED,
+  READPE_BINDING_MISSING_MODULE,  /* no module of the name in the set */
+  READPE_BINDING_MISSING_EXPORT,
+  READPE_BINDING_BROKEN_FORWARDER,  /* malformed, looping or too deep */
+} readpe_binding_status_t;
+
+const char*
+readpe_binding_status_stringify(
+    readpe_binding_status_t status
+);
+
+typedef struct readpe_binding_t {
+  readpe_binding_status_t status;
+
+  /* the module providing the export at the end of forwarders, or the last
+   * module reached by them, READPE_MODULES_NOT_FOUND if none */
+  size_t module;
+
+  readpe_export_t exp;       /* valid if resolved */
+  size_t          forwards;  /* number of forwarders followed */
+} readpe_binding_t;
+
+readpe_error_t
+readpe_modules_create(
+    readpe_modules_t** mods
+);
+
+void
+readpe_modules_destroy(
+    readpe_modules_t* mods  /* NULLABLE */
+);
+
+readpe_error_t
+readpe_modules_add(
+    readpe_modules_t*  mods,
+    const char*        path,
+    readpe_context_t** ctx
+);
+    /* Finds the import and export tables of the context created by
+     * readpe_context_create and builds its export hash, then takes it into
+     * the set and sets *ctx to NULL. The context is left to the caller on
+     * errors. May be called from many threads at once. */
+
+readpe_error_t
+readpe_modules_link(
+    readpe_modules_t* mods,
+    size_t            threads  /* 0 means the number of processors */
+);
+    /* Orders modules by path, resolves imports of all modules by threads
+     * and builds the graph of dependencies. No module can be added after.
+     * Where modules share a name, one of the same bitness as the importer
+     * is preferred and then the one of the first path. */
+
+size_t
+readpe_modules_get_length(
+    const readpe_modules_t* mods
+);
+
+const char*
+readpe_modules_get_path(
+    const readpe_modules_t* mods,
+    size_t                  index
+);
+
+const readpe_context_t*
+readpe_modules_get_context(
+    const readpe_modules_t* mods,
+    size_t                  index
+);
+
+size_t
+readpe_modules_find(
+    const readpe_modules_t* mods,
+    const char*             name,  /* not terminated */
+    size_t                  len,
+    bool                    _64bit  /* preferred bitness */
+);
+    /* Finds a module by name in any case, assuming ".dll" if the name has
+     * no extension. Returns READPE_MODULES_NOT_FOUND if missing. */
+
+/* The following functions require readpe_modules_link to have succeeded. */
+const readpe_binding_t*
+readpe_modules_get_bindings(
+    const readpe_modules_t* mods,
+    size_t                  index,
+    size_t*                 len
+);
+    /* Returns bindings of the import entries of the module, in the same
+     * order as readpe_import_entries_t. */
+
+const uint32_t*
+readpe_modules_get_dependencies(
+    const readpe_modules_t* mods,
+    size_t                  index,
+    size_t*                 len
+);
+    /* Returns indices of the modules which the module imports from
+     * directly or through forwarders, in ascending order. */
+
+readpe_error_t
+readpe_modules_get_load_order(
+    const readpe_modules_t* mods,
+    size_t                  index,
+    uint32_t*               order,  /* room for every module of the set */
+    size_t*                 len
+);
+    /* Fills the transitive closure of dependencies of the module, ending
+     * with the module itself, in an order the loader may initialize them:
+     * every module follows its dependencies, except those in a cycle,
+     * which are ordered by their paths with the module itself last. */
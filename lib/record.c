@@ -0,0 +1,250 @@
+#include "./readpe.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline size_t readpe_record_align_(size_t n) {
+  return (n + 7) & ~(size_t) 7;
+}
+
+static size_t readpe_record_type_size_(uint8_t type) {
+  switch (type) {
+  case READPE_RECORD_TYPE_U8:  return 1;
+  case READPE_RECORD_TYPE_U16: return 2;
+  case READPE_RECORD_TYPE_U32: return 4;
+  case READPE_RECORD_TYPE_U64: return 8;
+  case READPE_RECORD_TYPE_F64: return 8;
+  default:                     return 0;
+  }
+}
+
+static bool readpe_record_validate_column_(
+    const readpe_record_column_header_t* col,
+    const uint8_t*                       data,
+    uint64_t                             rows) {
+  if (col->type == READPE_RECORD_TYPE_STRING) {
+    if (rows >= SIZE_MAX/4) return false;
+    const size_t head = (rows+1)*4;
+    if (col->length < head) return false;
+
+    const uint32_t* offsets = (const uint32_t*) data;
+    if (offsets[0] != 0 || offsets[rows] != col->length - head) return false;
+    for (size_t i = 0; i < rows; ++i) {
+      if (offsets[i] > offsets[i+1]) return false;
+    }
+    return true;
+  }
+
+  const size_t size = readpe_record_type_size_(col->type);
+  return size > 0 && rows <= SIZE_MAX/size && col->length == rows*size;
+}
+
+static bool readpe_record_validate_table_(
+    const readpe_record_table_header_t* table) {
+  const uint8_t* base = (const uint8_t*) table;
+  const uint8_t* end  = base + table->length;
+
+  const readpe_record_column_header_t* cols = (typeof(cols))
+      (base + READPE_RECORD_TABLE_HEADER_SIZE);
+  if ((size_t) (end - (const uint8_t*) cols) <
+      (size_t) table->columns*READPE_RECORD_COLUMN_HEADER_SIZE) {
+    return false;
+  }
+
+  size_t names = 0;
+  for (size_t i = 0; i < table->columns; ++i) names += cols[i].name_length;
+
+  const uint8_t* itr = (const uint8_t*) (cols + table->columns);
+  if ((size_t) (end - itr) < readpe_record_align_(names)) return false;
+  itr += readpe_record_align_(names);
+
+  for (size_t i = 0; i < table->columns; ++i) {
+    if (cols[i].length > (size_t) (end - itr)) return false;
+    if (readpe_record_align_(cols[i].length) > (size_t) (end - itr)) {
+      return false;
+    }
+    if (!readpe_record_validate_column_(&cols[i], itr, table->rows)) {
+      return false;
+    }
+    itr += readpe_record_align_(cols[i].length);
+  }
+  return itr == end;
+}
+
+readpe_error_t readpe_record_read(
+    const uint8_t* buf, size_t len, size_t* offset, readpe_record_t* rec) {
+  assert(buf    != NULL || len == 0);
+  assert(offset != NULL);
+  assert(rec    != NULL);
+  assert((uintptr_t) buf % 8 == 0);
+
+  size_t off = *offset;
+  if (off % 8 != 0 || off > len ||
+      len - off < READPE_RECORD_HEADER_SIZE) {
+    return READPE_ERROR_INVALID_RECORD;
+  }
+
+  const readpe_record_header_t* header = (typeof(header)) (buf + off);
+  if (memcmp(header->magic, READPE_RECORD_MAGIC, 4) != 0 ||
+      header->version != READPE_RECORD_VERSION) {
+    return READPE_ERROR_INVALID_RECORD;
+  }
+  off += READPE_RECORD_HEADER_SIZE;
+
+  const size_t path_length = header->path_length;
+  if (len - off < readpe_record_align_(path_length)) {
+    return READPE_ERROR_INVALID_RECORD;
+  }
+  *rec = (typeof(*rec)) {
+    .path        = (const char*) (buf + off),
+    .path_length = path_length,
+  };
+  off += readpe_record_align_(path_length);
+
+  rec->tables = buf + off;
+  for (;;) {
+    if (len - off < READPE_RECORD_TABLE_HEADER_SIZE) {
+      return READPE_ERROR_INVALID_RECORD;
+    }
+    const readpe_record_table_header_t* table = (typeof(table)) (buf + off);
+    if (table->length < READPE_RECORD_TABLE_HEADER_SIZE ||
+        table->length % 8 != 0 || table->length > len - off) {
+      return READPE_ERROR_INVALID_RECORD;
+    }
+
+    if (table->kind == READPE_RECORD_TABLE_END) {
+      rec->tables_length = (size_t) (buf + off - rec->tables);
+      rec->status        = (readpe_error_t) table->status;
+      off += table->length;
+      break;
+    }
+    if (!readpe_record_validate_table_(table)) {
+      return READPE_ERROR_INVALID_RECORD;
+    }
+    off += table->length;
+  }
+
+  *offset = off;
+  return READPE_OK;
+}
+
+bool readpe_record_next_table(
+    const readpe_record_t* rec, size_t* offset, readpe_record_table_t* table) {
+  assert(rec    != NULL);
+  assert(offset != NULL);
+  assert(table  != NULL);
+
+  if (*offset >= rec->tables_length) return false;
+
+  const readpe_record_table_header_t* header =
+      (typeof(header)) (rec->tables + *offset);
+  *table = (typeof(*table)) {
+    .kind    = (readpe_record_table_kind_t) header->kind,
+    .rows    = header->rows,
+    .columns = header->columns,
+    .header  = header,
+  };
+  *offset += header->length;
+  return true;
+}
+
+bool readpe_record_get_column(
+    const readpe_record_table_t* table,
+    size_t                       index,
+    readpe_record_column_t*      column) {
+  assert(table  != NULL);
+  assert(column != NULL);
+
+  if (index >= table->columns) return false;
+
+  const readpe_record_column_header_t* cols = (typeof(cols))
+      ((const uint8_t*) table->header + READPE_RECORD_TABLE_HEADER_SIZE);
+
+  const char* name = (const char*) (cols + table->columns);
+  size_t      names = 0;
+  for (size_t i = 0; i < table->columns; ++i) {
+    if (i < index) name += cols[i].name_length;
+    names += cols[i].name_length;
+  }
+
+  const uint8_t* data =
+      (const uint8_t*) (cols + table->columns) + readpe_record_align_(names);
+  for (size_t i = 0; i < index; ++i) {
+    data += readpe_record_align_(cols[i].length);
+  }
+
+  *column = (typeof(*column)) {
+    .name        = name,
+    .name_length = cols[index].name_length,
+    .type        = (readpe_record_type_t) cols[index].type,
+    .rows        = table->rows,
+    .data        = data,
+  };
+  if (column->type == READPE_RECORD_TYPE_STRING) {
+    column->bytes = (const char*) (data + (table->rows+1)*4);
+  }
+  return true;
+}
+
+bool readpe_record_find_column(
+    const readpe_record_table_t* table,
+    const char*                  name,
+    readpe_record_column_t*      column) {
+  assert(table  != NULL);
+  assert(name   != NULL);
+  assert(column != NULL);
+
+  const size_t len = strlen(name);
+  for (size_t i = 0; readpe_record_get_column(table, i, column); ++i) {
+    if (column->name_length == len && memcmp(column->name, name, len) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t readpe_record_get_value(
+    const readpe_record_column_t* column, size_t row) {
+  assert(column != NULL);
+  assert(row < column->rows);
+
+  switch (column->type) {
+  case READPE_RECORD_TYPE_U8:
+    return ((const uint8_t*) column->data)[row];
+  case READPE_RECORD_TYPE_U16:
+    return ((const uint16_t*) column->data)[row];
+  case READPE_RECORD_TYPE_U32:
+    return ((const uint32_t*) column->data)[row];
+  case READPE_RECORD_TYPE_U64:
+    return ((const uint64_t*) column->data)[row];
+  default:
+    assert(false);
+    return 0;
+  }
+}
+
+double readpe_record_get_double(
+    const readpe_record_column_t* column, size_t row) {
+  assert(column != NULL);
+  assert(column->type == READPE_RECORD_TYPE_F64);
+  assert(row < column->rows);
+
+  double ret;
+  memcpy(&ret, (const uint8_t*) column->data + row*sizeof(ret), sizeof(ret));
+  return ret;
+}
+
+const char* readpe_record_get_string(
+    const readpe_record_column_t* column, size_t row, size_t* len) {
+  assert(column != NULL);
+  assert(len    != NULL);
+  assert(column->type == READPE_RECORD_TYPE_STRING);
+  assert(row < column->rows);
+
+  const uint32_t* offsets = column->data;
+  *len = offsets[row+1] - offsets[row];
+  return column->bytes + offsets[row];
+}
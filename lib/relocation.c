@@ -0,0 +1,329 @@
+#include "./relocation.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./image.h"
+#include "./readpe.h"
+
+/* Each entry is a 16-bit word, whose lower 12 bits are an offset from the
+ * block and higher 4 bits are the type. */
+static void readpe_relocation_decode_(
+    const uint8_t* src,
+    size_t         n,
+    uint32_t       va,
+    uint32_t*      rva,
+    uint8_t*       type) {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i mask = _mm_set1_epi16(0x0FFF);
+  const __m128i base = _mm_set1_epi32((int) va);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i+8 <= n; i += 8) {
+    const __m128i v   = _mm_loadu_si128((const __m128i*) (src + i*2));
+    const __m128i off = _mm_and_si128(v, mask);
+    const __m128i t   = _mm_srli_epi16(v, 12);
+
+    _mm_storeu_si128((__m128i*) (rva + i),
+        _mm_add_epi32(_mm_unpacklo_epi16(off, zero), base));
+    _mm_storeu_si128((__m128i*) (rva + i+4),
+        _mm_add_epi32(_mm_unpackhi_epi16(off, zero), base));
+    _mm_storel_epi64((__m128i*) (type + i), _mm_packus_epi16(t, zero));
+  }
+#endif
+
+  for (; i < n; ++i) {
+    uint16_t e;
+    memcpy(&e, src + i*2, sizeof(e));
+    rva[i]  = va + (e & 0x0FFF);
+    type[i] = e >> 12;
+  }
+}
+
+bool readpe_relocation_parse(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  if (ctx->data_directory_length <= PE_IMAGE_DIRECTORY_ENTRY_BASERELOC) {
+    return true;
+  }
+
+  const pe_image_data_directory_t* dir =
+      &ctx->data_directory[PE_IMAGE_DIRECTORY_ENTRY_BASERELOC];
+  if (dir->virtual_address == 0 || dir->size == 0) return true;
+
+  size_t len;
+  ctx->relocations = readpe_context_resolve_rva(ctx, dir->virtual_address, &len);
+  ctx->relocations_length = dir->size;
+
+  if (ctx->relocations == NULL || len < ctx->relocations_length) {
+    return false;
+  }
+
+  /* every block has its header, so these are upper bounds */
+  const size_t max_entries =
+      ctx->relocations_length/PE_BASE_RELOCATION_ENTRY_SIZE;
+  const size_t max_blocks  =
+      ctx->relocations_length/PE_BASE_RELOCATION_BLOCK_SIZE;
+
+  readpe_relocation_entries_t* e = &ctx->relocation_entries;
+  e->rva         = malloc(max_entries*sizeof(*e->rva));
+  e->type        = malloc(max_entries*sizeof(*e->type));
+  e->block_begin = malloc((max_blocks+1)*sizeof(*e->block_begin));
+  if (e->rva == NULL || e->type == NULL || e->block_begin == NULL) {
+    return false;
+  }
+
+  const uint8_t* itr = ctx->relocations;
+  const uint8_t* end = itr + ctx->relocations_length;
+  while (itr < end) {
+    if ((size_t) (end - itr) < PE_BASE_RELOCATION_BLOCK_SIZE) return false;
+
+    const pe_base_relocation_block_t* block = (typeof(block)) itr;
+    if (block->size_of_block < PE_BASE_RELOCATION_BLOCK_SIZE ||
+        block->size_of_block > (size_t) (end - itr)) {
+      return false;
+    }
+    itr += PE_BASE_RELOCATION_BLOCK_SIZE;
+
+    const size_t cnt = (block->size_of_block - PE_BASE_RELOCATION_BLOCK_SIZE) /
+        PE_BASE_RELOCATION_ENTRY_SIZE;
+    readpe_relocation_decode_(itr, cnt, block->virtual_address,
+        e->rva + e->length, e->type + e->length);
+    itr += cnt*PE_BASE_RELOCATION_ENTRY_SIZE;
+
+    e->block_begin[e->blocks++] = e->length;
+    e->length += cnt;
+  }
+  e->block_begin[e->blocks] = e->length;
+
+  for (size_t i = 0; i < e->length; ++i) {
+    if (e->type[i] == PE_IMAGE_REL_BASED_ABSOLUTE) continue;
+    if ((uintmax_t) e->rva[i] + sizeof(uint32_t) > ctx->image_length) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void readpe_relocation_deinitialize(readpe_relocation_entries_t* entries) {
+  if (entries == NULL) return;
+
+  free(entries->rva);
+  free(entries->type);
+  free(entries->block_begin);
+  *entries = (typeof(*entries)) {0};
+}
+
+const readpe_relocation_entries_t* readpe_context_get_relocation_entries(
+    const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_BASERELOC));
+
+  return &ctx->relocation_entries;
+}
+
+readpe_error_t readpe_context_build_relocation_index(readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  const readpe_error_t err = readpe_context_find_relocation_table(ctx);
+  if (err != READPE_OK) return err;
+
+  if (ctx->relocations == NULL || ctx->relocation_pages != NULL) {
+    return READPE_OK;
+  }
+
+  const readpe_relocation_entries_t* e = &ctx->relocation_entries;
+
+  const size_t pages =
+      (ctx->image_length + READPE_RELOCATION_PAGE_SIZE - 1) /
+      READPE_RELOCATION_PAGE_SIZE;
+
+  uint32_t* index   = calloc(pages, sizeof(*index));
+  uint32_t* density = calloc(pages, sizeof(*density));
+  if (index == NULL || density == NULL) goto ABORT;
+
+  for (size_t i = 0; i < e->length; ++i) {
+    if (e->type[i] == PE_IMAGE_REL_BASED_ABSOLUTE) continue;
+    ++density[e->rva[i] / READPE_RELOCATION_PAGE_SIZE];
+  }
+
+  /* only pages having fixups get their bitmaps */
+  size_t used = 0;
+  for (size_t i = 0; i < pages; ++i) {
+    if (density[i] > 0) index[i] = ++used;
+  }
+
+  uint64_t* bitmaps =
+      calloc(used*READPE_CONTEXT_RELOCATION_BITMAP_WORDS, sizeof(*bitmaps));
+  if (bitmaps == NULL && used > 0) goto ABORT;
+
+  for (size_t i = 0; i < e->length; ++i) {
+    if (e->type[i] == PE_IMAGE_REL_BASED_ABSOLUTE) continue;
+
+    const uint32_t rva    = e->rva[i];
+    const uint32_t offset = rva % READPE_RELOCATION_PAGE_SIZE;
+    uint64_t* bitmap = bitmaps +
+        (index[rva / READPE_RELOCATION_PAGE_SIZE] - 1) *
+        READPE_CONTEXT_RELOCATION_BITMAP_WORDS;
+    bitmap[offset/64] |= UINT64_C(1) << (offset%64);
+  }
+
+  ctx->relocation_pages        = index;
+  ctx->relocation_pages_length = pages;
+  ctx->relocation_bitmaps      = bitmaps;
+  ctx->relocation_density      = density;
+  return READPE_OK;
+
+ABORT:
+  free(index);
+  free(density);
+  return READPE_ERROR_NO_MEMORY;
+}
+
+bool readpe_context_is_relocated(const readpe_context_t* ctx, uintmax_t rva) {
+  assert(ctx != NULL);
+  assert(ctx->relocations == NULL || ctx->relocation_pages != NULL);
+
+  const uintmax_t page = rva / READPE_RELOCATION_PAGE_SIZE;
+  if (ctx->relocation_pages == NULL ||
+      page >= ctx->relocation_pages_length ||
+      ctx->relocation_pages[page] == 0) {
+    return false;
+  }
+
+  const uint32_t  offset = rva % READPE_RELOCATION_PAGE_SIZE;
+  const uint64_t* bitmap = ctx->relocation_bitmaps +
+      (ctx->relocation_pages[page] - 1) * READPE_CONTEXT_RELOCATION_BITMAP_WORDS;
+  return (bitmap[offset/64] >> (offset%64)) & 1;
+}
+
+const uint32_t* readpe_context_get_relocation_density(
+    const readpe_context_t* ctx, size_t* pages) {
+  assert(ctx   != NULL);
+  assert(pages != NULL);
+  assert(ctx->relocations == NULL || ctx->relocation_pages != NULL);
+
+  *pages = ctx->relocation_pages_length;
+  return ctx->relocation_density;
+}
+
+uintmax_t readpe_context_get_image_base(const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  return ctx->image_base;
+}
+
+size_t readpe_context_get_image_length(const readpe_context_t* ctx) {
+  assert(ctx != NULL);
+
+  return ctx->image_length;
+}
+
+void readpe_context_load_image(const readpe_context_t* ctx, uint8_t* dst) {
+  assert(ctx != NULL);
+
+  readpe_image_load(&ctx->image, dst);
+}
+
+readpe_error_t readpe_context_rebase_image(
+    const readpe_context_t* ctx, uint8_t* image, uintmax_t base) {
+  assert(ctx   != NULL);
+  assert(image != NULL);
+  assert(ctx->directories_found & (1u << PE_IMAGE_DIRECTORY_ENTRY_BASERELOC));
+
+  const readpe_relocation_entries_t* e = &ctx->relocation_entries;
+
+  /* everything is checked first not to leave a half-patched image */
+  for (size_t i = 0; i < e->length; ++i) {
+    switch (e->type[i]) {
+    case PE_IMAGE_REL_BASED_ABSOLUTE:
+    case PE_IMAGE_REL_BASED_HIGH:
+    case PE_IMAGE_REL_BASED_LOW:
+    case PE_IMAGE_REL_BASED_HIGHLOW:
+      break;
+    case PE_IMAGE_REL_BASED_DIR64:
+      if ((uintmax_t) e->rva[i] + sizeof(uint64_t) > ctx->image_length) {
+        return READPE_ERROR_INVALID_RELOCATION_TABLE;
+      }
+      break;
+    default:
+      return READPE_ERROR_UNSUPPORTED_RELOCATION;
+    }
+  }
+
+  const uint64_t delta = (uint64_t) base - (uint64_t) ctx->image_base;
+  if (delta == 0) return READPE_OK;
+
+  /* ABSOLUTE entries are padding, whose RVAs are not checked */
+  const uint32_t* rva  = e->rva;
+  const uint8_t*  type = e->type;
+  for (size_t i = 0; i < e->length; ++i) {
+    switch (type[i]) {
+    case PE_IMAGE_REL_BASED_HIGH:
+      {
+        uint16_t v;
+        memcpy(&v, image + rva[i], sizeof(v));
+        v += (uint16_t) (delta >> 16);
+        memcpy(image + rva[i], &v, sizeof(v));
+      }
+      break;
+    case PE_IMAGE_REL_BASED_LOW:
+      {
+        uint16_t v;
+        memcpy(&v, image + rva[i], sizeof(v));
+        v += (uint16_t) delta;
+        memcpy(image + rva[i], &v, sizeof(v));
+      }
+      break;
+    case PE_IMAGE_REL_BASED_HIGHLOW:
+      {
+        uint32_t v;
+        memcpy(&v, image + rva[i], sizeof(v));
+        v += (uint32_t) delta;
+        memcpy(image + rva[i], &v, sizeof(v));
+      }
+      break;
+    case PE_IMAGE_REL_BASED_DIR64:
+      {
+        uint64_t v;
+        memcpy(&v, image + rva[i], sizeof(v));
+        v += delta;
+        memcpy(image + rva[i], &v, sizeof(v));
+      }
+      break;
+    }
+  }
+
+  /* The loader also writes the new base into the optional header, which
+   * is patched where the header is laid out at its own RVA. */
+  const void* field = ctx->_64bit?
+      (const void*) &ctx->nt_header->optional._64bit.image_base:
+      (const void*) &ctx->nt_header->optional._32bit.image_base;
+  const size_t field_size = ctx->_64bit? sizeof(uint64_t): sizeof(uint32_t);
+  const size_t offset     = (const uint8_t*) field - ctx->file;
+
+  size_t         len;
+  const uint8_t* laid = readpe_context_resolve_rva(ctx, offset, &len);
+  if (laid == ctx->file + offset && len >= field_size) {
+    if (ctx->_64bit) {
+      const uint64_t v = base;
+      memcpy(image + offset, &v, sizeof(v));
+    } else {
+      const uint32_t v = (uint32_t) base;
+      memcpy(image + offset, &v, sizeof(v));
+    }
+  }
+  return READPE_OK;
+}
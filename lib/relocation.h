@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "./context.h"
+#include "./readpe.h"
+
+bool
+readpe_relocation_parse(
+    readpe_context_t* ctx
+);
+    /* Validates the base relocation directory and decodes its entries. */
+
+void
+readpe_relocation_deinitialize(
+    readpe_relocation_entries_t* entries
+);
@@ -0,0 +1,602 @@
+#include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./parallel.h"
+#include "./readpe.h"
+
+/* file names longer than this never name a module */
+#define READPE_MODULES_NAME_MAX 255
+
+typedef struct readpe_modules_module_t {
+  char*             path;
+  char*             name;  /* the file name in lower case */
+  size_t            name_length;
+  readpe_context_t* ctx;
+
+  uint32_t* deps;
+  size_t    deps_length;
+  bool      broken;  /* failed to allocate deps */
+} readpe_modules_module_t;
+
+struct readpe_modules_t {
+  pthread_mutex_t mtx;
+  bool            linked;
+
+  readpe_modules_module_t* modules;
+  size_t                   length;
+  size_t                   reserved;
+
+  uint32_t* by_name;  /* indices of modules ordered by name and path */
+
+  readpe_binding_t* bindings;
+  size_t*           bindings_begin;  /* has (length + 1) items */
+
+  uint32_t* order;  /* every module, each following its dependencies */
+};
+
+static int readpe_modules_compare_paths_(const void* a, const void* b) {
+  const readpe_modules_module_t* x = a;
+  const readpe_modules_module_t* y = b;
+  return strcmp(x->path, y->path);
+}
+
+static int readpe_modules_compare_names_(
+    const char* a, size_t alen, const char* b, size_t blen) {
+  const int c = memcmp(a, b, alen < blen? alen: blen);
+  if (c != 0) return c;
+  return (alen > blen) - (alen < blen);
+}
+
+/* qsort has no context, so the items carry what they are compared by */
+typedef struct readpe_modules_name_t {
+  const char* name;
+  size_t      length;
+  uint32_t    index;
+} readpe_modules_name_t;
+
+static int readpe_modules_compare_by_name_(const void* a, const void* b) {
+  const readpe_modules_name_t* x = a;
+  const readpe_modules_name_t* y = b;
+
+  const int c = readpe_modules_compare_names_(
+      x->name, x->length, y->name, y->length);
+  if (c != 0) return c;
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+static int readpe_modules_compare_indices_(const void* a, const void* b) {
+  const uint32_t x = *(const uint32_t*) a;
+  const uint32_t y = *(const uint32_t*) b;
+  return (x > y) - (x < y);
+}
+
+const char* readpe_binding_status_stringify(readpe_binding_status_t status) {
+  switch (status) {
+  case READPE_BINDING_RESOLVED:
+    return "resolved";
+  case READPE_BINDING_MISSING_MODULE:
+    return "missing module";
+  case READPE_BINDING_MISSING_EXPORT:
+    return "missing export";
+  case READPE_BINDING_BROKEN_FORWARDER:
+    return "broken forwarder";
+  default:
+    return "unknown status";
+  }
+}
+
+readpe_error_t readpe_modules_create(readpe_modules_t** mods) {
+  assert(mods != NULL);
+
+  readpe_modules_t* m = calloc(1, sizeof(*m));
+  if (m == NULL) return READPE_ERROR_NO_MEMORY;
+
+  pthread_mutex_init(&m->mtx, NULL);
+  *mods = m;
+  return READPE_OK;
+}
+
+void readpe_modules_destroy(readpe_modules_t* mods) {
+  if (mods == NULL) return;
+
+  for (size_t i = 0; i < mods->length; ++i) {
+    readpe_modules_module_t* m = &mods->modules[i];
+    readpe_context_destroy(m->ctx);
+    free(m->path);
+    free(m->name);
+    free(m->deps);
+  }
+  pthread_mutex_destroy(&mods->mtx);
+  free(mods->modules);
+  free(mods->by_name);
+  free(mods->bindings);
+  free(mods->bindings_begin);
+  free(mods->order);
+  free(mods);
+}
+
+readpe_error_t readpe_modules_add(
+    readpe_modules_t* mods, const char* path, readpe_context_t** ctx) {
+  assert(mods != NULL);
+  assert(path != NULL);
+  assert(ctx  != NULL && *ctx != NULL);
+  assert(!mods->linked);
+
+  readpe_error_t err = readpe_context_find_import_table(*ctx);
+  if (err != READPE_OK) return err;
+
+  /* lookups from other modules are made by threads */
+  err = readpe_context_build_export_hash(*ctx);
+  if (err != READPE_OK) return err;
+
+  const char* base = strrchr(path, '/');
+  base = base != NULL? base+1: path;
+
+  readpe_modules_module_t m = {
+    .path        = strdup(path),
+    .name        = strdup(base),
+    .name_length = strlen(base),
+    .ctx         = *ctx,
+  };
+  if (m.path == NULL || m.name == NULL) goto ABORT;
+
+  for (size_t i = 0; i < m.name_length; ++i) {
+    m.name[i] = (char) tolower((unsigned char) m.name[i]);
+  }
+
+  pthread_mutex_lock(&mods->mtx);
+  bool ok = mods->length < UINT32_MAX;
+  if (ok && mods->length >= mods->reserved) {
+    const size_t n = mods->reserved*2 + 64;
+
+    readpe_modules_module_t* modules =
+        realloc(mods->modules, n*sizeof(*modules));
+    ok = modules != NULL;
+    if (ok) {
+      mods->modules  = modules;
+      mods->reserved = n;
+    }
+  }
+  if (ok) mods->modules[mods->length++] = m;
+  pthread_mutex_unlock(&mods->mtx);
+
+  if (!ok) goto ABORT;
+
+  *ctx = NULL;
+  return READPE_OK;
+
+ABORT:
+  free(m.path);
+  free(m.name);
+  return READPE_ERROR_NO_MEMORY;
+}
+
+size_t readpe_modules_get_length(const readpe_modules_t* mods) {
+  assert(mods != NULL);
+  return mods->length;
+}
+
+const char* readpe_modules_get_path(
+    const readpe_modules_t* mods, size_t index) {
+  assert(mods != NULL);
+  assert(index < mods->length);
+  return mods->modules[index].path;
+}
+
+const readpe_context_t* readpe_modules_get_context(
+    const readpe_modules_t* mods, size_t index) {
+  assert(mods != NULL);
+  assert(index < mods->length);
+  return mods->modules[index].ctx;
+}
+
+size_t readpe_modules_find(
+    const readpe_modules_t* mods, const char* name, size_t len, bool _64bit) {
+  assert(mods != NULL);
+  assert(name != NULL || len == 0);
+  assert(mods->by_name != NULL || mods->length == 0);
+
+  if (len > READPE_MODULES_NAME_MAX) return READPE_MODULES_NOT_FOUND;
+
+  char key[READPE_MODULES_NAME_MAX + 4];
+  for (size_t i = 0; i < len; ++i) {
+    key[i] = (char) tolower((unsigned char) name[i]);
+  }
+  if (memchr(key, '.', len) == NULL) {
+    memcpy(key + len, ".dll", 4);
+    len += 4;
+  }
+
+  size_t l = 0, r = mods->length;
+  while (l < r) {
+    const size_t                   m = l + (r-l)/2;
+    const readpe_modules_module_t* x = &mods->modules[mods->by_name[m]];
+    if (readpe_modules_compare_names_(
+          x->name, x->name_length, key, len) < 0) {
+      l = m+1;
+    } else {
+      r = m;
+    }
+  }
+
+  size_t found = READPE_MODULES_NOT_FOUND;
+  for (size_t i = l; i < mods->length; ++i) {
+    const uint32_t                 j = mods->by_name[i];
+    const readpe_modules_module_t* x = &mods->modules[j];
+    if (x->name_length != len || memcmp(x->name, key, len) != 0) break;
+
+    if (x->ctx->_64bit == _64bit) return j;
+    if (found == READPE_MODULES_NOT_FOUND) found = j;
+  }
+  return found;
+}
+
+/* modules reached from a module, deduplicated when all are found */
+typedef struct readpe_modules_deps_t {
+  uint32_t* items;
+  size_t    length;
+  size_t    reserved;
+  bool      broken;  /* failed to allocate */
+} readpe_modules_deps_t;
+
+static void readpe_modules_deps_push_(readpe_modules_deps_t* d, size_t i) {
+  if (d->length >= d->reserved) {
+    const size_t n = d->reserved*2 + 16;
+
+    uint32_t* items = realloc(d->items, n*sizeof(*items));
+    if (items == NULL) {
+      d->broken = true;
+      return;
+    }
+    d->items    = items;
+    d->reserved = n;
+  }
+  d->items[d->length++] = i;
+}
+
+static void readpe_modules_resolve_(
+    const readpe_modules_t* mods,
+    size_t                  index,
+    size_t                  entry,
+    readpe_modules_deps_t*  deps,
+    readpe_binding_t*       b) {
+  const readpe_context_t*        ctx = mods->modules[index].ctx;
+  const readpe_import_entries_t* e   = &ctx->import_entries;
+
+  *b = (readpe_binding_t) {
+    .status = READPE_BINDING_MISSING_MODULE,
+    .module = READPE_MODULES_NOT_FOUND,
+  };
+
+  size_t      dll_len;
+  const char* dll = readpe_context_resolve_string(
+      ctx, ctx->imports[e->dll[entry]].name, &dll_len);
+  if (dll == NULL) return;
+
+  bool        by_ordinal = e->by_ordinal[entry];
+  uint32_t    ordinal    = e->hint[entry];
+  const char* fn         = NULL;
+  size_t      fn_len     = 0;
+  if (!by_ordinal) {
+    fn = readpe_context_resolve_string(ctx, e->name[entry], &fn_len);
+    if (fn == NULL) {
+      b->status = READPE_BINDING_MISSING_EXPORT;
+      return;
+    }
+  }
+
+  for (;;) {
+    const size_t target = readpe_modules_find(mods, dll, dll_len, ctx->_64bit);
+    if (target == READPE_MODULES_NOT_FOUND) {
+      b->status = READPE_BINDING_MISSING_MODULE;
+      return;
+    }
+    if (target != index) readpe_modules_deps_push_(deps, target);
+    b->module = target;
+
+    const readpe_context_t* tctx = mods->modules[target].ctx;
+
+    const bool found = by_ordinal?
+        readpe_context_find_export_by_ordinal(tctx, ordinal, &b->exp):
+        readpe_context_find_export_by_string(tctx, fn, fn_len, &b->exp);
+    if (!found) {
+      b->status = READPE_BINDING_MISSING_EXPORT;
+      return;
+    }
+    if (!b->exp.forwarded) {
+      b->status = READPE_BINDING_RESOLVED;
+      return;
+    }
+
+    /* "<module>.<name>" or "<module>.#<ordinal>", where the name of the
+     * module may also have dots */
+    b->status = READPE_BINDING_BROKEN_FORWARDER;
+    if (++b->forwards > READPE_MODULES_FORWARD_LIMIT) return;
+
+    const char* fw     = b->exp.forwarder;
+    const size_t fw_len = b->exp.forwarder_length;
+    if (fw == NULL) return;
+
+    const char* dot = NULL;
+    for (size_t i = fw_len; i > 0; --i) {
+      if (fw[i-1] == '.') {
+        dot = &fw[i-1];
+        break;
+      }
+    }
+    if (dot == NULL || dot == fw || dot+1 == fw+fw_len) return;
+
+    dll     = fw;
+    dll_len = dot - fw;
+    fn      = dot+1;
+    fn_len  = fw+fw_len - fn;
+
+    by_ordinal = fn[0] == '#';
+    if (by_ordinal) {
+      if (fn_len < 2 || fn_len > 11) return;
+
+      uint64_t v = 0;
+      for (size_t i = 1; i < fn_len; ++i) {
+        if (!isdigit((unsigned char) fn[i])) return;
+        v = v*10 + (fn[i] - '0');
+      }
+      if (v > UINT32_MAX) return;
+      ordinal = v;
+    }
+  }
+}
+
+/* modules are dealt out in turn, as thousands of them even out */
+static void readpe_modules_work_(void* udata, size_t i) {
+  readpe_modules_t*        mods = udata;
+  readpe_modules_module_t* m    = &mods->modules[i];
+  const readpe_import_entries_t* e = &m->ctx->import_entries;
+
+  readpe_modules_deps_t deps = {0};
+
+  /* a module depends on its descriptors even if nothing is bound */
+  for (size_t j = 0; j < m->ctx->imports_length; ++j) {
+    size_t      len;
+    const char* dll = readpe_context_resolve_string(
+        m->ctx, m->ctx->imports[j].name, &len);
+    if (dll == NULL) continue;
+
+    const size_t t = readpe_modules_find(mods, dll, len, m->ctx->_64bit);
+    if (t != READPE_MODULES_NOT_FOUND && t != i) {
+      readpe_modules_deps_push_(&deps, t);
+    }
+  }
+
+  readpe_binding_t* bindings = mods->bindings + mods->bindings_begin[i];
+  for (size_t j = 0; j < e->length; ++j) {
+    readpe_modules_resolve_(mods, i, j, &deps, &bindings[j]);
+  }
+
+  if (deps.broken) {
+    free(deps.items);
+    m->broken = true;
+    return;
+  }
+
+  size_t n = 0;
+  if (deps.length > 0) {
+    qsort(deps.items, deps.length, sizeof(*deps.items),
+        readpe_modules_compare_indices_);
+    for (size_t j = 0; j < deps.length; ++j) {
+      if (n == 0 || deps.items[n-1] != deps.items[j]) {
+        deps.items[n++] = deps.items[j];
+      }
+    }
+  }
+  m->deps        = deps.items;
+  m->deps_length = n;
+}
+
+static readpe_error_t readpe_modules_resolve_all_(
+    readpe_modules_t* mods, size_t threads) {
+  readpe_parallel_for(mods->length, threads, readpe_modules_work_, mods);
+
+  for (size_t i = 0; i < mods->length; ++i) {
+    if (mods->modules[i].broken) return READPE_ERROR_NO_MEMORY;
+  }
+  return READPE_OK;
+}
+
+/* Orders all modules by Tarjan's algorithm, which closes a component only
+ * after every component reachable from it, so dependencies come first.
+ * Members of a component are ordered by their paths. */
+static readpe_error_t readpe_modules_order_(readpe_modules_t* mods) {
+  const size_t n = mods->length;
+
+  typedef struct frame_t {
+    uint32_t node;
+    size_t   edge;
+  } frame_t;
+
+  uint32_t* low    = calloc(n+1, sizeof(*low));
+  uint32_t* number = calloc(n+1, sizeof(*number));  /* 0 means unvisited */
+  bool*     onstk  = calloc(n+1, sizeof(*onstk));
+  uint32_t* stack  = calloc(n+1, sizeof(*stack));
+  frame_t*  frames = calloc(n+1, sizeof(*frames));
+  mods->order      = calloc(n+1, sizeof(*mods->order));
+
+  readpe_error_t err = READPE_ERROR_NO_MEMORY;
+  if (low == NULL || number == NULL || onstk == NULL || stack == NULL ||
+      frames == NULL || mods->order == NULL) {
+    goto FINALIZE;
+  }
+
+  size_t counter = 0, stack_length = 0, order_length = 0;
+  for (size_t root = 0; root < n; ++root) {
+    if (number[root] != 0) continue;
+
+    size_t depth = 0;
+    frames[depth++] = (frame_t) { .node = root, };
+    number[root] = low[root] = ++counter;
+    stack[stack_length++] = root;
+    onstk[root] = true;
+
+    while (depth > 0) {
+      frame_t*                       f = &frames[depth-1];
+      const readpe_modules_module_t* m = &mods->modules[f->node];
+
+      if (f->edge < m->deps_length) {
+        const uint32_t next = m->deps[f->edge++];
+        if (number[next] == 0) {
+          number[next] = low[next] = ++counter;
+          stack[stack_length++] = next;
+          onstk[next] = true;
+          frames[depth++] = (frame_t) { .node = next, };
+        } else if (onstk[next] && number[next] < low[f->node]) {
+          low[f->node] = number[next];
+        }
+        continue;
+      }
+
+      const uint32_t node = f->node;
+      --depth;
+      if (depth > 0) {
+        const uint32_t parent = frames[depth-1].node;
+        if (low[node] < low[parent]) low[parent] = low[node];
+      }
+      if (low[node] != number[node]) continue;
+
+      const size_t begin = order_length;
+      uint32_t     v;
+      do {
+        v = stack[--stack_length];
+        onstk[v] = false;
+        mods->order[order_length++] = v;
+      } while (v != node);
+      qsort(mods->order + begin, order_length - begin,
+          sizeof(*mods->order), readpe_modules_compare_indices_);
+    }
+  }
+  assert(order_length == n);
+  err = READPE_OK;
+
+FINALIZE:
+  free(low);
+  free(number);
+  free(onstk);
+  free(stack);
+  free(frames);
+  return err;
+}
+
+readpe_error_t readpe_modules_link(readpe_modules_t* mods, size_t threads) {
+  assert(mods != NULL);
+  assert(!mods->linked);
+
+  mods->linked = true;
+
+  const size_t n = mods->length;
+  qsort(mods->modules, n, sizeof(*mods->modules),
+      readpe_modules_compare_paths_);
+
+  mods->by_name        = calloc(n+1, sizeof(*mods->by_name));
+  mods->bindings_begin = calloc(n+1, sizeof(*mods->bindings_begin));
+  if (mods->by_name == NULL || mods->bindings_begin == NULL) {
+    return READPE_ERROR_NO_MEMORY;
+  }
+
+  readpe_modules_name_t* names = calloc(n+1, sizeof(*names));
+  if (names == NULL) return READPE_ERROR_NO_MEMORY;
+  for (size_t i = 0; i < n; ++i) {
+    names[i] = (readpe_modules_name_t) {
+      .name   = mods->modules[i].name,
+      .length = mods->modules[i].name_length,
+      .index  = i,
+    };
+  }
+  qsort(names, n, sizeof(*names), readpe_modules_compare_by_name_);
+  for (size_t i = 0; i < n; ++i) mods->by_name[i] = names[i].index;
+  free(names);
+
+  for (size_t i = 0; i < n; ++i) {
+    mods->bindings_begin[i+1] =
+        mods->bindings_begin[i] + mods->modules[i].ctx->import_entries.length;
+  }
+  mods->bindings = calloc(mods->bindings_begin[n]+1, sizeof(*mods->bindings));
+  if (mods->bindings == NULL) return READPE_ERROR_NO_MEMORY;
+
+  const readpe_error_t err = readpe_modules_resolve_all_(mods, threads);
+  if (err != READPE_OK) return err;
+
+  return readpe_modules_order_(mods);
+}
+
+const readpe_binding_t* readpe_modules_get_bindings(
+    const readpe_modules_t* mods, size_t index, size_t* len) {
+  assert(mods != NULL);
+  assert(len  != NULL);
+  assert(mods->order != NULL);
+  assert(index < mods->length);
+
+  *len = mods->bindings_begin[index+1] - mods->bindings_begin[index];
+  return mods->bindings + mods->bindings_begin[index];
+}
+
+const uint32_t* readpe_modules_get_dependencies(
+    const readpe_modules_t* mods, size_t index, size_t* len) {
+  assert(mods != NULL);
+  assert(len  != NULL);
+  assert(mods->order != NULL);
+  assert(index < mods->length);
+
+  *len = mods->modules[index].deps_length;
+  return mods->modules[index].deps;
+}
+
+readpe_error_t readpe_modules_get_load_order(
+    const readpe_modules_t* mods, size_t index, uint32_t* order, size_t* len) {
+  assert(mods  != NULL);
+  assert(order != NULL);
+  assert(len   != NULL);
+  assert(mods->order != NULL);
+  assert(index < mods->length);
+
+  const size_t n = mods->length;
+
+  bool* reached = calloc(n, sizeof(*reached));
+  if (reached == NULL) return READPE_ERROR_NO_MEMORY;
+
+  /* finds the closure by the output as a queue */
+  size_t tail = 0;
+  reached[index] = true;
+  order[tail++]  = index;
+  for (size_t head = 0; head < tail; ++head) {
+    const readpe_modules_module_t* m = &mods->modules[order[head]];
+    for (size_t i = 0; i < m->deps_length; ++i) {
+      const uint32_t d = m->deps[i];
+      if (!reached[d]) {
+        reached[d]      = true;
+        order[tail++] = d;
+      }
+    }
+  }
+
+  /* the global order is kept, and the module itself goes last even if it's
+   * in a cycle */
+  size_t k = 0;
+  for (size_t i = 0; i < n && k+1 < tail; ++i) {
+    const uint32_t v = mods->order[i];
+    if (reached[v] && v != index) order[k++] = v;
+  }
+  order[k++] = index;
+  assert(k == tail);
+
+  free(reached);
+  *len = k;
+  return READPE_OK;
+}
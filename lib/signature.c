@@ -0,0 +1,807 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define READPE_SIGNATURE_SSSE3
+# include <immintrin.h>
+#endif
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./readpe.h"
+
+/* Anchors longer than this select no better but make the automaton large. */
+#define READPE_SIGNATURE_ANCHOR_MAX 16
+
+/* Each pattern is matched by its anchor, the longest run of bytes without
+ * wildcards, which the Aho-Corasick automaton finds. The whole pattern is
+ * compared with masks at each position where the anchor is found. */
+struct readpe_signatures_t {
+  size_t length;
+
+  /* the i-th signature spans [begin[i], begin[i+1]) of each array */
+  char*    names;  /* each is terminated */
+  size_t*  name_begin;
+  uint8_t* bytes;  /* masked already */
+  uint8_t* masks;
+  size_t*  pattern_begin;
+  size_t   max_length;
+
+  size_t* anchor;  /* offset in the pattern */
+  size_t* anchor_length;
+
+  /* Node 0 is the root, whose transitions are kept in a table. So are
+   * those of its children, as input rarely falls back to the root when
+   * anchors begin with most bytes. */
+  size_t    nodes;
+  uint32_t  root[256];
+  uint16_t* shallow;     /* 1 + the byte to a child of the root, or 0 */
+  uint32_t* level1;      /* 256 transitions for each child of the root */
+  uint32_t* fail;
+  uint32_t* dict;        /* nearest node with outputs by fail links, or 0 */
+  uint32_t* edge_begin;  /* of each node, has (nodes + 1) items */
+  uint8_t*  edge_bytes;  /* sorted in each node */
+  uint32_t* edge_nodes;
+  uint32_t* out_begin;   /* of each node, has (nodes + 1) items */
+  uint32_t* outs;        /* signatures whose anchors end at the node */
+
+  /* Bytes which begin anchors and which follow them. Skipping positions
+   * out of these keeps the root state, so it's done at the root. */
+  bool first[256];
+  bool second[256];
+
+  /* the same sets as nibble tables of truffle, see the SSSE3 skip */
+  uint8_t truffle[2][2][16];
+};
+
+typedef struct readpe_signature_buffer_t {
+  uint8_t* ptr;
+  size_t   length;
+  size_t   reserved;
+} readpe_signature_buffer_t;
+
+static bool readpe_signature_buffer_push_(
+    readpe_signature_buffer_t* buf, const void* data, size_t len) {
+  if (buf->length + len > buf->reserved) {
+    size_t n = buf->reserved? buf->reserved: 256;
+    while (n < buf->length + len) n *= 2;
+
+    uint8_t* ptr = realloc(buf->ptr, n);
+    if (ptr == NULL) return false;
+    buf->ptr      = ptr;
+    buf->reserved = n;
+  }
+  memcpy(buf->ptr + buf->length, data, len);
+  buf->length += len;
+  return true;
+}
+
+static int readpe_signature_hex_(char c) {
+  if ('0' <= c && c <= '9') return c - '0';
+  if ('a' <= c && c <= 'f') return c - 'a' + 10;
+  if ('A' <= c && c <= 'F') return c - 'A' + 10;
+  if (c == '?') return 16;
+  return -1;
+}
+
+static inline bool readpe_signature_is_space_(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Parses "<name>: <pattern>" into the buffers, where the pattern is hex
+ * bytes and '?' is a wildcard of a nibble. Spaces between bytes are
+ * optional. */
+static bool readpe_signature_parse_line_(
+    const char*                line,
+    size_t                     len,
+    readpe_signature_buffer_t* names,
+    readpe_signature_buffer_t* bytes,
+    readpe_signature_buffer_t* masks) {
+  const char* colon = memchr(line, ':', len);
+  if (colon == NULL) return false;
+
+  const char* name     = line;
+  size_t      name_len = colon - line;
+  while (name_len > 0 && readpe_signature_is_space_(name[name_len-1])) {
+    --name_len;
+  }
+  if (name_len == 0) return false;
+  if (!readpe_signature_buffer_push_(names, name, name_len) ||
+      !readpe_signature_buffer_push_(names, "", 1)) {
+    return false;
+  }
+
+  bool   anchored = false;
+  size_t count    = 0;
+  for (size_t i = colon - line + 1; i < len;) {
+    if (readpe_signature_is_space_(line[i])) {
+      ++i;
+      continue;
+    }
+    if (i+1 >= len) return false;
+
+    const int hi = readpe_signature_hex_(line[i]);
+    const int lo = readpe_signature_hex_(line[i+1]);
+    if (hi < 0 || lo < 0) return false;
+    i += 2;
+
+    const uint8_t mask = (hi < 16? 0xF0: 0) | (lo < 16? 0x0F: 0);
+    const uint8_t byte = (((hi & 0xF) << 4) | (lo & 0xF)) & mask;
+    if (!readpe_signature_buffer_push_(bytes, &byte, 1) ||
+        !readpe_signature_buffer_push_(masks, &mask, 1)) {
+      return false;
+    }
+    anchored = anchored || mask == 0xFF;
+    ++count;
+  }
+  return count > 0 && anchored;
+}
+
+static bool readpe_signature_push_size_(
+    readpe_signature_buffer_t* buf, size_t v) {
+  return readpe_signature_buffer_push_(buf, &v, sizeof(v));
+}
+
+typedef struct readpe_signature_anchor_t {
+  const uint8_t* bytes;
+  size_t         length;
+  uint32_t       signature;
+} readpe_signature_anchor_t;
+
+static int readpe_signature_compare_anchors_(const void* a, const void* b) {
+  const readpe_signature_anchor_t* x = a;
+  const readpe_signature_anchor_t* y = b;
+
+  const size_t len = x->length < y->length? x->length: y->length;
+  const int    c   = memcmp(x->bytes, y->bytes, len);
+  if (c != 0) return c;
+  if (x->length != y->length) return x->length < y->length? -1: 1;
+  return (x->signature > y->signature) - (x->signature < y->signature);
+}
+
+static uint32_t readpe_signature_goto_(
+    const readpe_signatures_t* sigs, uint32_t node, uint8_t c) {
+  if (node == 0) return sigs->root[c];
+
+  const uint32_t end = sigs->edge_begin[node+1];
+  for (uint32_t i = sigs->edge_begin[node]; i < end; ++i) {
+    if (sigs->edge_bytes[i] == c) return sigs->edge_nodes[i];
+    if (sigs->edge_bytes[i] >  c) break;
+  }
+  return 0;
+}
+
+static inline uint32_t readpe_signature_step_(
+    const readpe_signatures_t* sigs, uint32_t node, uint8_t c) {
+  for (;;) {
+    if (sigs->shallow[node] > 0) {
+      return sigs->level1[(sigs->shallow[node] - 1)*256 + c];
+    }
+    const uint32_t next = readpe_signature_goto_(sigs, node, c);
+    if (next != 0 || node == 0) return next;
+    node = sigs->fail[node];
+  }
+}
+
+static inline bool readpe_signature_has_outs_(
+    const readpe_signatures_t* sigs, uint32_t node) {
+  return sigs->out_begin[node] != sigs->out_begin[node+1];
+}
+
+static void readpe_signature_build_truffle_(
+    uint8_t tables[2][16], const bool set[256]) {
+  memset(tables, 0, 2*16);
+  for (size_t c = 0; c < 256; ++c) {
+    if (set[c]) tables[c >> 7][c & 0xF] |= 1 << ((c >> 4) & 7);
+  }
+}
+
+static readpe_error_t readpe_signature_build_automaton_(
+    readpe_signatures_t* sigs) {
+  const size_t n = sigs->length;
+
+  readpe_signature_anchor_t* anchors = calloc(n, sizeof(*anchors));
+  if (anchors == NULL) return READPE_ERROR_NO_MEMORY;
+
+  size_t total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    anchors[i] = (readpe_signature_anchor_t) {
+      .bytes     = sigs->bytes + sigs->pattern_begin[i] + sigs->anchor[i],
+      .length    = sigs->anchor_length[i],
+      .signature = i,
+    };
+    total += sigs->anchor_length[i];
+  }
+  qsort(anchors, n, sizeof(*anchors), readpe_signature_compare_anchors_);
+
+  /* one node for each anchor byte at most, and the root */
+  const size_t max = total + 1;
+
+  uint32_t* parents  = calloc(max, sizeof(*parents));
+  uint8_t*  bytes    = calloc(max, sizeof(*bytes));
+  uint32_t* out_node = calloc(n,   sizeof(*out_node));
+  uint32_t* queue    = calloc(max, sizeof(*queue));
+
+  sigs->shallow    = calloc(max,   sizeof(*sigs->shallow));
+  sigs->level1     = calloc(256*256, sizeof(*sigs->level1));
+  sigs->fail       = calloc(max,   sizeof(*sigs->fail));
+  sigs->dict       = calloc(max,   sizeof(*sigs->dict));
+  sigs->edge_begin = calloc(max+1, sizeof(*sigs->edge_begin));
+  sigs->edge_bytes = calloc(max,   sizeof(*sigs->edge_bytes));
+  sigs->edge_nodes = calloc(max,   sizeof(*sigs->edge_nodes));
+  sigs->out_begin  = calloc(max+1, sizeof(*sigs->out_begin));
+  sigs->outs       = calloc(n,     sizeof(*sigs->outs));
+
+  readpe_error_t err = READPE_ERROR_NO_MEMORY;
+  if (parents == NULL || bytes == NULL || out_node == NULL ||
+      queue == NULL || sigs->shallow == NULL || sigs->level1 == NULL ||
+      sigs->fail == NULL || sigs->dict == NULL ||
+      sigs->edge_begin == NULL || sigs->edge_bytes == NULL ||
+      sigs->edge_nodes == NULL || sigs->out_begin == NULL ||
+      sigs->outs == NULL) {
+    goto FINALIZE;
+  }
+
+  /* Anchors are inserted in sorted order, so a new anchor shares the path
+   * of the previous one up to their common prefix, and children of a node
+   * are created in order of bytes. */
+  uint32_t path[READPE_SIGNATURE_ANCHOR_MAX+1] = {0};
+  size_t   nodes = 1;
+  for (size_t i = 0; i < n; ++i) {
+    const readpe_signature_anchor_t* a = &anchors[i];
+
+    size_t lcp = 0;
+    if (i > 0) {
+      const readpe_signature_anchor_t* prev = &anchors[i-1];
+      while (lcp < a->length && lcp < prev->length &&
+          a->bytes[lcp] == prev->bytes[lcp]) {
+        ++lcp;
+      }
+    }
+    for (size_t d = lcp; d < a->length; ++d) {
+      parents[nodes] = path[d];
+      bytes[nodes]   = a->bytes[d];
+      path[d+1]      = nodes++;
+    }
+    out_node[a->signature] = path[a->length];
+  }
+  sigs->nodes = nodes;
+
+  /* edges and outputs grouped by nodes, keeping the order */
+  for (size_t i = 1; i < nodes; ++i) ++sigs->edge_begin[parents[i]+1];
+  for (size_t i = 0; i < nodes; ++i) {
+    sigs->edge_begin[i+1] += sigs->edge_begin[i];
+  }
+  for (size_t i = 1; i < nodes; ++i) {
+    const uint32_t k = sigs->edge_begin[parents[i]] + queue[parents[i]]++;
+    sigs->edge_bytes[k] = bytes[i];
+    sigs->edge_nodes[k] = i;
+    if (parents[i] == 0) sigs->root[bytes[i]] = i;
+  }
+
+  /* children of the root fail to the root, so a missing edge is the
+   * transition of the root */
+  for (size_t c = 0; c < 256; ++c) {
+    const uint32_t u = sigs->root[c];
+    if (u == 0) continue;
+
+    uint32_t* row = &sigs->level1[c*256];
+    memcpy(row, sigs->root, sizeof(sigs->root));
+    for (uint32_t i = sigs->edge_begin[u]; i < sigs->edge_begin[u+1]; ++i) {
+      row[sigs->edge_bytes[i]] = sigs->edge_nodes[i];
+    }
+    sigs->shallow[u] = c + 1;
+  }
+
+  for (size_t i = 0; i < n; ++i) ++sigs->out_begin[out_node[i]+1];
+  for (size_t i = 0; i < nodes; ++i) {
+    sigs->out_begin[i+1] += sigs->out_begin[i];
+  }
+  memset(queue, 0, nodes*sizeof(*queue));
+  for (size_t i = 0; i < n; ++i) {
+    const uint32_t node = out_node[i];
+    sigs->outs[sigs->out_begin[node] + queue[node]++] = i;
+  }
+
+  /* fail links in breadth-first order, as each refers to shallower one */
+  size_t head = 0, tail = 0;
+  for (uint32_t i = sigs->edge_begin[0]; i < sigs->edge_begin[1]; ++i) {
+    queue[tail++] = sigs->edge_nodes[i];
+  }
+  while (head < tail) {
+    const uint32_t u = queue[head++];
+    for (uint32_t i = sigs->edge_begin[u]; i < sigs->edge_begin[u+1]; ++i) {
+      const uint32_t v = sigs->edge_nodes[i];
+      const uint32_t f =
+          readpe_signature_step_(sigs, sigs->fail[u], sigs->edge_bytes[i]);
+      sigs->fail[v] = f;
+      sigs->dict[v] = readpe_signature_has_outs_(sigs, f)? f: sigs->dict[f];
+      queue[tail++] = v;
+    }
+  }
+
+  bool any_single = false;
+  for (size_t i = 0; i < n; ++i) {
+    const readpe_signature_anchor_t* a = &anchors[i];
+    sigs->first[a->bytes[0]] = true;
+    if (a->length >= 2) {
+      sigs->second[a->bytes[1]] = true;
+    } else {
+      any_single = true;
+    }
+  }
+  if (any_single) memset(sigs->second, true, sizeof(sigs->second));
+  readpe_signature_build_truffle_(sigs->truffle[0], sigs->first);
+  readpe_signature_build_truffle_(sigs->truffle[1], sigs->second);
+
+  err = READPE_OK;
+
+FINALIZE:
+  free(anchors);
+  free(parents);
+  free(bytes);
+  free(out_node);
+  free(queue);
+  return err;
+}
+
+readpe_error_t readpe_signatures_create(
+    readpe_signatures_t** sigs, const char* text, size_t len, size_t* line) {
+  assert(sigs != NULL);
+  assert(text != NULL || len == 0);
+
+  *sigs = NULL;
+  if (line != NULL) *line = 0;
+
+  readpe_signatures_t* ret = calloc(1, sizeof(*ret));
+  if (ret == NULL) return READPE_ERROR_NO_MEMORY;
+
+  readpe_signature_buffer_t names = {0}, bytes = {0}, masks = {0};
+  readpe_signature_buffer_t name_begin = {0}, pattern_begin = {0};
+
+  readpe_error_t err = READPE_ERROR_NO_MEMORY;
+  if (!readpe_signature_push_size_(&name_begin, 0) ||
+      !readpe_signature_push_size_(&pattern_begin, 0)) {
+    goto ABORT;
+  }
+
+  size_t lineno = 0;
+  for (size_t i = 0; i < len;) {
+    const char* begin = text + i;
+    const char* end   = memchr(begin, '\n', len - i);
+    if (end == NULL) end = text + len;
+    i = end - text + 1;
+    ++lineno;
+
+    while (begin < end && readpe_signature_is_space_(*begin)) ++begin;
+    if (begin == end || *begin == '#') continue;
+
+    if (!readpe_signature_parse_line_(
+          begin, end - begin, &names, &bytes, &masks)) {
+      err = READPE_ERROR_INVALID_SIGNATURE;
+      if (line != NULL) *line = lineno;
+      goto ABORT;
+    }
+    if (!readpe_signature_push_size_(&name_begin, names.length) ||
+        !readpe_signature_push_size_(&pattern_begin, bytes.length)) {
+      goto ABORT;
+    }
+    ++ret->length;
+  }
+
+  ret->names         = (char*) names.ptr;
+  ret->bytes         = bytes.ptr;
+  ret->masks         = masks.ptr;
+  ret->name_begin    = (size_t*) name_begin.ptr;
+  ret->pattern_begin = (size_t*) pattern_begin.ptr;
+
+  const size_t n = ret->length;
+  ret->anchor        = calloc(n+1, sizeof(*ret->anchor));
+  ret->anchor_length = calloc(n+1, sizeof(*ret->anchor_length));
+  if (ret->anchor == NULL || ret->anchor_length == NULL) {
+    readpe_signatures_destroy(ret);
+    return READPE_ERROR_NO_MEMORY;
+  }
+
+  /* the first longest run without wildcards is the anchor */
+  for (size_t i = 0; i < n; ++i) {
+    const uint8_t* m   = ret->masks + ret->pattern_begin[i];
+    const size_t   len = ret->pattern_begin[i+1] - ret->pattern_begin[i];
+    if (len > ret->max_length) ret->max_length = len;
+
+    for (size_t j = 0; j < len;) {
+      if (m[j] != 0xFF) {
+        ++j;
+        continue;
+      }
+      size_t k = j;
+      while (k < len && m[k] == 0xFF) ++k;
+      if (k - j > ret->anchor_length[i]) {
+        ret->anchor[i]        = j;
+        ret->anchor_length[i] = k - j;
+      }
+      j = k;
+    }
+    if (ret->anchor_length[i] > READPE_SIGNATURE_ANCHOR_MAX) {
+      ret->anchor_length[i] = READPE_SIGNATURE_ANCHOR_MAX;
+    }
+  }
+
+  err = n > 0? readpe_signature_build_automaton_(ret): READPE_OK;
+  if (err != READPE_OK) {
+    readpe_signatures_destroy(ret);
+    return err;
+  }
+  *sigs = ret;
+  return READPE_OK;
+
+ABORT:
+  free(names.ptr);
+  free(bytes.ptr);
+  free(masks.ptr);
+  free(name_begin.ptr);
+  free(pattern_begin.ptr);
+  free(ret);
+  return err;
+}
+
+readpe_error_t readpe_signatures_load(
+    readpe_signatures_t** sigs, const char* path, size_t* line) {
+  assert(sigs != NULL);
+  assert(path != NULL);
+
+  *sigs = NULL;
+  if (line != NULL) *line = 0;
+
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) return READPE_ERROR_OPEN;
+
+  readpe_signature_buffer_t text = {0};
+
+  readpe_error_t err = READPE_OK;
+  for (;;) {
+    uint8_t buf[16*1024];
+    const size_t n = fread(buf, 1, sizeof(buf), fp);
+    if (n > 0 && !readpe_signature_buffer_push_(&text, buf, n)) {
+      err = READPE_ERROR_NO_MEMORY;
+      break;
+    }
+    if (n < sizeof(buf)) {
+      if (ferror(fp)) err = READPE_ERROR_READ;
+      break;
+    }
+  }
+  fclose(fp);
+
+  if (err == READPE_OK) {
+    err = readpe_signatures_create(
+        sigs, (const char*) text.ptr, text.length, line);
+  }
+  free(text.ptr);
+  return err;
+}
+
+void readpe_signatures_destroy(readpe_signatures_t* sigs) {
+  if (sigs == NULL) return;
+
+  free(sigs->names);
+  free(sigs->name_begin);
+  free(sigs->bytes);
+  free(sigs->masks);
+  free(sigs->pattern_begin);
+  free(sigs->anchor);
+  free(sigs->anchor_length);
+  free(sigs->shallow);
+  free(sigs->level1);
+  free(sigs->fail);
+  free(sigs->dict);
+  free(sigs->edge_begin);
+  free(sigs->edge_bytes);
+  free(sigs->edge_nodes);
+  free(sigs->out_begin);
+  free(sigs->outs);
+  free(sigs);
+}
+
+size_t readpe_signatures_get_length(const readpe_signatures_t* sigs) {
+  assert(sigs != NULL);
+  return sigs->length;
+}
+
+const char* readpe_signatures_get_name(
+    const readpe_signatures_t* sigs, size_t index, size_t* len) {
+  assert(sigs  != NULL);
+  assert(index < sigs->length);
+
+  if (len != NULL) {
+    *len = sigs->name_begin[index+1] - sigs->name_begin[index] - 1;
+  }
+  return sigs->names + sigs->name_begin[index];
+}
+
+/* Returns the first position from i which may begin an anchor, or n. The
+ * byte after the last one is unknown, so it may always begin. */
+static size_t readpe_signature_skip_(
+    const readpe_signatures_t* sigs, const uint8_t* p, size_t n, size_t i) {
+  for (; i+1 < n; ++i) {
+    if (sigs->first[p[i]] && sigs->second[p[i+1]]) return i;
+  }
+  if (i < n && !sigs->first[p[i]]) ++i;
+  return i;
+}
+
+#if defined(READPE_SIGNATURE_SSSE3)
+/* Tests 16 bytes for membership of a set at once, by two lookups of the low
+ * nibble, for bytes below and above 0x80, and a bit of the high nibble. */
+__attribute__((target("ssse3")))
+static inline __m128i readpe_signature_truffle_(
+    __m128i v, __m128i clear, __m128i set) {
+  const __m128i bits = _mm_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, (char) 128, 1, 2, 4, 8, 16, 32, 64, (char) 128);
+
+  /* a lane whose index has the top bit is zero */
+  const __m128i lo = _mm_or_si128(
+      _mm_shuffle_epi8(clear, v),
+      _mm_shuffle_epi8(set, _mm_xor_si128(v, _mm_set1_epi8((char) 0x80))));
+  const __m128i hi = _mm_shuffle_epi8(
+      bits, _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x07)));
+  return _mm_and_si128(lo, hi);
+}
+
+__attribute__((target("ssse3")))
+static size_t readpe_signature_skip_ssse3_(
+    const readpe_signatures_t* sigs, const uint8_t* p, size_t n, size_t i) {
+  const __m128i c1 = _mm_loadu_si128((const __m128i*) sigs->truffle[0][0]);
+  const __m128i s1 = _mm_loadu_si128((const __m128i*) sigs->truffle[0][1]);
+  const __m128i c2 = _mm_loadu_si128((const __m128i*) sigs->truffle[1][0]);
+  const __m128i s2 = _mm_loadu_si128((const __m128i*) sigs->truffle[1][1]);
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i+17 <= n; i += 16) {
+    const __m128i a = _mm_loadu_si128((const __m128i*) (p + i));
+    const __m128i b = _mm_loadu_si128((const __m128i*) (p + i+1));
+
+    /* bits of the two sets differ, so lanes are compared before joined */
+    const __m128i x = _mm_or_si128(
+        _mm_cmpeq_epi8(readpe_signature_truffle_(a, c1, s1), zero),
+        _mm_cmpeq_epi8(readpe_signature_truffle_(b, c2, s2), zero));
+    const unsigned bits = _mm_movemask_epi8(x) ^ 0xFFFF;
+    if (bits != 0) return i + __builtin_ctz(bits);
+  }
+  return readpe_signature_skip_(sigs, p, n, i);
+}
+#endif
+
+typedef struct readpe_signature_scan_t {
+  const readpe_context_t*    ctx;
+  const readpe_signatures_t* sigs;
+  readpe_signature_layout_t  layout;
+
+  uint8_t* window;  /* image bytes being compared */
+  bool     ssse3;
+
+  readpe_signature_callback_t callback;
+  void*                       udata;
+} readpe_signature_scan_t;
+
+/* copies image bytes, zero-filling those not in the file */
+static void readpe_signature_read_image_(
+    const readpe_context_t* ctx, uintmax_t rva, uint8_t* dst, size_t len) {
+  while (len > 0) {
+    size_t    n    = 0;
+    uintmax_t vlen = 0;
+
+    const uint8_t* p = readpe_image_resolve(&ctx->image, rva, &n, &vlen);
+    if (p != NULL) {
+      if (n > len) n = len;
+      memcpy(dst, p, n);
+    } else {
+      n = vlen > 0 && vlen < len? vlen: vlen > 0? len: 1;
+      memset(dst, 0, n);
+    }
+    dst += n;
+    rva += n;
+    len -= n;
+  }
+}
+
+static size_t readpe_signature_find_section_(
+    const readpe_context_t* ctx, uintmax_t pos, bool raw) {
+  for (size_t i = 0; i < ctx->nt_header->file.number_of_sections; ++i) {
+    const pe_image_section_header_t* s = &ctx->sections[i];
+    if (raw) {
+      if (pos - s->pointer_to_raw_data < s->size_of_raw_data) return i;
+    } else {
+      const uintmax_t len = s->misc.virtual_size?
+          s->misc.virtual_size: s->size_of_raw_data;
+      if (pos - s->virtual_address < len) return i;
+    }
+  }
+  return READPE_SIGNATURE_NO_SECTION;
+}
+
+static void readpe_signature_report_(
+    const readpe_signature_scan_t* sc, size_t sig, uintmax_t pos) {
+  const readpe_context_t* ctx = sc->ctx;
+
+  readpe_signature_match_t m = {
+    .signature = sig,
+    .rva       = UINTMAX_MAX,
+    .offset    = UINTMAX_MAX,
+  };
+  if (sc->layout == READPE_SIGNATURE_RAW) {
+    m.offset  = pos;
+    m.section = readpe_signature_find_section_(ctx, pos, true);
+    if (m.section != READPE_SIGNATURE_NO_SECTION) {
+      const pe_image_section_header_t* s = &ctx->sections[m.section];
+      m.rva = s->virtual_address + (pos - s->pointer_to_raw_data);
+    } else if (pos < ctx->header_length) {
+      m.rva = pos;
+    }
+  } else {
+    m.rva     = pos;
+    m.section = readpe_signature_find_section_(ctx, pos, false);
+
+    size_t         n;
+    const uint8_t* p = readpe_image_resolve(&ctx->image, pos, &n, NULL);
+    if (p != NULL) m.offset = p - ctx->file;
+  }
+  sc->callback(sc->udata, &m);
+}
+
+/* verifies signatures whose anchors end at the position */
+static void readpe_signature_verify_(
+    const readpe_signature_scan_t* sc,
+    uint32_t                       node,
+    const uint8_t*                 p,  /* NULLABLE, the whole file if raw */
+    uintmax_t                      end) {
+  const readpe_signatures_t* sigs = sc->sigs;
+
+  const uintmax_t total = sc->layout == READPE_SIGNATURE_RAW?
+      sc->ctx->file_length: sc->ctx->image.length;
+
+  for (uint32_t i = sigs->out_begin[node]; i < sigs->out_begin[node+1]; ++i) {
+    const uint32_t sig = sigs->outs[i];
+    const size_t   len =
+        sigs->pattern_begin[sig+1] - sigs->pattern_begin[sig];
+    const size_t   before = sigs->anchor[sig] + sigs->anchor_length[sig];
+
+    if (end+1 < before) continue;
+    const uintmax_t begin = end+1 - before;
+    if (begin > total || len > total - begin) continue;
+
+    const uint8_t* data = sc->window;
+    if (p != NULL) {
+      data = p + begin;
+    } else {
+      readpe_signature_read_image_(sc->ctx, begin, sc->window, len);
+    }
+
+    const uint8_t* bytes = sigs->bytes + sigs->pattern_begin[sig];
+    const uint8_t* masks = sigs->masks + sigs->pattern_begin[sig];
+
+    size_t j = 0;
+    while (j < len && (data[j] & masks[j]) == bytes[j]) ++j;
+    if (j == len) readpe_signature_report_(sc, sig, begin);
+  }
+}
+
+/* Runs the automaton over n bytes at base, from the node, and returns the
+ * last node. p is the whole file if raw, otherwise the image is read for
+ * verification. */
+static uint32_t readpe_signature_feed_(
+    const readpe_signature_scan_t* sc,
+    uint32_t                       node,
+    const uint8_t*                 data,
+    size_t                         n,
+    uintmax_t                      base) {
+  const readpe_signatures_t* sigs = sc->sigs;
+  const uint8_t* p = sc->layout == READPE_SIGNATURE_RAW? sc->ctx->file: NULL;
+
+  for (size_t i = 0; i < n; ++i) {
+    if (node == 0) {
+#if defined(READPE_SIGNATURE_SSSE3)
+      i = sc->ssse3?
+          readpe_signature_skip_ssse3_(sigs, data, n, i):
+          readpe_signature_skip_(sigs, data, n, i);
+#else
+      i = readpe_signature_skip_(sigs, data, n, i);
+#endif
+      if (i >= n) break;
+    }
+    node = readpe_signature_step_(sigs, node, data[i]);
+
+    uint32_t out = node;
+    if (!readpe_signature_has_outs_(sigs, node)) out = sigs->dict[node];
+    for (; out != 0; out = sigs->dict[out]) {
+      readpe_signature_verify_(sc, out, p, base + i);
+    }
+  }
+  return node;
+}
+
+/* Zeros between and after the data of extents, which may be long. Once a
+ * zero keeps the node without outputs, the rest keep it too. */
+static uint32_t readpe_signature_feed_zeros_(
+    const readpe_signature_scan_t* sc,
+    uint32_t                       node,
+    uintmax_t                      n,
+    uintmax_t                      base) {
+  static const uint8_t zeros[256] = {0};
+
+  const readpe_signatures_t* sigs = sc->sigs;
+  while (n > 0) {
+    const uint32_t next = readpe_signature_step_(sigs, node, 0);
+    if (next == node && !readpe_signature_has_outs_(sigs, node) &&
+        sigs->dict[node] == 0) {
+      break;
+    }
+
+    const size_t len = n < sizeof(zeros)? n: sizeof(zeros);
+    node = readpe_signature_feed_(sc, node, zeros, len, base);
+    base += len;
+    n    -= len;
+  }
+  return node;
+}
+
+readpe_error_t readpe_context_scan_signatures(
+    const readpe_context_t*     ctx,
+    const readpe_signatures_t*  sigs,
+    readpe_signature_layout_t   layout,
+    readpe_signature_callback_t callback,
+    void*                       udata) {
+  assert(ctx      != NULL);
+  assert(sigs     != NULL);
+  assert(callback != NULL);
+
+  readpe_signature_scan_t sc = {
+    .ctx      = ctx,
+    .sigs     = sigs,
+    .layout   = layout,
+    .callback = callback,
+    .udata    = udata,
+  };
+  if (sigs->length == 0) return READPE_OK;
+
+#if defined(READPE_SIGNATURE_SSSE3)
+  sc.ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+
+  if (layout == READPE_SIGNATURE_RAW) {
+    readpe_signature_feed_(&sc, 0, ctx->file, ctx->file_length, 0);
+    return READPE_OK;
+  }
+
+  sc.window = malloc(sigs->max_length);
+  if (sc.window == NULL) return READPE_ERROR_NO_MEMORY;
+
+  const readpe_image_t* img = &ctx->image;
+
+  uint32_t  node = 0;
+  uintmax_t cur  = 0;
+  for (size_t i = 0; i < img->extents_length && cur < img->length; ++i) {
+    const readpe_image_extent_t* ext = &img->extents[i];
+    if (ext->rva >= img->length) break;
+
+    uintmax_t vlen = ext->virtual_length;
+    if (vlen > img->length - ext->rva) vlen = img->length - ext->rva;
+    const size_t len = ext->length < vlen? ext->length: vlen;
+
+    node = readpe_signature_feed_zeros_(&sc, node, ext->rva - cur, cur);
+    node = readpe_signature_feed_(&sc, node, ext->data, len, ext->rva);
+    node = readpe_signature_feed_zeros_(
+        &sc, node, vlen - len, ext->rva + len);
+    cur = ext->rva + vlen;
+  }
+  readpe_signature_feed_zeros_(&sc, node, img->length - cur, cur);
+
+  free(sc.window);
+  return READPE_OK;
+}
@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./parallel.h"
+#include "./readpe.h"
+
+/* Sections larger than this are split into slices counted by threads. */
+#define READPE_STATS_SLICE_SIZE (4*1024*1024)
+
+/* Adds counts of each byte value to the histogram.
+ *
+ * Incrementing one table stalls on repeated bytes, as each increment waits
+ * for the previous store to the same counter. So four tables are
+ * incremented in turn, and 16 bytes of a single value are detected with
+ * one vector compare and counted at once, which makes paddings cheap. */
+static void readpe_stats_count_(
+    uint64_t* hist, const uint8_t* p, size_t len) {
+  /* the counters never overflow, as each takes at most 2^28 */
+  static const size_t block = (size_t) 1 << 28;
+
+  while (len > 0) {
+    const size_t n = len < block? len: block;
+
+    uint32_t c[4][256] = {0};
+    size_t   i = 0;
+    for (; i+16 <= n; i += 16) {
+#if defined(__SSE2__)
+      const __m128i v = _mm_loadu_si128((const __m128i*) (p + i));
+      const __m128i f = _mm_set1_epi8((char) p[i]);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, f)) == 0xFFFF) {
+        c[0][p[i]] += 16;
+        continue;
+      }
+#endif
+
+      uint64_t a, b;
+      memcpy(&a, p + i,   sizeof(a));
+      memcpy(&b, p + i+8, sizeof(b));
+
+#if !defined(__SSE2__)
+      if (a == b && a == p[i]*UINT64_C(0x0101010101010101)) {
+        c[0][p[i]] += 16;
+        continue;
+      }
+#endif
+
+      ++c[0][a & 0xFF]; ++c[1][(a >>  8) & 0xFF];
+      ++c[2][(a >> 16) & 0xFF]; ++c[3][(a >> 24) & 0xFF];
+      ++c[0][(a >> 32) & 0xFF]; ++c[1][(a >> 40) & 0xFF];
+      ++c[2][(a >> 48) & 0xFF]; ++c[3][ a >> 56];
+      ++c[0][b & 0xFF]; ++c[1][(b >>  8) & 0xFF];
+      ++c[2][(b >> 16) & 0xFF]; ++c[3][(b >> 24) & 0xFF];
+      ++c[0][(b >> 32) & 0xFF]; ++c[1][(b >> 40) & 0xFF];
+      ++c[2][(b >> 48) & 0xFF]; ++c[3][ b >> 56];
+    }
+    for (; i < n; ++i) ++c[0][p[i]];
+
+    for (size_t j = 0; j < 256; ++j) {
+      hist[j] += (uint64_t) c[0][j] + c[1][j] + c[2][j] + c[3][j];
+    }
+    p   += n;
+    len -= n;
+  }
+}
+
+typedef struct readpe_stats_slice_t {
+  const uint8_t* data;
+  size_t         length;
+  size_t         section;
+  uint64_t       hist[256];
+} readpe_stats_slice_t;
+
+/* slices have almost the same size, so they are dealt out in turn */
+static void readpe_stats_work_(void* udata, size_t index) {
+  readpe_stats_slice_t* s = (readpe_stats_slice_t*) udata + index;
+  readpe_stats_count_(s->hist, s->data, s->length);
+}
+
+static void readpe_stats_finalize_(readpe_section_stats_t* st) {
+  st->entropy    = 0;
+  st->zero_ratio = 0;
+  st->chi_square = 0;
+  if (st->length == 0) return;
+
+  const double n        = (double) st->length;
+  const double expected = n / 256;
+  for (size_t i = 0; i < 256; ++i) {
+    const double c = (double) st->histogram[i];
+    if (c > 0) {
+      const double p = c / n;
+      st->entropy -= p * log2(p);
+    }
+    st->chi_square += (c - expected) * (c - expected) / expected;
+  }
+  st->zero_ratio = (double) st->histogram[0] / n;
+}
+
+readpe_error_t readpe_context_compute_section_stats(
+    readpe_context_t* ctx, size_t threads) {
+  assert(ctx != NULL);
+
+  if (ctx->section_stats != NULL) return READPE_OK;
+
+  const size_t sections = ctx->nt_header->file.number_of_sections;
+
+  size_t n = 0;
+  for (size_t i = 0; i < sections; ++i) {
+    const size_t len = ctx->sections[i].size_of_raw_data;
+    n += (len + READPE_STATS_SLICE_SIZE - 1) / READPE_STATS_SLICE_SIZE;
+  }
+
+  readpe_stats_slice_t* slices = calloc(n, sizeof(*slices));
+  if (slices == NULL && n > 0) return READPE_ERROR_NO_MEMORY;
+
+  /* one item at least, as NULL means not computed */
+  ctx->section_stats =
+      calloc(sections > 0? sections: 1, sizeof(*ctx->section_stats));
+  if (ctx->section_stats == NULL) {
+    free(slices);
+    return READPE_ERROR_NO_MEMORY;
+  }
+
+  /* the raw data is known to be in the file since initialization */
+  size_t k = 0;
+  for (size_t i = 0; i < sections; ++i) {
+    const pe_image_section_header_t* s = &ctx->sections[i];
+    for (size_t off = 0; off < s->size_of_raw_data;) {
+      size_t len = s->size_of_raw_data - off;
+      if (len > READPE_STATS_SLICE_SIZE) len = READPE_STATS_SLICE_SIZE;
+
+      slices[k++] = (readpe_stats_slice_t) {
+        .data    = ctx->file + s->pointer_to_raw_data + off,
+        .length  = len,
+        .section = i,
+      };
+      off += len;
+    }
+  }
+  assert(k == n);
+
+  readpe_parallel_for(n, threads, readpe_stats_work_, slices);
+
+  for (size_t i = 0; i < n; ++i) {
+    readpe_section_stats_t* st = &ctx->section_stats[slices[i].section];
+    for (size_t j = 0; j < 256; ++j) st->histogram[j] += slices[i].hist[j];
+    st->length += slices[i].length;
+  }
+  free(slices);
+
+  for (size_t i = 0; i < sections; ++i) {
+    readpe_stats_finalize_(&ctx->section_stats[i]);
+  }
+  return READPE_OK;
+}
+
+const readpe_section_stats_t* readpe_context_get_section_stats(
+    const readpe_context_t* ctx) {
+  assert(ctx                != NULL);
+  assert(ctx->section_stats != NULL);
+  return ctx->section_stats;
+}
@@ -0,0 +1,487 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include "pe.h"
+
+#include "./context.h"
+#include "./parallel.h"
+#include "./readpe.h"
+
+/* Sections are split into slices of this size, scanned by threads. */
+#define READPE_STRINGS_SLICE_SIZE (1024*1024)
+
+/* Slices scanned ahead of the callback per thread, which bounds memory. */
+#define READPE_STRINGS_WINDOW 4
+
+static inline bool readpe_strings_is_printable_(uint8_t c) {
+  return (c >= 0x20 && c < 0x7F) || c == 0x09;
+}
+
+#if defined(__SSE2__)
+static inline uint64_t readpe_strings_bytes16_(const uint8_t* p) {
+  const __m128i v = _mm_loadu_si128((const __m128i*) p);
+
+  /* bytes above 0x7F are negative, so they fail the first compare */
+  const __m128i lo  = _mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F));
+  const __m128i hi  = _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F));
+  const __m128i tab = _mm_cmpeq_epi8(v, _mm_set1_epi8(0x09));
+  return (uint16_t) _mm_movemask_epi8(
+      _mm_or_si128(_mm_and_si128(lo, hi), tab));
+}
+
+static inline __m128i readpe_strings_units8_(const uint8_t* p) {
+  const __m128i v = _mm_loadu_si128((const __m128i*) p);
+
+  /* a unit whose upper byte is not zero is out of the range */
+  const __m128i lo  = _mm_cmpgt_epi16(v, _mm_set1_epi16(0x1F));
+  const __m128i hi  = _mm_cmplt_epi16(v, _mm_set1_epi16(0x7F));
+  const __m128i tab = _mm_cmpeq_epi16(v, _mm_set1_epi16(0x09));
+  return _mm_or_si128(_mm_and_si128(lo, hi), tab);
+}
+
+static inline uint64_t readpe_strings_units16_(const uint8_t* p) {
+  return (uint16_t) _mm_movemask_epi8(_mm_packs_epi16(
+      readpe_strings_units8_(p), readpe_strings_units8_(p + 16)));
+}
+#endif
+
+/* Returns bits of 64 characters from pos, set if the character is printable.
+ * Characters are bytes, or 16-bit units if utf16. Bits at or after n are
+ * clear. */
+static uint64_t readpe_strings_mask_(
+    const uint8_t* p, size_t n, size_t pos, bool utf16) {
+  uint64_t m = 0;
+
+#if defined(__SSE2__)
+  if (n - pos >= 64) {
+    if (utf16) {
+      const uint8_t* q = p + pos*2;
+      m  = readpe_strings_units16_(q);
+      m |= readpe_strings_units16_(q +  32) << 16;
+      m |= readpe_strings_units16_(q +  64) << 32;
+      m |= readpe_strings_units16_(q +  96) << 48;
+    } else {
+      const uint8_t* q = p + pos;
+      m  = readpe_strings_bytes16_(q);
+      m |= readpe_strings_bytes16_(q + 16) << 16;
+      m |= readpe_strings_bytes16_(q + 32) << 32;
+      m |= readpe_strings_bytes16_(q + 48) << 48;
+    }
+    return m;
+  }
+#endif
+
+  const size_t len = n - pos < 64? n - pos: 64;
+  if (utf16) {
+    for (size_t i = 0; i < len; ++i) {
+      const uint8_t* q = p + (pos+i)*2;
+      m |= (uint64_t) (readpe_strings_is_printable_(q[0]) && q[1] == 0) << i;
+    }
+  } else {
+    for (size_t i = 0; i < len; ++i) {
+      m |= (uint64_t) readpe_strings_is_printable_(p[pos+i]) << i;
+    }
+  }
+  return m;
+}
+
+typedef struct readpe_strings_name_t {
+  uint32_t            rva;
+  readpe_string_tag_t tag;
+} readpe_strings_name_t;
+
+typedef struct readpe_strings_scan_t {
+  const readpe_strings_options_t* opts;
+
+  const readpe_strings_name_t* names;
+  size_t                       names_length;
+} readpe_strings_scan_t;
+
+typedef struct readpe_strings_slice_t {
+  const uint8_t* data;  /* of the whole section */
+  size_t         length;
+  size_t         section;
+  uint32_t       rva;   /* of the section */
+
+  /* strings beginning in this range belong to this slice */
+  size_t begin;
+  size_t end;
+
+  readpe_string_t* strings;
+  size_t           strings_length;
+  size_t           strings_reserved;
+
+  bool done;
+  bool failed;
+} readpe_strings_slice_t;
+
+static int readpe_strings_compare_names_(const void* a, const void* b) {
+  const readpe_strings_name_t* x = a;
+  const readpe_strings_name_t* y = b;
+  return x->rva < y->rva? -1: x->rva > y->rva? 1: 0;
+}
+
+static readpe_string_tag_t readpe_strings_find_tag_(
+    const readpe_strings_scan_t* scan, uint32_t rva) {
+  size_t l = 0, r = scan->names_length;
+  while (l < r) {
+    const size_t m = l + (r-l)/2;
+    if (scan->names[m].rva < rva) {
+      l = m+1;
+    } else {
+      r = m;
+    }
+  }
+  return l < scan->names_length && scan->names[l].rva == rva?
+      scan->names[l].tag: READPE_STRING_UNTAGGED;
+}
+
+static bool readpe_strings_push_(
+    const readpe_strings_scan_t* scan,
+    readpe_strings_slice_t*      slice,
+    size_t                       offset,  /* in the section */
+    size_t                       length,
+    bool                         utf16) {
+  readpe_string_t str = {
+    .section  = slice->section,
+    .rva      = (uint32_t) (slice->rva + offset),
+    .encoding = utf16? READPE_STRING_UTF16LE: READPE_STRING_ASCII,
+    .data     = slice->data + offset,
+    .length   = length,
+  };
+  if (!utf16) str.tag = readpe_strings_find_tag_(scan, str.rva);
+  if (scan->opts->skip_names && str.tag != READPE_STRING_UNTAGGED) {
+    return true;
+  }
+
+  if (slice->strings_length >= slice->strings_reserved) {
+    const size_t n = slice->strings_reserved? slice->strings_reserved*2: 64;
+    readpe_string_t* ptr = realloc(slice->strings, n*sizeof(*ptr));
+    if (ptr == NULL) return false;
+    slice->strings          = ptr;
+    slice->strings_reserved = n;
+  }
+  slice->strings[slice->strings_length++] = str;
+  return true;
+}
+
+/* Finds runs of printable characters beginning in [begin, end), where
+ * characters are bytes from p, or units from p if utf16. A run may continue
+ * to n, and a run continued from before begin belongs to the previous
+ * slice. shift and step convert a character index to an offset. */
+static bool readpe_strings_scan_runs_(
+    const readpe_strings_scan_t* scan,
+    readpe_strings_slice_t*      slice,
+    const uint8_t*               p,
+    size_t                       n,
+    size_t                       begin,
+    size_t                       end,
+    bool                         utf16) {
+  const size_t shift = p - slice->data;
+  const size_t step  = utf16? 2: 1;
+  const size_t min   = scan->opts->min_length;
+
+  size_t start   = SIZE_MAX;  /* of the current run */
+  bool   foreign = false;
+  if (begin > 0 && begin < n &&
+      (readpe_strings_mask_(p, n, begin-1, utf16) & 1)) {
+    start   = begin;
+    foreign = true;
+  }
+
+  size_t pos = begin;
+  for (; pos < n; pos += 64) {
+    if (start == SIZE_MAX && pos >= end) return true;
+
+    const uint64_t m = readpe_strings_mask_(p, n, pos, utf16);
+    if (start == SIZE_MAX && m == 0) continue;
+
+    size_t i = 0;
+    while (i < 64) {
+      if (start == SIZE_MAX) {
+        const uint64_t set = m >> i;
+        if (set == 0) break;
+        i += __builtin_ctzll(set);
+        start = pos + i;
+        if (start >= end) return true;
+      }
+
+      const uint64_t clear = ~m >> i;
+      if (clear == 0) break;
+      i += __builtin_ctzll(clear);
+
+      const size_t len = pos + i - start;
+      if (!foreign && len >= min &&
+          !readpe_strings_push_(scan, slice, shift + start*step, len, utf16)) {
+        return false;
+      }
+      start   = SIZE_MAX;
+      foreign = false;
+    }
+  }
+
+  if (start != SIZE_MAX && !foreign && n - start >= min) {
+    return readpe_strings_push_(
+        scan, slice, shift + start*step, n - start, utf16);
+  }
+  return true;
+}
+
+static int readpe_strings_compare_(const void* a, const void* b) {
+  const readpe_string_t* x = a;
+  const readpe_string_t* y = b;
+  if (x->data != y->data) return x->data < y->data? -1: 1;
+  return (int) x->encoding - (int) y->encoding;
+}
+
+static bool readpe_strings_scan_slice_(
+    const readpe_strings_scan_t* scan, readpe_strings_slice_t* slice) {
+  if (!readpe_strings_scan_runs_(scan, slice, slice->data, slice->length,
+        slice->begin, slice->end, false)) {
+    return false;
+  }
+
+  /* UTF-16 strings may begin at odd offsets, and units of two alignments
+   * never overlap, as the upper byte of a unit is zero and not printable */
+  for (size_t align = 0; align < 2; ++align) {
+    if (slice->length <= align) break;
+
+    const size_t n = (slice->length - align) / 2;
+    const size_t b = slice->begin <= align? 0: (slice->begin - align + 1)/2;
+    const size_t e = slice->end   <= align? 0: (slice->end   - align + 1)/2;
+    if (!readpe_strings_scan_runs_(
+          scan, slice, slice->data + align, n, b, e, true)) {
+      return false;
+    }
+  }
+
+  if (slice->strings_length > 1) {
+    qsort(slice->strings, slice->strings_length,
+        sizeof(*slice->strings), readpe_strings_compare_);
+  }
+  return true;
+}
+
+typedef struct readpe_strings_state_t {
+  const readpe_strings_scan_t* scan;
+
+  readpe_strings_slice_t* slices;
+  size_t                  slices_length;
+
+  pthread_mutex_t mtx;
+  pthread_cond_t  cond;
+
+  size_t next;     /* index of the slice to be taken next */
+  size_t emitted;  /* number of slices passed to the callback */
+  size_t window;
+  bool   aborted;
+} readpe_strings_state_t;
+
+static void* readpe_strings_work_(void* udata) {
+  readpe_strings_state_t* st = udata;
+
+  pthread_mutex_lock(&st->mtx);
+  for (;;) {
+    while (!st->aborted && st->next < st->slices_length &&
+        st->next >= st->emitted + st->window) {
+      pthread_cond_wait(&st->cond, &st->mtx);
+    }
+    if (st->aborted || st->next >= st->slices_length) break;
+
+    readpe_strings_slice_t* slice = &st->slices[st->next++];
+    pthread_mutex_unlock(&st->mtx);
+
+    const bool ok = readpe_strings_scan_slice_(st->scan, slice);
+
+    pthread_mutex_lock(&st->mtx);
+    slice->done   = true;
+    slice->failed = !ok;
+    pthread_cond_broadcast(&st->cond);
+  }
+  pthread_mutex_unlock(&st->mtx);
+  return NULL;
+}
+
+static readpe_error_t readpe_strings_collect_names_(
+    readpe_context_t* ctx, readpe_strings_name_t** names, size_t* len) {
+  *names = NULL;
+  *len   = 0;
+
+  /* names of broken tables are just unknown */
+  readpe_error_t err = readpe_context_find_import_table(ctx);
+  if (err == READPE_ERROR_NO_MEMORY) return err;
+  const bool imports = err == READPE_OK && ctx->imports != NULL;
+
+  err = readpe_context_find_export_table(ctx);
+  if (err == READPE_ERROR_NO_MEMORY) return err;
+  const bool exports = err == READPE_OK && ctx->export_ != NULL;
+
+  size_t n = 0;
+  if (imports) n += ctx->imports_length + ctx->import_entries.length;
+  if (exports) n += 1 + ctx->export_->number_of_names;
+  if (n == 0) return READPE_OK;
+
+  readpe_strings_name_t* ret = malloc(n*sizeof(*ret));
+  if (ret == NULL) return READPE_ERROR_NO_MEMORY;
+
+  size_t k = 0;
+  if (imports) {
+    for (size_t i = 0; i < ctx->imports_length; ++i) {
+      ret[k++] = (readpe_strings_name_t) {
+        ctx->imports[i].name, READPE_STRING_DLL_NAME, };
+    }
+    const readpe_import_entries_t* e = &ctx->import_entries;
+    for (size_t i = 0; i < e->length; ++i) {
+      if (e->by_ordinal[i]) continue;
+      ret[k++] = (readpe_strings_name_t) {
+        e->name[i], READPE_STRING_IMPORT_NAME, };
+    }
+  }
+  if (exports) {
+    ret[k++] = (readpe_strings_name_t) {
+      ctx->export_->name, READPE_STRING_DLL_NAME, };
+    for (size_t i = 0; i < ctx->export_->number_of_names; ++i) {
+      ret[k++] = (readpe_strings_name_t) {
+        ctx->export_names[i], READPE_STRING_EXPORT_NAME, };
+    }
+  }
+  qsort(ret, k, sizeof(*ret), readpe_strings_compare_names_);
+
+  *names = ret;
+  *len   = k;
+  return READPE_OK;
+}
+
+readpe_error_t readpe_context_extract_strings(
+    readpe_context_t*               ctx,
+    const readpe_strings_options_t* opts,
+    readpe_string_callback_t        callback,
+    void*                           udata) {
+  assert(ctx      != NULL);
+  assert(opts     != NULL);
+  assert(callback != NULL);
+
+  readpe_strings_options_t o = *opts;
+  if (o.min_length == 0) o.min_length = 4;
+
+  readpe_strings_scan_t scan = { .opts = &o, };
+
+  readpe_strings_name_t* names;
+  readpe_error_t err =
+      readpe_strings_collect_names_(ctx, &names, &scan.names_length);
+  if (err != READPE_OK) return err;
+  scan.names = names;
+
+  const size_t sections = ctx->nt_header->file.number_of_sections;
+
+  size_t n = 0;
+  for (size_t i = 0; i < sections; ++i) {
+    const size_t len = ctx->sections[i].size_of_raw_data;
+    n += (len + READPE_STRINGS_SLICE_SIZE - 1) / READPE_STRINGS_SLICE_SIZE;
+  }
+
+  readpe_strings_slice_t* slices = calloc(n, sizeof(*slices));
+  if (slices == NULL && n > 0) {
+    free(names);
+    return READPE_ERROR_NO_MEMORY;
+  }
+
+  /* the raw data is known to be in the file since initialization */
+  size_t k = 0;
+  for (size_t i = 0; i < sections; ++i) {
+    const pe_image_section_header_t* s = &ctx->sections[i];
+    for (size_t off = 0; off < s->size_of_raw_data;) {
+      size_t len = s->size_of_raw_data - off;
+      if (len > READPE_STRINGS_SLICE_SIZE) len = READPE_STRINGS_SLICE_SIZE;
+
+      slices[k++] = (readpe_strings_slice_t) {
+        .data    = ctx->file + s->pointer_to_raw_data,
+        .length  = s->size_of_raw_data,
+        .section = i,
+        .rva     = s->virtual_address,
+        .begin   = off,
+        .end     = off + len,
+      };
+      off += len;
+    }
+  }
+  assert(k == n);
+
+  const size_t threads = readpe_parallel_threads(o.threads, n);
+
+  readpe_strings_state_t st = {
+    .scan          = &scan,
+    .slices        = slices,
+    .slices_length = n,
+    .window        = threads*READPE_STRINGS_WINDOW,
+  };
+  pthread_mutex_init(&st.mtx, NULL);
+  pthread_cond_init(&st.cond, NULL);
+
+  /* the caller thread passes strings to the callback while workers scan
+   * the following slices, or scans by itself if no worker starts */
+  pthread_t* workers = NULL;
+  size_t     started = 0;
+  if (threads > 1) workers = calloc(threads, sizeof(*workers));
+  if (workers != NULL) {
+    for (; started < threads; ++started) {
+      if (pthread_create(&workers[started], NULL,
+            readpe_strings_work_, &st) != 0) {
+        break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < n && err == READPE_OK; ++i) {
+    readpe_strings_slice_t* slice = &slices[i];
+
+    if (started > 0) {
+      pthread_mutex_lock(&st.mtx);
+      while (!slice->done) pthread_cond_wait(&st.cond, &st.mtx);
+      pthread_mutex_unlock(&st.mtx);
+    } else {
+      slice->failed = !readpe_strings_scan_slice_(&scan, slice);
+    }
+    if (slice->failed) {
+      err = READPE_ERROR_NO_MEMORY;
+      break;
+    }
+
+    for (size_t j = 0; j < slice->strings_length; ++j) {
+      callback(udata, &slice->strings[j]);
+    }
+    free(slice->strings);
+    slice->strings = NULL;
+
+    if (started > 0) {
+      pthread_mutex_lock(&st.mtx);
+      st.emitted = i+1;
+      pthread_cond_broadcast(&st.cond);
+      pthread_mutex_unlock(&st.mtx);
+    }
+  }
+
+  pthread_mutex_lock(&st.mtx);
+  st.aborted = true;
+  pthread_cond_broadcast(&st.cond);
+  pthread_mutex_unlock(&st.mtx);
+  for (size_t i = 0; i < started; ++i) pthread_join(workers[i], NULL);
+  free(workers);
+
+  pthread_cond_destroy(&st.cond);
+  pthread_mutex_destroy(&st.mtx);
+
+  for (size_t i = 0; i < n; ++i) free(slices[i].strings);
+  free(slices);
+  free(names);
+  return err;
+}
@@ -325,5 +325,12 @@ typedef struct pe_base_relocation_entry_t {
 # define PE_BASE_RELOCATION_ENTRY_SIZE 2
 
   unsigned offset : 12;
+
   unsigned type   : 4;
+# define PE_IMAGE_REL_BASED_ABSOLUTE 0
+# define PE_IMAGE_REL_BASED_HIGH     1
+# define PE_IMAGE_REL_BASED_LOW      2
+# define PE_IMAGE_REL_BASED_HIGHLOW  3
+# define PE_IMAGE_REL_BASED_HIGHADJ  4
+# define PE_IMAGE_REL_BASED_DIR64    10
 } pe_base_relocation_entry_t;
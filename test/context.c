@@ -0,0 +1,185 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pe.h"
+
+#include "lib/readpe.h"
+
+#include "./fixture.h"
+#include "./test.h"
+
+/* Known answers of the fixture, computed apart from readpe. */
+#define READPE_TEST_FILE_MD5 \
+    "b0e5c4045f01d7da807b175d0b9a5b19"
+#define READPE_TEST_FILE_SHA256 \
+    "e5477f7482e3182f0e6f1e70cb3e434d5a708a26dc4a71ad7794f6b7baad763b"
+#define READPE_TEST_AUTHENTICODE_SHA1 \
+    "4154888a012a36b0b9468c3a97aee0dc38975919"
+#define READPE_TEST_AUTHENTICODE_SHA256 \
+    "f14b4608a4b11f2690650f6f15db79c49559f79408e6f09a3bff68da9370220d"
+#define READPE_TEST_CHECKSUM 0xDEF9
+
+/* MD5 of "kernel32.exitprocess,ws2_32.closesocket" */
+#define READPE_TEST_IMPHASH \
+    "daa3d857aa59c4ec2fd5529910ba862c"
+/* SHA-256 of "alpha,beta" */
+#define READPE_TEST_EXPHASH \
+    "76ba5a3bc22ef0b439168b9a5c771cebe88baaf65d793c368e15eaba15730512"
+
+static bool readpe_test_equal_hex_(
+    const uint8_t* bytes, const char* hex, size_t len) {
+  uint8_t expected[64];
+  readpe_test_parse_hex(hex, expected, len);
+  return memcmp(bytes, expected, len) == 0;
+}
+
+static uint64_t readpe_test_r64_(const uint8_t* p) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < 8; ++i) v |= (uint64_t) p[i] << (i*8);
+  return v;
+}
+
+static void readpe_test_digests_(readpe_context_t* ctx) {
+  READPE_TEST_CHECK(readpe_context_compute_hashes(ctx) == READPE_OK);
+  const readpe_hash_t* file = readpe_context_get_file_hash(ctx);
+  READPE_TEST_CHECK(readpe_test_equal_hex_(
+      file->md5, READPE_TEST_FILE_MD5, 16));
+  READPE_TEST_CHECK(readpe_test_equal_hex_(
+      file->sha256, READPE_TEST_FILE_SHA256, 32));
+
+  READPE_TEST_CHECK(readpe_context_compute_authenticode(ctx) == READPE_OK);
+  const readpe_hash_t* auth = readpe_context_get_authenticode_hash(ctx);
+  READPE_TEST_CHECK(readpe_test_equal_hex_(
+      auth->sha1, READPE_TEST_AUTHENTICODE_SHA1, 20));
+  READPE_TEST_CHECK(readpe_test_equal_hex_(
+      auth->sha256, READPE_TEST_AUTHENTICODE_SHA256, 32));
+  READPE_TEST_CHECK(readpe_context_get_checksum(ctx) == READPE_TEST_CHECKSUM);
+  READPE_TEST_CHECK(!readpe_context_is_signed(ctx));
+
+  READPE_TEST_CHECK(readpe_context_compute_fingerprints(ctx) == READPE_OK);
+  const readpe_fingerprints_t* fp = readpe_context_get_fingerprints(ctx);
+  READPE_TEST_CHECK(fp->imphash_found);
+  READPE_TEST_CHECK(readpe_test_equal_hex_(
+      fp->imphash, READPE_TEST_IMPHASH, 16));
+  READPE_TEST_CHECK(fp->exphash_found);
+  READPE_TEST_CHECK(readpe_test_equal_hex_(
+      fp->exphash, READPE_TEST_EXPHASH, 32));
+  READPE_TEST_CHECK(!fp->rich_hash_found);
+}
+
+static void readpe_test_exports_(readpe_context_t* ctx) {
+  READPE_TEST_CHECK(readpe_context_find_export_table(ctx) == READPE_OK);
+
+  readpe_export_t exp;
+  READPE_TEST_CHECK(readpe_context_find_export_by_name(ctx, "alpha", &exp));
+  READPE_TEST_CHECK(exp.ordinal == 1 && exp.rva == 0x1000);
+  READPE_TEST_CHECK(!exp.forwarded);
+
+  READPE_TEST_CHECK(readpe_context_find_export_by_string(
+      ctx, "betamax", 4, &exp));
+  READPE_TEST_CHECK(exp.ordinal == 2 && exp.forwarded);
+  READPE_TEST_CHECK(exp.forwarder_length == 14 &&
+      memcmp(exp.forwarder, "KERNEL32.Sleep", 14) == 0);
+
+  READPE_TEST_CHECK(readpe_context_find_export_by_ordinal(ctx, 3, &exp));
+  READPE_TEST_CHECK(exp.rva == 0x1020 && exp.name == NULL);
+  READPE_TEST_CHECK(readpe_context_find_export_by_ordinal(ctx, 1, &exp));
+  READPE_TEST_CHECK(exp.name_length == 5 && memcmp(exp.name, "alpha", 5) == 0);
+
+  READPE_TEST_CHECK(!readpe_context_find_export_by_name(ctx, "alph", &exp));
+  READPE_TEST_CHECK(!readpe_context_find_export_by_name(ctx, "gamma", &exp));
+  READPE_TEST_CHECK(!readpe_context_find_export_by_ordinal(ctx, 0, &exp));
+  READPE_TEST_CHECK(!readpe_context_find_export_by_ordinal(ctx, 4, &exp));
+
+  /* the same answers through the hash index */
+  READPE_TEST_CHECK(readpe_context_build_export_hash(ctx) == READPE_OK);
+  READPE_TEST_CHECK(readpe_context_find_export_by_name(ctx, "beta", &exp));
+  READPE_TEST_CHECK(exp.ordinal == 2);
+  READPE_TEST_CHECK(!readpe_context_find_export_by_name(ctx, "gamma", &exp));
+}
+
+static void readpe_test_imports_(readpe_context_t* ctx) {
+  READPE_TEST_CHECK(readpe_context_find_import_table(ctx) == READPE_OK);
+
+  size_t descs;
+  READPE_TEST_CHECK(
+      readpe_context_get_import_descriptors(ctx, &descs) != NULL);
+  READPE_TEST_CHECK(descs == 2);
+
+  const readpe_import_entries_t* e = readpe_context_get_import_entries(ctx);
+  READPE_TEST_CHECK(e->length == 2);
+  if (e->length != 2) return;
+  READPE_TEST_CHECK(e->dll[0] == 0 && !e->by_ordinal[0]);
+  READPE_TEST_CHECK(e->name[0] == 0x2122 && e->hint[0] == 0);
+  READPE_TEST_CHECK(e->iat[0] == 0x20E0);
+  READPE_TEST_CHECK(e->dll[1] == 1 && e->by_ordinal[1] && e->hint[1] == 3);
+  READPE_TEST_CHECK(e->iat[1] == 0x20F0);
+}
+
+static void readpe_test_relocations_(readpe_context_t* ctx) {
+  READPE_TEST_CHECK(readpe_context_find_relocation_table(ctx) == READPE_OK);
+
+  const readpe_relocation_entries_t* r =
+      readpe_context_get_relocation_entries(ctx);
+  READPE_TEST_CHECK(r->length == 4 && r->blocks == 1);
+  if (r->length != 4) return;
+  READPE_TEST_CHECK(r->rva[0] == 0x1010 && r->rva[1] == 0x1018);
+  READPE_TEST_CHECK(r->type[0] == PE_IMAGE_REL_BASED_DIR64);
+  READPE_TEST_CHECK(r->type[2] == PE_IMAGE_REL_BASED_ABSOLUTE);
+
+  READPE_TEST_CHECK(readpe_context_build_relocation_index(ctx) == READPE_OK);
+  READPE_TEST_CHECK(readpe_context_is_relocated(ctx, 0x1010));
+  READPE_TEST_CHECK(readpe_context_is_relocated(ctx, 0x1018));
+  READPE_TEST_CHECK(!readpe_context_is_relocated(ctx, 0x1014));
+  READPE_TEST_CHECK(!readpe_context_is_relocated(ctx, 0x1000));
+
+  READPE_TEST_CHECK(
+      readpe_context_get_image_base(ctx) == READPE_FIXTURE_IMAGE_BASE);
+  const size_t len = readpe_context_get_image_length(ctx);
+  READPE_TEST_CHECK(len == READPE_FIXTURE_IMAGE_SIZE);
+
+  uint8_t* image = malloc(len);
+  if (image == NULL) return;
+  readpe_context_load_image(ctx, image);
+  READPE_TEST_CHECK(readpe_test_r64_(image + 0x1010) ==
+      READPE_FIXTURE_IMAGE_BASE + 0x2000);
+
+  const uint64_t base = UINT64_C(0x140000000);
+  READPE_TEST_CHECK(
+      readpe_context_rebase_image(ctx, image, base) == READPE_OK);
+  READPE_TEST_CHECK(readpe_test_r64_(image + 0x1010) == base + 0x2000);
+  READPE_TEST_CHECK(readpe_test_r64_(image + 0x1018) == base + 0x1000);
+  READPE_TEST_CHECK(readpe_test_r64_(image + 0x58 + 24) == base);
+  READPE_TEST_CHECK(image[0x1000] == 0xC3 && image[0x1020] == 0xC3);
+  free(image);
+}
+
+int main(void) {
+  static uint8_t buf[READPE_FIXTURE_LENGTH];
+  readpe_fixture_build(buf);
+
+  readpe_context_t* ctx;
+  const readpe_error_t err =
+      readpe_context_create_from_memory(&ctx, buf, sizeof(buf));
+  if (err != READPE_OK) {
+    fprintf(stderr, "failed to parse the fixture: %s\n",
+        readpe_error_stringify(err));
+    return EXIT_FAILURE;
+  }
+  READPE_TEST_CHECK(readpe_context_is_64bit(ctx));
+
+  size_t sections;
+  readpe_context_get_sections(ctx, &sections);
+  READPE_TEST_CHECK(sections == 2);
+
+  readpe_test_digests_(ctx);
+  readpe_test_exports_(ctx);
+  readpe_test_imports_(ctx);
+  readpe_test_relocations_(ctx);
+
+  readpe_context_destroy(ctx);
+  return READPE_TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+#include "./fixture.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#define READPE_FIXTURE_NT       0x040
+#define READPE_FIXTURE_OPTIONAL 0x058
+#define READPE_FIXTURE_SECTIONS 0x148
+
+/* file offsets of RVAs in each section */
+#define text_(rva)  ((rva) - 0x1000 + 0x200)
+#define rdata_(rva) ((rva) - 0x2000 + 0x400)
+
+static void readpe_fixture_w16_(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+}
+static void readpe_fixture_w32_(uint8_t* p, uint32_t v) {
+  readpe_fixture_w16_(p,   (uint16_t) v);
+  readpe_fixture_w16_(p+2, (uint16_t) (v >> 16));
+}
+static void readpe_fixture_w64_(uint8_t* p, uint64_t v) {
+  readpe_fixture_w32_(p,   (uint32_t) v);
+  readpe_fixture_w32_(p+4, (uint32_t) (v >> 32));
+}
+static void readpe_fixture_str_(uint8_t* p, const char* s) {
+  memcpy(p, s, strlen(s)+1);
+}
+
+static void readpe_fixture_section_(
+    uint8_t* p, const char* name,
+    uint32_t vsize, uint32_t va, uint32_t rawsize, uint32_t raw,
+    uint32_t characteristics) {
+  memcpy(p, name, strlen(name));
+  readpe_fixture_w32_(p+ 8, vsize);
+  readpe_fixture_w32_(p+12, va);
+  readpe_fixture_w32_(p+16, rawsize);
+  readpe_fixture_w32_(p+20, raw);
+  readpe_fixture_w32_(p+36, characteristics);
+}
+
+void readpe_fixture_build(uint8_t* dst) {
+  assert(dst != NULL);
+
+  uint8_t* const f = dst;
+  memset(f, 0, READPE_FIXTURE_LENGTH);
+
+  /* DOS header */
+  f[0] = 'M';
+  f[1] = 'Z';
+  readpe_fixture_w32_(f+0x3C, READPE_FIXTURE_NT);
+
+  /* NT header */
+  memcpy(f+READPE_FIXTURE_NT, "PE\0\0", 4);
+  uint8_t* fh = f+READPE_FIXTURE_NT+4;
+  readpe_fixture_w16_(fh+ 0, 0x8664);  /* AMD64 */
+  readpe_fixture_w16_(fh+ 2, 2);       /* sections */
+  readpe_fixture_w16_(fh+16, 0xF0);    /* size of the optional header */
+  readpe_fixture_w16_(fh+18, 0x2022);  /* DLL, large address aware */
+
+  uint8_t* oh = f+READPE_FIXTURE_OPTIONAL;
+  readpe_fixture_w16_(oh+  0, 0x20B);  /* PE32+ */
+  readpe_fixture_w32_(oh+  4, 0x200);  /* size of code */
+  readpe_fixture_w32_(oh+  8, 0x400);  /* size of initialized data */
+  readpe_fixture_w32_(oh+ 16, 0x1000); /* entry point */
+  readpe_fixture_w32_(oh+ 20, 0x1000); /* base of code */
+  readpe_fixture_w64_(oh+ 24, READPE_FIXTURE_IMAGE_BASE);
+  readpe_fixture_w32_(oh+ 32, 0x1000); /* section alignment */
+  readpe_fixture_w32_(oh+ 36, 0x200);  /* file alignment */
+  readpe_fixture_w16_(oh+ 40, 6);      /* OS version */
+  readpe_fixture_w16_(oh+ 48, 6);      /* subsystem version */
+  readpe_fixture_w32_(oh+ 56, READPE_FIXTURE_IMAGE_SIZE);
+  readpe_fixture_w32_(oh+ 60, 0x200);  /* size of headers */
+  readpe_fixture_w16_(oh+ 68, 2);      /* Windows GUI */
+  readpe_fixture_w16_(oh+ 70, 0x0140); /* dynamic base, NX compatible */
+  readpe_fixture_w64_(oh+ 72, 0x100000);
+  readpe_fixture_w64_(oh+ 80, 0x1000);
+  readpe_fixture_w64_(oh+ 88, 0x100000);
+  readpe_fixture_w64_(oh+ 96, 0x1000);
+  readpe_fixture_w32_(oh+108, 16);     /* data directories */
+
+  uint8_t* dir = oh+112;
+  readpe_fixture_w32_(dir+0*8,   0x2000);  /* export */
+  readpe_fixture_w32_(dir+0*8+4, 0x70);
+  readpe_fixture_w32_(dir+1*8,   0x2080);  /* import */
+  readpe_fixture_w32_(dir+1*8+4, 0x3C);
+  readpe_fixture_w32_(dir+5*8,   0x2200);  /* base relocation */
+  readpe_fixture_w32_(dir+5*8+4, 0x10);
+
+  uint8_t* sec = f+READPE_FIXTURE_SECTIONS;
+  readpe_fixture_section_(sec,    ".text",  0x100, 0x1000, 0x200, 0x200,
+      0x60000020);
+  readpe_fixture_section_(sec+40, ".rdata", 0x300, 0x2000, 0x400, 0x400,
+      0x40000040);
+
+  /* .text: ret, and the pointers to .rdata and .text */
+  f[text_(0x1000)] = 0xC3;
+  f[text_(0x1020)] = 0xC3;
+  readpe_fixture_w64_(f+text_(0x1010), READPE_FIXTURE_IMAGE_BASE + 0x2000);
+  readpe_fixture_w64_(f+text_(0x1018), READPE_FIXTURE_IMAGE_BASE + 0x1000);
+
+  /* export directory */
+  uint8_t* ex = f+rdata_(0x2000);
+  readpe_fixture_w32_(ex+12, 0x2050);  /* name */
+  readpe_fixture_w32_(ex+16, 1);       /* base */
+  readpe_fixture_w32_(ex+20, 3);       /* functions */
+  readpe_fixture_w32_(ex+24, 2);       /* names */
+  readpe_fixture_w32_(ex+28, 0x2028);
+  readpe_fixture_w32_(ex+32, 0x2034);
+  readpe_fixture_w32_(ex+36, 0x203C);
+
+  readpe_fixture_w32_(f+rdata_(0x2028), 0x1000);
+  readpe_fixture_w32_(f+rdata_(0x202C), 0x2060);  /* forwarder */
+  readpe_fixture_w32_(f+rdata_(0x2030), 0x1020);
+  readpe_fixture_w32_(f+rdata_(0x2034), 0x2040);
+  readpe_fixture_w32_(f+rdata_(0x2038), 0x2048);
+  readpe_fixture_w16_(f+rdata_(0x203C), 0);
+  readpe_fixture_w16_(f+rdata_(0x203E), 1);
+  readpe_fixture_str_(f+rdata_(0x2040), "alpha");
+  readpe_fixture_str_(f+rdata_(0x2048), "beta");
+  readpe_fixture_str_(f+rdata_(0x2050), "fixture.dll");
+  readpe_fixture_str_(f+rdata_(0x2060), "KERNEL32.Sleep");
+
+  /* import descriptors, terminated by zeros */
+  uint8_t* im = f+rdata_(0x2080);
+  readpe_fixture_w32_(im+ 0, 0x20C0);
+  readpe_fixture_w32_(im+12, 0x2100);
+  readpe_fixture_w32_(im+16, 0x20E0);
+  readpe_fixture_w32_(im+20, 0x20D0);
+  readpe_fixture_w32_(im+32, 0x2110);
+  readpe_fixture_w32_(im+36, 0x20F0);
+
+  /* INTs and IATs */
+  readpe_fixture_w64_(f+rdata_(0x20C0), 0x2120);
+  readpe_fixture_w64_(f+rdata_(0x20D0), UINT64_C(0x8000000000000003));
+  readpe_fixture_w64_(f+rdata_(0x20E0), 0x2120);
+  readpe_fixture_w64_(f+rdata_(0x20F0), UINT64_C(0x8000000000000003));
+  readpe_fixture_str_(f+rdata_(0x2100), "KERNEL32.dll");
+  readpe_fixture_str_(f+rdata_(0x2110), "WS2_32.dll");
+  readpe_fixture_str_(f+rdata_(0x2122), "ExitProcess");
+
+  /* a block of two DIR64 fixups padded with ABSOLUTE ones */
+  uint8_t* rel = f+rdata_(0x2200);
+  readpe_fixture_w32_(rel+0, 0x1000);
+  readpe_fixture_w32_(rel+4, 0x10);
+  readpe_fixture_w16_(rel+ 8, 0xA010);
+  readpe_fixture_w16_(rel+10, 0xA018);
+  readpe_fixture_w16_(rel+12, 0x0000);
+  readpe_fixture_w16_(rel+14, 0x0000);
+}
+
+const char* readpe_fixture_write(void) {
+  static char path[] = "/tmp/readpe-fixture-XXXXXX";
+  strcpy(path + sizeof(path) - 7, "XXXXXX");
+
+  const int fd = mkstemp(path);
+  if (fd < 0) return NULL;
+
+  uint8_t buf[READPE_FIXTURE_LENGTH];
+  readpe_fixture_build(buf);
+
+  const bool ok = write(fd, buf, sizeof(buf)) == (ssize_t) sizeof(buf);
+  close(fd);
+  if (!ok) {
+    unlink(path);
+    return NULL;
+  }
+  return path;
+}
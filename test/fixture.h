@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A PE32+ DLL built byte by byte, small enough to check by hand:
+ *
+ *   .text  RVA 0x1000, two pointers at 0x1010 and 0x1018 with fixups
+ *   .rdata RVA 0x2000, the export, import and base relocation tables
+ *
+ * It exports "alpha" (ordinal 1), "beta" (ordinal 2, forwarded to
+ * KERNEL32.Sleep) and ordinal 3 by ordinal only, and imports
+ * KERNEL32.dll!ExitProcess by name and WS2_32.dll!#3 (closesocket). */
+#define READPE_FIXTURE_LENGTH     0x800
+#define READPE_FIXTURE_IMAGE_BASE UINT64_C(0x180000000)
+#define READPE_FIXTURE_IMAGE_SIZE 0x3000
+
+void
+readpe_fixture_build(
+    uint8_t* dst  /* must have READPE_FIXTURE_LENGTH bytes */
+);
+
+const char*  /* NULLABLE */
+readpe_fixture_write(
+    void
+);
+    /* Writes the fixture to a temporary file and returns its path, which
+     * is valid until the next call. */
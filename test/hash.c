@@ -0,0 +1,126 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/hash.h"
+#include "lib/readpe.h"
+
+#include "./test.h"
+
+/* Known answers of RFC 1321, FIPS 180-2 and the padding boundaries. The
+ * test runs twice, through the SHA-NI path where the CPU supports it and
+ * through the scalar one built with READPE_HASH_NO_SHANI. */
+typedef struct readpe_test_hash_vector_t {
+  const char* unit;
+  size_t      count;  /* the message is the unit repeated */
+
+  const char* md5;
+  const char* sha1;
+  const char* sha256;
+} readpe_test_hash_vector_t;
+
+static const readpe_test_hash_vector_t readpe_test_hash_vectors_[] = {
+  { "", 1,
+    "d41d8cd98f00b204e9800998ecf8427e",
+    "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", },
+  { "abc", 1,
+    "900150983cd24fb0d6963f7d28e17f72",
+    "a9993e364706816aba3e25717850c26c9cd0d89d",
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", },
+  { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+    "8215ef0796a20bcaaae116d3876c664a",
+    "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", },
+  { "a", 55,
+    "ef1772b6dff9a122358552954ad0df65",
+    "c1c8bbdc22796e28c0e15163d20899b65621d65a",
+    "9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318", },
+  { "a", 56,
+    "3b0c8ac703f828b04c6c197006d17218",
+    "c2db330f6083854c99d4b5bfb6e8f29f201be699",
+    "b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a", },
+  { "a", 64,
+    "014842d480b571495a4a0363793f7367",
+    "0098ba824b5c16427bd7a1122a5a442a25ec644d",
+    "ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb", },
+  { "a", 119,
+    "8a7bd0732ed6a28ce75f6dabc90e1613",
+    "ee971065aaa017e0632a8ca6c77bb3bf8b1dfc56",
+    "31eba51c313a5c08226adf18d4a359cfdfd8d2e816b13f4af952f7ea6584dcfb", },
+  { "a", 1000000,
+    "7707d6ae4e027c70eea2a935c2296f21",
+    "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+    "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", },
+};
+
+static void readpe_test_hash_check_(
+    const readpe_test_hash_vector_t* v,
+    const readpe_hash_t*             hash,
+    unsigned                         algorithms) {
+  static const uint8_t zero[32] = {0};
+
+  uint8_t md5[16], sha1[20], sha256[32];
+  readpe_test_parse_hex(v->md5,    md5,    sizeof(md5));
+  readpe_test_parse_hex(v->sha1,   sha1,   sizeof(sha1));
+  readpe_test_parse_hex(v->sha256, sha256, sizeof(sha256));
+
+  READPE_TEST_CHECK_BYTES(hash->md5,
+      algorithms & READPE_HASH_MD5? md5: zero, sizeof(md5));
+  READPE_TEST_CHECK_BYTES(hash->sha1,
+      algorithms & READPE_HASH_SHA1? sha1: zero, sizeof(sha1));
+  READPE_TEST_CHECK_BYTES(hash->sha256,
+      algorithms & READPE_HASH_SHA256? sha256: zero, sizeof(sha256));
+}
+
+int main(void) {
+  static const unsigned algorithms[] = {
+    READPE_HASH_ALL,
+    READPE_HASH_MD5,
+    READPE_HASH_SHA1,
+    READPE_HASH_SHA256,
+    READPE_HASH_SHA1 | READPE_HASH_SHA256,
+  };
+  static const size_t chunks[] = { 1, 7, 63, 64, 65, 4096, };
+
+  const size_t vectors =
+      sizeof(readpe_test_hash_vectors_)/sizeof(readpe_test_hash_vectors_[0]);
+  for (size_t i = 0; i < vectors; ++i) {
+    const readpe_test_hash_vector_t* v = &readpe_test_hash_vectors_[i];
+
+    const size_t unit = strlen(v->unit);
+    const size_t len  = unit*v->count;
+    uint8_t* msg = malloc(len + 1);
+    if (msg == NULL) return EXIT_FAILURE;
+    for (size_t j = 0; j < v->count; ++j) {
+      memcpy(msg + j*unit, v->unit, unit);
+    }
+
+    for (size_t a = 0; a < sizeof(algorithms)/sizeof(algorithms[0]); ++a) {
+      readpe_hash_state_t st;
+      readpe_hash_t       hash;
+      readpe_hash_initialize(&st, algorithms[a]);
+      readpe_hash_update(&st, msg, len);
+      readpe_hash_finalize(&st, &hash);
+      readpe_test_hash_check_(v, &hash, algorithms[a]);
+    }
+
+    /* the buffering of partial blocks over updates of every size */
+    for (size_t c = 0; c < sizeof(chunks)/sizeof(chunks[0]); ++c) {
+      if (len > 100000 && chunks[c] < 64) continue;
+
+      readpe_hash_state_t st;
+      readpe_hash_t       hash;
+      readpe_hash_initialize(&st, READPE_HASH_ALL);
+      for (size_t off = 0; off < len; off += chunks[c]) {
+        const size_t n = len - off < chunks[c]? len - off: chunks[c];
+        readpe_hash_update(&st, msg + off, n);
+      }
+      readpe_hash_finalize(&st, &hash);
+      readpe_test_hash_check_(v, &hash, READPE_HASH_ALL);
+    }
+    free(msg);
+  }
+  return READPE_TEST_RESULT();
+}
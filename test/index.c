@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "lib/readpe.h"
+
+#include "./fixture.h"
+#include "./test.h"
+
+static bool readpe_test_find_(
+    const readpe_index_t* idx,
+    readpe_index_kind_t   kind,
+    const char*           key,
+    bool                  prefix,
+    readpe_index_symbol_t* sym) {
+  size_t begin, end;
+  if (readpe_index_find(
+        idx, kind, key, strlen(key), prefix, &begin, &end) != READPE_OK) {
+    return false;
+  }
+  if (end - begin != 1) return false;
+  return readpe_index_get_symbol(idx, begin, sym);
+}
+
+static bool readpe_test_path_is_(
+    const readpe_index_t* idx, uint32_t index, const char* path) {
+  size_t len;
+  const char* p = readpe_index_get_path(idx, index, &len);
+  return p != NULL && len == strlen(path) && memcmp(p, path, len) == 0;
+}
+
+int main(void) {
+  static uint8_t buf[READPE_FIXTURE_LENGTH], stripped[READPE_FIXTURE_LENGTH];
+  readpe_fixture_build(buf);
+
+  /* the other file imports nothing */
+  readpe_fixture_build(stripped);
+  memset(stripped + 0x58 + 112 + 8, 0, 8);
+
+  readpe_context_t *ctx, *ctx2;
+  if (readpe_context_create_from_memory(
+        &ctx, buf, sizeof(buf)) != READPE_OK ||
+      readpe_context_create_from_memory(
+        &ctx2, stripped, sizeof(stripped)) != READPE_OK) {
+    fprintf(stderr, "failed to parse the fixture\n");
+    return EXIT_FAILURE;
+  }
+
+  char path[] = "/tmp/readpe-index-XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) return EXIT_FAILURE;
+  close(fd);
+
+  /* added in reverse order of the paths */
+  readpe_index_builder_t* builder;
+  READPE_TEST_CHECK(readpe_index_builder_create(&builder) == READPE_OK);
+  READPE_TEST_CHECK(
+      readpe_index_builder_add(builder, "z/fixture.dll", ctx) == READPE_OK);
+  READPE_TEST_CHECK(
+      readpe_index_builder_add(builder, "a/exports.dll", ctx2) == READPE_OK);
+  READPE_TEST_CHECK(readpe_index_builder_write(builder, path) == READPE_OK);
+  readpe_index_builder_destroy(builder);
+
+  readpe_context_destroy(ctx);
+  readpe_context_destroy(ctx2);
+
+  readpe_index_t* idx;
+  READPE_TEST_CHECK(readpe_index_open(&idx, path) == READPE_OK);
+  unlink(path);
+  if (readpe_test_failures_) return EXIT_FAILURE;
+
+  READPE_TEST_CHECK(readpe_index_get_files_length(idx) == 2);
+  READPE_TEST_CHECK(readpe_test_path_is_(idx, 0, "a/exports.dll"));
+  READPE_TEST_CHECK(readpe_test_path_is_(idx, 1, "z/fixture.dll"));
+  size_t len;
+  READPE_TEST_CHECK(readpe_index_get_path(idx, 2, &len) == NULL);
+
+  readpe_index_symbol_t sym;
+  READPE_TEST_CHECK(readpe_test_find_(
+      idx, READPE_INDEX_EXPORT, "alpha", false, &sym));
+  READPE_TEST_CHECK(sym.kind == READPE_INDEX_EXPORT);
+  READPE_TEST_CHECK(sym.files_length == 2);
+  READPE_TEST_CHECK(sym.files[0] == 0 && sym.files[1] == 1);
+
+  READPE_TEST_CHECK(readpe_test_find_(
+      idx, READPE_INDEX_EXPORT, "be", true, &sym));
+  READPE_TEST_CHECK(sym.name_length == 4 && memcmp(sym.name, "beta", 4) == 0);
+
+  /* the DLL name in any case, with ".dll" assumed */
+  READPE_TEST_CHECK(readpe_test_find_(
+      idx, READPE_INDEX_IMPORT, "KERNEL32!ExitProcess", false, &sym));
+  READPE_TEST_CHECK(sym.kind == READPE_INDEX_IMPORT);
+  READPE_TEST_CHECK(sym.files_length == 1 && sym.files[0] == 1);
+  READPE_TEST_CHECK(readpe_test_find_(
+      idx, READPE_INDEX_IMPORT, "ws2_32.dll!#3", false, &sym));
+  READPE_TEST_CHECK(sym.files_length == 1 && sym.files[0] == 1);
+
+  size_t begin, end;
+  READPE_TEST_CHECK(readpe_index_find(
+      idx, READPE_INDEX_EXPORT, "gamma", 5, false, &begin, &end) ==
+      READPE_OK);
+  READPE_TEST_CHECK(begin == end);
+  READPE_TEST_CHECK(readpe_index_find(
+      idx, READPE_INDEX_IMPORT, "alpha", 5, false, &begin, &end) ==
+      READPE_OK);
+  READPE_TEST_CHECK(begin == end);
+  READPE_TEST_CHECK(readpe_index_find(
+      idx, READPE_INDEX_EXPORT, "", 0, true, &begin, &end) == READPE_OK);
+  READPE_TEST_CHECK(end - begin == 2);
+
+  readpe_index_close(idx);
+  return READPE_TEST_RESULT();
+}
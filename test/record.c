@@ -0,0 +1,213 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include "lib/readpe.h"
+
+#include "./fixture.h"
+#include "./test.h"
+
+/* Runs the readpe executable given as the argument over the fixture, and
+ * reads the records written back through the reader of the library. */
+#define READPE_TEST_OPTIONS  \
+    "--format=record --export-table --import-table --relocation-table " \
+    "--authenticode"
+
+static uint8_t* readpe_test_run_(const char* cmd, size_t* len) {
+  FILE* fp = popen(cmd, "r");
+  if (fp == NULL) return NULL;
+
+  /* records must be aligned to 8 bytes, as malloc does */
+  size_t   cap = 4096;
+  uint8_t* buf = malloc(cap);
+  *len = 0;
+  for (;;) {
+    if (buf == NULL) break;
+    const size_t n = fread(buf + *len, 1, cap - *len, fp);
+    *len += n;
+    if (*len < cap) break;
+    cap *= 2;
+    uint8_t* grown = realloc(buf, cap);
+    if (grown == NULL) free(buf);
+    buf = grown;
+  }
+  if (pclose(fp) != 0) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+static bool readpe_test_string_is_(
+    const readpe_record_column_t* col, size_t row, const char* str) {
+  size_t len;
+  const char* s = readpe_record_get_string(col, row, &len);
+  return len == strlen(str) && memcmp(s, str, len) == 0;
+}
+
+static void readpe_test_exports_(const readpe_record_table_t* t) {
+  READPE_TEST_CHECK(t->rows == 3);
+
+  readpe_record_column_t ord, name, fwd, fwder;
+  READPE_TEST_CHECK(readpe_record_find_column(t, "ordinal", &ord));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "name", &name));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "forwarded", &fwd));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "forwarder", &fwder));
+  if (readpe_test_failures_ || t->rows != 3) return;
+
+  READPE_TEST_CHECK(ord.type == READPE_RECORD_TYPE_U32);
+  READPE_TEST_CHECK(name.type == READPE_RECORD_TYPE_STRING);
+  for (size_t i = 0; i < 3; ++i) {
+    READPE_TEST_CHECK(readpe_record_get_value(&ord, i) == i+1);
+    READPE_TEST_CHECK(readpe_record_get_value(&fwd, i) == (i == 1));
+  }
+  READPE_TEST_CHECK(readpe_test_string_is_(&name, 0, "alpha"));
+  READPE_TEST_CHECK(readpe_test_string_is_(&name, 1, "beta"));
+  READPE_TEST_CHECK(readpe_test_string_is_(&name, 2, ""));
+  READPE_TEST_CHECK(readpe_test_string_is_(&fwder, 1, "KERNEL32.Sleep"));
+}
+
+static void readpe_test_imports_(const readpe_record_table_t* t) {
+  READPE_TEST_CHECK(t->rows == 2);
+
+  readpe_record_column_t dll, hint, by_ordinal, name;
+  READPE_TEST_CHECK(readpe_record_find_column(t, "dll", &dll));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "hint", &hint));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "by_ordinal", &by_ordinal));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "name", &name));
+  if (readpe_test_failures_ || t->rows != 2) return;
+
+  READPE_TEST_CHECK(readpe_record_get_value(&dll, 0) == 0);
+  READPE_TEST_CHECK(readpe_record_get_value(&by_ordinal, 0) == 0);
+  READPE_TEST_CHECK(readpe_test_string_is_(&name, 0, "ExitProcess"));
+  READPE_TEST_CHECK(readpe_record_get_value(&dll, 1) == 1);
+  READPE_TEST_CHECK(readpe_record_get_value(&by_ordinal, 1) == 1);
+  READPE_TEST_CHECK(readpe_record_get_value(&hint, 1) == 3);
+}
+
+static void readpe_test_authenticode_(const readpe_record_table_t* t) {
+  READPE_TEST_CHECK(t->rows == 1);
+
+  readpe_record_column_t checksum, sha256;
+  READPE_TEST_CHECK(
+      readpe_record_find_column(t, "computed_checksum", &checksum));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "sha256", &sha256));
+  if (readpe_test_failures_ || t->rows != 1) return;
+
+  READPE_TEST_CHECK(readpe_record_get_value(&checksum, 0) == 0xDEF9);
+
+  uint8_t expected[32];
+  readpe_test_parse_hex(
+      "f14b4608a4b11f2690650f6f15db79c49559f79408e6f09a3bff68da9370220d",
+      expected, sizeof(expected));
+  size_t len;
+  const char* digest = readpe_record_get_string(&sha256, 0, &len);
+  READPE_TEST_CHECK(len == 32 && memcmp(digest, expected, 32) == 0);
+}
+
+static void readpe_test_relocations_(const readpe_record_table_t* t) {
+  READPE_TEST_CHECK(t->rows == 4);
+
+  readpe_record_column_t rva, type;
+  READPE_TEST_CHECK(readpe_record_find_column(t, "rva", &rva));
+  READPE_TEST_CHECK(readpe_record_find_column(t, "type", &type));
+  if (readpe_test_failures_ || t->rows != 4) return;
+
+  READPE_TEST_CHECK(readpe_record_get_value(&rva, 0) == 0x1010);
+  READPE_TEST_CHECK(readpe_record_get_value(&rva, 1) == 0x1018);
+  READPE_TEST_CHECK(readpe_record_get_value(&type, 0) == 10);
+  READPE_TEST_CHECK(readpe_record_get_value(&type, 3) == 0);
+}
+
+static void readpe_test_record_(
+    const readpe_record_t* rec, const char* path) {
+  READPE_TEST_CHECK(rec->status == READPE_OK);
+  READPE_TEST_CHECK(rec->path_length == strlen(path) &&
+      memcmp(rec->path, path, rec->path_length) == 0);
+
+  unsigned seen = 0;
+
+  size_t offset = 0;
+  readpe_record_table_t t;
+  while (readpe_record_next_table(rec, &offset, &t)) {
+    seen |= 1u << t.kind;
+    switch (t.kind) {
+    case READPE_RECORD_TABLE_EXPORTS:
+      readpe_test_exports_(&t);
+      break;
+    case READPE_RECORD_TABLE_IMPORTS:
+      readpe_test_imports_(&t);
+      break;
+    case READPE_RECORD_TABLE_AUTHENTICODE:
+      readpe_test_authenticode_(&t);
+      break;
+    case READPE_RECORD_TABLE_RELOCATIONS:
+      readpe_test_relocations_(&t);
+      break;
+    default:
+      break;
+    }
+  }
+  READPE_TEST_CHECK(offset == rec->tables_length);
+  READPE_TEST_CHECK(seen & (1u << READPE_RECORD_TABLE_EXPORTS));
+  READPE_TEST_CHECK(seen & (1u << READPE_RECORD_TABLE_IMPORTS));
+  READPE_TEST_CHECK(seen & (1u << READPE_RECORD_TABLE_AUTHENTICODE));
+  READPE_TEST_CHECK(seen & (1u << READPE_RECORD_TABLE_RELOCATIONS));
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <readpe executable>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const char* fixture = readpe_fixture_write();
+  if (fixture == NULL) {
+    fprintf(stderr, "failed to write the fixture\n");
+    return EXIT_FAILURE;
+  }
+  char path[64];
+  snprintf(path, sizeof(path), "%s", fixture);
+
+  char cmd[1024];
+  snprintf(cmd, sizeof(cmd), "'%s' '%s' '%s' %s",
+      argv[1], path, path, READPE_TEST_OPTIONS);
+
+  size_t   len;
+  uint8_t* buf = readpe_test_run_(cmd, &len);
+  unlink(path);
+  if (buf == NULL) {
+    fprintf(stderr, "failed to run readpe\n");
+    return EXIT_FAILURE;
+  }
+
+  /* a record of each input, in order */
+  size_t          offset = 0, first = 0;
+  readpe_record_t rec;
+  for (size_t i = 0; i < 2; ++i) {
+    READPE_TEST_CHECK(
+        readpe_record_read(buf, len, &offset, &rec) == READPE_OK);
+    if (readpe_test_failures_) break;
+    readpe_test_record_(&rec, path);
+    if (i == 0) first = offset;
+  }
+  READPE_TEST_CHECK(offset == len);
+
+  /* the reader rejects truncated and broken records */
+  if (first > 8) {
+    offset = 0;
+    READPE_TEST_CHECK(
+        readpe_record_read(buf, first - 8, &offset, &rec) != READPE_OK);
+    buf[0] ^= 0xFF;
+    offset = 0;
+    READPE_TEST_CHECK(
+        readpe_record_read(buf, len, &offset, &rec) != READPE_OK);
+  }
+  free(buf);
+  return READPE_TEST_RESULT();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Each test is an executable reporting failed checks to stderr, and
+ * exiting with a failure if any. */
+static int readpe_test_failures_ = 0;
+
+#define READPE_TEST_CHECK(expr) do {  \
+      if (!(expr)) {  \
+        fprintf(stderr, "%s:%d: check failed: %s\n",  \
+            __FILE__, __LINE__, #expr);  \
+        ++readpe_test_failures_;  \
+      }  \
+    } while (0)
+
+#define READPE_TEST_CHECK_BYTES(a, b, n) \
+    READPE_TEST_CHECK(memcmp((a), (b), (n)) == 0)
+
+#define READPE_TEST_RESULT()  \
+    (readpe_test_failures_ == 0? EXIT_SUCCESS: EXIT_FAILURE)
+
+static inline void readpe_test_parse_hex(
+    const char* hex, uint8_t* dst, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    unsigned v;
+    sscanf(hex + i*2, "%2x", &v);
+    dst[i] = (uint8_t) v;
+  }
+}